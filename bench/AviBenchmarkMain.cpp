@@ -0,0 +1,263 @@
+// Benchmark and round-trip check for AviWriter, portable to Linux: write
+// throughput and the cost of each WriteFrame() call, then every file is read
+// back through AviReader and each frame compared with what was written.
+// Results go out as one JSON document:
+//   {"options": {...}, "results": [{"name": ..., ...}, ...]}
+//
+// The raw 1080p run writes past 2 GB, so it spans several RIFFs and checks
+// the OpenDML indexes where plain AVI would have given out. A copy of the
+// MJPEG file cut short must still open and read back every frame left
+// whole, found by walking the movi lists once its indexes no longer fit.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DNDEBUG -Isrc bench/AviBenchmarkMain.cpp src/AviFile.cpp src/PixelConversion.cpp
+//       src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp src/CpuFeatures.cpp
+//       src/FrameLatency.cpp src/LatencyHistogram.cpp src/Log.cpp src/ThreadCpu.cpp src/Trace.cpp
+//       -lpthread -o avi_benchmark
+//
+// Usage: avi_benchmark [--dir DIR] [--quick] [--keep] [--out FILE]
+// Exits with 1 if any frame fails to round-trip.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "AviFile.h"
+#include "FrameLatency.h"
+#include "Log.h"
+#include "PixelConversion.h"
+
+struct BenchmarkOptions {
+    std::string directory = "avi-benchmark";
+    bool quick = false;     // Smaller files, none past 2 GB
+    bool keep = false;      // Leave the files on disk
+    std::string outPath;
+};
+
+struct RunConfig {
+    const char* name;
+    PixelFormat format;
+    int width;
+    int height;
+    uint64_t frames;
+    uint64_t quickFrames;
+};
+
+// Frame 'index' of a run: raw frames have the full size, MJPEG-like ones
+// vary in size, odd sizes included, as compressed frames do.
+static size_t FrameBytes(const RunConfig& run, uint64_t index) {
+    if (run.format != PixelFormat::MJPEG) {
+        return FrameSize(run.format, run.height, DefaultStride(run.format, run.width));
+    }
+    return 150000 + static_cast<size_t>((index * 7919) % 100001);
+}
+
+static void FillFrame(uint64_t index, uint8_t* data, size_t size) {
+    uint32_t state = static_cast<uint32_t>(index) * 2654435761u + 1;
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        state = state * 1664525u + 1013904223u;
+        memcpy(data + i, &state, 4);
+    }
+    for (; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(index + i);
+    }
+}
+
+static const char* SourceName(AviReader::IndexSource source) {
+    switch (source) {
+    case AviReader::IndexSource::SuperIndex: return "indx";
+    case AviReader::IndexSource::Legacy: return "idx1";
+    case AviReader::IndexSource::Scan: return "scan";
+    default: return "none";
+    }
+}
+
+// Read the file back and compare every frame. Returns the frames that
+// matched, or -1 if the file would not open or the format is wrong.
+static int64_t VerifyFile(const std::filesystem::path& path, const RunConfig& run, double fps,
+    AviReader::IndexSource* source, double* megabytesPerSecond) {
+    AviReader reader;
+    if (!reader.Open(path)) {
+        return -1;
+    }
+    *source = reader.Source();
+    const VideoFormat& format = reader.Format();
+    if (format.format != run.format || format.width != run.width || format.height != run.height ||
+        reader.FramesPerSecond() < fps - 0.01 || reader.FramesPerSecond() > fps + 0.01) {
+        return -1;
+    }
+
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> actual;
+    uint64_t bytes = 0;
+    int64_t matched = 0;
+    const int64_t start = MonotonicNanos();
+    for (uint64_t i = 0; i < reader.FrameCount(); ++i) {
+        size_t size = 0;
+        if (!reader.ReadFrame(i, &actual, &size)) {
+            break;
+        }
+        expected.resize(FrameBytes(run, i));
+        FillFrame(i, expected.data(), expected.size());
+        if (size != expected.size() || memcmp(actual.data(), expected.data(), size) != 0) {
+            fprintf(stderr, "%s: frame %llu differs\n", run.name, static_cast<unsigned long long>(i));
+            break;
+        }
+        bytes += size;
+        ++matched;
+    }
+    *megabytesPerSecond = bytes / 1e6 / ((MonotonicNanos() - start) / 1e9);
+    return matched;
+}
+
+static bool RunAvi(const BenchmarkOptions& options, const RunConfig& run, std::string& json) {
+    fprintf(stderr, "%s\n", run.name);
+    const std::filesystem::path path = std::filesystem::path(options.directory) / (std::string(run.name) + ".avi");
+    const uint64_t frameCount = options.quick ? run.quickFrames : run.frames;
+    const double fps = 30.0;
+
+    VideoFormat format;
+    format.format = run.format;
+    format.width = run.width;
+    format.height = run.height;
+    format.stride = DefaultStride(run.format, run.width);
+
+    // Frame contents are made up front so the timing covers only the writer
+    // and the disk.
+    std::vector<std::vector<uint8_t>> pattern(16);
+    for (uint64_t i = 0; i < pattern.size(); ++i) {
+        pattern[i].resize(FrameBytes(run, i));
+        FillFrame(i, pattern[i].data(), pattern[i].size());
+    }
+
+    AviWriter writer;
+    if (!writer.Open(path, format, fps)) {
+        fprintf(stderr, "Could not create %s\n", path.string().c_str());
+        return false;
+    }
+    LatencyHistogram writeLatency;
+    std::vector<uint8_t> frame;
+    uint64_t written = 0;
+    int64_t writeNanos = 0;
+    for (uint64_t i = 0; i < frameCount; ++i) {
+        const std::vector<uint8_t>* data = &pattern[i];
+        if (i >= pattern.size()) {
+            frame.resize(FrameBytes(run, i));
+            FillFrame(i, frame.data(), frame.size());
+            data = &frame;
+        }
+        const int64_t before = MonotonicNanos();
+        if (!writer.WriteFrame(data->data(), data->size())) {
+            break;
+        }
+        const int64_t elapsed = MonotonicNanos() - before;
+        writeLatency.Record(elapsed);
+        writeNanos += elapsed;
+        ++written;
+    }
+    const int64_t beforeClose = MonotonicNanos();
+    const uint64_t fileBytes = writer.BytesWritten();
+    const bool closed = writer.Close();
+    writeNanos += MonotonicNanos() - beforeClose;
+
+    AviReader::IndexSource source = AviReader::IndexSource::None;
+    double readMegabytesPerSecond = 0.0;
+    const int64_t matched = VerifyFile(path, run, fps, &source, &readMegabytesPerSecond);
+    const bool ok = closed && written == frameCount && matched == static_cast<int64_t>(frameCount) &&
+        source == AviReader::IndexSource::SuperIndex;
+
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+        "{\"name\": \"%s\", \"frames\": %llu, \"file_mb\": %.1f, \"write_mb_per_s\": %.1f, "
+        "\"read_mb_per_s\": %.1f, \"index\": \"%s\", \"frames_matched\": %lld, \"ok\": %s, \"write_frame\": ",
+        run.name, static_cast<unsigned long long>(written), fileBytes / 1e6, fileBytes / 1e6 / (writeNanos / 1e9),
+        readMegabytesPerSecond, SourceName(source), static_cast<long long>(matched), ok ? "true" : "false");
+    json += buffer;
+    AppendLatencySummaryJson(json, writeLatency.Summarize());
+    json += '}';
+
+    // A file cut short, as by a full disk or a copy that stopped: the
+    // header points past the end, so the reader has to find the frames.
+    bool truncatedOk = true;
+    if (run.format == PixelFormat::MJPEG) {
+        const std::filesystem::path cut = std::filesystem::path(options.directory) / "truncated.avi";
+        std::error_code error;
+        std::filesystem::copy_file(path, cut, std::filesystem::copy_options::overwrite_existing, error);
+        std::filesystem::resize_file(cut, fileBytes * 2 / 3, error);
+        const int64_t truncatedMatched = error ? -1 : VerifyFile(cut, run, fps, &source, &readMegabytesPerSecond);
+        truncatedOk = truncatedMatched >= static_cast<int64_t>(written * 2 / 3 * 99 / 100);
+        snprintf(buffer, sizeof(buffer),
+            ",\n  {\"name\": \"%s, truncated to 2/3\", \"index\": \"%s\", \"frames_matched\": %lld, \"ok\": %s}",
+            run.name, SourceName(source), static_cast<long long>(truncatedMatched), truncatedOk ? "true" : "false");
+        json += buffer;
+        std::filesystem::remove(cut, error);
+    }
+
+    if (!options.keep) {
+        std::filesystem::remove(path);
+    }
+    return ok && truncatedOk;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--dir") == 0 && hasValue) {
+            options.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        }
+        else if (strcmp(argv[i], "--keep") == 0) {
+            options.keep = true;
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--dir DIR] [--quick] [--keep] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    LogSetOutput(stderr);
+    std::error_code error;
+    std::filesystem::create_directories(options.directory, error);
+
+    // 1080p YUY2 frames are 4 MB, so 640 of them make a 2.65 GB file
+    const RunConfig runs[] = {
+        { "mjpeg 1080p", PixelFormat::MJPEG, 1920, 1080, 5000, 3000 },
+        { "yuy2 1080p", PixelFormat::YUY2, 1920, 1080, 640, 120 },
+        { "nv12 720p", PixelFormat::NV12, 1280, 720, 1500, 300 },
+        { "bgr24 640x480", PixelFormat::BGR24, 640, 480, 2000, 300 },
+    };
+
+    std::string json = "{\"options\": {\"directory\": \"" + options.directory + "\", \"quick\": " +
+        (options.quick ? "true" : "false") + "},\n\"results\": [\n";
+    bool ok = true;
+    for (size_t i = 0; i < std::size(runs); ++i) {
+        json += i == 0 ? "  " : ",\n  ";
+        ok &= RunAvi(options, runs[i], json);
+    }
+    json += "\n]}\n";
+    if (!options.keep) {
+        std::filesystem::remove(options.directory, error);
+    }
+    LogShutdown();
+
+    if (options.outPath.empty()) {
+        fputs(json.c_str(), stdout);
+    }
+    else {
+        std::ofstream out(options.outPath, std::ios::trunc);
+        if (!(out << json)) {
+            fprintf(stderr, "Could not write %s\n", options.outPath.c_str());
+            return 1;
+        }
+    }
+    return ok ? 0 : 1;
+}
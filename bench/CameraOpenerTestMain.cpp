@@ -0,0 +1,215 @@
+// CameraOpener against a mock device whose open outlasts the timeout,
+// portable to Linux. The UI side is a thread polling Status() every
+// millisecond, as the render loop does. Scenarios:
+//   blocking     one driver call sleeps past the timeout without looking at
+//                the context; Status() must report the open failed with
+//                kCameraOpenTimedOut at the deadline, not when the call
+//                returns, and must not change its mind afterwards
+//   cooperative  the open checks the context between steps; it must see the
+//                open cancelled at the deadline and stop
+//   queued       a new open posted while the worker is stuck in a timed-out
+//                call; it runs, and succeeds, once the call returns
+// After each timeout the device must have been closed, and an open of a
+// device that is fast again must succeed. Results go out as one JSON line
+// per scenario; the exit code is 1 if a check failed.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -Isrc bench/CameraOpenerTestMain.cpp src/CameraOpener.cpp src/ThreadCpu.cpp
+//       src/Trace.cpp src/FrameLatency.cpp src/LatencyHistogram.cpp src/Log.cpp -lpthread -o camera_opener_test
+//
+// Usage: camera_opener_test [--timeout MS]
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include "CameraOpener.h"
+#include "FrameLatency.h"
+
+static const int kSteps = 4;
+
+// Opens in kSteps steps lasting 'openMs' in all. Blocking opens spend it in
+// one call that never looks at the context.
+class SlowDevice : public CameraDevice {
+public:
+    std::atomic<int> openMs{ 0 };
+    std::atomic<bool> blocking{ false };
+    std::atomic<int> opens{ 0 };
+    std::atomic<int> closes{ 0 };
+    std::atomic<int> sawCancel{ 0 };
+    std::atomic<int64_t> lastOpenNanos{ 0 };  // Time spent in the last OpenDevice()
+
+    long OpenDevice(const std::wstring&, CameraOpenContext& context) override {
+        const int64_t start = MonotonicNanos();
+        ++opens;
+        const int total = openMs.load();
+        long hr = 0;
+        if (blocking.load()) {
+            context.Step("Building graph");
+            std::this_thread::sleep_for(std::chrono::milliseconds(total));
+        }
+        else {
+            for (int step = 0; step < kSteps; ++step) {
+                if (context.Cancelled()) {
+                    ++sawCancel;
+                    hr = -1;
+                    break;
+                }
+                context.Step("Warming up");
+                std::this_thread::sleep_for(std::chrono::milliseconds(total / kSteps));
+            }
+        }
+        lastOpenNanos.store(MonotonicNanos() - start);
+        return hr;
+    }
+
+    void CloseDevice() override {
+        ++closes;
+    }
+};
+
+// Polls Status() until 'done' says so or 'limitMs' passes. Returns the last
+// status and the milliseconds from 'start' at which it first met 'done'.
+template <typename Predicate>
+static CameraStatus WaitFor(const CameraOpener& opener, int64_t start, int limitMs, Predicate&& done, double* atMs) {
+    CameraStatus status;
+    while (true) {
+        status = opener.Status();
+        const int64_t now = MonotonicNanos();
+        if (done(status)) {
+            *atMs = (now - start) / 1e6;
+            return status;
+        }
+        if (now - start > static_cast<int64_t>(limitMs) * 1000000) {
+            *atMs = -1.0;
+            return status;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+static bool TimedOut(const CameraStatus& status) {
+    return status.state == CameraState::Failed && status.result == kCameraOpenTimedOut;
+}
+
+static bool Report(const char* scenario, bool ok, const char* format, ...) {
+    char details[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(details, sizeof(details), format, args);
+    va_end(args);
+    printf("{\"scenario\": \"%s\", %s, \"ok\": %s}\n", scenario, details, ok ? "true" : "false");
+    return ok;
+}
+
+// Open a device that is fast again; must succeed well inside the timeout.
+static bool OpensAfterwards(CameraOpener& opener, SlowDevice& device, double* openMs) {
+    device.blocking = false;
+    device.openMs = 20;
+    opener.Open(L"fast");
+    double atMs = 0.0;
+    const CameraStatus status = WaitFor(opener, MonotonicNanos(), 2000,
+        [](const CameraStatus& s) { return s.path == L"fast" && (s.state == CameraState::Open || s.state == CameraState::Failed); },
+        &atMs);
+    *openMs = status.openMs;
+    return status.state == CameraState::Open;
+}
+
+int main(int argc, char** argv) {
+    int timeoutMs = 200;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            timeoutMs = atoi(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--timeout MS]\n", argv[0]);
+            return 2;
+        }
+    }
+    // Room for scheduling between the deadline and the UI's next poll
+    const double slackMs = 50.0;
+    bool ok = true;
+
+    {
+        SlowDevice device;
+        CameraOpener opener(&device, kSteps, std::chrono::milliseconds(timeoutMs));
+        device.blocking = true;
+        device.openMs = timeoutMs * 3;
+        const int64_t start = MonotonicNanos();
+        opener.Open(L"blocking");
+        double failedAtMs = 0.0;
+        WaitFor(opener, start, timeoutMs * 10, TimedOut, &failedAtMs);
+        // The driver call is still running; the UI keeps seeing the failure
+        // through its return and after
+        bool steady = true;
+        double settledAtMs = 0.0;
+        WaitFor(opener, start, timeoutMs * 10, [&](const CameraStatus& s) {
+            steady &= TimedOut(s);
+            return device.closes.load() > 0;
+        }, &settledAtMs);
+        steady &= TimedOut(opener.Status());
+        const CameraOpenerStats stats = opener.GetStats();
+        double reopenMs = 0.0;
+        const bool reopened = OpensAfterwards(opener, device, &reopenMs);
+        const bool passed = failedAtMs >= timeoutMs && failedAtMs <= timeoutMs + slackMs && steady &&
+            settledAtMs >= timeoutMs * 3 && stats.timedOut == 1 && stats.failed == 1 && device.closes >= 1 &&
+            reopened && reopenMs < timeoutMs;
+        ok &= Report("blocking", passed,
+            "\"timeout_ms\": %d, \"failed_at_ms\": %.1f, \"call_returned_at_ms\": %.1f, \"stayed_failed\": %s, "
+            "\"timed_out\": %llu, \"closes\": %d, \"reopened\": %s, \"reopen_ms\": %.1f",
+            timeoutMs, failedAtMs, settledAtMs, steady ? "true" : "false",
+            static_cast<unsigned long long>(stats.timedOut), device.closes.load(), reopened ? "true" : "false", reopenMs);
+    }
+
+    {
+        SlowDevice device;
+        CameraOpener opener(&device, kSteps, std::chrono::milliseconds(timeoutMs));
+        device.openMs = timeoutMs * 5;
+        const int64_t start = MonotonicNanos();
+        opener.Open(L"cooperative");
+        double failedAtMs = 0.0;
+        WaitFor(opener, start, timeoutMs * 10, TimedOut, &failedAtMs);
+        double settledAtMs = 0.0;
+        WaitFor(opener, start, timeoutMs * 10, [&](const CameraStatus&) { return device.closes.load() > 0; }, &settledAtMs);
+        // The open gives up at the first step after the deadline
+        const double openCallMs = device.lastOpenNanos.load() / 1e6;
+        const double stepMs = timeoutMs * 5.0 / kSteps;
+        double reopenMs = 0.0;
+        const bool reopened = OpensAfterwards(opener, device, &reopenMs);
+        const bool passed = failedAtMs >= timeoutMs && failedAtMs <= timeoutMs + slackMs && device.sawCancel == 1 &&
+            openCallMs <= timeoutMs + stepMs + slackMs && opener.GetStats().timedOut == 1 && reopened;
+        ok &= Report("cooperative", passed,
+            "\"timeout_ms\": %d, \"failed_at_ms\": %.1f, \"open_call_ms\": %.1f, \"saw_cancel\": %d, "
+            "\"reopened\": %s, \"reopen_ms\": %.1f",
+            timeoutMs, failedAtMs, openCallMs, device.sawCancel.load(), reopened ? "true" : "false", reopenMs);
+    }
+
+    {
+        SlowDevice device;
+        CameraOpener opener(&device, kSteps, std::chrono::milliseconds(timeoutMs));
+        device.blocking = true;
+        device.openMs = timeoutMs * 3;
+        const int64_t start = MonotonicNanos();
+        opener.Open(L"stuck");
+        double failedAtMs = 0.0;
+        WaitFor(opener, start, timeoutMs * 10, TimedOut, &failedAtMs);
+        // The user tries again while the worker is still stuck
+        device.blocking = false;
+        device.openMs = 20;
+        opener.Open(L"retry");
+        double openAtMs = 0.0;
+        const CameraStatus status = WaitFor(opener, start, timeoutMs * 10,
+            [](const CameraStatus& s) { return s.state == CameraState::Open; }, &openAtMs);
+        const bool passed = failedAtMs >= timeoutMs && failedAtMs <= timeoutMs + slackMs &&
+            status.state == CameraState::Open && status.path == L"retry" && openAtMs >= timeoutMs * 3 &&
+            device.opens == 2 && opener.GetStats().opened == 1;
+        ok &= Report("queued", passed,
+            "\"timeout_ms\": %d, \"failed_at_ms\": %.1f, \"retry_open_at_ms\": %.1f, \"opens\": %d",
+            timeoutMs, failedAtMs, openAtMs, device.opens.load());
+    }
+    return ok ? 0 : 1;
+}
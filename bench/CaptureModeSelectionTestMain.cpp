@@ -0,0 +1,175 @@
+// Checks CaptureCapabilities::Select() against capability tables recorded
+// from real cameras, portable to Linux. Each case names the mode a policy
+// must pick, including the cases where MJPEG has to win over an
+// uncompressed format (bus limits, latency with a parallel decoder) and
+// the ones where two modes tie on the goal and the next criterion decides.
+// Every case also runs on the table in reverse order, since the choice must
+// not depend on the order the driver enumerates modes in.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -Isrc bench/CaptureModeSelectionTestMain.cpp src/CaptureCapabilities.cpp
+//       src/PixelConversion.cpp src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp
+//       src/CpuFeatures.cpp -o capture_mode_selection_test
+//
+// Usage: capture_mode_selection_test
+// Prints one line per case; the exit code is 1 if any case picked another
+// mode.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+#include "CaptureCapabilities.h"
+
+// A capability table as IAMStreamConfig listed it, duplicates included.
+struct CapabilityFixture {
+    const char* name;
+    std::vector<CaptureMode> modes;
+};
+
+// Index of the capability the chosen mode and rate resolve to, and the rate
+// to request; index -1 when no mode meets the policy.
+struct SelectionCase {
+    const char* name;
+    const CapabilityFixture* fixture;
+    CapturePolicy policy;
+    double decodeThreads;
+    int index;
+    double fps;
+};
+
+static CaptureMode Mode(int index, PixelFormat format, int width, int height, double minFps, double maxFps) {
+    CaptureMode mode;
+    mode.index = index;
+    mode.format = format;
+    mode.width = width;
+    mode.height = height;
+    mode.minFps = minFps;
+    mode.maxFps = maxFps;
+    return mode;
+}
+
+static CapturePolicy Policy(CaptureGoal goal, double minFps, double busBytesPerSecond = 0.0, double cpuBudget = 0.0,
+                            int maxWidth = 0) {
+    CapturePolicy policy;
+    policy.goal = goal;
+    policy.minFps = minFps;
+    policy.busBytesPerSecond = busBytesPerSecond;
+    policy.cpuBudget = cpuBudget;
+    policy.maxWidth = maxWidth;
+    return policy;
+}
+
+// USB 2 1080p webcam: raw YUY2 only at low rates above VGA
+static const CapabilityFixture kUsb2Webcam = { "USB 2 1080p webcam", {
+    Mode(0, PixelFormat::YUY2, 640, 480, 5, 30),
+    Mode(1, PixelFormat::YUY2, 1280, 720, 5, 10),
+    Mode(2, PixelFormat::YUY2, 1920, 1080, 5, 5),
+    Mode(3, PixelFormat::MJPEG, 640, 480, 5, 30),
+    Mode(4, PixelFormat::MJPEG, 1280, 720, 5, 30),
+    Mode(5, PixelFormat::MJPEG, 1920, 1080, 5, 30),
+    Mode(6, PixelFormat::YUY2, 320, 240, 5, 30),
+} };
+
+// USB 3 4K camera with NV12, YUY2 and MJPEG
+static const CapabilityFixture kUsb3Camera = { "USB 3 4K camera", {
+    Mode(0, PixelFormat::NV12, 3840, 2160, 5, 30),
+    Mode(1, PixelFormat::NV12, 1920, 1080, 5, 60),
+    Mode(2, PixelFormat::MJPEG, 3840, 2160, 5, 30),
+    Mode(3, PixelFormat::MJPEG, 1920, 1080, 5, 60),
+    Mode(4, PixelFormat::YUY2, 1920, 1080, 5, 60),
+    Mode(5, PixelFormat::NV12, 1280, 720, 5, 120),
+    Mode(6, PixelFormat::MJPEG, 1280, 720, 5, 120),
+} };
+
+// Capture card listing each frame rate as a capability of its own
+static const CapabilityFixture kCaptureCard = { "capture card with one entry per rate", {
+    Mode(0, PixelFormat::YUY2, 640, 480, 30, 30),
+    Mode(1, PixelFormat::YUY2, 640, 480, 15, 15),
+    Mode(2, PixelFormat::MJPEG, 1280, 720, 30, 30),
+    Mode(3, PixelFormat::MJPEG, 1280, 720, 60, 60),
+    Mode(4, PixelFormat::BGR24, 640, 480, 30, 30),
+} };
+
+static const double kUsb2Bus = 40e6;
+static const double kUsb3Bus = 350e6;
+
+static const SelectionCase kCases[] = {
+    // Raw 1080p only reaches 5 fps, so MJPEG is the largest mode at 30
+    { "default policy takes MJPEG 1080p", &kUsb2Webcam, DefaultCapturePolicy(), 1.0, 5, 30.0 },
+    // Equal size: the higher rate wins, then CPU cost
+    { "size tie broken by frame rate", &kUsb2Webcam, Policy(CaptureGoal::MaxResolution, 5.0, kUsb2Bus), 1.0, 5, 30.0 },
+    { "size and rate tie broken by CPU cost", &kUsb2Webcam, Policy(CaptureGoal::MaxResolution, 30.0, 0.0, 0.0, 640), 1.0, 0, 30.0 },
+    // VGA MJPEG crosses the bus in half the time of QVGA YUY2
+    { "latency on USB 2 prefers small MJPEG", &kUsb2Webcam, Policy(CaptureGoal::LowestLatency, 30.0, kUsb2Bus), 1.0, 3, 30.0 },
+    { "bandwidth at 15 fps prefers MJPEG", &kUsb2Webcam, Policy(CaptureGoal::LowestBandwidth, 15.0), 1.0, 3, 15.0 },
+    { "nothing runs at 60 fps", &kUsb2Webcam, Policy(CaptureGoal::LowestLatency, 60.0), 1.0, -1, 0.0 },
+
+    // 4K NV12 at 30 fps needs more than the bus carries
+    { "4K over USB 3 needs MJPEG", &kUsb3Camera, Policy(CaptureGoal::MaxResolution, 30.0, kUsb3Bus), 1.0, 2, 30.0 },
+    { "4K tie without a bus limit goes raw", &kUsb3Camera, Policy(CaptureGoal::MaxResolution, 30.0), 1.0, 0, 30.0 },
+    { "latency with one decode thread goes raw", &kUsb3Camera, Policy(CaptureGoal::LowestLatency, 60.0, kUsb3Bus), 1.0, 5, 120.0 },
+    { "latency with eight decode threads goes MJPEG", &kUsb3Camera, Policy(CaptureGoal::LowestLatency, 60.0, kUsb3Bus), 8.0, 6, 120.0 },
+    // NV12 and YUY2 1080p at 60 fps tie; YUY2 converts for less
+    { "CPU budget leaves a 1080p tie", &kUsb3Camera, Policy(CaptureGoal::MaxResolution, 30.0, kUsb3Bus, 0.5), 1.0, 4, 60.0 },
+    { "bandwidth capped at 720p", &kUsb3Camera, Policy(CaptureGoal::LowestBandwidth, 30.0, 0.0, 0.0, 1280), 1.0, 6, 30.0 },
+
+    // Duplicates merge: MJPEG 720p becomes 30-60 fps, and each rate is
+    // requested from the entry that lists it
+    { "merged entry reaches 60 fps", &kCaptureCard, Policy(CaptureGoal::LowestLatency, 60.0), 1.0, 3, 60.0 },
+    { "merged entry runs at its slowest for bandwidth", &kCaptureCard, Policy(CaptureGoal::LowestBandwidth, 15.0), 1.0, 2, 30.0 },
+    // YUY2 VGA merges to 15-30 fps but runs at nothing in between
+    { "rate between merged entries rounds up", &kCaptureCard, Policy(CaptureGoal::LowestBandwidth, 20.0, 0.0, 0.0, 640), 1.0, 0, 30.0 },
+    { "VGA tie goes to the cheaper RGB", &kCaptureCard, Policy(CaptureGoal::MaxResolution, 30.0, 0.0, 0.0, 640), 1.0, 4, 30.0 },
+};
+
+static const char* ModeName(const CaptureCapabilities& capabilities, int position, double fps, char* buffer, size_t size) {
+    if (position < 0) {
+        snprintf(buffer, size, "none");
+    }
+    else {
+        const CaptureMode mode = capabilities.ModeFor(position, fps);
+        snprintf(buffer, size, "#%d %s %dx%d", mode.index, PixelFormatName(mode.format), mode.width, mode.height);
+    }
+    return buffer;
+}
+
+static bool RunCase(const SelectionCase& test, bool reversed) {
+    CaptureCapabilities capabilities;
+    std::vector<CaptureMode> modes = test.fixture->modes;
+    if (reversed) {
+        std::reverse(modes.begin(), modes.end());
+    }
+    for (const CaptureMode& mode : modes) {
+        capabilities.Add(mode);
+    }
+    CaptureCostModel costs;
+    costs.decodeThreads = test.decodeThreads;
+
+    double fps = 0.0;
+    const int position = capabilities.Select(test.policy, &fps, costs);
+    // The capability SetFormat() would be given
+    const int index = position >= 0 ? capabilities.ModeFor(position, fps).index : -1;
+    const bool passed = index == test.index && (index < 0 || std::fabs(fps - test.fps) < 1e-9);
+
+    char chosen[64];
+    printf("%s  %s / %s%s: %s @ %.0f fps", passed ? "pass" : "FAIL", test.fixture->name, test.name,
+        reversed ? " (reversed)" : "", ModeName(capabilities, position, fps, chosen, sizeof(chosen)), fps);
+    if (!passed) {
+        printf(", expected #%d @ %.0f fps", test.index, test.fps);
+    }
+    printf("\n");
+    return passed;
+}
+
+int main() {
+    int failures = 0;
+    for (const SelectionCase& test : kCases) {
+        for (bool reversed : { false, true }) {
+            failures += RunCase(test, reversed) ? 0 : 1;
+        }
+    }
+    printf("%d of %d cases failed\n", failures, static_cast<int>(std::size(kCases)) * 2);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// Hot-plug test of DeviceRegistry with a fake enumerator, portable to Linux.
+// Cameras arrive, leave, come back under the same path, and a second camera
+// of the same model shows up with the same friendly name. After each step
+// the test checks what the UI relies on:
+//   - a device keeps its path and hardware ID, so Find() locates it again
+//     after it left and returned
+//   - Generation() moves exactly when the list changed, which is what the
+//     camera modal watches to re-find its selection
+//   - nothing is enumerated until the registry has been invalidated, and a
+//     failed enumeration keeps the cached list
+//   - two cameras with one friendly name get distinct labels
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -Isrc bench/DeviceRegistryTestMain.cpp src/DeviceRegistry.cpp -o device_registry_test
+//
+// Usage: device_registry_test
+// Prints one line per check; the exit code is 1 if any check failed.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "DeviceRegistry.h"
+
+// What the fake "system" has plugged in right now. Shared with the test,
+// since the registry owns the enumerator.
+struct FakeSystem {
+    std::vector<DeviceInfo> devices;
+    bool failing = false;    // Enumerate() reports the system unavailable
+    int enumerations = 0;
+};
+
+class FakeEnumerator : public DeviceEnumerator {
+public:
+    explicit FakeEnumerator(FakeSystem* system) : system(system) {}
+
+    bool Enumerate(std::vector<DeviceInfo>* devices) override {
+        ++system->enumerations;
+        if (system->failing) {
+            return false;
+        }
+        *devices = system->devices;
+        return true;
+    }
+
+private:
+    FakeSystem* system;
+};
+
+static DeviceInfo Device(const char* name, const char* serial) {
+    DeviceInfo device;
+    device.utf8Name = name;
+    device.name.assign(name, name + strlen(name));
+    const std::string path = std::string("@device:pnp:\\\\?\\usb#vid_046d&pid_085e#") + serial;
+    device.path.assign(path.begin(), path.end());
+    device.id.assign(serial, serial + strlen(serial));
+    return device;
+}
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what) {
+    printf("%s  %s\n", condition ? "pass" : "FAIL", what);
+    failures += condition ? 0 : 1;
+}
+
+int main() {
+    FakeSystem system;
+    DeviceRegistry registry(std::make_unique<FakeEnumerator>(&system));
+    const DeviceInfo builtIn = Device("Integrated Camera", "0001");
+    const DeviceInfo webcamA = Device("HD Pro Webcam C920", "A1B2");
+    const DeviceInfo webcamB = Device("HD Pro Webcam C920", "C3D4");
+
+    // Start-up: one camera, enumerated once however often the UI asks
+    system.devices = { builtIn };
+    for (int frame = 0; frame < 60; ++frame) {
+        registry.Devices();
+        registry.Names();
+        registry.Find(builtIn.path);
+    }
+    Check(system.enumerations == 1, "start-up enumerates once across 60 UI frames");
+    Check(registry.Devices().size() == 1 && registry.Generation() == 1, "start-up list has the built-in camera");
+
+    // Arrival: nothing changes until the device-change notification
+    uint64_t generation = registry.Generation();
+    system.devices = { builtIn, webcamA };
+    Check(registry.Devices().size() == 1 && system.enumerations == 1, "arrival is not seen before invalidation");
+    registry.Invalidate();
+    Check(registry.Devices().size() == 2 && registry.Generation() == generation + 1, "arrival bumps the generation once");
+    Check(registry.Find(webcamA.path) == 1 && registry.Devices()[1].id == webcamA.id, "arrived camera found by path with its ID");
+    Check(registry.Find(builtIn.path) == 0, "built-in camera keeps its path and position");
+
+    // A notification that changed nothing rescans without a new generation
+    generation = registry.Generation();
+    registry.Invalidate();
+    registry.Devices();
+    Check(system.enumerations == 3 && registry.Generation() == generation, "unrelated notification leaves the generation alone");
+
+    // Removal
+    system.devices = { builtIn };
+    registry.Invalidate();
+    Check(registry.Find(webcamA.path) == -1 && registry.Generation() == generation + 1, "removal drops the camera and bumps the generation");
+
+    // Enumeration failing in between keeps the cache
+    generation = registry.Generation();
+    system.failing = true;
+    registry.Invalidate();
+    Check(registry.Devices().size() == 1 && registry.Generation() == generation, "failed enumeration keeps the cached list");
+    system.failing = false;
+
+    // Re-arrival under the same path, now in another slot
+    // (Generation() does not rescan by itself; the UI reads it after Devices())
+    system.devices = { webcamA, builtIn };
+    registry.Invalidate();
+    registry.Devices();
+    Check(registry.Generation() == generation + 1, "re-arrival bumps the generation");
+    Check(registry.Find(webcamA.path) == 0 && registry.Devices()[0].id == webcamA.id, "re-arrived camera found again by its path and ID");
+    Check(registry.Find(builtIn.path) == 1, "built-in camera found at its new position");
+
+    // Second camera of the same model: same friendly name, own path and ID
+    generation = registry.Generation();
+    system.devices = { webcamA, builtIn, webcamB };
+    registry.Invalidate();
+    const std::vector<const char*>& names = registry.Names();
+    Check(registry.Generation() == generation + 1 && names.size() == 3, "duplicate-name arrival bumps the generation");
+    Check(registry.Find(webcamA.path) == 0 && registry.Find(webcamB.path) == 2, "duplicate names stay separate devices");
+    Check(registry.Devices()[2].id == webcamB.id && registry.Devices()[2].utf8Name == webcamB.utf8Name, "second camera keeps its ID and name");
+    Check(strcmp(names[0], "HD Pro Webcam C920") == 0 && strcmp(names[2], "HD Pro Webcam C920 (2)") == 0,
+        "duplicate names get distinct labels");
+    Check(strcmp(names[1], "Integrated Camera") == 0, "unique names are left alone");
+
+    // The first of the pair leaving renames the second back
+    system.devices = { builtIn, webcamB };
+    registry.Invalidate();
+    Check(registry.Find(webcamB.path) == 1 && strcmp(registry.Names()[1], "HD Pro Webcam C920") == 0,
+        "remaining camera of the pair loses its number");
+
+    printf("%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
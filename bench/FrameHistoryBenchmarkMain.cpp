@@ -0,0 +1,307 @@
+// Benchmark and check for FrameHistory and its lossless codec, portable to
+// Linux. Results go out as one JSON document; the exit code is 1 if any
+// check failed.
+//
+//   codec    Ratio and speed of LosslessCompress() on camera-like frames
+//            (smooth image plus sensor noise) and on pure noise, which has
+//            to come back byte-exact too.
+//   memory   Memory per second of history for MJPEG and for raw frames
+//            with and without compression, and the cost of Add().
+//   export   A clip saved while frames keep arriving at the camera rate:
+//            every frame in the AVI has to match the one captured, and
+//            Add() has to stay fast while the export runs.
+// Each frame carries its sequence number in its first bytes and otherwise
+// follows from it, so any frame can be checked on its own.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DNDEBUG -Isrc bench/FrameHistoryBenchmarkMain.cpp src/FrameHistory.cpp
+//       src/LosslessFrameCodec.cpp src/AviFile.cpp src/FrameLatency.cpp src/LatencyHistogram.cpp
+//       src/PixelConversion.cpp src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp
+//       src/CpuFeatures.cpp src/Log.cpp src/ThreadCpu.cpp src/Trace.cpp -lpthread -o frame_history_benchmark
+//
+// Usage: frame_history_benchmark [--dir DIR] [--out FILE]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AviFile.h"
+#include "FrameHistory.h"
+#include "FrameLatency.h"
+#include "LatencyHistogram.h"
+#include "Log.h"
+#include "LosslessFrameCodec.h"
+
+struct BenchmarkOptions {
+    std::string directory = "frame-history-benchmark";
+    std::string outPath;
+};
+
+static const double kFps = 30.0;
+
+struct FrameConfig {
+    const char* name;
+    PixelFormat format;
+    int width;
+    int height;
+};
+
+static VideoFormat LayoutOf(const FrameConfig& config) {
+    VideoFormat format;
+    format.format = config.format;
+    format.width = config.width;
+    format.height = config.height;
+    format.stride = config.format == PixelFormat::MJPEG ? 0 : DefaultStride(config.format, config.width);
+    return format;
+}
+
+// MJPEG frames vary around a typical camera JPEG size; their bytes are
+// noise, as entropy-coded data is.
+static size_t FrameBytes(const FrameConfig& config, uint64_t sequence) {
+    if (config.format == PixelFormat::MJPEG) {
+        const size_t typical = static_cast<size_t>(config.width) * config.height / 8;
+        return typical - typical / 8 + (sequence * 7919) % (typical / 4);
+    }
+    return FrameSize(config.format, config.height, DefaultStride(config.format, config.width));
+}
+
+static size_t MaxFrameBytes(const FrameConfig& config) {
+    return FrameBytes(config, 0) * 2;
+}
+
+// A smooth image that drifts from frame to frame, plus noise of a few
+// levels as a camera sensor adds; pure noise with 'noiseOnly'.
+static void FillFrame(const FrameConfig& config, uint64_t sequence, uint8_t* data, size_t size, bool noiseOnly = false) {
+    uint32_t state = static_cast<uint32_t>(sequence) * 2654435761u + 1;
+    const bool smooth = !noiseOnly && config.format != PixelFormat::MJPEG;
+    const size_t rowBytes = smooth ? static_cast<size_t>(DefaultStride(config.format, config.width)) : size;
+    for (size_t i = 0; i < size; ++i) {
+        state = state * 1664525u + 1013904223u;
+        if (!smooth) {
+            data[i] = static_cast<uint8_t>(state >> 24);
+            continue;
+        }
+        const size_t x = i % rowBytes;
+        const size_t y = i / rowBytes;
+        const int base = static_cast<int>((x / 4 + y + sequence) / 8 % 200) + 16;
+        // Sum of two uniform values: roughly normal, spread of about 2 levels
+        const int noise = static_cast<int>((state >> 28) + (state >> 24 & 15)) - 15;
+        data[i] = static_cast<uint8_t>(base + noise / 4);
+    }
+    memcpy(data, &sequence, sizeof(sequence));
+}
+
+static bool RunCodec(const FrameConfig& config, bool noiseOnly, std::string& json) {
+    const size_t size = FrameBytes(config, 0);
+    std::vector<uint8_t> frame(size);
+    FillFrame(config, 0, frame.data(), size, noiseOnly);
+    std::vector<uint8_t> compressed(LosslessCompressBound(size));
+    std::vector<uint8_t> restored(size);
+
+    const int iterations = 20;
+    size_t compressedSize = 0;
+    const int64_t start = MonotonicNanos();
+    for (int i = 0; i < iterations; ++i) {
+        compressedSize = LosslessCompress(config.format, frame.data(), size, compressed.data());
+    }
+    const int64_t compressedAt = MonotonicNanos();
+    bool ok = true;
+    for (int i = 0; i < iterations; ++i) {
+        ok &= LosslessDecompress(compressed.data(), compressedSize, restored.data(), size);
+    }
+    const int64_t end = MonotonicNanos();
+    ok &= restored == frame;
+
+    const double megabytes = static_cast<double>(size) * iterations / 1e6;
+    char line[512];
+    snprintf(line, sizeof(line),
+        "{\"test\": \"codec\", \"name\": \"%s%s\", \"frame_bytes\": %zu, \"ratio\": %.3f, "
+        "\"compress_mb_per_s\": %.0f, \"decompress_mb_per_s\": %.0f, \"compress_ms\": %.2f, \"exact\": %s}",
+        config.name, noiseOnly ? " noise" : "", size, static_cast<double>(compressedSize) / size,
+        megabytes / ((compressedAt - start) / 1e9), megabytes / ((end - compressedAt) / 1e9),
+        (compressedAt - start) / 1e6 / iterations, ok ? "true" : "false");
+    json += line;
+    return ok;
+}
+
+static void RunMemory(const FrameConfig& config, bool compressRaw, std::string& json) {
+    // A minute of frames, fed back to back with camera timestamps
+    FrameHistoryOptions options;
+    options.compressRaw = compressRaw;
+    FrameHistory history(options);
+    std::vector<uint8_t> frame(MaxFrameBytes(config));
+    const VideoFormat format = LayoutOf(config);
+    LatencyHistogram addLatency;
+    const uint64_t frames = static_cast<uint64_t>(60 * kFps);
+    for (uint64_t sequence = 0; sequence < frames; ++sequence) {
+        const size_t size = FrameBytes(config, sequence);
+        FillFrame(config, sequence, frame.data(), size);
+        const int64_t before = MonotonicNanos();
+        history.Add(format, frame.data(), size, sequence / kFps);
+        addLatency.Record(MonotonicNanos() - before);
+    }
+
+    const FrameHistoryStats stats = history.GetStats();
+    char line[768];
+    snprintf(line, sizeof(line),
+        "{\"test\": \"memory\", \"name\": \"%s%s\", \"budget_mb\": %.0f, \"frames_held\": %llu, "
+        "\"seconds_held\": %.2f, \"mb_per_second\": %.2f, \"raw_mb_per_second\": %.2f, \"seconds_at_budget\": %.2f, "
+        "\"evicted\": %llu, \"dropped\": %llu, \"add_latency\": ",
+        config.name, config.format == PixelFormat::MJPEG ? "" : compressRaw ? " compressed" : " uncompressed",
+        options.memoryBytes / 1048576.0, static_cast<unsigned long long>(stats.frames), stats.seconds,
+        stats.bytesPerSecond / 1048576.0, stats.rawBytesPerSecond / 1048576.0, stats.secondsAtBudget,
+        static_cast<unsigned long long>(stats.framesEvicted), static_cast<unsigned long long>(stats.framesDropped));
+    json += line;
+    AppendLatencySummaryJson(json, addLatency.Summarize());
+    json += "}";
+}
+
+static bool RunExport(const BenchmarkOptions& options, const FrameConfig& config, std::string& json) {
+    FrameHistoryOptions historyOptions;
+    FrameHistory history(historyOptions);
+    std::vector<uint8_t> frame(MaxFrameBytes(config));
+    const VideoFormat format = LayoutOf(config);
+
+    // Fill the history past its budget, then save while frames keep coming
+    // at the camera rate
+    uint64_t sequence = 0;
+    for (; sequence < static_cast<uint64_t>(40 * kFps); ++sequence) {
+        const size_t size = FrameBytes(config, sequence);
+        FillFrame(config, sequence, frame.data(), size);
+        history.Add(format, frame.data(), size, sequence / kFps);
+    }
+    const FrameHistoryStats before = history.GetStats();
+    const std::filesystem::path path = std::filesystem::path(options.directory) / "clip.avi";
+    const double clipSeconds = 30.0;
+    bool ok = history.StartExport(path, clipSeconds);
+
+    LatencyHistogram addLatency;
+    const int64_t start = MonotonicNanos();
+    int64_t due = start;
+    const int64_t interval = static_cast<int64_t>(1e9 / kFps);
+    uint64_t addedDuringExport = 0;
+    while (ok && history.GetExportStatus().state == ClipExportState::Running) {
+        const int64_t now = MonotonicNanos();
+        if (now < due) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+            continue;
+        }
+        due += interval;
+        const size_t size = FrameBytes(config, sequence);
+        FillFrame(config, sequence, frame.data(), size);
+        const int64_t beforeAdd = MonotonicNanos();
+        history.Add(format, frame.data(), size, sequence / kFps);
+        addLatency.Record(MonotonicNanos() - beforeAdd);
+        ++sequence;
+        ++addedDuringExport;
+    }
+    const double exportSeconds = (MonotonicNanos() - start) / 1e9;
+    const ClipExportStatus status = history.GetExportStatus();
+    ok &= status.state == ClipExportState::Done;
+
+    // Every frame has to be one that was captured, in order and intact
+    AviReader reader;
+    uint64_t verified = 0;
+    uint64_t previous = 0;
+    if (ok && reader.Open(path)) {
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> expected(frame.size());
+        for (uint64_t index = 0; index < reader.FrameCount(); ++index) {
+            size_t size = 0;
+            uint64_t frameSequence = 0;
+            if (!reader.ReadFrame(index, &data, &size) || size < sizeof(frameSequence)) {
+                break;
+            }
+            memcpy(&frameSequence, data.data(), sizeof(frameSequence));
+            const size_t expectedSize = FrameBytes(config, frameSequence);
+            FillFrame(config, frameSequence, expected.data(), expectedSize);
+            if (size != expectedSize || memcmp(data.data(), expected.data(), size) != 0 ||
+                (index > 0 && frameSequence <= previous)) {
+                break;
+            }
+            previous = frameSequence;
+            ++verified;
+        }
+        ok &= verified == status.framesWritten && verified == reader.FrameCount();
+    }
+    else {
+        ok = false;
+    }
+
+    char line[1024];
+    snprintf(line, sizeof(line),
+        "{\"test\": \"export\", \"name\": \"%s\", \"clip_seconds\": %.0f, \"seconds_held\": %.2f, "
+        "\"frames_total\": %llu, \"frames_written\": %llu, \"frames_skipped\": %llu, \"frames_verified\": %llu, "
+        "\"file_mb\": %.1f, \"export_seconds\": %.2f, \"added_during_export\": %llu, \"ok\": %s, \"add_latency\": ",
+        config.name, clipSeconds, before.seconds, static_cast<unsigned long long>(status.framesTotal),
+        static_cast<unsigned long long>(status.framesWritten), static_cast<unsigned long long>(status.framesSkipped),
+        static_cast<unsigned long long>(verified), status.bytesWritten / 1048576.0, exportSeconds,
+        static_cast<unsigned long long>(addedDuringExport), ok ? "true" : "false");
+    json += line;
+    AppendLatencySummaryJson(json, addLatency.Summarize());
+    json += "}";
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    LogSetOutput(stderr);
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--dir") == 0 && hasValue) {
+            options.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--dir DIR] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    std::error_code error;
+    std::filesystem::create_directories(options.directory, error);
+
+    const FrameConfig yuy2 = { "1080p YUY2", PixelFormat::YUY2, 1920, 1080 };
+    const FrameConfig nv12 = { "1080p NV12", PixelFormat::NV12, 1920, 1080 };
+    const FrameConfig mjpeg = { "1080p MJPEG", PixelFormat::MJPEG, 1920, 1080 };
+
+    std::string json = "{\"results\": [\n  ";
+    bool ok = RunCodec(yuy2, false, json);
+    json += ",\n  ";
+    ok &= RunCodec(nv12, false, json);
+    json += ",\n  ";
+    ok &= RunCodec(yuy2, true, json);
+    json += ",\n  ";
+    RunMemory(mjpeg, true, json);
+    json += ",\n  ";
+    RunMemory(yuy2, true, json);
+    json += ",\n  ";
+    RunMemory(yuy2, false, json);
+    json += ",\n  ";
+    ok &= RunExport(options, mjpeg, json);
+    json += ",\n  ";
+    ok &= RunExport(options, yuy2, json);
+    json += "\n]}\n";
+    std::filesystem::remove_all(options.directory, error);
+    LogShutdown();
+
+    if (options.outPath.empty()) {
+        fputs(json.c_str(), stdout);
+    }
+    else {
+        std::ofstream out(options.outPath, std::ios::trunc);
+        if (!(out << json)) {
+            fprintf(stderr, "Could not write %s\n", options.outPath.c_str());
+            return 1;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+// Stress test for FrameMailbox, portable to Linux: a producer publishing at
+// 240 fps against a consumer polling at display rate, then both running
+// flat out. Every frame is a sequence number plus a payload that follows
+// from it, so a frame read while half written shows up as a mismatch.
+//
+// Checked on every run:
+//   - no frame the consumer acquires is torn
+//   - sequence numbers the consumer sees only ever go up
+//   - once the producer stops and the consumer drains the mailbox,
+//     published == consumed + dropped
+// Results go out as one JSON document; the exit code is 1 if a check failed.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DNDEBUG -Isrc bench/FrameMailboxStressMain.cpp src/FrameLatency.cpp
+//       src/LatencyHistogram.cpp src/Log.cpp src/ThreadCpu.cpp src/Trace.cpp -lpthread -o frame_mailbox_stress
+// Add -fsanitize=thread to have TSan watch the handoff as well.
+//
+// Usage: frame_mailbox_stress [--seconds S] [--out FILE]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "FrameLatency.h"
+#include "FrameMailbox.h"
+
+struct StressOptions {
+    double seconds = 3.0;   // Length of each run
+    std::string outPath;
+};
+
+// Big enough that copying it takes a while and spans many cache lines
+struct TestFrame {
+    uint64_t sequence = 0;
+    uint32_t payload[1024] = {};
+};
+
+static uint32_t PayloadWord(uint64_t sequence, size_t index) {
+    return static_cast<uint32_t>(sequence * 2654435761u) ^ static_cast<uint32_t>(index * 40503u);
+}
+
+static bool FrameIntact(const TestFrame& frame) {
+    for (size_t i = 0; i < sizeof(frame.payload) / sizeof(frame.payload[0]); ++i) {
+        if (frame.payload[i] != PayloadWord(frame.sequence, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct RunConfig {
+    const char* name;
+    double producerFps;  // 0: back to back
+    double consumerFps;
+};
+
+static void PaceTo(int64_t& due, double fps) {
+    if (fps <= 0.0) {
+        return;
+    }
+    const int64_t now = MonotonicNanos();
+    if (now < due) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+    }
+    due += static_cast<int64_t>(1e9 / fps);
+}
+
+static bool RunStress(const StressOptions& options, const RunConfig& run, std::string& json) {
+    FrameMailbox<TestFrame> mailbox;
+    std::atomic<bool> producing{ true };
+
+    std::thread producer([&] {
+        const int64_t end = MonotonicNanos() + static_cast<int64_t>(options.seconds * 1e9);
+        int64_t due = MonotonicNanos();
+        for (uint64_t sequence = 1; MonotonicNanos() < end; ++sequence) {
+            PaceTo(due, run.producerFps);
+            TestFrame& frame = mailbox.WriteSlot();
+            frame.sequence = sequence;
+            for (size_t i = 0; i < sizeof(frame.payload) / sizeof(frame.payload[0]); ++i) {
+                frame.payload[i] = PayloadWord(sequence, i);
+            }
+            mailbox.Publish();
+        }
+        producing.store(false, std::memory_order_release);
+    });
+
+    uint64_t torn = 0;
+    uint64_t backwards = 0;
+    uint64_t acquired = 0;
+    uint64_t lastSequence = 0;
+    const auto check = [&] {
+        const TestFrame& frame = mailbox.ReadSlot();
+        ++acquired;
+        torn += FrameIntact(frame) ? 0 : 1;
+        backwards += frame.sequence > lastSequence ? 0 : 1;
+        lastSequence = frame.sequence;
+    };
+    int64_t due = MonotonicNanos();
+    while (producing.load(std::memory_order_acquire)) {
+        PaceTo(due, run.consumerFps);
+        if (mailbox.Acquire()) {
+            check();
+        }
+    }
+    producer.join();
+    // Pick up the frame published last, if the consumer had not yet
+    if (mailbox.Acquire()) {
+        check();
+    }
+
+    const FrameMailboxStats stats = mailbox.GetStats();
+    const bool balanced = stats.published == stats.consumed + stats.dropped && stats.consumed == acquired;
+    const bool ok = torn == 0 && backwards == 0 && balanced;
+    char line[512];
+    snprintf(line, sizeof(line),
+        "{\"name\": \"%s\", \"published\": %llu, \"consumed\": %llu, \"dropped\": %llu, \"repeated\": %llu, "
+        "\"torn\": %llu, \"backwards\": %llu, \"balanced\": %s, \"ok\": %s}",
+        run.name, static_cast<unsigned long long>(stats.published), static_cast<unsigned long long>(stats.consumed),
+        static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.repeated),
+        static_cast<unsigned long long>(torn), static_cast<unsigned long long>(backwards),
+        balanced ? "true" : "false", ok ? "true" : "false");
+    json += line;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    StressOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            options.seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--seconds S] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    static const RunConfig runs[] = {
+        { "240 fps into 60 Hz display", 240.0, 60.0 },
+        { "240 fps into 144 Hz display", 240.0, 144.0 },
+        { "flat out both sides", 0.0, 0.0 },
+    };
+    std::string json = "{\"results\": [\n";
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+        json += i == 0 ? "  " : ",\n  ";
+        ok &= RunStress(options, runs[i], json);
+    }
+    json += "\n]}\n";
+
+    if (options.outPath.empty()) {
+        fputs(json.c_str(), stdout);
+    }
+    else {
+        std::ofstream out(options.outPath, std::ios::trunc);
+        if (!(out << json)) {
+            fprintf(stderr, "Could not write %s\n", options.outPath.c_str());
+            return 1;
+        }
+    }
+    return ok ? 0 : 1;
+}
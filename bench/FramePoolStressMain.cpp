@@ -0,0 +1,203 @@
+// Concurrent acquire and release stress test for FramePool, portable to
+// Linux. Several threads acquire frames of varying sizes, stamp each with a
+// lease number, and share references with each other through inboxes, so
+// the last reference to a frame drops on an arbitrary thread. Every holder
+// checks the stamp before letting go: if the pool handed a frame out again
+// while someone still held it, the new owner's stamp gives it away.
+//
+// Checked on every run:
+//   - no frame is handed out while still referenced (stamp intact, and a
+//     fresh frame has exactly one reference)
+//   - once every reference is gone, every frame is back on the free list
+//   - acquired and exhausted match the calls the threads made, and heap
+//     allocations stay within one header and one buffer per size for each
+//     frame
+// Results go out as one JSON line; the exit code is 1 if a check failed.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O1 -g -fsanitize=thread -Isrc bench/FramePoolStressMain.cpp src/FramePool.cpp
+//       -lpthread -o frame_pool_stress
+// Use -fsanitize=address instead to check for use after release.
+//
+// Usage: frame_pool_stress [--seconds S] [--threads N] [--frames N]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "FramePool.h"
+
+static const size_t kSizes[] = { 4096, 65536, 614400 };
+
+struct Inbox {
+    std::mutex mutex;
+    std::deque<FrameRef> frames;
+};
+
+struct Counters {
+    std::atomic<uint64_t> acquired{ 0 };
+    std::atomic<uint64_t> exhausted{ 0 };
+    std::atomic<uint64_t> shared{ 0 };        // References handed to another thread
+    std::atomic<uint64_t> checked{ 0 };       // References checked before release
+    std::atomic<uint64_t> stampBroken{ 0 };   // Frame reused while still held
+    std::atomic<uint64_t> notFresh{ 0 };      // Acquired frame with other references
+};
+
+static void Stamp(VideoFrame& frame, uint64_t lease) {
+    frame.sequence = lease;
+    memcpy(frame.pixels, &lease, sizeof(lease));
+    memcpy(frame.pixels + frame.size - sizeof(lease), &lease, sizeof(lease));
+}
+
+static bool StampIntact(const VideoFrame& frame) {
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    memcpy(&head, frame.pixels, sizeof(head));
+    memcpy(&tail, frame.pixels + frame.size - sizeof(tail), sizeof(tail));
+    return head == frame.sequence && tail == frame.sequence && frame.size <= frame.capacity;
+}
+
+// Check the stamp and drop the reference, possibly the last one.
+static void CheckAndRelease(FrameRef& frame, Counters& counters) {
+    counters.checked.fetch_add(1, std::memory_order_relaxed);
+    if (!StampIntact(*frame)) {
+        counters.stampBroken.fetch_add(1, std::memory_order_relaxed);
+    }
+    frame.Reset();
+}
+
+static void Worker(int self, FramePool& pool, std::vector<std::unique_ptr<Inbox>>& inboxes, Counters& counters,
+                   std::atomic<uint64_t>& nextLease, const std::atomic<bool>& stop) {
+    std::mt19937 random(1234 + self);
+    std::vector<FrameRef> held;
+    std::deque<FrameRef> incoming;
+    const int threads = static_cast<int>(inboxes.size());
+    while (!stop.load(std::memory_order_relaxed)) {
+        VideoFormat layout;
+        layout.format = PixelFormat::BGRA32;
+        FrameRef frame = pool.Acquire(layout, kSizes[random() % std::size(kSizes)]);
+        if (frame) {
+            counters.acquired.fetch_add(1, std::memory_order_relaxed);
+            if (frame.UseCount() != 1) {
+                counters.notFresh.fetch_add(1, std::memory_order_relaxed);
+            }
+            Stamp(*frame, nextLease.fetch_add(1, std::memory_order_relaxed));
+            // Share with up to two other threads, copying the reference
+            const int copies = static_cast<int>(random() % 3);
+            for (int i = 0; i < copies && threads > 1; ++i) {
+                const int target = (self + 1 + static_cast<int>(random() % (threads - 1))) % threads;
+                std::lock_guard<std::mutex> lock(inboxes[target]->mutex);
+                inboxes[target]->frames.push_back(frame);
+                counters.shared.fetch_add(1, std::memory_order_relaxed);
+            }
+            held.push_back(std::move(frame));
+        }
+        else {
+            // Let the holders run; they are the only way a frame comes back
+            counters.exhausted.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+
+        // Keep a few frames for a while, so the pool runs dry now and then
+        while (held.size() > random() % 4) {
+            const size_t victim = random() % held.size();
+            CheckAndRelease(held[victim], counters);
+            held[victim] = std::move(held.back());
+            held.pop_back();
+        }
+        {
+            std::lock_guard<std::mutex> lock(inboxes[self]->mutex);
+            incoming.swap(inboxes[self]->frames);
+        }
+        for (FrameRef& shared : incoming) {
+            CheckAndRelease(shared, counters);
+        }
+        incoming.clear();
+    }
+    for (FrameRef& frame : held) {
+        CheckAndRelease(frame, counters);
+    }
+}
+
+int main(int argc, char** argv) {
+    double seconds = 2.0;
+    int threadCount = 4;
+    size_t maxFrames = 16;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            maxFrames = static_cast<size_t>(atoi(argv[++i]));
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--seconds S] [--threads N] [--frames N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Counters counters;
+    uint64_t heapAllocationsMidway = 0;
+    FramePoolStats stats;
+    {
+        FramePool pool(maxFrames);
+        std::vector<std::unique_ptr<Inbox>> inboxes;
+        for (int i = 0; i < threadCount; ++i) {
+            inboxes.push_back(std::make_unique<Inbox>());
+        }
+        std::atomic<uint64_t> nextLease{ 1 };
+        std::atomic<bool> stop{ false };
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back(Worker, i, std::ref(pool), std::ref(inboxes), std::ref(counters), std::ref(nextLease), std::cref(stop));
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds / 2));
+        heapAllocationsMidway = pool.GetStats().heapAllocations;
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds / 2));
+        stop.store(true);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        // References still waiting in inboxes drop here, on this thread
+        for (std::unique_ptr<Inbox>& inbox : inboxes) {
+            for (FrameRef& frame : inbox->frames) {
+                CheckAndRelease(frame, counters);
+            }
+            inbox->frames.clear();
+        }
+        stats = pool.GetStats();
+    }
+
+    const bool allReturned = stats.free == stats.frames && stats.frames <= maxFrames;
+    const bool countsMatch = stats.acquired == counters.acquired.load() && stats.exhausted == counters.exhausted.load();
+    // Every frame header plus one buffer per size it grew through
+    const bool allocationsBounded = stats.heapAllocations <= stats.frames * (1 + std::size(kSizes));
+    const bool ok = counters.stampBroken == 0 && counters.notFresh == 0 && allReturned && countsMatch &&
+        allocationsBounded && counters.checked == counters.acquired + counters.shared;
+    printf("{\"threads\": %d, \"max_frames\": %llu, \"acquired\": %llu, \"exhausted\": %llu, \"shared\": %llu, "
+        "\"checked\": %llu, \"stamp_broken\": %llu, \"not_fresh\": %llu, \"frames\": %llu, \"free\": %llu, "
+        "\"heap_allocations\": %llu, \"heap_allocations_second_half\": %llu, \"all_returned\": %s, "
+        "\"counts_match\": %s, \"ok\": %s}\n",
+        threadCount, static_cast<unsigned long long>(maxFrames),
+        static_cast<unsigned long long>(counters.acquired.load()), static_cast<unsigned long long>(counters.exhausted.load()),
+        static_cast<unsigned long long>(counters.shared.load()), static_cast<unsigned long long>(counters.checked.load()),
+        static_cast<unsigned long long>(counters.stampBroken.load()), static_cast<unsigned long long>(counters.notFresh.load()),
+        static_cast<unsigned long long>(stats.frames), static_cast<unsigned long long>(stats.free),
+        static_cast<unsigned long long>(stats.heapAllocations),
+        static_cast<unsigned long long>(stats.heapAllocations - heapAllocationsMidway),
+        allReturned ? "true" : "false", countsMatch ? "true" : "false",
+        ok ? "true" : "false");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+// Logger throughput under contention, portable to Linux. Several threads log
+// at once while the sink formats and writes everything out. Each call is
+// timed on the caller's side, which is what the capture and UI threads pay.
+// Scenarios:
+//   steady       rate limit off, each thread pausing between messages; the
+//                sink should keep up, so nothing is dropped
+//   burst        rate limit off, each thread logging flat out, far faster
+//                than the sink drains the 512-entry per-thread queues: the
+//                overflow has to be dropped, never waited for
+//   rate limit   the default per-site limit, every thread on one call site;
+//                all but the first burst each second has to be suppressed
+// For each: messages/s accepted and written, caller-side latency, drops and
+// suppressions. Checked: every call is accounted for once the log is
+// flushed (written + dropped + suppressed), steady drops nothing, burst
+// drops, and rate limit suppresses. Results go out as one JSON document; the
+// exit code is 1 if a check failed.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DNDEBUG -Isrc bench/LogThroughputMain.cpp src/Log.cpp src/FrameLatency.cpp
+//       src/LatencyHistogram.cpp -lpthread -o log_throughput
+//
+// Usage: log_throughput [--seconds S] [--threads N] [--log FILE] [--out FILE]
+// The log itself goes to the null device unless --log names a file.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameLatency.h"
+#include "LatencyHistogram.h"
+#include "Log.h"
+
+#if defined(_WIN32)
+static const char* kNullDevice = "NUL";
+#else
+static const char* kNullDevice = "/dev/null";
+#endif
+
+static FILE* OpenLogFile(const char* path) {
+#if defined(_MSC_VER)
+    FILE* file = nullptr;
+    return fopen_s(&file, path, "wb") == 0 ? file : nullptr;
+#else
+    return fopen(path, "wb");
+#endif
+}
+
+struct Scenario {
+    const char* name;
+    uint32_t rateLimit;     // Per site per second; 0 is off
+    int pauseMicros;        // Between one thread's messages; 0 is flat out
+};
+
+struct ScenarioResult {
+    uint64_t calls = 0;
+    double seconds = 0.0;
+    LogStats stats;                              // Change over the scenario
+    std::vector<LatencySummary> callerLatency;   // One per thread
+};
+
+// Every thread logs from the same call site, as threads running the same
+// code do. The rate limit scenario has a site of its own, so its suppression
+// counts start from a fresh window.
+static void LogOne(int thread, uint64_t i, bool sharedSite) {
+    if (sharedSite) {
+        LOG_INFO("Bench", "Shared site, thread %d message %llu, %.3f ms", thread, static_cast<unsigned long long>(i), i * 0.001);
+    }
+    else {
+        LOG_INFO("Bench", "Thread %d message %llu took %.3f ms on %s", thread, static_cast<unsigned long long>(i), i * 0.001,
+            "camera");
+    }
+}
+
+static ScenarioResult RunScenario(const Scenario& scenario, int threadCount, double seconds) {
+    LogSetRateLimit(scenario.rateLimit);
+    LogFlush();
+    const LogStats before = GetLogStats();
+
+    std::vector<std::unique_ptr<LatencyHistogram>> latency;
+    for (int i = 0; i < threadCount; ++i) {
+        latency.push_back(std::make_unique<LatencyHistogram>());
+    }
+    std::atomic<bool> go{ false };
+    std::atomic<uint64_t> calls{ 0 };
+    const int64_t runNanos = static_cast<int64_t>(seconds * 1e9);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            LatencyHistogram& histogram = *latency[t];
+            const int64_t end = MonotonicNanos() + runNanos;
+            uint64_t i = 0;
+            for (int64_t now = MonotonicNanos(); now < end; ++i) {
+                LogOne(t, i, scenario.rateLimit != 0);
+                const int64_t after = MonotonicNanos();
+                histogram.Record(after - now);
+                now = after;
+                if (scenario.pauseMicros > 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(scenario.pauseMicros));
+                    now = MonotonicNanos();
+                }
+            }
+            calls.fetch_add(i, std::memory_order_relaxed);
+        });
+    }
+    const int64_t start = MonotonicNanos();
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ScenarioResult result;
+    result.seconds = (MonotonicNanos() - start) / 1e9;
+    LogFlush();
+
+    const LogStats after = GetLogStats();
+    result.calls = calls.load();
+    result.stats.written = after.written - before.written;
+    result.stats.dropped = after.dropped - before.dropped;
+    result.stats.suppressed = after.suppressed - before.suppressed;
+    for (const std::unique_ptr<LatencyHistogram>& histogram : latency) {
+        result.callerLatency.push_back(histogram->Summarize());
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    double seconds = 1.0;
+    int threadCount = 4;
+    std::string logPath = kNullDevice;
+    std::string outPath;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threadCount = std::max(atoi(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "--log") == 0 && hasValue) {
+            logPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--seconds S] [--threads N] [--log FILE] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    FILE* logFile = OpenLogFile(logPath.c_str());
+    if (!logFile) {
+        fprintf(stderr, "Could not open %s\n", logPath.c_str());
+        return 1;
+    }
+    LogSetOutput(logFile);
+
+    static const Scenario scenarios[] = {
+        { "steady", 0, 100 },
+        { "burst", 0, 0 },
+        { "rate limit", kLogSiteBurst, 0 },
+    };
+    char line[1024];
+    snprintf(line, sizeof(line), "{\"threads\": %d, \"seconds\": %.2f, \"queue_capacity\": 512,\n\"results\": [\n",
+        threadCount, seconds);
+    std::string json = line;
+    bool ok = true;
+    for (size_t s = 0; s < std::size(scenarios); ++s) {
+        const Scenario& scenario = scenarios[s];
+        const ScenarioResult result = RunScenario(scenario, threadCount, seconds);
+        const uint64_t accounted = result.stats.written + result.stats.dropped + result.stats.suppressed;
+        bool passed = accounted == result.calls;
+        if (s == 0) {
+            passed &= result.stats.dropped == 0;
+        }
+        else if (scenario.rateLimit == 0) {
+            passed &= result.stats.dropped > 0;
+        }
+        else {
+            passed &= result.stats.suppressed > 0 && result.stats.written <= (result.seconds + 1) * scenario.rateLimit + threadCount;
+        }
+        ok &= passed;
+
+        // The worst thread is what a capture thread would see
+        LatencySummary worst;
+        for (const LatencySummary& summary : result.callerLatency) {
+            if (summary.p99 >= worst.p99) {
+                worst = summary;
+            }
+        }
+        snprintf(line, sizeof(line),
+            "%s  {\"name\": \"%s\", \"rate_limit\": %u, \"pause_us\": %d, \"calls\": %llu, \"calls_per_s\": %.0f, "
+            "\"written\": %llu, \"written_per_s\": %.0f, \"dropped\": %llu, \"suppressed\": %llu, "
+            "\"accounted\": %s, \"caller_p99_us\": %.3f, \"caller_worst_thread\": ",
+            s ? ",\n" : "", scenario.name, scenario.rateLimit, scenario.pauseMicros,
+            static_cast<unsigned long long>(result.calls), result.calls / result.seconds,
+            static_cast<unsigned long long>(result.stats.written), result.stats.written / result.seconds,
+            static_cast<unsigned long long>(result.stats.dropped), static_cast<unsigned long long>(result.stats.suppressed),
+            accounted == result.calls ? "true" : "false", worst.p99);
+        json += line;
+        AppendLatencySummaryJson(json, worst);
+        json += passed ? ", \"ok\": true}" : ", \"ok\": false}";
+    }
+    json += "\n]}\n";
+    LogShutdown();
+    fclose(logFile);
+
+    if (outPath.empty()) {
+        fputs(json.c_str(), stdout);
+    }
+    else {
+        std::ofstream out(outPath, std::ios::trunc);
+        if (!(out << json)) {
+            fprintf(stderr, "Could not write %s\n", outPath.c_str());
+            return 1;
+        }
+    }
+    return ok ? 0 : 1;
+}
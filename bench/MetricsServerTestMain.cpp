@@ -0,0 +1,323 @@
+// Scrape test for MetricsServer over loopback, portable to Linux. The server
+// starts on port 0 with the collector UIManager uses, over latency
+// histograms filled with values on both sides of every bucket bound. A
+// plain socket client then checks what a Prometheus scraper relies on:
+//   - GET /metrics answers 200 with a Content-Length equal to the body
+//   - every histogram's _bucket{le="+Inf"} equals its _count, and its
+//     buckets never decrease, also while a capture thread keeps recording
+//     during the scrapes
+//   - an idle histogram reports exactly the frames recorded into it
+//   - the scrape counter counts this scrape, and a query string is ignored
+//   - another path answers 404 and another method 405, each with a correct
+//     Content-Length
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -Isrc bench/MetricsServerTestMain.cpp src/MetricsServer.cpp src/CaptureMetrics.cpp
+//       src/FrameLatency.cpp src/LatencyHistogram.cpp src/Log.cpp src/ThreadCpu.cpp src/Trace.cpp
+//       -lpthread -o metrics_server_test
+// On Windows link ws2_32.lib as well.
+//
+// Usage: metrics_server_test [--scrapes N]
+// Prints one line per check; the exit code is 1 if any check failed.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include "CaptureMetrics.h"
+#include "MetricsServer.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+static const SocketHandle kBadSocket = INVALID_SOCKET;
+static void CloseSocket(SocketHandle socket) { closesocket(socket); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+static const SocketHandle kBadSocket = -1;
+static void CloseSocket(SocketHandle socket) { close(socket); }
+#endif
+
+struct HttpResponse {
+    bool received = false;
+    int status = 0;
+    long contentLength = -1;  // -1 without the header
+    std::string body;
+};
+
+// Send 'request' as is and read the response until the server closes.
+static HttpResponse Fetch(int port, const std::string& request) {
+    HttpResponse response;
+    const SocketHandle client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (client == kBadSocket) {
+        return response;
+    }
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::string raw;
+    if (connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0 &&
+        send(client, request.data(), static_cast<int>(request.size()), 0) == static_cast<int>(request.size())) {
+        char buffer[4096];
+        for (;;) {
+            const auto received = recv(client, buffer, static_cast<int>(sizeof(buffer)), 0);
+            if (received <= 0) {
+                break;
+            }
+            raw.append(buffer, static_cast<size_t>(received));
+        }
+    }
+    CloseSocket(client);
+
+    const size_t headerEnd = raw.find("\r\n\r\n");
+    if (raw.compare(0, 9, "HTTP/1.1 ") != 0 || headerEnd == std::string::npos) {
+        return response;
+    }
+    response.received = true;
+    response.status = atoi(raw.c_str() + 9);
+    const std::string headers = raw.substr(0, headerEnd);
+    const size_t length = headers.find("\r\nContent-Length: ");
+    if (length != std::string::npos) {
+        response.contentLength = atol(headers.c_str() + length + 18);
+    }
+    response.body = raw.substr(headerEnd + 4);
+    return response;
+}
+
+static HttpResponse Get(int port, const char* path) {
+    return Fetch(port, std::string("GET ") + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+}
+
+// What the histograms on one page add up to.
+struct HistogramCheck {
+    int histograms = 0;          // Distinct name and label sets
+    int infMismatches = 0;       // +Inf bucket differs from _count
+    int decreasingBuckets = 0;   // A bucket below the one before it
+    int missingInf = 0;          // _count without a +Inf bucket
+    std::map<std::string, uint64_t> counts;  // _count per name{labels}
+};
+
+// Splits 'name{labels} value' into its parts; false for comments and blanks.
+static bool ParseSample(const std::string& line, std::string* name, std::string* labels, uint64_t* value) {
+    if (line.empty() || line[0] == '#') {
+        return false;
+    }
+    const size_t space = line.rfind(' ');
+    const size_t brace = line.find('{');
+    if (space == std::string::npos) {
+        return false;
+    }
+    *name = line.substr(0, brace < space ? brace : space);
+    *labels = brace < space ? line.substr(brace + 1, line.rfind('}') - brace - 1) : std::string();
+    *value = strtoull(line.c_str() + space + 1, nullptr, 10);
+    return true;
+}
+
+// Removes le="..." from a label list, leaving the labels that identify the
+// histogram.
+static std::string WithoutLe(const std::string& labels) {
+    const size_t le = labels.find("le=\"");
+    if (le == std::string::npos) {
+        return labels;
+    }
+    const size_t end = labels.find('"', le + 4) + 1;
+    std::string rest = labels.substr(0, le) + labels.substr(end);
+    if (!rest.empty() && rest.back() == ',') {
+        rest.pop_back();
+    }
+    if (!rest.empty() && rest.front() == ',') {
+        rest.erase(0, 1);
+    }
+    return rest;
+}
+
+static HistogramCheck CheckHistograms(const std::string& page) {
+    HistogramCheck check;
+    std::map<std::string, bool> isHistogram;
+    std::map<std::string, uint64_t> inf;
+    std::map<std::string, uint64_t> lastBucket;
+    size_t start = 0;
+    while (start < page.size()) {
+        size_t end = page.find('\n', start);
+        if (end == std::string::npos) {
+            end = page.size();
+        }
+        const std::string line = page.substr(start, end - start);
+        start = end + 1;
+        if (line.compare(0, 7, "# TYPE ") == 0 && line.size() > 10 && line.compare(line.size() - 10, 10, " histogram") == 0) {
+            isHistogram[line.substr(7, line.size() - 17)] = true;
+            continue;
+        }
+        std::string name;
+        std::string labels;
+        uint64_t value = 0;
+        if (!ParseSample(line, &name, &labels, &value)) {
+            continue;
+        }
+        for (const char* suffix : { "_bucket", "_count" }) {
+            const size_t length = strlen(suffix);
+            if (name.size() <= length || name.compare(name.size() - length, length, suffix) != 0) {
+                continue;
+            }
+            const std::string family = name.substr(0, name.size() - length);
+            if (!isHistogram.count(family)) {
+                continue;
+            }
+            const std::string key = family + "{" + WithoutLe(labels) + "}";
+            if (suffix[1] == 'b') {
+                if (lastBucket.count(key) && value < lastBucket[key]) {
+                    ++check.decreasingBuckets;
+                }
+                lastBucket[key] = value;
+                if (labels.find("le=\"+Inf\"") != std::string::npos) {
+                    inf[key] = value;
+                }
+            }
+            else {
+                ++check.histograms;
+                check.counts[key] = value;
+                if (!inf.count(key)) {
+                    ++check.missingInf;
+                }
+                else if (inf[key] != value) {
+                    ++check.infMismatches;
+                }
+            }
+        }
+    }
+    return check;
+}
+
+static uint64_t CountOf(const HistogramCheck& check, const char* key) {
+    const auto found = check.counts.find(key);
+    return found == check.counts.end() ? 0 : found->second;
+}
+
+// Value of an unlabelled sample, or -1 when the page has none.
+static long long SampleValue(const std::string& page, const char* name) {
+    const std::string prefix = std::string("\n") + name + " ";
+    const size_t at = page.find(prefix);
+    return at == std::string::npos ? -1 : atoll(page.c_str() + at + prefix.size());
+}
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what) {
+    printf("%s  %s\n", condition ? "pass" : "FAIL", what);
+    failures += condition ? 0 : 1;
+}
+
+// Durations on both sides of every bound, plus zero and past the last one.
+static int64_t TestLatency(uint64_t i) {
+    const double bound = MetricsWriter::kLatencyBoundsSeconds[i % std::size(MetricsWriter::kLatencyBoundsSeconds)];
+    switch (i % 4) {
+    case 0: return static_cast<int64_t>(bound * 0.9e9);
+    case 1: return static_cast<int64_t>(bound * 1.1e9);
+    case 2: return 0;
+    default: return static_cast<int64_t>(2.5e9);
+    }
+}
+
+static void RecordFrame(FrameLatencyCollector& latency, uint64_t i) {
+    const int64_t grab = 1000000000LL + static_cast<int64_t>(i) * 33333333;
+    latency.RecordCapture(i / 30.0, grab, grab + TestLatency(i));
+    FrameTimestamps times;
+    times.grab = grab;
+    times.publish = grab + TestLatency(i);
+    times.pickup = times.publish + TestLatency(i + 1);
+    times.convert = times.pickup + TestLatency(i + 2);
+    times.display = times.convert + TestLatency(i + 3);
+    latency.RecordDisplay(times);
+}
+
+int main(int argc, char** argv) {
+    int scrapeCount = 50;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--scrapes") == 0 && i + 1 < argc) {
+            scrapeCount = atoi(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--scrapes N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const uint64_t idleFrames = 1000;
+    FrameLatencyCollector latency;
+    for (uint64_t i = 0; i < idleFrames; ++i) {
+        RecordFrame(latency, i);
+    }
+    CaptureMetrics metrics;
+    metrics.state = CameraState::Open;
+    metrics.latency = &latency;
+    MetricsServer server([&metrics](MetricsWriter& writer) { WriteCaptureMetrics(writer, metrics); });
+    Check(server.Start("127.0.0.1", 0) && server.Port() > 0, "server starts on a free port");
+    const int port = server.Port();
+
+    // Idle: the page must show exactly what was recorded
+    const HttpResponse page = Get(port, "/metrics");
+    Check(page.received && page.status == 200, "GET /metrics answers 200");
+    Check(page.contentLength == static_cast<long>(page.body.size()) && !page.body.empty(),
+        "Content-Length matches the body");
+    const HistogramCheck idle = CheckHistograms(page.body);
+    Check(idle.histograms == static_cast<int>(LatencyStage::Count) + static_cast<int>(JitterPoint::Count),
+        "every latency stage and jitter point is a histogram");
+    Check(idle.infMismatches == 0 && idle.missingInf == 0, "every +Inf bucket equals its _count");
+    Check(idle.decreasingBuckets == 0, "buckets never decrease");
+    Check(CountOf(idle, "camviex_frame_latency_seconds{stage=\"capture\"}") == idleFrames &&
+        CountOf(idle, "camviex_frame_latency_seconds{stage=\"end_to_end\"}") == idleFrames,
+        "idle histograms count the frames recorded");
+    Check(SampleValue(page.body, "camviex_metrics_scrapes_total") == 1, "the scrape counts itself");
+
+    // Scrapes while the capture and display sides keep recording
+    std::atomic<bool> stop{ false };
+    std::thread capture([&] {
+        for (uint64_t i = idleFrames; !stop.load(std::memory_order_relaxed); ++i) {
+            RecordFrame(latency, i);
+        }
+    });
+    int ok = 0;
+    int mismatched = 0;
+    int decreasing = 0;
+    for (int i = 0; i < scrapeCount; ++i) {
+        const HttpResponse busy = Get(port, i % 2 ? "/metrics?from=test" : "/metrics");
+        if (busy.status == 200 && busy.contentLength == static_cast<long>(busy.body.size())) {
+            ++ok;
+        }
+        const HistogramCheck check = CheckHistograms(busy.body);
+        mismatched += check.infMismatches + check.missingInf;
+        decreasing += check.decreasingBuckets;
+    }
+    stop.store(true);
+    capture.join();
+    Check(ok == scrapeCount, "scrapes during recording answer 200 with the right length, query or not");
+    Check(mismatched == 0, "+Inf equals _count while recording");
+    Check(decreasing == 0, "buckets never decrease while recording");
+    Check(server.Scrapes() == static_cast<uint64_t>(scrapeCount) + 1, "every scrape is counted");
+
+    const HttpResponse notFound = Get(port, "/other");
+    Check(notFound.status == 404 && notFound.contentLength == static_cast<long>(notFound.body.size()),
+        "another path answers 404 with the right length");
+    const HttpResponse root = Get(port, "/metricsfoo");
+    Check(root.status == 404, "a path starting with /metrics answers 404");
+    const HttpResponse post = Fetch(port, "POST /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 0\r\n\r\n");
+    Check(post.status == 405 && post.contentLength == static_cast<long>(post.body.size()),
+        "POST answers 405 with the right length");
+    Check(server.Scrapes() == static_cast<uint64_t>(scrapeCount) + 1, "errors are not counted as scrapes");
+
+    server.Stop();
+    Check(!server.Running() && !Get(port, "/metrics").received, "nothing answers after Stop()");
+
+    printf("%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
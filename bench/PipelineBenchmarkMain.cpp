@@ -0,0 +1,988 @@
+// Benchmarks for the frame pipeline, portable to Linux. Results go out as one
+// JSON document so runs can be diffed or plotted:
+//   {"machine": {...}, "options": {...}, "results": [{"suite": ..., "name": ..., ...}, ...]}
+//
+// Suites:
+//   convert   every pixel format to RGBA at sizes up to 4K, per instruction
+//             set, in megapixels and in GB/s of source plus destination
+//             bytes; plus reorientation, fused into the conversion and
+//             as a second pass over the converted image
+//   mjpeg     (with --mjpeg) decoding a JPEG file, or every JPEG in a
+//             directory, with 1 to N threads, N from --threads or the
+//             hardware; each decode must match the serial one, and files
+//             without restart markers must fall back to one slice
+//   pool      FramePool acquire/release, alone and contended
+//   handoff   latest-frame mailbox and broadcast publish cost, including
+//             publishing while other threads subscribe and unsubscribe
+//   latency   cost of the per-frame instrumentation: clock reads, histogram
+//             records, and the capture and display stamping of one frame,
+//             against a target of 100 ns per record
+//   e2e       synthetic camera -> copy into the pool -> publish -> display
+//             thread converting to RGBA, plus N broadcast consumers, at
+//             sizes up to 4K and several frame rates, with the memory
+//             bandwidth each stage drives
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DNDEBUG -Isrc bench/PipelineBenchmarkMain.cpp
+//       src/PixelConversion.cpp src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp
+//       src/CpuFeatures.cpp src/MjpegDecoder.cpp src/WorkerPool.cpp src/FramePool.cpp src/FrameBroadcast.cpp
+//       src/FrameLatency.cpp src/LatencyHistogram.cpp src/SyntheticCaptureSource.cpp src/CaptureCapabilities.cpp
+//       src/CameraOpener.cpp src/ThreadCpu.cpp src/Trace.cpp -lpthread -o pipeline_benchmark
+//
+// Usage: pipeline_benchmark [--suite NAME]... [--seconds S] [--quick] [--mjpeg FILE|DIR] [--threads N]
+//                           [--out FILE]
+// The exit code is 1 if an MJPEG check failed.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CameraOpener.h"
+#include "FrameBroadcast.h"
+#include "FrameLatency.h"
+#include "FrameMailbox.h"
+#include "FramePool.h"
+#include "MjpegDecoder.h"
+#include "PixelConversion.h"
+#include "SyntheticCaptureSource.h"
+#include "ThreadCpu.h"
+#include "WorkerPool.h"
+
+struct BenchmarkOptions {
+    std::vector<std::string> suites;
+    double seconds = 1.0;        // Length of each end-to-end run
+    double minSeconds = 0.2;     // Minimum measuring time of each microbenchmark
+    bool quick = false;          // Fewer sizes and configurations
+    std::string mjpegPath;       // A JPEG file or a directory of them
+    int maxThreads = 0;          // MJPEG thread sweep upper end; 0: hardware threads
+    std::string outPath;
+
+    bool Runs(const char* suite) const {
+        return suites.empty() || std::find(suites.begin(), suites.end(), suite) != suites.end();
+    }
+};
+
+struct Resolution {
+    int width;
+    int height;
+};
+
+static const Resolution kResolutions[] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+
+// Results collected as JSON objects, written out at the end.
+class BenchmarkReport {
+public:
+    // Start a result object; finish it with the Add*() calls and End().
+    void Begin(const char* suite, const std::string& name) {
+        current = "{\"suite\": \"";
+        current += suite;
+        current += "\", \"name\": \"";
+        current += name;
+        current += '"';
+        fprintf(stderr, "%-8s %s\n", suite, name.c_str());
+    }
+
+    void Add(const char* key, double value) {
+        char buffer[96];
+        snprintf(buffer, sizeof(buffer), ", \"%s\": %.4f", key, value);
+        current += buffer;
+    }
+
+    void Add(const char* key, uint64_t value) {
+        char buffer[96];
+        snprintf(buffer, sizeof(buffer), ", \"%s\": %llu", key, static_cast<unsigned long long>(value));
+        current += buffer;
+    }
+
+    void Add(const char* key, const char* value) {
+        current += ", \"";
+        current += key;
+        current += "\": \"";
+        current += value;
+        current += '"';
+    }
+
+    void Add(const char* key, const LatencySummary& summary) {
+        current += ", \"";
+        current += key;
+        current += "\": ";
+        AppendLatencySummaryJson(current, summary);
+    }
+
+    void End() {
+        current += '}';
+        results.push_back(std::move(current));
+        current.clear();
+    }
+
+    std::string ToJson(const BenchmarkOptions& options) const {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer),
+            "{\"machine\": {\"best_isa\": \"%s\", \"hardware_threads\": %u}, "
+            "\"options\": {\"seconds\": %.2f, \"quick\": %s},\n\"results\": [\n",
+            PixelIsaName(GetBestPixelIsa()), std::thread::hardware_concurrency(), options.seconds,
+            options.quick ? "true" : "false");
+        std::string json = buffer;
+        for (size_t i = 0; i < results.size(); ++i) {
+            json += "  ";
+            json += results[i];
+            json += i + 1 < results.size() ? ",\n" : "\n";
+        }
+        json += "]}\n";
+        return json;
+    }
+
+private:
+    std::string current;
+    std::vector<std::string> results;
+};
+
+// Run 'operation' until 'minSeconds' have passed and at least 'minIterations'
+// ran, recording each call. Returns the iteration count.
+template <typename Operation>
+static uint64_t Measure(double minSeconds, uint64_t minIterations, LatencyHistogram& histogram, Operation&& operation) {
+    const int64_t end = MonotonicNanos() + static_cast<int64_t>(minSeconds * 1e9);
+    uint64_t iterations = 0;
+    while (iterations < minIterations || MonotonicNanos() < end) {
+        const int64_t start = MonotonicNanos();
+        operation();
+        histogram.Record(MonotonicNanos() - start);
+        ++iterations;
+    }
+    return iterations;
+}
+
+// Same for operations too short to time one by one: calls 'operation' in
+// batches of 'batch' and reports the mean per call.
+template <typename Operation>
+static double MeasureBatched(double minSeconds, int batch, Operation&& operation, uint64_t* iterations) {
+    const int64_t start = MonotonicNanos();
+    const int64_t end = start + static_cast<int64_t>(minSeconds * 1e9);
+    uint64_t count = 0;
+    int64_t now = start;
+    while (now < end) {
+        for (int i = 0; i < batch; ++i) {
+            operation();
+        }
+        count += batch;
+        now = MonotonicNanos();
+    }
+    *iterations = count;
+    return static_cast<double>(now - start) / count;
+}
+
+// A frame of 'format' in the DirectShow layout with a varied pattern.
+static std::vector<uint8_t> MakeFrame(PixelFormat format, int width, int height) {
+    std::vector<uint8_t> data(FrameSize(format, height, DefaultStride(format, width)));
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 7 + (i >> 11) * 13);
+    }
+    return data;
+}
+
+static void RunConvertSuite(const BenchmarkOptions& options, BenchmarkReport& report) {
+    static const PixelFormat formats[] = {
+        PixelFormat::BGR24, PixelFormat::BGRA32, PixelFormat::YUY2, PixelFormat::NV12,
+        PixelFormat::I420, PixelFormat::I422, PixelFormat::I444,
+    };
+    std::vector<PixelIsa> isas = { PixelIsa::Scalar };
+    if (GetBestPixelIsa() != PixelIsa::Scalar) {
+        isas.push_back(GetBestPixelIsa());
+    }
+    const PixelIsa original = GetPixelIsa();
+
+    for (const Resolution& resolution : kResolutions) {
+        if (options.quick && resolution.width != 1280) {
+            continue;
+        }
+        std::vector<uint8_t> rgba(static_cast<size_t>(resolution.width) * resolution.height * 4);
+        for (PixelFormat format : formats) {
+            const std::vector<uint8_t> frame = MakeFrame(format, resolution.width, resolution.height);
+            ImagePlanes planes;
+            if (!DescribeFrame(format, frame.data(), frame.size(), resolution.width, resolution.height,
+                    DefaultStride(format, resolution.width), &planes)) {
+                continue;
+            }
+            for (PixelIsa isa : isas) {
+                SetPixelIsa(isa);
+                char name[96];
+                snprintf(name, sizeof(name), "%s %dx%d %s", PixelFormatName(format), resolution.width, resolution.height, PixelIsaName(isa));
+                report.Begin("convert", name);
+                LatencyHistogram histogram;
+                const YuvColorSpace colorSpace = DefaultYuvColorSpace(resolution.width, resolution.height);
+                const uint64_t iterations = Measure(options.minSeconds, 10, histogram,
+                    [&] { ConvertToRGBA(planes, rgba.data(), resolution.width * 4, colorSpace); });
+                const LatencySummary summary = histogram.Summarize();
+                report.Add("isa", PixelIsaName(isa));
+                report.Add("iterations", iterations);
+                report.Add("megapixels_per_s", resolution.width * resolution.height / summary.p50);
+                // Memory traffic of one pass: the source frame read, the RGBA written
+                report.Add("gigabytes_per_s", static_cast<double>(frame.size() + rgba.size()) / summary.p50 / 1e3);
+                report.Add("frame_time", summary);
+                report.End();
+            }
+        }
+    }
+    SetPixelIsa(original);
+
+    // Reorientation fused into the conversion, best instruction set, against
+    // converting first and reorienting the RGBA image in a second pass. The
+    // second pass reads the intermediate image as BGRA32; the channel swap
+    // rides along the same reorientation kernels, so it costs what a plain
+    // reorienting copy would.
+    const Resolution resolution = { 1280, 720 };
+    const std::vector<uint8_t> frame = MakeFrame(PixelFormat::YUY2, resolution.width, resolution.height);
+    ImagePlanes planes;
+    DescribeFrame(PixelFormat::YUY2, frame.data(), frame.size(), resolution.width, resolution.height,
+        DefaultStride(PixelFormat::YUY2, resolution.width), &planes);
+    const YuvColorSpace colorSpace = DefaultYuvColorSpace(resolution.width, resolution.height);
+    std::vector<uint8_t> rgba(static_cast<size_t>(resolution.width) * resolution.height * 4);
+    std::vector<uint8_t> upright(rgba.size());
+    ImagePlanes intermediate;
+    intermediate.format = PixelFormat::BGRA32;
+    intermediate.width = resolution.width;
+    intermediate.height = resolution.height;
+    intermediate.data[0] = rgba.data();
+    intermediate.stride[0] = resolution.width * 4;
+    struct NamedOrientation {
+        const char* name;
+        FrameOrientation orientation;
+    };
+    const NamedOrientation orientations[] = {
+        { "none", { FrameRotation::None, false, false } },
+        { "mirror", { FrameRotation::None, true, false } },
+        { "flip", { FrameRotation::None, false, true } },
+        { "rotate90", { FrameRotation::Rotate90, false, false } },
+        { "rotate180", { FrameRotation::Rotate180, false, false } },
+        { "rotate270 mirror", { FrameRotation::Rotate270, true, false } },
+    };
+    for (const NamedOrientation& entry : orientations) {
+        int width = 0;
+        int height = 0;
+        OrientedSize(entry.orientation, resolution.width, resolution.height, &width, &height);
+        report.Begin("convert", std::string("YUY2 1280x720 ") + entry.name);
+        LatencyHistogram fused;
+        const uint64_t iterations = Measure(options.minSeconds, 10, fused,
+            [&] { ConvertToRGBA(planes, upright.data(), width * 4, colorSpace, entry.orientation); });
+        LatencyHistogram separate;
+        LatencyHistogram secondPass;
+        Measure(options.minSeconds, 10, separate, [&] {
+            ConvertToRGBA(planes, rgba.data(), resolution.width * 4, colorSpace);
+            const int64_t start = MonotonicNanos();
+            ConvertToRGBA(intermediate, upright.data(), width * 4, YuvColorSpace(), entry.orientation);
+            secondPass.Record(MonotonicNanos() - start);
+        });
+        const LatencySummary summary = fused.Summarize();
+        const LatencySummary separateSummary = separate.Summarize();
+        report.Add("orientation", entry.name);
+        report.Add("iterations", iterations);
+        report.Add("megapixels_per_s", resolution.width * resolution.height / summary.p50);
+        report.Add("frame_time", summary);
+        report.Add("separate_megapixels_per_s", resolution.width * resolution.height / separateSummary.p50);
+        report.Add("separate_frame_time", separateSummary);
+        report.Add("second_pass_time", secondPass.Summarize());
+        report.Add("fused_speedup", separateSummary.p50 / summary.p50);
+        report.End();
+    }
+}
+
+// The JPEG files to decode: the one --mjpeg names, or every .jpg and .jpeg
+// in the directory it names.
+static std::vector<std::filesystem::path> MjpegCorpus(const std::string& path) {
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    if (!std::filesystem::is_directory(path, error)) {
+        files.push_back(path);
+        return files;
+    }
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(path, error)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+        if (entry.is_regular_file() && (extension == ".jpg" || extension == ".jpeg")) {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// True if the scan has RSTn markers. Table segments are skipped by their
+// lengths; inside the entropy-coded data byte stuffing keeps FF D0 to FF D7
+// from meaning anything else.
+static bool HasRestartMarkers(const std::vector<uint8_t>& jpeg) {
+    size_t i = 2;  // After SOI
+    while (i + 4 <= jpeg.size() && jpeg[i] == 0xFF && jpeg[i + 1] != 0xDA) {
+        i += 2 + (static_cast<size_t>(jpeg[i + 2]) << 8 | jpeg[i + 3]);
+    }
+    for (; i + 1 < jpeg.size(); ++i) {
+        if (jpeg[i] == 0xFF && jpeg[i + 1] >= 0xD0 && jpeg[i + 1] <= 0xD7) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// MJPEG decode rate against the number of decoding threads, per file and for
+// the corpus as a whole. Every parallel decode has to match the serial one,
+// and files without restart markers have to fall back to a single slice.
+static bool RunMjpegSuite(const BenchmarkOptions& options, BenchmarkReport& report) {
+    struct CorpusFrame {
+        std::string name;
+        std::vector<uint8_t> jpeg;
+        std::vector<uint8_t> serial;  // Reference decode on the calling thread
+        int width = 0;
+        int height = 0;
+        bool restartMarkers = false;
+    };
+    std::vector<CorpusFrame> corpus;
+    for (const std::filesystem::path& path : MjpegCorpus(options.mjpegPath)) {
+        std::ifstream file(path, std::ios::binary);
+        CorpusFrame frame;
+        frame.name = path.filename().string();
+        frame.jpeg.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (!MjpegDecoder::ReadFrameSize(frame.jpeg.data(), frame.jpeg.size(), &frame.width, &frame.height)) {
+            fprintf(stderr, "Not a baseline JPEG: %s\n", path.string().c_str());
+            continue;
+        }
+        frame.serial.resize(static_cast<size_t>(frame.width) * frame.height * 4);
+        if (!MjpegDecoder().DecodeToRGBA(frame.jpeg.data(), frame.jpeg.size(), frame.serial.data(), frame.width * 4)) {
+            fprintf(stderr, "Unsupported JPEG variant: %s\n", path.string().c_str());
+            continue;
+        }
+        frame.restartMarkers = HasRestartMarkers(frame.jpeg);
+        corpus.push_back(std::move(frame));
+    }
+    if (corpus.empty()) {
+        fprintf(stderr, "No decodable JPEG files in %s\n", options.mjpegPath.c_str());
+        return false;
+    }
+
+    const int maxThreads = options.maxThreads > 0 ? options.maxThreads : std::max(1u, std::thread::hardware_concurrency());
+    bool ok = true;
+    std::vector<uint8_t> decoded;
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        WorkerPool workers(threads - 1);  // The caller is the last thread
+        MjpegDecoder decoder(&workers);
+        uint64_t corpusFrames = 0;
+        double corpusMicros = 0.0;
+        for (const CorpusFrame& frame : corpus) {
+            decoded.assign(frame.serial.size(), 0);
+            const bool decodedOk = decoder.DecodeToRGBA(frame.jpeg.data(), frame.jpeg.size(), decoded.data(), frame.width * 4);
+            const bool matches = decodedOk && decoded == frame.serial;
+            const int slices = decoder.LastSliceCount();
+            const bool serialFallback = frame.restartMarkers || slices == 1;
+            if (!matches || !serialFallback) {
+                fprintf(stderr, "MJPEG %s with %d threads: %s\n", frame.name.c_str(), threads,
+                    !matches ? "differs from the serial decode" : "no restart markers but decoded in slices");
+                ok = false;
+            }
+
+            char name[192];
+            snprintf(name, sizeof(name), "MJPEG %s %dx%d %d threads", frame.name.c_str(), frame.width, frame.height, threads);
+            report.Begin("mjpeg", name);
+            LatencyHistogram histogram;
+            const uint64_t iterations = Measure(options.minSeconds, 10, histogram,
+                [&] { decoder.DecodeToRGBA(frame.jpeg.data(), frame.jpeg.size(), decoded.data(), frame.width * 4); });
+            const LatencySummary summary = histogram.Summarize();
+            corpusFrames += 1;
+            corpusMicros += summary.p50;
+            report.Add("threads", static_cast<uint64_t>(threads));
+            report.Add("restart_markers", frame.restartMarkers ? "yes" : "no");
+            report.Add("slices", static_cast<uint64_t>(slices));
+            report.Add("matches_serial", matches ? "yes" : "no");
+            report.Add("iterations", iterations);
+            report.Add("fps", 1e6 / summary.p50);
+            report.Add("megapixels_per_s", frame.width * frame.height / summary.p50);
+            report.Add("frame_time", summary);
+            report.End();
+        }
+        // The corpus played in a loop, each file once
+        char name[64];
+        snprintf(name, sizeof(name), "MJPEG corpus %d threads", threads);
+        report.Begin("mjpeg", name);
+        report.Add("threads", static_cast<uint64_t>(threads));
+        report.Add("files", static_cast<uint64_t>(corpus.size()));
+        report.Add("fps", corpusFrames * 1e6 / corpusMicros);
+        report.End();
+    }
+    return ok;
+}
+
+static void RunPoolSuite(const BenchmarkOptions& options, BenchmarkReport& report) {
+    VideoFormat layout;
+    layout.format = PixelFormat::YUY2;
+    layout.width = 1280;
+    layout.height = 720;
+    layout.stride = DefaultStride(layout.format, layout.width);
+    const size_t bytes = FrameSize(layout.format, layout.height, layout.stride);
+
+    {
+        FramePool pool(32);
+        pool.Acquire(layout, bytes);  // Allocate the buffer outside the measurement
+        report.Begin("pool", "acquire+release");
+        uint64_t iterations = 0;
+        const double ns = MeasureBatched(options.minSeconds, 1000, [&] { FrameRef frame = pool.Acquire(layout, bytes); }, &iterations);
+        report.Add("iterations", iterations);
+        report.Add("ns_per_op", ns);
+        report.End();
+    }
+
+    for (int threads : { 2, 4 }) {
+        FramePool pool(32);
+        std::atomic<bool> go{ false };
+        std::atomic<uint64_t> total{ 0 };
+        std::atomic<int64_t> busyNanos{ 0 };
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i) {
+            workers.emplace_back([&] {
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                uint64_t iterations = 0;
+                const int64_t start = MonotonicNanos();
+                const double ns = MeasureBatched(options.minSeconds, 1000, [&] { FrameRef frame = pool.Acquire(layout, bytes); }, &iterations);
+                busyNanos.fetch_add(MonotonicNanos() - start);
+                total.fetch_add(iterations);
+                (void)ns;
+            });
+        }
+        go.store(true, std::memory_order_release);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "acquire+release %d threads", threads);
+        report.Begin("pool", name);
+        report.Add("iterations", total.load());
+        report.Add("ns_per_op", static_cast<double>(busyNanos.load()) / total.load());
+        report.End();
+    }
+
+    {
+        // Released on another thread, as when a consumer drops the last reference
+        FramePool pool(32);
+        FrameMailbox<FrameRef> mailbox;
+        std::atomic<bool> stop{ false };
+        std::thread consumer([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                mailbox.Acquire();
+            }
+        });
+        report.Begin("pool", "acquire, release on consumer");
+        uint64_t iterations = 0;
+        uint64_t exhausted = 0;
+        const double ns = MeasureBatched(options.minSeconds, 100, [&] {
+            FrameRef frame = pool.Acquire(layout, bytes);
+            if (!frame) {
+                ++exhausted;
+                return;
+            }
+            mailbox.WriteSlot() = std::move(frame);
+            mailbox.Publish();
+        }, &iterations);
+        stop.store(true);
+        consumer.join();
+        report.Add("iterations", iterations);
+        report.Add("exhausted", exhausted);
+        report.Add("ns_per_op", ns);
+        report.End();
+    }
+}
+
+static void RunHandoffSuite(const BenchmarkOptions& options, BenchmarkReport& report) {
+    VideoFormat layout;
+    layout.format = PixelFormat::YUY2;
+    layout.width = 1280;
+    layout.height = 720;
+    layout.stride = DefaultStride(layout.format, layout.width);
+    const size_t bytes = FrameSize(layout.format, layout.height, layout.stride);
+
+    {
+        // Producer publishing as fast as it can, consumer polling; latency is
+        // from Publish() to the consumer's Acquire() seeing the frame.
+        FramePool pool(8);
+        FrameMailbox<FrameRef> mailbox;
+        std::atomic<bool> stop{ false };
+        LatencyHistogram latency;
+        std::thread consumer([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (mailbox.Acquire()) {
+                    latency.Record(MonotonicNanos() - mailbox.ReadSlot()->publishTime);
+                }
+            }
+        });
+        report.Begin("handoff", "mailbox publish, polling consumer");
+        uint64_t iterations = 0;
+        const double ns = MeasureBatched(options.minSeconds, 100, [&] {
+            FrameRef frame = pool.Acquire(layout, bytes);
+            if (!frame) {
+                return;
+            }
+            frame->publishTime = MonotonicNanos();
+            mailbox.WriteSlot() = std::move(frame);
+            mailbox.Publish();
+        }, &iterations);
+        stop.store(true);
+        consumer.join();
+        const FrameMailboxStats stats = mailbox.GetStats();
+        report.Add("iterations", iterations);
+        report.Add("ns_per_publish", ns);
+        report.Add("published", stats.published);
+        report.Add("consumed", stats.consumed);
+        report.Add("dropped", stats.dropped);
+        report.Add("publish_to_acquire", latency.Summarize());
+        report.End();
+    }
+
+    for (int subscribers : { 1, 4, 16 }) {
+        for (BackpressurePolicy policy : { BackpressurePolicy::DropOldest, BackpressurePolicy::DropNewest }) {
+            FramePool pool(64);
+            FrameBroadcast broadcast;
+            std::vector<std::unique_ptr<FrameSubscriber>> subscribed;
+            std::vector<std::thread> consumers;
+            std::atomic<bool> stop{ false };
+            SubscriberOptions subscriberOptions;
+            subscriberOptions.policy = policy;
+            for (int i = 0; i < subscribers; ++i) {
+                subscriberOptions.name = "consumer " + std::to_string(i);
+                subscribed.push_back(broadcast.Subscribe(subscriberOptions));
+            }
+            for (const std::unique_ptr<FrameSubscriber>& subscriber : subscribed) {
+                consumers.emplace_back([&stop, subscriber = subscriber.get()] {
+                    FrameRef frame;
+                    while (!stop.load(std::memory_order_relaxed)) {
+                        subscriber->Pop(&frame, std::chrono::microseconds(1000));
+                        frame.Reset();
+                    }
+                });
+            }
+            FrameRef frame = pool.Acquire(layout, bytes);
+            char name[96];
+            snprintf(name, sizeof(name), "broadcast publish %d %s", subscribers,
+                policy == BackpressurePolicy::DropOldest ? "drop-oldest" : "drop-newest");
+            report.Begin("handoff", name);
+            uint64_t iterations = 0;
+            const double ns = MeasureBatched(options.minSeconds, 100, [&] { broadcast.Publish(frame); }, &iterations);
+            stop.store(true);
+            broadcast.Close();
+            for (std::thread& consumer : consumers) {
+                consumer.join();
+            }
+            uint64_t received = 0;
+            uint64_t dropped = 0;
+            for (const std::unique_ptr<FrameSubscriber>& subscriber : subscribed) {
+                const SubscriberStats stats = subscriber->GetStats();
+                received += stats.received;
+                dropped += stats.dropped;
+            }
+            report.Add("iterations", iterations);
+            report.Add("ns_per_publish", ns);
+            report.Add("received", received);
+            report.Add("dropped", dropped);
+            report.End();
+        }
+    }
+
+    {
+        // Publishing while another thread subscribes and unsubscribes as fast
+        // as it can; the publisher must not wait on the churn's allocations.
+        FramePool pool(8);
+        FrameBroadcast broadcast;
+        SubscriberOptions subscriberOptions;
+        subscriberOptions.policy = BackpressurePolicy::DropNewest;
+        subscriberOptions.name = "consumer";
+        std::unique_ptr<FrameSubscriber> steady = broadcast.Subscribe(subscriberOptions);
+        std::atomic<bool> stop{ false };
+        std::atomic<uint64_t> churned{ 0 };
+        std::thread churn([&] {
+            SubscriberOptions churnOptions;
+            churnOptions.policy = BackpressurePolicy::DropNewest;
+            churnOptions.name = "churn";
+            while (!stop.load(std::memory_order_relaxed)) {
+                std::unique_ptr<FrameSubscriber> subscriber = broadcast.Subscribe(churnOptions);
+                FrameRef frame;
+                subscriber->TryPop(&frame);
+                churned.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        FrameRef frame = pool.Acquire(layout, bytes);
+        FrameRef popped;
+        LatencyHistogram publish;
+        report.Begin("handoff", "broadcast publish during subscriber churn");
+        uint64_t iterations = 0;
+        const double ns = MeasureBatched(options.minSeconds, 100, [&] {
+            const int64_t start = MonotonicNanos();
+            broadcast.Publish(frame);
+            publish.Record(MonotonicNanos() - start);
+            steady->TryPop(&popped);
+        }, &iterations);
+        stop.store(true);
+        churn.join();
+        broadcast.Close();
+        report.Add("iterations", iterations);
+        report.Add("ns_per_publish", ns);
+        report.Add("subscriptions", churned.load());
+        report.Add("publish_time", publish.Summarize());
+        report.End();
+    }
+}
+
+// Per-frame instrumentation cost. Every frame pays for a few clock reads and
+// histogram records on the capture and UI threads, so each record is meant to
+// stay under kRecordTargetNs.
+static const double kRecordTargetNs = 100.0;
+
+static void AddRecordCost(BenchmarkReport& report, uint64_t iterations, double ns, int records) {
+    report.Add("iterations", iterations);
+    report.Add("ns_per_op", ns);
+    report.Add("records_per_op", static_cast<uint64_t>(records));
+    report.Add("ns_per_record", ns / records);
+    report.Add("target_ns_per_record", kRecordTargetNs);
+    report.Add("within_target", ns / records < kRecordTargetNs ? "true" : "false");
+    report.End();
+}
+
+static void RunLatencySuite(const BenchmarkOptions& options, BenchmarkReport& report) {
+    // Durations spread over many buckets, as real stage latencies are
+    std::vector<int64_t> values(4096);
+    uint64_t seed = 12345;
+    for (int64_t& value : values) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        value = static_cast<int64_t>((seed >> 33) % 50000000);
+    }
+
+    {
+        report.Begin("latency", "monotonic clock read");
+        int64_t total = 0;
+        uint64_t iterations = 0;
+        const double ns = MeasureBatched(options.minSeconds, 1000, [&] { total += MonotonicNanos(); }, &iterations);
+        report.Add("iterations", iterations);
+        report.Add("ns_per_op", ns);
+        report.Add("checksum", static_cast<uint64_t>(total & 0xFFFF));
+        report.End();
+    }
+
+    {
+        LatencyHistogram histogram;
+        size_t next = 0;
+        report.Begin("latency", "histogram record");
+        uint64_t iterations = 0;
+        const double ns = MeasureBatched(options.minSeconds, 1000, [&] {
+            histogram.Record(values[next++ & (values.size() - 1)]);
+        }, &iterations);
+        AddRecordCost(report, iterations, ns, 1);
+    }
+
+    {
+        // WebcamController::OnFrame(): stamp the grab and the publish, then
+        // the capture-side latency and three jitter points
+        FrameLatencyCollector collector;
+        double sampleTime = 0.0;
+        report.Begin("latency", "capture stamping per frame");
+        uint64_t iterations = 0;
+        const double ns = MeasureBatched(options.minSeconds, 1000, [&] {
+            const int64_t grab = MonotonicNanos();
+            const int64_t publish = MonotonicNanos();
+            collector.RecordCapture(sampleTime, grab, publish);
+            sampleTime += 1.0 / 30.0;
+        }, &iterations);
+        AddRecordCost(report, iterations, ns, 4);
+    }
+
+    {
+        // The UI thread: pickup, convert and display stamps, then four
+        // latencies and two jitter points
+        FrameLatencyCollector collector;
+        FrameTimestamps times;
+        report.Begin("latency", "display stamping per frame");
+        uint64_t iterations = 0;
+        const double ns = MeasureBatched(options.minSeconds, 1000, [&] {
+            times.grab = times.display - 40000000;
+            times.publish = times.grab + 200000;
+            times.pickup = MonotonicNanos();
+            times.convert = MonotonicNanos();
+            times.display = MonotonicNanos();
+            collector.RecordDisplay(times);
+        }, &iterations);
+        AddRecordCost(report, iterations, ns, 6);
+    }
+}
+
+// What WebcamController::OnFrame() does, minus the device bookkeeping.
+class PipelineSink : public CaptureSink {
+public:
+    FramePool pool{ 32 };
+    FrameBroadcast broadcast;
+    FrameMailbox<FrameRef> mailbox;
+    FrameLatencyCollector latency;
+    std::atomic<uint64_t> captured{ 0 };
+
+    void OnFrame(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) override {
+        const int64_t grabTime = MonotonicNanos();
+        RegisterThreadCpu("Capture");
+        const size_t bytes = FrameSize(format.format, format.height, format.stride);
+        if (bytes == 0 || size < bytes) {
+            return;
+        }
+        FrameRef frame = pool.Acquire(format, bytes);
+        if (!frame) {
+            return;
+        }
+        memcpy(frame->pixels, data, bytes);
+        frame->sampleTime = sampleTime;
+        frame->sequence = ++sequence;
+        frame->grabTime = grabTime;
+        frame->publishTime = MonotonicNanos();
+        broadcast.Publish(frame);
+        mailbox.WriteSlot() = std::move(frame);
+        mailbox.Publish();
+        latency.RecordCapture(sampleTime, grabTime, MonotonicNanos());
+        captured.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    uint64_t sequence = 0;
+};
+
+// CPU use of the threads registered as 'name', in percent of one core. The
+// threads are started for the run, so their whole CPU time counts.
+static double ThreadCpuPercent(const char* name, const ThreadCpuUsage* usage, size_t count, double seconds) {
+    double total = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(usage[i].name, name) == 0) {
+            total += usage[i].cpuSeconds;
+        }
+    }
+    return total / seconds * 100.0;
+}
+
+static void RunEndToEnd(const BenchmarkOptions& options, BenchmarkReport& report, Resolution resolution, double fps, int consumerCount) {
+    PipelineSink sink;
+    SyntheticSourceConfig config;
+    config.format = PixelFormat::YUY2;
+    config.width = resolution.width;
+    config.height = resolution.height;
+    config.fps = fps > 0.0 ? fps : 30.0;
+    config.realtime = fps > 0.0;
+    SyntheticCaptureSource source(config);
+    CameraOpenContext context;
+    if (source.Open(DefaultCapturePolicy(), context) < 0) {
+        return;
+    }
+
+    // Consumers take frames as a recorder or analyzer would, touching one
+    // byte per cache line.
+    std::vector<std::unique_ptr<FrameSubscriber>> subscribers;
+    for (int i = 0; i < consumerCount; ++i) {
+        SubscriberOptions subscriberOptions;
+        subscriberOptions.name = "consumer " + std::to_string(i);
+        subscriberOptions.policy = BackpressurePolicy::DropOldest;
+        subscribers.push_back(sink.broadcast.Subscribe(subscriberOptions));
+    }
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> checksum{ 0 };
+    std::vector<std::thread> consumers;
+    for (const std::unique_ptr<FrameSubscriber>& subscriber : subscribers) {
+        consumers.emplace_back([&, subscriber = subscriber.get()] {
+            RegisterThreadCpu("Consumer");
+            FrameRef frame;
+            uint64_t sum = 0;
+            while (subscriber->Pop(&frame, std::chrono::microseconds(100000))) {
+                for (size_t offset = 0; offset < frame->size; offset += 64) {
+                    sum += frame->pixels[offset];
+                }
+                frame.Reset();
+            }
+            checksum.fetch_add(sum);
+        });
+    }
+
+    // Display thread: picks up the newest frame and converts it to RGBA, as
+    // the UI thread does, polling at about 1 kHz like an uncapped render loop.
+    std::vector<uint8_t> rgba(static_cast<size_t>(resolution.width) * resolution.height * 4);
+    uint64_t displayed = 0;
+    std::thread display([&] {
+        RegisterThreadCpu("Display");
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (!sink.mailbox.Acquire()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(1000));
+                continue;
+            }
+            const VideoFrame& frame = *sink.mailbox.ReadSlot();
+            FrameTimestamps times;
+            times.sampleTime = frame.sampleTime;
+            times.grab = frame.grabTime;
+            times.publish = frame.publishTime;
+            times.pickup = MonotonicNanos();
+            ImagePlanes planes;
+            if (DescribeFrame(frame.format, frame.pixels, frame.size, frame.width, frame.height, frame.stride, &planes)) {
+                ConvertToRGBA(planes, rgba.data(), frame.width * 4, DefaultYuvColorSpace(frame.width, frame.height));
+            }
+            times.convert = MonotonicNanos();
+            times.display = times.convert;
+            sink.latency.RecordDisplay(times);
+            ++displayed;
+        }
+    });
+
+    ThreadCpuUsage threads[kMaxCpuThreads];
+    const int64_t start = MonotonicNanos();
+    source.Start(&sink);
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+    // Sample while every thread is still alive
+    const size_t threadCount = SampleThreadCpu(threads, kMaxCpuThreads);
+    source.Stop();
+    const double seconds = (MonotonicNanos() - start) / 1e9;
+    stop.store(true);
+    display.join();
+    sink.broadcast.Close();
+    for (std::thread& consumer : consumers) {
+        consumer.join();
+    }
+
+    char name[96];
+    if (fps > 0.0) {
+        snprintf(name, sizeof(name), "%dx%d@%.0f %d consumers", resolution.width, resolution.height, fps, consumerCount);
+    }
+    else {
+        snprintf(name, sizeof(name), "%dx%d unpaced %d consumers", resolution.width, resolution.height, consumerCount);
+    }
+    report.Begin("e2e", name);
+    report.Add("width", static_cast<uint64_t>(resolution.width));
+    report.Add("height", static_cast<uint64_t>(resolution.height));
+    report.Add("target_fps", fps);
+    report.Add("consumers", static_cast<uint64_t>(consumerCount));
+    report.Add("seconds", seconds);
+    report.Add("capture_fps", sink.captured.load() / seconds);
+    report.Add("display_fps", displayed / seconds);
+    const FrameMailboxStats mailbox = sink.mailbox.GetStats();
+    report.Add("display_dropped", mailbox.dropped);
+    report.Add("pool_exhausted", sink.pool.GetStats().exhausted);
+    uint64_t received = 0;
+    uint64_t dropped = 0;
+    uint64_t minimum = UINT64_MAX;
+    for (const std::unique_ptr<FrameSubscriber>& subscriber : subscribers) {
+        const SubscriberStats stats = subscriber->GetStats();
+        received += stats.received;
+        dropped += stats.dropped;
+        minimum = std::min(minimum, stats.received);
+    }
+    report.Add("consumer_received", received);
+    report.Add("consumer_dropped", dropped);
+    report.Add("consumer_min_fps", consumerCount ? minimum / seconds : 0.0);
+    // Memory traffic per stage: the capture copy reads the camera buffer and
+    // writes a pool buffer, the display reads a frame and writes RGBA, and
+    // each consumer pulls in every cache line of the frames it gets.
+    const double frameBytes = static_cast<double>(FrameSize(config.format, config.height, DefaultStride(config.format, config.width)));
+    const double captureBytes = sink.captured.load() * frameBytes * 2;
+    const double displayBytes = displayed * (frameBytes + rgba.size());
+    const double consumerBytes = received * frameBytes;
+    report.Add("frame_bytes", static_cast<uint64_t>(frameBytes));
+    report.Add("capture_gigabytes_per_s", captureBytes / seconds / 1e9);
+    report.Add("display_gigabytes_per_s", displayBytes / seconds / 1e9);
+    report.Add("consumer_gigabytes_per_s", consumerBytes / seconds / 1e9);
+    report.Add("total_gigabytes_per_s", (captureBytes + displayBytes + consumerBytes) / seconds / 1e9);
+    report.Add("capture_cpu_percent", ThreadCpuPercent("Capture", threads, threadCount, seconds));
+    report.Add("display_cpu_percent", ThreadCpuPercent("Display", threads, threadCount, seconds));
+    report.Add("consumer_cpu_percent", ThreadCpuPercent("Consumer", threads, threadCount, seconds));
+    for (int i = 0; i < static_cast<int>(LatencyStage::Count); ++i) {
+        const LatencyStage stage = static_cast<LatencyStage>(i);
+        if (stage == LatencyStage::Display) {
+            continue;  // Nothing is presented here
+        }
+        report.Add((std::string("latency_") + LatencyStageName(stage)).c_str(), sink.latency.Latency(stage).Summarize());
+    }
+    report.End();
+}
+
+static void RunEndToEndSuite(const BenchmarkOptions& options, BenchmarkReport& report) {
+    const double rates[] = { 30.0, 60.0, 0.0 };  // 0: unpaced
+    const int consumerCounts[] = { 1, 4 };
+    for (const Resolution& resolution : kResolutions) {
+        if (options.quick && resolution.width != 1280) {
+            continue;
+        }
+        for (double fps : rates) {
+            for (int consumers : consumerCounts) {
+                if (options.quick && consumers != 4) {
+                    continue;
+                }
+                RunEndToEnd(options, report, resolution, fps, consumers);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--suite") == 0 && hasValue) {
+            options.suites.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            options.seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+            options.minSeconds = 0.05;
+        }
+        else if (strcmp(argv[i], "--mjpeg") == 0 && hasValue) {
+            options.mjpegPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            options.maxThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--suite convert|mjpeg|pool|handoff|latency|e2e]... [--seconds S] [--quick] "
+                "[--mjpeg FILE|DIR] [--threads N] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    BenchmarkReport report;
+    bool ok = true;
+    if (options.Runs("convert")) {
+        RunConvertSuite(options, report);
+    }
+    if (options.Runs("mjpeg") && !options.mjpegPath.empty()) {
+        ok &= RunMjpegSuite(options, report);
+    }
+    if (options.Runs("pool")) {
+        RunPoolSuite(options, report);
+    }
+    if (options.Runs("handoff")) {
+        RunHandoffSuite(options, report);
+    }
+    if (options.Runs("latency")) {
+        RunLatencySuite(options, report);
+    }
+    if (options.Runs("e2e")) {
+        RunEndToEndSuite(options, report);
+    }
+
+    const std::string json = report.ToJson(options);
+    if (options.outPath.empty()) {
+        fputs(json.c_str(), stdout);
+        return ok ? 0 : 1;
+    }
+    std::ofstream out(options.outPath, std::ios::trunc);
+    if (!(out << json)) {
+        fprintf(stderr, "Could not write %s\n", options.outPath.c_str());
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+// Checks every SIMD conversion kernel the CPU can run against the scalar
+// reference, portable to Linux. YUY2, NV12, I420, I422 and I444 frames are
+// converted at odd and even widths and heights, with row strides padded by
+// odd byte counts, in all four color spaces. The frame contents are random
+// or edge values: all 0, all 255, alternating extremes, and full-scale luma
+// under saturated chroma. Each frame also goes through every orientation,
+// which exercises the reverse and transpose kernels.
+//
+// Every plane is allocated to its exact extent, so a kernel reading past a
+// row end shows up under -fsanitize=address. The destination rows have guard
+// bytes that must stay untouched. A channel differing from the scalar result
+// by more than 1 fails the check. The kernels are meant to be bit-exact
+// (PixelKernels.h), so the largest difference found is reported as well.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -Isrc bench/PixelKernelCheckMain.cpp src/PixelConversion.cpp src/PixelKernelsScalar.cpp
+//       src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp src/CpuFeatures.cpp -o pixel_kernel_check
+//
+// Usage: pixel_kernel_check [--quick]
+// Prints one JSON line per instruction set; the exit code is 1 if any
+// conversion differed.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include "PixelConversion.h"
+
+static const uint8_t kGuard = 0xCD;
+static const int kGuardBytes = 12;
+
+enum class Pattern {
+    Random,
+    Zero,
+    Full,
+    Alternating,     // 0 and 255 in turn, so neighbours differ by the most
+    SaturatedChroma, // Luma 255 or 0, chroma at its extremes
+    Count,
+};
+
+static const char* PatternName(Pattern pattern) {
+    switch (pattern) {
+    case Pattern::Random:          return "random";
+    case Pattern::Zero:            return "zero";
+    case Pattern::Full:            return "full";
+    case Pattern::Alternating:     return "alternating";
+    case Pattern::SaturatedChroma: return "saturated chroma";
+    default:                       return "unknown";
+    }
+}
+
+// A source frame whose planes each live in their own exact-size buffer.
+struct TestFrame {
+    std::vector<uint8_t> plane[3];
+    ImagePlanes planes;
+};
+
+static void FillPlane(std::vector<uint8_t>& plane, Pattern pattern, bool chroma, std::mt19937& random) {
+    for (size_t i = 0; i < plane.size(); ++i) {
+        uint8_t value = 0;
+        switch (pattern) {
+        case Pattern::Random:          value = static_cast<uint8_t>(random()); break;
+        case Pattern::Zero:            value = 0; break;
+        case Pattern::Full:            value = 255; break;
+        case Pattern::Alternating:     value = (i & 1) ? 255 : 0; break;
+        case Pattern::SaturatedChroma: value = chroma ? ((i / 3) & 1 ? 255 : 0) : ((i / 5) & 1 ? 255 : 0); break;
+        default:                       break;
+        }
+        plane[i] = value;
+    }
+}
+
+// Bytes of the last row of a plane: no padding after it, so an overread past
+// the row runs off the allocation.
+static size_t PlaneBytes(int rowBytes, int stride, int rows) {
+    return static_cast<size_t>(stride) * (rows - 1) + rowBytes;
+}
+
+static void MakeFrame(PixelFormat format, int width, int height, int padding, Pattern pattern, std::mt19937& random, TestFrame* frame) {
+    const int chromaWidth = (width + 1) / 2;
+    int rowBytes[3] = {};
+    int rows[3] = { height, 0, 0 };
+    int planeCount = 1;
+    switch (format) {
+    case PixelFormat::YUY2:
+        rowBytes[0] = chromaWidth * 4;
+        break;
+    case PixelFormat::NV12:
+        rowBytes[0] = width;
+        rowBytes[1] = chromaWidth * 2;
+        rows[1] = (height + 1) / 2;
+        planeCount = 2;
+        break;
+    case PixelFormat::I420:
+    case PixelFormat::I422:
+        rowBytes[0] = width;
+        rowBytes[1] = rowBytes[2] = chromaWidth;
+        rows[1] = rows[2] = format == PixelFormat::I420 ? (height + 1) / 2 : height;
+        planeCount = 3;
+        break;
+    case PixelFormat::I444:
+        rowBytes[0] = rowBytes[1] = rowBytes[2] = width;
+        rows[1] = rows[2] = height;
+        planeCount = 3;
+        break;
+    default:
+        break;
+    }
+
+    frame->planes = ImagePlanes();
+    frame->planes.format = format;
+    frame->planes.width = width;
+    frame->planes.height = height;
+    for (int i = 0; i < 3; ++i) {
+        frame->plane[i].clear();
+        if (i >= planeCount) {
+            continue;
+        }
+        // Chroma planes get a different odd padding from luma
+        const int stride = rowBytes[i] + padding + (i > 0 ? padding / 2 : 0);
+        frame->plane[i].resize(PlaneBytes(rowBytes[i], stride, rows[i]));
+        FillPlane(frame->plane[i], pattern, i > 0 || format == PixelFormat::YUY2, random);
+        if (format == PixelFormat::YUY2 && pattern == Pattern::SaturatedChroma) {
+            // Luma bytes at full scale, chroma bytes at the extremes
+            for (size_t j = 0; j < frame->plane[i].size(); j += 2) {
+                frame->plane[i][j] = (j / 6) & 1 ? 255 : 0;
+            }
+        }
+        frame->planes.data[i] = frame->plane[i].data();
+        frame->planes.stride[i] = stride;
+    }
+}
+
+struct Destination {
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    ptrdiff_t stride = 0;
+};
+
+static void PrepareDestination(int width, int height, Destination* destination) {
+    destination->width = width;
+    destination->height = height;
+    destination->stride = static_cast<ptrdiff_t>(width) * 4 + kGuardBytes;
+    destination->pixels.assign(static_cast<size_t>(destination->stride) * height, kGuard);
+}
+
+static bool GuardsIntact(const Destination& destination) {
+    for (int y = 0; y < destination.height; ++y) {
+        const uint8_t* guard = destination.pixels.data() + y * destination.stride + destination.width * 4;
+        for (int i = 0; i < kGuardBytes; ++i) {
+            if (guard[i] != kGuard) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Largest channel difference between two converted images, or 256 if the
+// guards were overwritten or alpha is not opaque.
+static int Compare(const Destination& expected, const Destination& actual) {
+    if (!GuardsIntact(actual)) {
+        return 256;
+    }
+    int worst = 0;
+    for (int y = 0; y < actual.height; ++y) {
+        const uint8_t* a = expected.pixels.data() + y * expected.stride;
+        const uint8_t* b = actual.pixels.data() + y * actual.stride;
+        for (int x = 0; x < actual.width * 4; ++x) {
+            if ((x & 3) == 3 && b[x] != 0xFF) {
+                return 256;
+            }
+            worst = std::max(worst, std::abs(a[x] - b[x]));
+        }
+    }
+    return worst;
+}
+
+struct IsaResult {
+    uint64_t conversions = 0;
+    uint64_t failures = 0;
+    int largestDifference = 0;
+};
+
+static void Convert(PixelIsa isa, const TestFrame& frame, YuvColorSpace colorSpace, FrameOrientation orientation, Destination* destination) {
+    SetPixelIsa(isa);
+    int width = 0;
+    int height = 0;
+    OrientedSize(orientation, frame.planes.width, frame.planes.height, &width, &height);
+    PrepareDestination(width, height, destination);
+    ConvertToRGBA(frame.planes, destination->pixels.data(), destination->stride, colorSpace, orientation);
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<PixelIsa> isas;
+    for (PixelIsa isa : { PixelIsa::SSSE3, PixelIsa::AVX2, PixelIsa::NEON }) {
+        if (SetPixelIsa(isa)) {
+            isas.push_back(isa);
+        }
+    }
+    if (isas.empty()) {
+        printf("{\"isa\": \"none\", \"note\": \"only the scalar kernels run on this CPU\"}\n");
+        return 0;
+    }
+
+    static const PixelFormat formats[] = {
+        PixelFormat::YUY2, PixelFormat::NV12, PixelFormat::I420, PixelFormat::I422, PixelFormat::I444,
+    };
+    // Around every vector width the kernels use (8, 16 and 32 pixels), plus
+    // sizes too small for any vector at all
+    std::vector<int> widths = { 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33, 47, 63, 64, 65, 97, 127, 129, 641 };
+    std::vector<int> heights = { 1, 2, 3, 5, 16, 17 };
+    const int paddings[] = { 0, 1, 7, 33 };
+    const YuvColorSpace colorSpaces[] = {
+        { YuvMatrix::BT601, YuvRange::Limited }, { YuvMatrix::BT601, YuvRange::Full },
+        { YuvMatrix::BT709, YuvRange::Limited }, { YuvMatrix::BT709, YuvRange::Full },
+    };
+    const FrameOrientation orientations[] = {
+        { FrameRotation::None, false, false }, { FrameRotation::None, true, false },
+        { FrameRotation::None, false, true }, { FrameRotation::Rotate90, false, false },
+        { FrameRotation::Rotate180, true, false }, { FrameRotation::Rotate270, false, true },
+    };
+    if (quick) {
+        widths = { 1, 3, 17, 33, 65 };
+        heights = { 1, 3, 17 };
+    }
+
+    std::vector<IsaResult> results(isas.size());
+    std::mt19937 random(12345);
+    TestFrame frame;
+    Destination expected;
+    Destination actual;
+    for (PixelFormat format : formats) {
+        for (int width : widths) {
+            for (int height : heights) {
+                for (int padding : paddings) {
+                    for (int p = 0; p < static_cast<int>(Pattern::Count); ++p) {
+                        const Pattern pattern = static_cast<Pattern>(p);
+                        MakeFrame(format, width, height, padding, pattern, random, &frame);
+                        for (const YuvColorSpace& colorSpace : colorSpaces) {
+                            // Orientations only with the first color space; they move
+                            // pixels and do not depend on it
+                            const size_t orientationCount = &colorSpace == colorSpaces ? std::size(orientations) : 1;
+                            for (size_t o = 0; o < orientationCount; ++o) {
+                                Convert(PixelIsa::Scalar, frame, colorSpace, orientations[o], &expected);
+                                for (size_t i = 0; i < isas.size(); ++i) {
+                                    Convert(isas[i], frame, colorSpace, orientations[o], &actual);
+                                    const int difference = Compare(expected, actual);
+                                    IsaResult& result = results[i];
+                                    ++result.conversions;
+                                    result.largestDifference = std::max(result.largestDifference, difference);
+                                    if (difference > 1) {
+                                        if (result.failures++ < 10) {
+                                            fprintf(stderr, "%s differs by %d: %s %dx%d padding %d %s, rotation %s%s%s\n",
+                                                PixelIsaName(isas[i]), difference, PixelFormatName(format), width, height,
+                                                padding, PatternName(pattern), FrameRotationName(orientations[o].rotation),
+                                                orientations[o].mirror ? " mirror" : "", orientations[o].flipVertical ? " flip" : "");
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < isas.size(); ++i) {
+        const IsaResult& result = results[i];
+        ok &= result.failures == 0;
+        printf("{\"isa\": \"%s\", \"conversions\": %llu, \"failures\": %llu, \"largest_difference\": %d}\n",
+            PixelIsaName(isas[i]), static_cast<unsigned long long>(result.conversions),
+            static_cast<unsigned long long>(result.failures), result.largestDifference);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+// Benchmark for SegmentedRecorder, portable to Linux: sustained write
+// throughput to a real disk and the worst-case cost of Enqueue() to the
+// thread feeding it. Results go out as one JSON document, ending with what
+// each run is accepted on: Enqueue() p99 and max, drops, and frames lost:
+//   {"machine": {...}, "options": {...}, "results": [{"name": ..., ...}, ...],
+//    "acceptance": [{"name": ..., "enqueue_p99_us": ..., "enqueue_max_us": ..., ...}, ...]}
+//
+// Each run feeds synthetic frames for a fixed time, either paced to a camera
+// frame rate or back to back, then stops the recorder, which writes out what
+// is still buffered. Throughput counts the time until the last byte is out.
+// Back to back runs feed far faster than any disk, so they show the write
+// rate the disk sustains and that a saturated disk costs dropped frames
+// while Enqueue() stays fast. The MJPEG runs record camera-sized JPEG
+// frames to AVI as they arrive, the passthrough path, and report the CPU the
+// producer and the I/O thread spend on it.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DNDEBUG -Isrc bench/RecorderBenchmarkMain.cpp
+//       src/SegmentedRecorder.cpp src/RawFrameFile.cpp src/AviFile.cpp src/FrameLatency.cpp src/LatencyHistogram.cpp
+//       src/PixelConversion.cpp src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp
+//       src/CpuFeatures.cpp src/Log.cpp src/ThreadCpu.cpp src/Trace.cpp -lpthread -o recorder_benchmark
+//
+// Usage: recorder_benchmark [--dir DIR] [--seconds S] [--quick] [--keep] [--out FILE]
+// DIR should be on the disk under test; it is created, and the segments
+// written there are removed afterwards unless --keep is given.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AviFile.h"
+#include "FrameLatency.h"
+#include "Log.h"
+#include "RawFrameFile.h"
+#include "SegmentedRecorder.h"
+#include "ThreadCpu.h"
+
+struct BenchmarkOptions {
+    std::string directory = "recorder-benchmark";
+    double seconds = 5.0;   // Length of each run
+    bool quick = false;     // Fewer configurations
+    bool keep = false;      // Leave the segments on disk
+    std::string outPath;
+};
+
+struct RunConfig {
+    const char* name;
+    int width;
+    int height;
+    double fps;          // 0: back to back
+    bool unbuffered;
+    uint64_t segmentMegabytes;
+    PixelFormat format = PixelFormat::YUY2;
+    RecordingContainer container = RecordingContainer::Raw;
+};
+
+// What a run is accepted on: the caller's worst Enqueue() costs, and no
+// frame recorded without reaching the file.
+struct RunAcceptance {
+    LatencySummary enqueue;
+    uint64_t dropped = 0;
+    uint64_t lost = 0;  // Recorded but not readable back
+};
+
+// CPU time of the recorder's I/O thread so far
+static double IoThreadCpuSeconds() {
+    ThreadCpuUsage threads[kMaxCpuThreads];
+    const size_t count = SampleThreadCpu(threads, kMaxCpuThreads);
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(threads[i].name, "Recorder I/O") == 0) {
+            return threads[i].cpuSeconds;
+        }
+    }
+    return 0.0;
+}
+
+static std::string RunRecorder(const BenchmarkOptions& options, const RunConfig& run, RunAcceptance* acceptance) {
+    fprintf(stderr, "%s\n", run.name);
+    const std::filesystem::path directory = std::filesystem::path(options.directory) / run.name;
+    std::filesystem::remove_all(directory);
+
+    RecorderOptions recorderOptions;
+    recorderOptions.directory = directory;
+    recorderOptions.baseName = "bench";
+    recorderOptions.segmentSeconds = 0.0;
+    recorderOptions.segmentBytes = run.segmentMegabytes << 20;
+    recorderOptions.unbuffered = run.unbuffered;
+    recorderOptions.container = run.container;
+    SegmentedRecorder recorder(recorderOptions);
+    if (!recorder.Start()) {
+        return std::string();
+    }
+
+    // A frame whose bytes change from frame to frame, so nothing along the
+    // way can get away with less than a full copy. MJPEG frames take the
+    // size a camera's JPEGs typically have and vary around it.
+    VideoFormat format;
+    format.format = run.format;
+    format.width = run.width;
+    format.height = run.height;
+    const bool compressed = run.format == PixelFormat::MJPEG;
+    format.stride = compressed ? 0 : run.width * 2;
+    const size_t frameBytes = compressed ? static_cast<size_t>(run.width) * run.height / 4 : static_cast<size_t>(format.stride) * run.height;
+    std::vector<uint8_t> frame(frameBytes + frameBytes / 8);
+    for (size_t i = 0; i < frame.size(); ++i) {
+        frame[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    LatencyHistogram enqueueLatency;
+    uint64_t offered = 0;
+    const double producerCpuStart = CurrentThreadCpuSeconds();
+    const int64_t start = MonotonicNanos();
+    const int64_t end = start + static_cast<int64_t>(options.seconds * 1e9);
+    const int64_t interval = run.fps > 0.0 ? static_cast<int64_t>(1e9 / run.fps) : 0;
+    int64_t due = start;
+    for (;;) {
+        const int64_t now = MonotonicNanos();
+        if (now >= end) {
+            break;
+        }
+        if (interval > 0 && now < due) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+            continue;
+        }
+        due += interval;
+        frame[static_cast<size_t>(offered % frame.size())] ^= 0xFF;
+
+        const int64_t before = MonotonicNanos();
+        const size_t size = compressed ? frameBytes - frameBytes / 8 + (offered * 7919) % (frameBytes / 4) : frameBytes;
+        recorder.Enqueue(format, frame.data(), size, offered / (run.fps > 0.0 ? run.fps : 30.0));
+        enqueueLatency.Record(MonotonicNanos() - before);
+        ++offered;
+    }
+    const int64_t fed = MonotonicNanos();
+    const double producerCpu = CurrentThreadCpuSeconds() - producerCpuStart;
+    const double ioCpu = IoThreadCpuSeconds();  // While fed; the thread is gone after Stop()
+    recorder.Stop();
+    const int64_t stopped = MonotonicNanos();
+
+    const RecorderStats stats = recorder.GetStats();
+    const double seconds = (stopped - start) / 1e9;
+
+    // Every frame recorded has to come back out of the files
+    uint64_t readable = 0;
+    for (uint64_t segment = 1; segment <= stats.segments; ++segment) {
+        if (run.container == RecordingContainer::Avi) {
+            AviReader reader;
+            if (reader.Open(recorder.SegmentPath(segment))) {
+                readable += reader.FrameCount();
+            }
+            continue;
+        }
+        RawFrameReader reader;
+        VideoFormat recorded;
+        std::vector<uint8_t> data;
+        size_t size = 0;
+        double sampleTime = 0.0;
+        if (reader.Open(recorder.SegmentPath(segment))) {
+            while (reader.Next(&recorded, &data, &size, &sampleTime)) {
+                ++readable;
+            }
+        }
+    }
+
+    char buffer[768];
+    snprintf(buffer, sizeof(buffer),
+        "{\"name\": \"%s\", \"format\": \"%s\", \"container\": \"%s\", \"width\": %d, \"height\": %d, "
+        "\"fps\": %.1f, \"unbuffered\": %s, \"written_mb_per_s\": %.1f, \"frames_offered\": %llu, "
+        "\"frames_recorded\": %llu, \"frames_readable\": %llu, \"frames_dropped\": %llu, \"segments\": %llu, \"write_errors\": %llu, "
+        "\"stop_ms\": %.1f, \"producer_cpu_percent\": %.2f, \"io_cpu_percent\": %.2f, \"enqueue\": ",
+        run.name, PixelFormatName(run.format), run.container == RecordingContainer::Avi ? "avi" : "raw",
+        run.width, run.height, run.fps, run.unbuffered ? "true" : "false",
+        stats.bytesWritten / 1e6 / seconds,
+        static_cast<unsigned long long>(offered), static_cast<unsigned long long>(stats.framesRecorded),
+        static_cast<unsigned long long>(readable), static_cast<unsigned long long>(stats.framesDropped), static_cast<unsigned long long>(stats.segments),
+        static_cast<unsigned long long>(stats.writeErrors), (stopped - fed) / 1e6,
+        100.0 * producerCpu / ((fed - start) / 1e9), 100.0 * ioCpu / ((fed - start) / 1e9));
+    std::string json = buffer;
+    acceptance->enqueue = enqueueLatency.Summarize();
+    acceptance->dropped = stats.framesDropped;
+    acceptance->lost = stats.framesRecorded > readable ? stats.framesRecorded - readable : 0;
+    AppendLatencySummaryJson(json, acceptance->enqueue);
+    json += ", \"write_call\": ";
+    AppendLatencySummaryJson(json, recorder.WriteLatency().Summarize());
+    json += '}';
+
+    if (!options.keep) {
+        std::filesystem::remove_all(directory);
+    }
+    return json;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--dir") == 0 && hasValue) {
+            options.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            options.seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        }
+        else if (strcmp(argv[i], "--keep") == 0) {
+            options.keep = true;
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--dir DIR] [--seconds S] [--quick] [--keep] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    LogSetOutput(stderr);
+
+    // Camera rates first, then back to back to find the disk's limit
+    const RunConfig runs[] = {
+        { "720p30", 1280, 720, 30.0, true, 256 },
+        { "1080p60", 1920, 1080, 60.0, true, 256 },
+        { "1080p back to back", 1920, 1080, 0.0, true, 1024 },
+        { "1080p back to back, buffered", 1920, 1080, 0.0, false, 1024 },
+        { "4K30", 3840, 2160, 30.0, true, 1024 },
+        { "4K30 MJPEG to AVI", 3840, 2160, 30.0, false, 1024, PixelFormat::MJPEG, RecordingContainer::Avi },
+        { "4K30 MJPEG to raw", 3840, 2160, 30.0, true, 1024, PixelFormat::MJPEG, RecordingContainer::Raw },
+    };
+    const size_t runCount = options.quick ? 3 : std::size(runs);
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+        "{\"machine\": {\"hardware_threads\": %u}, \"options\": {\"directory\": \"%s\", \"seconds\": %.2f},\n\"results\": [\n",
+        std::thread::hardware_concurrency(), options.directory.c_str(), options.seconds);
+    std::string json = buffer;
+    std::string acceptance;
+    for (size_t i = 0; i < runCount; ++i) {
+        RunAcceptance accepted;
+        const std::string result = RunRecorder(options, runs[i], &accepted);
+        if (result.empty()) {
+            fprintf(stderr, "Could not start the recorder in %s\n", options.directory.c_str());
+            return 1;
+        }
+        json += i ? ",\n  " : "  ";
+        json += result;
+        snprintf(buffer, sizeof(buffer),
+            "%s{\"name\": \"%s\", \"enqueue_p99_us\": %.1f, \"enqueue_max_us\": %.1f, \"frames_dropped\": %llu, "
+            "\"frames_lost\": %llu}",
+            i ? ",\n  " : "  ", runs[i].name, accepted.enqueue.p99, accepted.enqueue.max,
+            static_cast<unsigned long long>(accepted.dropped), static_cast<unsigned long long>(accepted.lost));
+        acceptance += buffer;
+        fprintf(stderr, "  enqueue p99 %.1f us, max %.1f us\n", accepted.enqueue.p99, accepted.enqueue.max);
+    }
+    json += "\n],\n\"acceptance\": [\n";
+    json += acceptance;
+    json += "\n]}\n";
+    if (!options.keep) {
+        std::error_code error;
+        std::filesystem::remove(options.directory, error);
+    }
+    LogShutdown();
+
+    if (options.outPath.empty()) {
+        fputs(json.c_str(), stdout);
+        return 0;
+    }
+    std::ofstream out(options.outPath, std::ios::trunc);
+    if (!(out << json)) {
+        fprintf(stderr, "Could not write %s\n", options.outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,224 @@
+// Replay test for RawFrameWriter, RawFrameReader and ReplayCaptureSource,
+// portable to Linux. A known sequence of frames is written to a raw frame
+// file, with a layout change part way through and recorded timestamps that
+// do not start at zero, then replayed through ReplayCaptureSource for more
+// than two passes. Checked:
+//   - Open() reports the recorded layout and frame rate
+//   - every delivered frame is byte-identical to the one written at its
+//     position in the file, with the same layout
+//   - sample times start at zero, increase monotonically across loops, and
+//     keep the recorded spacing, with one frame interval at each wrap
+//   - without looping the source stops after one pass
+//   - paced by the timestamps, a pass takes no less than it was recorded in
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -Isrc bench/ReplayCaptureTestMain.cpp src/ReplayCaptureSource.cpp src/RawFrameFile.cpp
+//       src/CaptureCapabilities.cpp src/CameraOpener.cpp src/PixelConversion.cpp src/PixelKernelsScalar.cpp
+//       src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp src/CpuFeatures.cpp src/FrameLatency.cpp
+//       src/LatencyHistogram.cpp src/Log.cpp src/ThreadCpu.cpp src/Trace.cpp -lpthread -o replay_capture_test
+//
+// Usage: replay_capture_test [--dir DIR]
+// Prints one line per check; the exit code is 1 if any check failed.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CameraOpener.h"
+#include "FrameLatency.h"
+#include "Log.h"
+#include "ReplayCaptureSource.h"
+
+static const int kFrameCount = 12;
+static const int kLayoutChange = 8;        // First frame in the second layout
+static const double kFirstTime = 12.5;     // Recorded time of the first frame
+static const double kInterval = 1.0 / 30.0;
+
+static VideoFormat TestFrameFormat(int index) {
+    VideoFormat format;
+    format.format = index < kLayoutChange ? PixelFormat::YUY2 : PixelFormat::BGR24;
+    format.width = index < kLayoutChange ? 64 : 48;
+    format.height = index < kLayoutChange ? 16 : 24;
+    format.stride = DefaultStride(format.format, format.width);
+    format.topDown = index >= kLayoutChange;
+    return format;
+}
+
+// Contents that differ from frame to frame and byte to byte.
+static std::vector<uint8_t> TestFrameData(int index) {
+    const VideoFormat format = TestFrameFormat(index);
+    std::vector<uint8_t> data(FrameSize(format.format, format.height, format.stride));
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 31 + index * 97 + (i >> 8));
+    }
+    return data;
+}
+
+struct ReceivedFrame {
+    VideoFormat format;
+    std::vector<uint8_t> data;
+    double sampleTime;
+};
+
+class RecordingSink : public CaptureSink {
+public:
+    void OnFrame(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames.push_back({ format, std::vector<uint8_t>(data, data + size), sampleTime });
+    }
+
+    std::vector<ReceivedFrame> Take() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::move(frames);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<ReceivedFrame> frames;
+};
+
+static bool Report(bool passed, const char* name, const std::string& detail) {
+    printf("%s  %s: %s\n", passed ? "pass" : "FAIL", name, detail.c_str());
+    return passed;
+}
+
+static bool WriteTestFile(const std::filesystem::path& path) {
+    RawFrameWriter writer;
+    if (!writer.Open(path)) {
+        return false;
+    }
+    bool written = true;
+    for (int i = 0; i < kFrameCount; ++i) {
+        const std::vector<uint8_t> data = TestFrameData(i);
+        written &= writer.Write(TestFrameFormat(i), data.data(), data.size(), kFirstTime + i * kInterval);
+    }
+    writer.Close();
+    return written;
+}
+
+// Replays the file until the source stops by itself, or 'timeout' passes.
+static std::vector<ReceivedFrame> Replay(const std::filesystem::path& path, bool realtime, bool loop, uint64_t frameLimit,
+                                         double* seconds) {
+    ReplaySourceConfig config;
+    config.path = path;
+    config.realtime = realtime;
+    config.loop = loop;
+    config.frameLimit = frameLimit;
+    ReplayCaptureSource source(config);
+    CameraOpenContext context;
+    RecordingSink sink;
+    if (source.Open(DefaultCapturePolicy(), context) != 0) {
+        return {};
+    }
+    const int64_t start = MonotonicNanos();
+    if (source.Start(&sink) != 0) {
+        return {};
+    }
+    const uint64_t expected = frameLimit ? frameLimit : kFrameCount;
+    const int64_t timeout = start + 10'000'000'000LL;
+    while (source.FramesDelivered() < expected && MonotonicNanos() < timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    *seconds = (MonotonicNanos() - start) / 1e9;
+    // Give a source that should have stopped the chance to overrun
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    source.Stop();
+    return sink.Take();
+}
+
+static bool SameFormat(const VideoFormat& a, const VideoFormat& b) {
+    return a.format == b.format && a.width == b.width && a.height == b.height && a.stride == b.stride && a.topDown == b.topDown;
+}
+
+static bool CheckOpen(const std::filesystem::path& path) {
+    ReplaySourceConfig config;
+    config.path = path;
+    ReplayCaptureSource source(config);
+    CameraOpenContext context;
+    const long result = source.Open(DefaultCapturePolicy(), context);
+    const VideoFormat format = source.Format();
+    const bool opened = result == 0 && source.SelectedMode() == 0;
+    const double fps = opened ? source.Capabilities().Modes()[0].maxFps : 0.0;
+    char detail[128];
+    snprintf(detail, sizeof(detail), "result %ld, %s %dx%d @ %.2f fps", result, PixelFormatName(format.format),
+        format.width, format.height, fps);
+    return Report(opened && SameFormat(format, TestFrameFormat(0)) && std::fabs(fps - 30.0) < 1e-6, "open", detail);
+}
+
+static bool CheckLoops(const std::filesystem::path& path) {
+    const uint64_t limit = kFrameCount * 2 + kFrameCount / 2;
+    double seconds = 0.0;
+    const std::vector<ReceivedFrame> frames = Replay(path, false, true, limit, &seconds);
+    bool passed = Report(frames.size() == limit, "loop count", std::to_string(frames.size()) + " of " + std::to_string(limit) + " frames");
+
+    int mismatched = 0;
+    int badTimes = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const int index = static_cast<int>(i % kFrameCount);
+        if (!SameFormat(frames[i].format, TestFrameFormat(index)) || frames[i].data != TestFrameData(index)) {
+            ++mismatched;
+        }
+        // Each pass keeps the recorded spacing, and a wrap adds one interval
+        const double expected = i * kInterval;
+        if (std::fabs(frames[i].sampleTime - expected) > 1e-9 || (i > 0 && frames[i].sampleTime <= frames[i - 1].sampleTime)) {
+            ++badTimes;
+        }
+    }
+    passed &= Report(mismatched == 0, "loop contents", std::to_string(mismatched) + " frames differ from the file");
+    char detail[128];
+    snprintf(detail, sizeof(detail), "%d out of place, last %.6f s", badTimes, frames.empty() ? 0.0 : frames.back().sampleTime);
+    passed &= Report(badTimes == 0 && !frames.empty(), "loop timestamps", detail);
+    return passed;
+}
+
+static bool CheckSinglePass(const std::filesystem::path& path) {
+    double seconds = 0.0;
+    const std::vector<ReceivedFrame> frames = Replay(path, false, false, 0, &seconds);
+    return Report(frames.size() == kFrameCount, "no loop", std::to_string(frames.size()) + " frames, one pass");
+}
+
+static bool CheckPacing(const std::filesystem::path& path) {
+    const uint64_t limit = kFrameCount + 1;
+    double seconds = 0.0;
+    const std::vector<ReceivedFrame> frames = Replay(path, true, true, limit, &seconds);
+    const double recorded = kFrameCount * kInterval;
+    char detail[128];
+    snprintf(detail, sizeof(detail), "%zu frames in %.3f s, recorded %.3f s", frames.size(), seconds, recorded);
+    return Report(frames.size() == limit && seconds >= recorded - 0.002, "realtime pacing", detail);
+}
+
+int main(int argc, char** argv) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "replay-capture-test";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--dir DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    const std::filesystem::path path = directory / "replay.qraw";
+
+    int failures = 0;
+    if (!Report(WriteTestFile(path), "write", path.string())) {
+        ++failures;
+    }
+    else {
+        failures += CheckOpen(path) ? 0 : 1;
+        failures += CheckLoops(path) ? 0 : 1;
+        failures += CheckSinglePass(path) ? 0 : 1;
+        failures += CheckPacing(path) ? 0 : 1;
+    }
+    std::filesystem::remove_all(directory, error);
+    LogShutdown();
+    printf("%d checks failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
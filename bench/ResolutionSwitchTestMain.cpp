@@ -0,0 +1,279 @@
+// Resolution switches mid-stream, portable to Linux. A scripted source
+// delivers 640x480, then 1920x1080, then 320x240 frames through the same
+// path WebcamController takes: copy into a FramePool frame, publish through
+// a FrameMailbox, and convert on a display thread into a texture that is
+// recreated whenever the oriented frame size changes. The texture is a heap
+// buffer of exactly its size, and so is every source frame, so a read or
+// write past either shows up under -fsanitize=address.
+//
+// Each phase fills its frames with a luma value of its own, so a texture
+// holding any pixel of a frame from another phase is caught. Checked per
+// run, in YUY2 and NV12, upright and rotated by 90 degrees:
+//   - the texture is recreated at every switch and has the new size
+//   - every frame the display takes is uniformly of its own phase, fills
+//     the whole texture, and sits in a pool buffer large enough for it
+//   - the pool grows its buffers when the larger frames arrive
+// Results go out as one JSON document; the exit code is 1 if a check failed.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -Isrc bench/ResolutionSwitchTestMain.cpp src/PixelConversion.cpp
+//       src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp src/CpuFeatures.cpp
+//       src/FramePool.cpp src/FrameLatency.cpp src/LatencyHistogram.cpp src/Log.cpp src/ThreadCpu.cpp
+//       src/Trace.cpp -lpthread -o resolution_switch_test
+// Add -fsanitize=address to have ASan watch the frame and texture bounds.
+//
+// Usage: resolution_switch_test [--frames N] [--out FILE]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameLatency.h"
+#include "FrameMailbox.h"
+#include "FramePool.h"
+
+struct Phase {
+    int width;
+    int height;
+    uint8_t luma;  // Every pixel of the phase's frames
+};
+
+static const Phase kPhases[] = {
+    { 640, 480, 40 },
+    { 1920, 1080, 120 },
+    { 320, 240, 200 },
+};
+static const int kPhaseCount = static_cast<int>(sizeof(kPhases) / sizeof(kPhases[0]));
+
+// Stands in for the D3D11 texture: exactly width * height RGBA pixels, so an
+// overrun lands outside the allocation.
+struct Texture {
+    std::unique_ptr<uint8_t[]> pixels;
+    int width = 0;
+    int height = 0;
+};
+
+struct SwitchResult {
+    uint64_t delivered = 0;
+    uint64_t displayed = 0;
+    uint64_t textureCreations = 0;
+    uint64_t wrongTextureSize = 0;   // Texture not of the frame's oriented size
+    uint64_t stalePixels = 0;        // Frames whose texture held another phase's pixels
+    uint64_t shortBuffers = 0;       // Frames larger than their pool buffer
+    uint64_t phasesDisplayed = 0;    // Phases at least one frame of reached the texture
+    uint64_t poolAllocationsBefore = 0;  // Pool heap allocations when the large frames began
+    uint64_t poolAllocationsAfter = 0;   // ... and when the first of them was displayed
+};
+
+// A frame of 'phase' in its own exact-size allocation, chroma neutral.
+static std::vector<uint8_t> MakeFrame(PixelFormat format, const Phase& phase, VideoFormat* layout) {
+    layout->format = format;
+    layout->width = phase.width;
+    layout->height = phase.height;
+    layout->stride = DefaultStride(format, phase.width);
+    layout->topDown = true;
+    std::vector<uint8_t> data(FrameSize(format, phase.height, layout->stride), 128);
+    if (format == PixelFormat::YUY2) {
+        for (size_t i = 0; i < data.size(); i += 2) {
+            data[i] = phase.luma;
+        }
+    }
+    else {
+        memset(data.data(), phase.luma, static_cast<size_t>(layout->stride) * phase.height);
+    }
+    return data;
+}
+
+// The RGBA pixel a frame of 'phase' converts to, from a 2x2 frame of the same
+// content through the same converter.
+static uint32_t ExpectedPixel(PixelFormat format, const Phase& phase) {
+    const Phase small = { 2, 2, phase.luma };
+    VideoFormat layout;
+    const std::vector<uint8_t> data = MakeFrame(format, small, &layout);
+    ImagePlanes planes;
+    DescribeFrame(format, data.data(), data.size(), 2, 2, layout.stride, &planes);
+    uint8_t rgba[16];
+    ConvertToRGBA(planes, rgba, 8, DefaultYuvColorSpace(phase.width, phase.height));
+    uint32_t pixel;
+    memcpy(&pixel, rgba, 4);
+    return pixel;
+}
+
+static int PhaseOf(const VideoFrame& frame) {
+    for (int i = 0; i < kPhaseCount; ++i) {
+        if (kPhases[i].width == frame.width && kPhases[i].height == frame.height) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static SwitchResult RunSwitch(PixelFormat format, FrameOrientation orientation, int framesPerPhase) {
+    SwitchResult result;
+    FramePool pool(8);
+    FrameMailbox<FrameRef> mailbox;
+    std::atomic<bool> producing{ true };
+    std::atomic<int> lastPhaseDisplayed{ -1 };
+    std::atomic<uint64_t> poolAllocationsAtSwitch{ 0 };
+
+    uint32_t expected[kPhaseCount];
+    for (int i = 0; i < kPhaseCount; ++i) {
+        expected[i] = ExpectedPixel(format, kPhases[i]);
+    }
+
+    // Display thread: GetFrameTexture() and UploadFrame() without D3D
+    std::thread display([&] {
+        Texture texture;
+        while (true) {
+            const bool done = !producing.load(std::memory_order_acquire);
+            if (!mailbox.Acquire()) {
+                if (done) {
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            const VideoFrame& frame = *mailbox.ReadSlot();
+            ++result.displayed;
+            if (frame.size != FrameSize(frame.format, frame.height, frame.stride) || frame.capacity < frame.size) {
+                ++result.shortBuffers;
+                continue;
+            }
+            ImagePlanes planes;
+            if (!frame.GetPlanes(&planes)) {
+                ++result.shortBuffers;
+                continue;
+            }
+            int width = 0;
+            int height = 0;
+            OrientedSize(orientation, frame.width, frame.height, &width, &height);
+            if (!texture.pixels || width != texture.width || height != texture.height) {
+                texture.pixels.reset(new uint8_t[static_cast<size_t>(width) * height * 4]);
+                texture.width = width;
+                texture.height = height;
+                ++result.textureCreations;
+            }
+            // Poison the texture so a pixel the conversion missed shows too
+            memset(texture.pixels.get(), 0, static_cast<size_t>(width) * height * 4);
+            ConvertToRGBA(planes, texture.pixels.get(), width * 4, DefaultYuvColorSpace(frame.width, frame.height), orientation);
+
+            const int phase = PhaseOf(frame);
+            if (phase < 0 || texture.width != width || texture.height != height) {
+                ++result.wrongTextureSize;
+                continue;
+            }
+            const uint8_t* pixels = texture.pixels.get();
+            for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+                if (memcmp(pixels + i * 4, &expected[phase], 4) != 0) {
+                    ++result.stalePixels;
+                    break;
+                }
+            }
+            if (phase != lastPhaseDisplayed.load(std::memory_order_relaxed)) {
+                ++result.phasesDisplayed;
+                if (phase == 1) {
+                    result.poolAllocationsAfter = pool.GetStats().heapAllocations;
+                }
+                lastPhaseDisplayed.store(phase, std::memory_order_release);
+            }
+        }
+    });
+
+    // Capture thread: WebcamController::OnFrame() at about 240 fps. Each
+    // phase lasts until the display has shown one of its frames, so no phase
+    // can be skipped by the mailbox.
+    for (int phase = 0; phase < kPhaseCount; ++phase) {
+        VideoFormat layout;
+        const std::vector<uint8_t> data = MakeFrame(format, kPhases[phase], &layout);
+        if (phase == 1) {
+            result.poolAllocationsBefore = pool.GetStats().heapAllocations;
+        }
+        const int64_t deadline = MonotonicNanos() + 5000000000LL;
+        for (int i = 0; i < framesPerPhase || (lastPhaseDisplayed.load(std::memory_order_acquire) != phase && MonotonicNanos() < deadline); ++i) {
+            FrameRef frame = pool.Acquire(layout, data.size());
+            if (frame) {
+                memcpy(frame->pixels, data.data(), data.size());
+                frame->sequence = ++result.delivered;
+                mailbox.WriteSlot() = std::move(frame);
+                mailbox.Publish();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(4166));
+        }
+    }
+    producing.store(false, std::memory_order_release);
+    display.join();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int framesPerPhase = 60;
+    std::string outPath;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            framesPerPhase = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--frames N] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    struct NamedOrientation {
+        const char* name;
+        FrameOrientation orientation;
+    };
+    const NamedOrientation orientations[] = {
+        { "none", { FrameRotation::None, false, false } },
+        { "rotate90", { FrameRotation::Rotate90, false, false } },
+    };
+    std::string json = "{\"results\": [\n";
+    bool ok = true;
+    bool first = true;
+    for (PixelFormat format : { PixelFormat::YUY2, PixelFormat::NV12 }) {
+        for (const NamedOrientation& entry : orientations) {
+            const SwitchResult result = RunSwitch(format, entry.orientation, framesPerPhase);
+            // One texture per phase, and the buffers grew for the large frames
+            const bool passed = result.textureCreations == kPhaseCount && result.phasesDisplayed == kPhaseCount &&
+                result.wrongTextureSize == 0 && result.stalePixels == 0 && result.shortBuffers == 0 &&
+                result.poolAllocationsAfter > result.poolAllocationsBefore;
+            ok &= passed;
+            char line[640];
+            snprintf(line, sizeof(line),
+                "%s{\"format\": \"%s\", \"orientation\": \"%s\", \"delivered\": %llu, \"displayed\": %llu, "
+                "\"texture_creations\": %llu, \"phases_displayed\": %llu, \"wrong_texture_size\": %llu, "
+                "\"stale_pixels\": %llu, \"short_buffers\": %llu, \"pool_allocations_before\": %llu, "
+                "\"pool_allocations_after\": %llu, \"ok\": %s}",
+                first ? "  " : ",\n  ", PixelFormatName(format), entry.name,
+                static_cast<unsigned long long>(result.delivered), static_cast<unsigned long long>(result.displayed),
+                static_cast<unsigned long long>(result.textureCreations), static_cast<unsigned long long>(result.phasesDisplayed),
+                static_cast<unsigned long long>(result.wrongTextureSize), static_cast<unsigned long long>(result.stalePixels),
+                static_cast<unsigned long long>(result.shortBuffers), static_cast<unsigned long long>(result.poolAllocationsBefore),
+                static_cast<unsigned long long>(result.poolAllocationsAfter), passed ? "true" : "false");
+            json += line;
+            first = false;
+        }
+    }
+    json += "\n]}\n";
+
+    if (outPath.empty()) {
+        fputs(json.c_str(), stdout);
+    }
+    else {
+        std::ofstream out(outPath, std::ios::trunc);
+        if (!(out << json)) {
+            fprintf(stderr, "Could not write %s\n", outPath.c_str());
+            return 1;
+        }
+    }
+    return ok ? 0 : 1;
+}
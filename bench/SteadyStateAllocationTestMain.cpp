@@ -0,0 +1,213 @@
+// Checks that the per-frame path does not touch the heap once warmed up,
+// portable to Linux. Each case runs frames of one format through what
+// WebcamController and the UI thread do with them, one step after another
+// on a single thread so every run is the same:
+//   Capture    FramePool::Acquire(), copy in the pixels, FrameBroadcast and
+//              FrameMailbox publish, FrameLatencyCollector::RecordCapture()
+//   Consumer   a subscriber of each backpressure policy pops the frame
+//   Convert    mailbox pickup, ConvertToRGBA(), RecordDisplay()
+// The steps run inside ALLOC_SCOPE scopes of those names. After the warm-up
+// frames, each scope's allocation count and the thread's own, which also
+// sees allocations outside the scopes, must not move for the rest of the
+// frames. A first check makes sure the tracker sees an allocation at all.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DENABLE_ALLOCATION_TRACKING -Isrc bench/SteadyStateAllocationTestMain.cpp
+//       src/AllocationTracker.cpp src/FramePool.cpp src/FrameBroadcast.cpp src/FrameLatency.cpp
+//       src/LatencyHistogram.cpp src/PixelConversion.cpp src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp
+//       src/PixelKernelsNeon.cpp src/CpuFeatures.cpp -ldl -lpthread -o steady_state_allocation_test
+//
+// Usage: steady_state_allocation_test [--frames N] [--warmup N]
+// Prints one line per check; the exit code is 1 if any check failed, or if
+// the build does not track allocations.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "AllocationTracker.h"
+#include "FrameBroadcast.h"
+#include "FrameLatency.h"
+#include "FrameMailbox.h"
+#include "FramePool.h"
+#include "PixelConversion.h"
+
+static const char* const kScopes[] = { "Capture", "Consumer", "Convert" };
+
+struct FormatCase {
+    PixelFormat format;
+    int width;
+    int height;
+};
+
+static const FormatCase kCases[] = {
+    { PixelFormat::YUY2, 640, 480 },
+    { PixelFormat::YUY2, 1280, 720 },
+    { PixelFormat::NV12, 1920, 1080 },
+    { PixelFormat::BGR24, 1280, 720 },
+};
+
+static bool Report(bool passed, const char* name, const char* detail) {
+    printf("%s  %s: %s\n", passed ? "pass" : "FAIL", name, detail);
+    return passed;
+}
+
+static bool TrackerSeesAllocations() {
+    const AllocationCounts before = GetScopeAllocations("Self check");
+    {
+        ALLOC_SCOPE("Self check");
+        std::unique_ptr<std::vector<int>> allocated = std::make_unique<std::vector<int>>(64);
+        (*allocated)[0] = 1;
+    }
+    const AllocationCounts counted = GetScopeAllocations("Self check") - before;
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%llu allocations, %llu frees",
+        static_cast<unsigned long long>(counted.allocations), static_cast<unsigned long long>(counted.frees));
+    return Report(counted.allocations >= 2 && counted.frees == counted.allocations, "tracker counts a scope", detail);
+}
+
+// The frames of one format, with the pipeline built fresh for them.
+static bool RunCase(const FormatCase& test, int frames, int warmup) {
+    FramePool pool(32);
+    FrameBroadcast broadcast;
+    FrameMailbox<FrameRef> mailbox;
+    FrameLatencyCollector latency;
+
+    std::vector<std::unique_ptr<FrameSubscriber>> subscribers;
+    for (BackpressurePolicy policy : { BackpressurePolicy::DropOldest, BackpressurePolicy::DropNewest, BackpressurePolicy::Block }) {
+        SubscriberOptions options;
+        options.policy = policy;
+        subscribers.push_back(broadcast.Subscribe(options));
+    }
+
+    VideoFormat format;
+    format.format = test.format;
+    format.width = test.width;
+    format.height = test.height;
+    format.stride = DefaultStride(test.format, test.width);
+    const size_t bytes = FrameSize(test.format, test.height, format.stride);
+    std::vector<uint8_t> source(bytes);
+    for (size_t i = 0; i < source.size(); ++i) {
+        source[i] = static_cast<uint8_t>(i * 7 + (i >> 12));
+    }
+    std::vector<uint8_t> rgba(static_cast<size_t>(test.width) * test.height * 4);
+    const YuvColorSpace colorSpace = DefaultYuvColorSpace(test.width, test.height);
+
+    AllocationCounts scopeBefore[std::size(kScopes)];
+    AllocationCounts threadBefore;
+    uint64_t converted = 0;
+    for (int i = 0; i < warmup + frames; ++i) {
+        if (i == warmup) {
+            for (size_t s = 0; s < std::size(kScopes); ++s) {
+                scopeBefore[s] = GetScopeAllocations(kScopes[s]);
+            }
+            threadBefore = GetThreadAllocations();
+        }
+        {
+            ALLOC_SCOPE("Capture");
+            const int64_t grabTime = MonotonicNanos();
+            FrameRef frame = pool.Acquire(format, bytes);
+            if (frame) {
+                memcpy(frame->pixels, source.data(), bytes);
+                frame->sampleTime = i / 30.0;
+                frame->sequence = static_cast<uint64_t>(i) + 1;
+                frame->grabTime = grabTime;
+                frame->publishTime = MonotonicNanos();
+                broadcast.Publish(frame);
+                mailbox.WriteSlot() = std::move(frame);
+                mailbox.Publish();
+                latency.RecordCapture(i / 30.0, grabTime, MonotonicNanos());
+            }
+        }
+        {
+            ALLOC_SCOPE("Consumer");
+            FrameRef frame;
+            for (const std::unique_ptr<FrameSubscriber>& subscriber : subscribers) {
+                while (subscriber->TryPop(&frame)) {
+                    frame.Reset();
+                }
+            }
+        }
+        {
+            ALLOC_SCOPE("Convert");
+            if (mailbox.Acquire()) {
+                const VideoFrame& frame = *mailbox.ReadSlot();
+                FrameTimestamps times;
+                times.sampleTime = frame.sampleTime;
+                times.grab = frame.grabTime;
+                times.publish = frame.publishTime;
+                times.pickup = MonotonicNanos();
+                ImagePlanes planes;
+                if (DescribeFrame(frame.format, frame.pixels, frame.size, frame.width, frame.height, frame.stride, &planes)) {
+                    ConvertToRGBA(planes, rgba.data(), test.width * 4, colorSpace);
+                    ++converted;
+                }
+                times.convert = MonotonicNanos();
+                times.display = times.convert;
+                latency.RecordDisplay(times);
+            }
+        }
+    }
+    const AllocationCounts threadAllocations = GetThreadAllocations() - threadBefore;
+
+    char name[96];
+    snprintf(name, sizeof(name), "%s %dx%d", PixelFormatName(test.format), test.width, test.height);
+    char detail[160];
+    bool passed = true;
+    for (size_t s = 0; s < std::size(kScopes); ++s) {
+        const AllocationCounts counted = GetScopeAllocations(kScopes[s]) - scopeBefore[s];
+        snprintf(detail, sizeof(detail), "%s %llu allocations, %llu frees over %d frames", kScopes[s],
+            static_cast<unsigned long long>(counted.allocations), static_cast<unsigned long long>(counted.frees), frames);
+        passed &= Report(counted.allocations == 0 && counted.frees == 0, name, detail);
+    }
+    snprintf(detail, sizeof(detail), "thread %llu allocations over %d frames",
+        static_cast<unsigned long long>(threadAllocations.allocations), frames);
+    passed &= Report(threadAllocations.allocations == 0, name, detail);
+
+    // Every frame has to have gone all the way through
+    uint64_t received = 0;
+    for (const std::unique_ptr<FrameSubscriber>& subscriber : subscribers) {
+        received += subscriber->GetStats().received;
+    }
+    const uint64_t expected = static_cast<uint64_t>(warmup + frames);
+    snprintf(detail, sizeof(detail), "%llu converted, %llu received by %zu subscribers, %llu pool exhausted",
+        static_cast<unsigned long long>(converted), static_cast<unsigned long long>(received), subscribers.size(),
+        static_cast<unsigned long long>(pool.GetStats().exhausted));
+    passed &= Report(converted == expected && received == expected * subscribers.size(), name, detail);
+    return passed;
+}
+
+int main(int argc, char** argv) {
+    int frames = 300;
+    int warmup = 30;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            frames = std::max(atoi(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            warmup = std::max(atoi(argv[++i]), 1);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--frames N] [--warmup N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!AllocationTrackingEnabled()) {
+        fprintf(stderr, "Built without ENABLE_ALLOCATION_TRACKING; nothing would be counted.\n");
+        return 1;
+    }
+
+    int failures = TrackerSeesAllocations() ? 0 : 1;
+    for (const FormatCase& test : kCases) {
+        failures += RunCase(test, frames, warmup) ? 0 : 1;
+    }
+    if (failures != 0) {
+        fputs(FormatAllocationReport(10).c_str(), stdout);
+    }
+    printf("%d of %d cases failed\n", failures, static_cast<int>(std::size(kCases)) + 1);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+// What tracing costs, portable to Linux. TRACE_SCOPE compiles to nothing
+// unless ENABLE_TRACING is defined, so each measurement runs the same work
+// twice: bare, which is exactly what a build without tracing runs, and with
+// the trace macros around it, which is what a tracing build runs. Rounds of
+// the two alternate, so clock and frequency drift hit both alike.
+//   tight loop   a few arithmetic operations per iteration, with a span or
+//                a counter sample per iteration: the cost of one event
+//   convert      ConvertToRGBA() of whole frames inside the two spans
+//                WebcamController::GetFrameTexture() opens around it: the
+//                slowdown of the real display path
+// Results go out as one JSON document with ns per event and the slowdown in
+// percent, measured and, for the convert path, as predicted from the cost of
+// a span. Built without ENABLE_TRACING both sides are the bare code, which
+// checks that a disabled build pays nothing.
+//
+// Build from the repository root (one command):
+//   g++ -std=c++20 -O2 -DNDEBUG -DENABLE_TRACING -Isrc bench/TraceOverheadMain.cpp src/Trace.cpp
+//       src/PixelConversion.cpp src/PixelKernelsScalar.cpp src/PixelKernelsX86.cpp src/PixelKernelsNeon.cpp
+//       src/CpuFeatures.cpp src/FrameLatency.cpp src/LatencyHistogram.cpp -o trace_overhead
+// Leave out -DENABLE_TRACING for the disabled build.
+//
+// Usage: trace_overhead [--seconds S] [--out FILE]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "FrameLatency.h"
+#include "PixelConversion.h"
+#include "Trace.h"
+
+struct Comparison {
+    uint64_t iterations = 0;   // Per side
+    double bareNs = 0.0;       // Per iteration
+    double tracedNs = 0.0;
+};
+
+// Alternate 'rounds' rounds of 'bare' and 'traced', each calling its
+// operation 'batch' times per clock read, for about 'seconds' in all.
+template <typename Bare, typename Traced>
+static Comparison Compare(double seconds, int batch, Bare&& bare, Traced&& traced) {
+    const int rounds = 20;
+    const int64_t roundNanos = static_cast<int64_t>(seconds * 1e9 / (rounds * 2));
+    int64_t bareTotal = 0;
+    int64_t tracedTotal = 0;
+    uint64_t bareCount = 0;
+    uint64_t tracedCount = 0;
+    for (int round = 0; round < rounds; ++round) {
+        // Start with the other side every other round
+        for (int side = 0; side < 2; ++side) {
+            const bool traceSide = (side + round) % 2 == 1;
+            const int64_t start = MonotonicNanos();
+            int64_t now = start;
+            uint64_t count = 0;
+            while (now - start < roundNanos) {
+                for (int i = 0; i < batch; ++i) {
+                    if (traceSide) {
+                        traced();
+                    }
+                    else {
+                        bare();
+                    }
+                }
+                count += batch;
+                now = MonotonicNanos();
+            }
+            (traceSide ? tracedTotal : bareTotal) += now - start;
+            (traceSide ? tracedCount : bareCount) += count;
+        }
+    }
+    Comparison result;
+    result.iterations = bareCount;
+    result.bareNs = static_cast<double>(bareTotal) / bareCount;
+    result.tracedNs = static_cast<double>(tracedTotal) / tracedCount;
+    return result;
+}
+
+// 'spanNs', when given, is the cost of one span from the tight loop. Frames
+// take long enough that run-to-run noise swamps a few spans, so the slowdown
+// those spans predict is reported next to the measured one.
+static void AppendResult(std::string& json, bool& first, const char* name, const char* detail, const Comparison& result,
+                         int eventsPerIteration, double spanNs = -1.0) {
+    const double overheadNs = result.tracedNs - result.bareNs;
+    char line[640];
+    int length = snprintf(line, sizeof(line),
+        "%s{\"name\": \"%s\", \"detail\": \"%s\", \"iterations\": %llu, \"bare_ns\": %.3f, \"traced_ns\": %.3f, "
+        "\"events_per_iteration\": %d, \"ns_per_event\": %.3f, \"slowdown_percent\": %.3f",
+        first ? "  " : ",\n  ", name, detail, static_cast<unsigned long long>(result.iterations), result.bareNs,
+        result.tracedNs, eventsPerIteration, overheadNs / eventsPerIteration, overheadNs * 100.0 / result.bareNs);
+    if (spanNs >= 0.0) {
+        length += snprintf(line + length, sizeof(line) - length, ", \"predicted_slowdown_percent\": %.4f",
+            spanNs * eventsPerIteration * 100.0 / result.bareNs);
+    }
+    snprintf(line + length, sizeof(line) - length, "}");
+    json += line;
+    first = false;
+}
+
+// Work the optimizer cannot drop
+static volatile uint64_t sink;
+
+int main(int argc, char** argv) {
+    double seconds = 2.0;
+    std::string outPath;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--seconds") == 0 && hasValue) {
+            seconds = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+            outPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--seconds S] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    TRACE_THREAD_NAME("Benchmark");
+
+    char header[160];
+    snprintf(header, sizeof(header), "{\"tracing_enabled\": %s, \"seconds\": %.2f,\n\"results\": [\n",
+        TracingEnabled() ? "true" : "false", seconds);
+    std::string json = header;
+    bool first = true;
+
+    double spanNs = 0.0;
+    {
+        uint64_t value = 1;
+        const Comparison result = Compare(seconds, 1000,
+            [&] { value = value * 6364136223846793005ULL + 1; sink = value; },
+            [&] {
+                TRACE_SCOPE("Tight loop");
+                value = value * 6364136223846793005ULL + 1;
+                sink = value;
+            });
+        AppendResult(json, first, "tight loop span", "TRACE_SCOPE per iteration", result, 1);
+        spanNs = std::max(result.tracedNs - result.bareNs, 0.0);
+    }
+
+    {
+        uint64_t value = 1;
+        const Comparison result = Compare(seconds, 1000,
+            [&] { value = value * 6364136223846793005ULL + 1; sink = value; },
+            [&] {
+                value = value * 6364136223846793005ULL + 1;
+                sink = value;
+                TRACE_COUNTER("Tight loop value", value & 0xFFFF);
+            });
+        AppendResult(json, first, "tight loop counter", "TRACE_COUNTER per iteration", result, 1);
+    }
+
+    struct ConvertCase {
+        PixelFormat format;
+        int width;
+        int height;
+    };
+    static const ConvertCase convertCases[] = {
+        { PixelFormat::YUY2, 640, 480 },
+        { PixelFormat::YUY2, 1280, 720 },
+        { PixelFormat::NV12, 1920, 1080 },
+    };
+    for (const ConvertCase& test : convertCases) {
+        const int stride = DefaultStride(test.format, test.width);
+        std::vector<uint8_t> frame(FrameSize(test.format, test.height, stride));
+        for (size_t i = 0; i < frame.size(); ++i) {
+            frame[i] = static_cast<uint8_t>(i * 7 + (i >> 11) * 13);
+        }
+        std::vector<uint8_t> rgba(static_cast<size_t>(test.width) * test.height * 4);
+        ImagePlanes planes;
+        DescribeFrame(test.format, frame.data(), frame.size(), test.width, test.height, stride, &planes);
+        const YuvColorSpace colorSpace = DefaultYuvColorSpace(test.width, test.height);
+
+        // The spans one displayed frame passes through in WebcamController
+        const Comparison result = Compare(seconds, 1,
+            [&] { ConvertToRGBA(planes, rgba.data(), test.width * 4, colorSpace); },
+            [&] {
+                TRACE_SCOPE("WebcamController::GetFrameTexture");
+                TRACE_SCOPE("Convert to RGBA");
+                ConvertToRGBA(planes, rgba.data(), test.width * 4, colorSpace);
+            });
+        sink = rgba[rgba.size() / 2];
+        char name[96];
+        snprintf(name, sizeof(name), "convert %s %dx%d", PixelFormatName(test.format), test.width, test.height);
+        AppendResult(json, first, name, "ConvertToRGBA with the display path's two spans", result, 2, spanNs);
+    }
+    json += "\n]}\n";
+
+    if (outPath.empty()) {
+        fputs(json.c_str(), stdout);
+        return 0;
+    }
+    std::ofstream out(outPath, std::ios::trunc);
+    if (!(out << json)) {
+        fprintf(stderr, "Could not write %s\n", outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
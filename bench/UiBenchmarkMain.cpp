@@ -0,0 +1,149 @@
+// Headless UI frame benchmark for Linux (and any other OS with a C++20
+// compiler). UIManager itself needs the Windows capture and D3D11 code, so
+// this draws the same layout from the portable pieces: the real PerfPanel and
+// ImGuiModaler, fed synthetic pipeline counters, next to stand-ins for the
+// camera pane and settings. On Windows, "QHair.exe --ui-benchmark" runs the
+// same harness over the real UIManager::Render().
+//
+// Build from the repository root (one command):
+//   IMGUI=src/libaries/imgui
+//   g++ -std=c++20 -O2 -DNDEBUG -Isrc -I$IMGUI $(pkg-config --cflags freetype2)
+//       bench/UiBenchmarkMain.cpp src/UiBenchmark.cpp src/PerfPanel.cpp src/ImGuiModaler.cpp
+//       src/Log.cpp src/FrameLatency.cpp src/LatencyHistogram.cpp src/ThreadCpu.cpp
+//       $IMGUI/imgui.cpp $IMGUI/imgui_draw.cpp $IMGUI/imgui_tables.cpp $IMGUI/imgui_widgets.cpp
+//       $IMGUI/misc/freetype/imgui_freetype.cpp $(pkg-config --libs freetype2) -lpthread -o ui_benchmark
+//
+// Usage: ui_benchmark [--frames N] [--warmup N] [--size WxH] [--no-input]
+// Prints the result as JSON on stdout.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "ImGuiModaler.h"
+#include "PerfPanel.h"
+#include "ThreadCpu.h"
+#include "UiBenchmark.h"
+#include "imgui.h"
+
+// Counters of a pipeline capturing at 30 fps with the odd drop.
+static void SyntheticCounters(int frame, PerfCounters* counters) {
+    counters->display.published = frame / 2;
+    counters->display.consumed = frame / 2 - frame / 600;
+    counters->display.dropped = frame / 600;
+    counters->display.repeated = frame - frame / 2;
+    counters->pool.frames = 32;
+    counters->pool.free = 28 - frame % 3;
+    for (int i = 0; i < static_cast<int>(LatencyStage::Count); ++i) {
+        LatencySummary& summary = counters->latency[i];
+        summary.count = frame;
+        summary.p50 = 1500.0 * (i + 1) + frame % 97;
+        summary.p90 = summary.p50 * 1.4;
+        summary.p99 = summary.p50 * 2.1;
+        summary.max = summary.p50 * 3.0;
+    }
+    counters->threadCount = SampleThreadCpu(counters->threads, kMaxCpuThreads);
+}
+
+class BenchmarkUi {
+public:
+    void Render(int frame) {
+        const ImVec2 display = ImGui::GetIO().DisplaySize;
+
+        ImGui::BeginMainMenuBar();
+        ImGui::MenuItem("Exit");
+        ImGui::MenuItem("Select Camera");
+        ImGui::MenuItem("Settings");
+        ImGui::EndMainMenuBar();
+
+        // A modal now and then, through the real modal stack
+        if (frame % 600 == 300) {
+            auto modal = std::make_unique<ImGuiModaler>("BenchmarkModal", []() {
+                static int current = 0;
+                static const char* cameras[] = { "Integrated Camera", "USB Video Device", "Virtual Camera" };
+                ImGui::Text("Select Camera");
+                ImGui::Combo("Cameras", &current, cameras, 3);
+                ImGui::Button("Select");
+                ImGui::SameLine();
+                ImGui::Button("Close");
+                });
+            modal->SetBackdrop(true, 0.9f);
+            ImGuiModaler::ShowModal(std::move(modal));
+        }
+        if (frame % 600 == 420) {
+            ImGuiModaler::CloseCurrentModal();
+        }
+        ImGuiModaler::RenderActiveModal();
+
+        // Camera feed: a 16:9 frame fitted into the pane
+        ImGui::SetNextWindowPos(ImVec2(0, 20), ImGuiCond_Always);
+        ImGui::SetNextWindowSize(ImVec2(display.x * 0.7f, display.y), ImGuiCond_Always);
+        ImGui::Begin("Camera Feed", nullptr, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+        const ImVec2 avail = ImGui::GetContentRegionAvail();
+        const float scale = avail.x / 1280.0f < avail.y / 720.0f ? avail.x / 1280.0f : avail.y / 720.0f;
+        ImGui::Image(reinterpret_cast<ImTextureID>(static_cast<intptr_t>(2)), ImVec2(1280.0f * scale, 720.0f * scale));
+        ImGui::End();
+
+        ImGui::SetNextWindowPos(ImVec2(display.x * 0.7f, 20), ImGuiCond_Always);
+        ImGui::SetNextWindowSize(ImVec2(display.x * 0.3f, display.y), ImGuiCond_Always);
+        ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+        if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::Text("State: %s", "Open");
+            ImGui::Text("Opened in %.0f ms", 412.0);
+            ImGui::Button("Close camera");
+        }
+        if (ImGui::CollapsingHeader("Orientation", ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::Checkbox("Mirror", &mirror);
+            ImGui::Checkbox("Flip vertically", &flip);
+        }
+
+        const double now = ImGui::GetTime();
+        if (perfPanel.SampleDue(now)) {
+            PerfCounters counters;
+            SyntheticCounters(frame, &counters);
+            perfPanel.AddSample(counters, now);
+        }
+        if (ImGui::CollapsingHeader("Performance", ImGuiTreeNodeFlags_DefaultOpen)) {
+            perfPanel.Draw();
+        }
+        ImGui::End();
+    }
+
+private:
+    PerfPanel perfPanel;
+    bool mirror = false;
+    bool flip = false;
+};
+
+int main(int argc, char** argv) {
+    UiBenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            options.warmupFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+            const char* size = argv[++i];
+            options.width = static_cast<float>(atof(size));
+            if (const char* x = strchr(size, 'x')) {
+                options.height = static_cast<float>(atof(x + 1));
+            }
+        }
+        else if (strcmp(argv[i], "--no-input") == 0) {
+            options.syntheticInput = false;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--frames N] [--warmup N] [--size WxH] [--no-input]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    RegisterThreadCpu("UI");
+    BenchmarkUi ui;
+    const UiBenchmarkResult result = RunUiBenchmark(options, [&ui](int frame) { ui.Render(frame); });
+    printf("%s\n", result.ToJson().c_str());
+    return 0;
+}
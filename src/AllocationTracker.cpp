@@ -0,0 +1,432 @@
+#include "AllocationTracker.h"
+
+#if defined(ENABLE_ALLOCATION_TRACKING)
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <dbghelp.h>
+#include <intrin.h>
+#pragma comment(lib, "dbghelp")
+#define ALLOCATION_CALLER() _ReturnAddress()
+#else
+#include <dlfcn.h>
+#define ALLOCATION_CALLER() __builtin_return_address(0)
+#endif
+
+// Everything below is constant-initialized and never allocates, since
+// operator new can run before main() and from inside any library.
+
+static const int kMaxAllocationScopes = 64;
+static const int kMaxScopeDepth = 8;
+static const uint64_t kAllocationSites = 1024;  // A power of two
+static const uint64_t kSiteProbes = 16;
+
+struct AllocationCounters {
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> frees{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+
+    AllocationCounts Load() const {
+        AllocationCounts counts;
+        counts.allocations = allocations.load(std::memory_order_relaxed);
+        counts.frees = frees.load(std::memory_order_relaxed);
+        counts.bytes = bytes.load(std::memory_order_relaxed);
+        return counts;
+    }
+};
+
+struct ScopeEntry {
+    std::atomic<const char*> name{ nullptr };
+    AllocationCounters counts;
+};
+
+// Keyed by the caller's address with the scope index in the top byte.
+struct SiteEntry {
+    std::atomic<uint64_t> key{ 0 };
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+};
+
+static AllocationCounters allocationTotals;
+static ScopeEntry allocationScopes[kMaxAllocationScopes];
+static SiteEntry allocationSites[kAllocationSites];
+static std::atomic<uint64_t> untrackedSiteAllocations{ 0 };  // Site table was full
+
+struct ThreadAllocations {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+    int depth;
+    int scopes[kMaxScopeDepth];  // Indices into allocationScopes, innermost last
+};
+
+static thread_local ThreadAllocations allocationThread;
+
+// Index of the scope called 'name', adding it if 'add' is set. -1 when
+// unknown, or when the table is full.
+static int FindAllocationScope(const char* name, bool add) {
+    for (int i = 0; i < kMaxAllocationScopes; ++i) {
+        const char* existing = allocationScopes[i].name.load(std::memory_order_acquire);
+        if (!existing) {
+            if (!add) {
+                return -1;
+            }
+            if (allocationScopes[i].name.compare_exchange_strong(existing, name, std::memory_order_acq_rel)) {
+                return i;
+            }
+            // Another thread took the slot; it may have added the same name.
+        }
+        // The same literal can have different addresses in different files.
+        if (existing == name || strcmp(existing, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void RecordAllocationSite(const void* caller, int scope, size_t size) {
+    const uint64_t key = reinterpret_cast<uintptr_t>(caller) ^ (static_cast<uint64_t>(scope + 1) << 56);
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 32;
+    for (uint64_t probe = 0; probe < kSiteProbes; ++probe) {
+        SiteEntry& site = allocationSites[(hash + probe) & (kAllocationSites - 1)];
+        uint64_t existing = site.key.load(std::memory_order_relaxed);
+        if (existing == 0 && site.key.compare_exchange_strong(existing, key, std::memory_order_relaxed)) {
+            existing = key;
+        }
+        if (existing == key) {
+            site.allocations.fetch_add(1, std::memory_order_relaxed);
+            site.bytes.fetch_add(size, std::memory_order_relaxed);
+            return;
+        }
+    }
+    untrackedSiteAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void RecordAllocation(size_t size, const void* caller) {
+    ThreadAllocations& thread = allocationThread;
+    ++thread.allocations;
+    thread.bytes += size;
+    allocationTotals.allocations.fetch_add(1, std::memory_order_relaxed);
+    allocationTotals.bytes.fetch_add(size, std::memory_order_relaxed);
+    for (int i = 0; i < thread.depth; ++i) {
+        AllocationCounters& counts = allocationScopes[thread.scopes[i]].counts;
+        counts.allocations.fetch_add(1, std::memory_order_relaxed);
+        counts.bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    RecordAllocationSite(caller, thread.depth ? thread.scopes[thread.depth - 1] : -1, size);
+}
+
+static void RecordFree(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+    ThreadAllocations& thread = allocationThread;
+    ++thread.frees;
+    allocationTotals.frees.fetch_add(1, std::memory_order_relaxed);
+    for (int i = 0; i < thread.depth; ++i) {
+        allocationScopes[thread.scopes[i]].counts.frees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+AllocationScope::AllocationScope(const char* name)
+    : pushed(false) {
+    ThreadAllocations& thread = allocationThread;
+    if (thread.depth >= kMaxScopeDepth) {
+        return;
+    }
+    const int index = FindAllocationScope(name, true);
+    if (index >= 0) {
+        thread.scopes[thread.depth++] = index;
+        pushed = true;
+    }
+}
+
+AllocationScope::~AllocationScope() {
+    if (pushed) {
+        --allocationThread.depth;
+    }
+}
+
+static void* AllocateUnaligned(size_t size) {
+    return malloc(size ? size : 1);
+}
+
+static void* AllocateAligned(size_t size, std::align_val_t alignment) {
+#if defined(_WIN32)
+    return _aligned_malloc(size ? size : 1, static_cast<size_t>(alignment));
+#else
+    void* pointer = nullptr;
+    const size_t align = static_cast<size_t>(alignment) < sizeof(void*) ? sizeof(void*) : static_cast<size_t>(alignment);
+    return posix_memalign(&pointer, align, size ? size : 1) == 0 ? pointer : nullptr;
+#endif
+}
+
+static void FreeAligned(void* pointer) {
+#if defined(_WIN32)
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+// Throwing operator new: retry through the new handler as the standard asks.
+template <typename Allocate>
+static void* AllocateOrThrow(size_t size, const void* caller, Allocate allocate) {
+    for (;;) {
+        if (void* pointer = allocate()) {
+            RecordAllocation(size, caller);
+            return pointer;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+template <typename Allocate>
+static void* AllocateOrNull(size_t size, const void* caller, Allocate allocate) noexcept {
+    try {
+        return AllocateOrThrow(size, caller, allocate);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size) {
+    return AllocateOrThrow(size, ALLOCATION_CALLER(), [size] { return AllocateUnaligned(size); });
+}
+
+void* operator new[](size_t size) {
+    return AllocateOrThrow(size, ALLOCATION_CALLER(), [size] { return AllocateUnaligned(size); });
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return AllocateOrNull(size, ALLOCATION_CALLER(), [size] { return AllocateUnaligned(size); });
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return AllocateOrNull(size, ALLOCATION_CALLER(), [size] { return AllocateUnaligned(size); });
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return AllocateOrThrow(size, ALLOCATION_CALLER(), [size, alignment] { return AllocateAligned(size, alignment); });
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return AllocateOrThrow(size, ALLOCATION_CALLER(), [size, alignment] { return AllocateAligned(size, alignment); });
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateOrNull(size, ALLOCATION_CALLER(), [size, alignment] { return AllocateAligned(size, alignment); });
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateOrNull(size, ALLOCATION_CALLER(), [size, alignment] { return AllocateAligned(size, alignment); });
+}
+
+void operator delete(void* pointer) noexcept {
+    RecordFree(pointer);
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    RecordFree(pointer);
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    operator delete[](pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    operator delete[](pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    RecordFree(pointer);
+    FreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    RecordFree(pointer);
+    FreeAligned(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept {
+    operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept {
+    operator delete[](pointer, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete[](pointer, alignment);
+}
+
+AllocationCounts GetThreadAllocations() {
+    AllocationCounts counts;
+    counts.allocations = allocationThread.allocations;
+    counts.frees = allocationThread.frees;
+    counts.bytes = allocationThread.bytes;
+    return counts;
+}
+
+AllocationCounts GetScopeAllocations(const char* name) {
+    const int index = FindAllocationScope(name, false);
+    return index >= 0 ? allocationScopes[index].counts.Load() : AllocationCounts();
+}
+
+AllocationCounts GetTotalAllocations() {
+    return allocationTotals.Load();
+}
+
+size_t GetTopAllocationSites(AllocationSite* sites, size_t capacity) {
+    // Insertion into the caller's array keeps this free of allocations.
+    size_t count = 0;
+    for (const SiteEntry& entry : allocationSites) {
+        const uint64_t key = entry.key.load(std::memory_order_relaxed);
+        if (key == 0 || capacity == 0) {
+            continue;
+        }
+        AllocationSite site;
+        const int scope = static_cast<int>(key >> 56) - 1;
+        site.scope = scope >= 0 ? allocationScopes[scope].name.load(std::memory_order_relaxed) : nullptr;
+        site.caller = reinterpret_cast<const void*>(key & ((1ull << 56) - 1));
+        site.allocations = entry.allocations.load(std::memory_order_relaxed);
+        site.bytes = entry.bytes.load(std::memory_order_relaxed);
+
+        size_t position = count < capacity ? count++ : capacity;
+        if (position == capacity && site.allocations <= sites[capacity - 1].allocations) {
+            continue;
+        }
+        position = position == capacity ? capacity - 1 : position;
+        while (position > 0 && sites[position - 1].allocations < site.allocations) {
+            sites[position] = sites[position - 1];
+            --position;
+        }
+        sites[position] = site;
+    }
+    return count;
+}
+
+// "function (file:line)" for the code at 'address', or an empty string.
+static std::string DescribeCaller(const void* address) {
+    std::string description;
+#if defined(_WIN32)
+    static const bool symbolsLoaded = SymInitialize(GetCurrentProcess(), nullptr, TRUE) != FALSE;
+    if (!symbolsLoaded) {
+        return description;
+    }
+    char buffer[sizeof(SYMBOL_INFO) + 256] = {};
+    SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+    symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+    symbol->MaxNameLen = 255;
+    DWORD64 displacement = 0;
+    if (SymFromAddr(GetCurrentProcess(), reinterpret_cast<DWORD64>(address), &displacement, symbol)) {
+        description = symbol->Name;
+    }
+    IMAGEHLP_LINE64 line = {};
+    line.SizeOfStruct = sizeof(line);
+    DWORD lineDisplacement = 0;
+    if (SymGetLineFromAddr64(GetCurrentProcess(), reinterpret_cast<DWORD64>(address), &lineDisplacement, &line)) {
+        description += " (";
+        description += line.FileName;
+        description += ':';
+        description += std::to_string(line.LineNumber);
+        description += ')';
+    }
+#else
+    Dl_info info;
+    if (dladdr(address, &info) && info.dli_sname) {
+        description = info.dli_sname;
+    }
+#endif
+    return description;
+}
+
+static void AppendCounts(std::string& report, const char* label, const AllocationCounts& counts) {
+    char line[192];
+    snprintf(line, sizeof(line), "%-24s %12llu allocations %12llu frees %14llu bytes\n", label,
+        static_cast<unsigned long long>(counts.allocations), static_cast<unsigned long long>(counts.frees),
+        static_cast<unsigned long long>(counts.bytes));
+    report += line;
+}
+
+std::string FormatAllocationReport(size_t top) {
+    // Snapshot the sites first so the report's own allocations don't show.
+    AllocationSite sites[64];
+    const size_t siteCount = GetTopAllocationSites(sites, top < 64 ? top : 64);
+    const AllocationCounts totals = GetTotalAllocations();
+
+    std::string report;
+    AppendCounts(report, "Total", totals);
+    for (const ScopeEntry& scope : allocationScopes) {
+        if (const char* name = scope.name.load(std::memory_order_acquire)) {
+            AppendCounts(report, name, scope.counts.Load());
+        }
+    }
+
+    report += "\nTop allocating call sites:\n";
+    char line[192];
+    for (size_t i = 0; i < siteCount; ++i) {
+        const AllocationSite& site = sites[i];
+        snprintf(line, sizeof(line), "%12llu allocations %14llu bytes  %-16s %p ",
+            static_cast<unsigned long long>(site.allocations), static_cast<unsigned long long>(site.bytes),
+            site.scope ? site.scope : "-", site.caller);
+        report += line;
+        report += DescribeCaller(site.caller);
+        report += '\n';
+    }
+    if (const uint64_t untracked = untrackedSiteAllocations.load(std::memory_order_relaxed)) {
+        snprintf(line, sizeof(line), "%12llu allocations from sites beyond the table\n", static_cast<unsigned long long>(untracked));
+        report += line;
+    }
+    return report;
+}
+
+#else
+
+AllocationCounts GetThreadAllocations() {
+    return AllocationCounts();
+}
+
+AllocationCounts GetScopeAllocations(const char*) {
+    return AllocationCounts();
+}
+
+AllocationCounts GetTotalAllocations() {
+    return AllocationCounts();
+}
+
+size_t GetTopAllocationSites(AllocationSite*, size_t) {
+    return 0;
+}
+
+std::string FormatAllocationReport(size_t) {
+    return "Allocation tracking is disabled; build with ENABLE_ALLOCATION_TRACKING.\n";
+}
+
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Counts heap allocations made through operator new, per thread and per
+// named scope, to check that the per-frame paths don't allocate once warmed
+// up. Define ENABLE_ALLOCATION_TRACKING for the whole build to turn it on;
+// the global operator new and delete are then replaced by counting versions.
+// Otherwise ALLOC_SCOPE expands to nothing and the queries return zeros.
+//
+//   ALLOC_SCOPE("Capture");  // Attribute allocations to "Capture" until the end of scope
+//
+//   const AllocationCounts before = GetScopeAllocations("Capture");
+//   ... run N frames ...
+//   assert((GetScopeAllocations("Capture") - before).allocations == 0);
+//
+// Scope names must be string literals. Scopes nest and counts are
+// inclusive: an allocation counts towards every scope open on the thread.
+// Frees are attributed to the scopes open where the memory is freed.
+// Allocations made with malloc() directly are not seen.
+
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;  // Requested by the allocations
+};
+
+inline AllocationCounts operator-(const AllocationCounts& a, const AllocationCounts& b) {
+    AllocationCounts difference;
+    difference.allocations = a.allocations - b.allocations;
+    difference.frees = a.frees - b.frees;
+    difference.bytes = a.bytes - b.bytes;
+    return difference;
+}
+
+// Where allocations came from: the innermost open scope and the code that
+// called operator new.
+struct AllocationSite {
+    const char* scope = nullptr;   // Null outside any scope
+    const void* caller = nullptr;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+#if defined(ENABLE_ALLOCATION_TRACKING)
+
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+#define ALLOC_SCOPE(name) AllocationScope ALLOC_CONCAT(allocationScope, __LINE__)(name)
+
+class AllocationScope {
+public:
+    explicit AllocationScope(const char* name);
+    ~AllocationScope();
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    bool pushed;
+};
+
+#else
+
+#define ALLOC_SCOPE(name) ((void)0)
+
+#endif
+
+// True when the build counts allocations.
+constexpr bool AllocationTrackingEnabled() {
+#if defined(ENABLE_ALLOCATION_TRACKING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Allocations by the calling thread since it started.
+AllocationCounts GetThreadAllocations();
+
+// Allocations made inside scope 'name' on any thread.
+AllocationCounts GetScopeAllocations(const char* name);
+
+// Allocations made anywhere in the process.
+AllocationCounts GetTotalAllocations();
+
+// The call sites that allocated most often, busiest first. Returns how many
+// entries were written to 'sites', at most 'capacity'.
+size_t GetTopAllocationSites(AllocationSite* sites, size_t capacity);
+
+// Human readable summary: totals, each scope, and the 'top' busiest call
+// sites with symbol names where they can be resolved. Building the report
+// allocates, so call it outside the scopes being checked.
+std::string FormatAllocationReport(size_t top = 20);
@@ -0,0 +1,642 @@
+#include "AviFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "PixelConversion.h"
+
+// AVI is little-endian, as is every machine we build for, so fields are
+// copied in and out with memcpy.
+
+static constexpr uint32_t FourCC(const char (&code)[5]) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(code[0])) |
+        static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 8 |
+        static_cast<uint32_t>(static_cast<uint8_t>(code[2])) << 16 |
+        static_cast<uint32_t>(static_cast<uint8_t>(code[3])) << 24;
+}
+
+static const uint32_t kAvihSize = 56;
+static const uint32_t kStrhSize = 56;
+static const uint32_t kStrfSize = 40;   // BITMAPINFOHEADER
+static const uint32_t kDmlhSize = 248;
+static const uint32_t kIndexHeaderSize = 24;  // After the chunk header, for both index kinds
+
+static const uint32_t kAvifHasIndex = 0x10;
+static const uint32_t kAviifKeyframe = 0x10;
+static const uint8_t kAviIndexOfIndexes = 0x00;
+static const uint8_t kAviIndexOfChunks = 0x01;
+
+// Bytes an ix00 chunk for a full kFramesPerIndexChunk frames takes, kept
+// free at the end of every RIFF.
+static const uint64_t kStandardIndexBytes = 8 + kIndexHeaderSize + 8ull * AviWriter::kFramesPerIndexChunk;
+
+// biCompression and biBitCount for each format; BI_RGB is 0.
+static bool DescribeAviFormat(PixelFormat format, uint32_t* compression, uint16_t* bitCount) {
+    switch (format) {
+    case PixelFormat::BGR24:  *compression = 0; *bitCount = 24; return true;
+    case PixelFormat::BGRA32: *compression = 0; *bitCount = 32; return true;
+    case PixelFormat::YUY2:   *compression = FourCC("YUY2"); *bitCount = 16; return true;
+    case PixelFormat::NV12:   *compression = FourCC("NV12"); *bitCount = 12; return true;
+    case PixelFormat::I420:   *compression = FourCC("I420"); *bitCount = 12; return true;
+    case PixelFormat::I422:   *compression = FourCC("Y42B"); *bitCount = 16; return true;
+    case PixelFormat::I444:   *compression = FourCC("444P"); *bitCount = 24; return true;
+    case PixelFormat::MJPEG:  *compression = FourCC("MJPG"); *bitCount = 24; return true;
+    default: return false;
+    }
+}
+
+static PixelFormat AviPixelFormat(uint32_t compression, uint16_t bitCount) {
+    if (compression == 0) {
+        return bitCount == 24 ? PixelFormat::BGR24 : bitCount == 32 ? PixelFormat::BGRA32 : PixelFormat::Unknown;
+    }
+    if (compression == FourCC("MJPG")) return PixelFormat::MJPEG;
+    if (compression == FourCC("YUY2") || compression == FourCC("YUYV")) return PixelFormat::YUY2;
+    if (compression == FourCC("NV12")) return PixelFormat::NV12;
+    if (compression == FourCC("I420") || compression == FourCC("IYUV")) return PixelFormat::I420;
+    if (compression == FourCC("Y42B")) return PixelFormat::I422;
+    if (compression == FourCC("444P")) return PixelFormat::I444;
+    return PixelFormat::Unknown;
+}
+
+// Fixed-size little-endian record built field by field
+template <size_t Size>
+struct AviRecord {
+    uint8_t bytes[Size] = {};
+    size_t used = 0;
+
+    template <typename T>
+    void Put(T value) {
+        memcpy(bytes + used, &value, sizeof(value));
+        used += sizeof(value);
+    }
+};
+
+bool AviWriter::Open(const std::filesystem::path& path, const VideoFormat& frameFormat, double fps) {
+    Close();
+    uint32_t compression = 0;
+    uint16_t bitCount = 0;
+    if (!DescribeAviFormat(frameFormat.format, &compression, &bitCount) || frameFormat.width <= 0 ||
+        frameFormat.height <= 0 || fps <= 0.0) {
+        return false;
+    }
+    const bool compressed = frameFormat.format == PixelFormat::MJPEG;
+    if (!compressed && frameFormat.stride != DefaultStride(frameFormat.format, frameFormat.width)) {
+        return false;  // AVI has no way to record a padded stride
+    }
+
+    // Frames go out in large writes; the buffer has to be set before open()
+    streamBuffer.resize(kStreamBufferBytes);
+    file.rdbuf()->pubsetbuf(streamBuffer.data(), static_cast<std::streamsize>(streamBuffer.size()));
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    format = frameFormat;
+    failed = false;
+    position = 0;
+    riffCount = 0;
+    totalFrames = 0;
+    firstRiffFrames = 0;
+    maxFrameBytes = 0;
+    superIndexUsed = 0;
+    standardIndex.clear();
+    standardIndex.reserve(kFramesPerIndexChunk);
+    legacyIndex.clear();
+    frameChunkId = FourCC("00dc");
+
+    // RIFF 'AVI ' and the header list. The counts and sizes are patched as
+    // the file grows.
+    BeginRiff();
+    const uint64_t hdrl = BeginList(FourCC("LIST"), FourCC("hdrl"));
+
+    const uint32_t microsecondsPerFrame = static_cast<uint32_t>(std::lround(1e6 / fps));
+    const size_t imageSize = compressed ? 0 : FrameSize(format.format, format.height, format.stride);
+    AviRecord<kAvihSize> avih;
+    avih.Put(microsecondsPerFrame);
+    avih.Put(static_cast<uint32_t>(0));       // dwMaxBytesPerSec
+    avih.Put(static_cast<uint32_t>(0));       // dwPaddingGranularity
+    avih.Put(kAvifHasIndex);
+    avih.Put(static_cast<uint32_t>(0));       // dwTotalFrames, first RIFF only
+    avih.Put(static_cast<uint32_t>(0));       // dwInitialFrames
+    avih.Put(static_cast<uint32_t>(1));       // dwStreams
+    avih.Put(static_cast<uint32_t>(imageSize)); // dwSuggestedBufferSize
+    avih.Put(static_cast<uint32_t>(format.width));
+    avih.Put(static_cast<uint32_t>(format.height));
+    AppendChunkHeader(FourCC("avih"), kAvihSize);
+    avihRateOffset = position;
+    avihTotalFramesOffset = position + 16;
+    avihBufferSizeOffset = position + 28;
+    Append(avih.bytes, sizeof(avih.bytes));
+
+    const uint64_t strl = BeginList(FourCC("LIST"), FourCC("strl"));
+    AviRecord<kStrhSize> strh;
+    strh.Put(FourCC("vids"));
+    strh.Put(compression ? compression : FourCC("DIB "));   // fccHandler
+    strh.Put(static_cast<uint32_t>(0));       // dwFlags
+    strh.Put(static_cast<uint16_t>(0));       // wPriority
+    strh.Put(static_cast<uint16_t>(0));       // wLanguage
+    strh.Put(static_cast<uint32_t>(0));       // dwInitialFrames
+    strh.Put(static_cast<uint32_t>(1000));    // dwScale
+    strh.Put(static_cast<uint32_t>(std::lround(fps * 1000.0)));  // dwRate
+    strh.Put(static_cast<uint32_t>(0));       // dwStart
+    strh.Put(static_cast<uint32_t>(0));       // dwLength
+    strh.Put(static_cast<uint32_t>(imageSize)); // dwSuggestedBufferSize
+    strh.Put(static_cast<uint32_t>(0xFFFFFFFF)); // dwQuality: default
+    strh.Put(static_cast<uint32_t>(0));       // dwSampleSize: varies
+    strh.Put(static_cast<int16_t>(0));        // rcFrame
+    strh.Put(static_cast<int16_t>(0));
+    strh.Put(static_cast<int16_t>(format.width));
+    strh.Put(static_cast<int16_t>(format.height));
+    AppendChunkHeader(FourCC("strh"), kStrhSize);
+    strhRateOffset = position + 24;
+    strhLengthOffset = position + 32;
+    strhBufferSizeOffset = position + 36;
+    Append(strh.bytes, sizeof(strh.bytes));
+
+    // Bottom-up RGB has a positive height, top-down RGB a negative one;
+    // YUV is always top-down with a positive height.
+    const bool rgb = compression == 0;
+    AviRecord<kStrfSize> strf;
+    strf.Put(kStrfSize);
+    strf.Put(static_cast<int32_t>(format.width));
+    strf.Put(static_cast<int32_t>(rgb && format.topDown ? -format.height : format.height));
+    strf.Put(static_cast<uint16_t>(1));       // biPlanes
+    strf.Put(bitCount);
+    strf.Put(compression);
+    strf.Put(static_cast<uint32_t>(compressed ? static_cast<size_t>(format.width) * format.height * 3 : imageSize));
+    AppendChunkHeader(FourCC("strf"), kStrfSize);
+    Append(strf.bytes, sizeof(strf.bytes));
+
+    // Super index with room for every ix00 the file may get; entries are
+    // filled in as each one is written.
+    const uint32_t indxSize = kIndexHeaderSize + 16 * kSuperIndexEntries;
+    AviRecord<kIndexHeaderSize> indx;
+    indx.Put(static_cast<uint16_t>(4));       // wLongsPerEntry
+    indx.Put(static_cast<uint8_t>(0));        // bIndexSubType
+    indx.Put(kAviIndexOfIndexes);
+    indx.Put(static_cast<uint32_t>(0));       // nEntriesInUse
+    indx.Put(frameChunkId);
+    superIndexOffset = position;
+    AppendChunkHeader(FourCC("indx"), indxSize);
+    Append(indx.bytes, sizeof(indx.bytes));
+    const std::vector<uint8_t> emptyEntries(16 * kSuperIndexEntries, 0);
+    Append(emptyEntries.data(), emptyEntries.size());
+    EndList(strl);
+
+    const uint64_t odml = BeginList(FourCC("LIST"), FourCC("odml"));
+    AppendChunkHeader(FourCC("dmlh"), kDmlhSize);
+    dmlhTotalFramesOffset = position;
+    const uint8_t dmlh[kDmlhSize] = {};
+    Append(dmlh, sizeof(dmlh));
+    EndList(odml);
+    EndList(hdrl);
+
+    moviSizeOffset = BeginList(FourCC("LIST"), FourCC("movi"));
+    firstMoviOffset = moviSizeOffset + 4;
+    return !failed;
+}
+
+void AviWriter::Append(const void* data, size_t size) {
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    position += size;
+    failed |= !file;
+}
+
+void AviWriter::Patch(uint64_t offset, uint32_t value) {
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    file.seekp(static_cast<std::streamoff>(position));
+    failed |= !file;
+}
+
+void AviWriter::AppendChunkHeader(uint32_t fourcc, uint32_t size) {
+    const uint32_t header[2] = { fourcc, size };
+    Append(header, sizeof(header));
+}
+
+uint64_t AviWriter::BeginList(uint32_t listType, uint32_t fourcc) {
+    const uint64_t sizeOffset = position + 4;
+    const uint32_t header[3] = { listType, 0, fourcc };
+    Append(header, sizeof(header));
+    return sizeOffset;
+}
+
+void AviWriter::EndList(uint64_t sizeOffset) {
+    Patch(sizeOffset, static_cast<uint32_t>(position - sizeOffset - 4));
+}
+
+void AviWriter::BeginRiff() {
+    ++riffCount;
+    riffSizeOffset = BeginList(FourCC("RIFF"), riffCount == 1 ? FourCC("AVI ") : FourCC("AVIX"));
+    if (riffCount > 1) {
+        moviSizeOffset = BeginList(FourCC("LIST"), FourCC("movi"));
+    }
+}
+
+void AviWriter::EndRiff() {
+    FlushStandardIndex();
+    EndList(moviSizeOffset);
+    if (riffCount == 1) {
+        // idx1 follows the first movi list and covers its frames
+        AppendChunkHeader(FourCC("idx1"), static_cast<uint32_t>(16 * legacyIndex.size()));
+        for (const LegacyIndexEntry& entry : legacyIndex) {
+            const uint32_t record[4] = { frameChunkId, kAviifKeyframe, entry.offset, entry.size };
+            Append(record, sizeof(record));
+        }
+        legacyIndex.clear();
+        legacyIndex.shrink_to_fit();
+    }
+    EndList(riffSizeOffset);
+}
+
+bool AviWriter::WriteFrame(const uint8_t* data, size_t size) {
+    if (!IsOpen() || failed || size > kMaxRiffBytes / 2) {
+        return false;
+    }
+    if (standardIndex.empty() && superIndexUsed >= kSuperIndexEntries) {
+        return false;
+    }
+
+    // Start the next RIFF when this frame, the index chunk after it and, in
+    // the first RIFF, idx1 would not fit.
+    const uint64_t chunkBytes = 8 + size + (size & 1);
+    uint64_t riffBytes = position - (riffSizeOffset - 4) + chunkBytes + kStandardIndexBytes;
+    if (riffCount == 1) {
+        riffBytes += 8 + 16 * (legacyIndex.size() + 1);
+    }
+    const bool riffHasFrames = riffCount == 1 ? totalFrames > 0 : position > moviSizeOffset + 8;
+    if (riffBytes > kMaxRiffBytes && riffHasFrames) {
+        EndRiff();
+        BeginRiff();
+    }
+
+    const uint64_t chunkOffset = position;
+    if (standardIndex.empty()) {
+        indexBase = chunkOffset;
+    }
+    AppendChunkHeader(frameChunkId, static_cast<uint32_t>(size));
+    Append(data, size);
+    if (size & 1) {
+        const uint8_t pad = 0;
+        Append(&pad, 1);
+    }
+
+    // Every frame is a key frame, so bit 31 of the size stays clear.
+    standardIndex.push_back({ static_cast<uint32_t>(chunkOffset + 8 - indexBase), static_cast<uint32_t>(size) });
+    if (riffCount == 1) {
+        legacyIndex.push_back({ static_cast<uint32_t>(chunkOffset - firstMoviOffset), static_cast<uint32_t>(size) });
+        ++firstRiffFrames;
+    }
+    ++totalFrames;
+    maxFrameBytes = std::max(maxFrameBytes, static_cast<uint32_t>(size));
+    if (standardIndex.size() == kFramesPerIndexChunk) {
+        FlushStandardIndex();
+    }
+    return !failed;
+}
+
+void AviWriter::FlushStandardIndex() {
+    if (standardIndex.empty() || superIndexUsed >= kSuperIndexEntries) {
+        return;
+    }
+    const uint64_t chunkOffset = position;
+    const uint32_t entries = static_cast<uint32_t>(standardIndex.size());
+    const uint32_t chunkSize = kIndexHeaderSize + 8 * entries;
+    AviRecord<kIndexHeaderSize> header;
+    header.Put(static_cast<uint16_t>(2));     // wLongsPerEntry
+    header.Put(static_cast<uint8_t>(0));      // bIndexSubType
+    header.Put(kAviIndexOfChunks);
+    header.Put(entries);
+    header.Put(frameChunkId);
+    header.Put(indexBase);                    // qwBaseOffset
+    AppendChunkHeader(FourCC("ix00"), chunkSize);
+    Append(header.bytes, sizeof(header.bytes));
+    Append(standardIndex.data(), sizeof(StandardIndexEntry) * entries);
+    standardIndex.clear();
+
+    // Add it to the super index in the header right away, and bring the
+    // counts and sizes up to date, so a file cut short by a crash is
+    // readable up to this point.
+    const uint64_t entryOffset = superIndexOffset + 8 + kIndexHeaderSize + 16ull * superIndexUsed;
+    Patch(entryOffset, static_cast<uint32_t>(chunkOffset));
+    Patch(entryOffset + 4, static_cast<uint32_t>(chunkOffset >> 32));
+    Patch(entryOffset + 8, chunkSize + 8);
+    Patch(entryOffset + 12, entries);         // dwDuration, in frames
+    ++superIndexUsed;
+    Patch(superIndexOffset + 8 + 4, superIndexUsed);
+    PatchHeaders();
+}
+
+void AviWriter::PatchHeaders() {
+    Patch(avihTotalFramesOffset, static_cast<uint32_t>(firstRiffFrames));
+    Patch(strhLengthOffset, static_cast<uint32_t>(totalFrames));
+    Patch(dmlhTotalFramesOffset, static_cast<uint32_t>(totalFrames));
+    if (format.format == PixelFormat::MJPEG) {
+        Patch(avihBufferSizeOffset, maxFrameBytes);
+        Patch(strhBufferSizeOffset, maxFrameBytes);
+    }
+    Patch(moviSizeOffset, static_cast<uint32_t>(position - moviSizeOffset - 4));
+    Patch(riffSizeOffset, static_cast<uint32_t>(position - riffSizeOffset - 4));
+}
+
+void AviWriter::SetFramesPerSecond(double fps) {
+    if (!IsOpen() || fps <= 0.0) {
+        return;
+    }
+    Patch(avihRateOffset, static_cast<uint32_t>(std::lround(1e6 / fps)));
+    Patch(strhRateOffset, static_cast<uint32_t>(std::lround(fps * 1000.0)));
+}
+
+bool AviWriter::Close() {
+    if (!file.is_open()) {
+        return true;
+    }
+    EndRiff();
+    PatchHeaders();
+    file.close();
+    const bool ok = !failed && !file.fail();
+    failed = false;
+    return ok;
+}
+
+bool AviReader::Open(const std::filesystem::path& path) {
+    Close();
+    std::error_code error;
+    fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    file.open(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    frameChunkId = FourCC("00dc");
+
+    // Every RIFF in turn: the header list, the movi lists and idx1
+    struct Movi {
+        uint64_t offset;  // 'movi' fourcc
+        uint64_t end;
+    };
+    std::vector<Movi> movis;
+    uint64_t legacyOffset = 0;
+    uint32_t legacySize = 0;
+    bool haveHeader = false;
+    uint64_t riff = 0;
+    while (riff + 12 <= fileSize) {
+        uint32_t header[3];
+        file.seekg(static_cast<std::streamoff>(riff));
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != FourCC("RIFF")) {
+            break;
+        }
+        const bool first = riff == 0;
+        if (first ? header[2] != FourCC("AVI ") : header[2] != FourCC("AVIX")) {
+            break;
+        }
+        // A file cut short has sizes reaching past its end
+        const uint64_t riffEnd = std::min<uint64_t>(riff + 8 + header[1], fileSize);
+        uint64_t chunk = riff + 12;
+        while (chunk + 8 <= riffEnd) {
+            uint32_t chunkHeader[3] = {};
+            file.seekg(static_cast<std::streamoff>(chunk));
+            if (!file.read(reinterpret_cast<char*>(chunkHeader), 8)) {
+                break;
+            }
+            const uint64_t dataEnd = std::min<uint64_t>(chunk + 8 + chunkHeader[1], riffEnd);
+            if (chunkHeader[0] == FourCC("LIST") && file.read(reinterpret_cast<char*>(&chunkHeader[2]), 4)) {
+                if (chunkHeader[2] == FourCC("hdrl") && first) {
+                    file.clear();
+                    haveHeader = ReadHeaderList(chunk + 12, dataEnd);
+                }
+                else if (chunkHeader[2] == FourCC("movi")) {
+                    movis.push_back({ chunk + 8, dataEnd });
+                }
+            }
+            else if (chunkHeader[0] == FourCC("idx1") && first) {
+                legacyOffset = chunk + 8;
+                legacySize = static_cast<uint32_t>(dataEnd - legacyOffset);
+            }
+            chunk = chunk + 8 + chunkHeader[1] + (chunkHeader[1] & 1);
+        }
+        file.clear();
+        riff = riff + 8 + header[1] + (header[1] & 1);
+    }
+    if (!haveHeader || movis.empty()) {
+        Close();
+        return false;
+    }
+
+    // The fastest index that is intact
+    if (!superIndex.empty() && ReadSuperIndex()) {
+        source = IndexSource::SuperIndex;
+    }
+    else if (legacySize > 0 && movis.size() == 1 && ReadLegacyIndex(legacyOffset, legacySize, movis[0].offset)) {
+        source = IndexSource::Legacy;
+    }
+    else {
+        frames.clear();
+        for (const Movi& movi : movis) {
+            ScanMovi(movi.offset + 4, movi.end);
+        }
+        source = IndexSource::Scan;
+    }
+    return true;
+}
+
+void AviReader::Close() {
+    if (file.is_open()) {
+        file.close();
+    }
+    file.clear();
+    frames.clear();
+    superIndex.clear();
+    format = VideoFormat();
+    fps = 0.0;
+    source = IndexSource::None;
+}
+
+bool AviReader::ReadHeaderList(uint64_t offset, uint64_t end) {
+    bool haveStream = false;
+    while (offset + 8 <= end) {
+        uint32_t header[3] = {};
+        file.seekg(static_cast<std::streamoff>(offset));
+        if (!file.read(reinterpret_cast<char*>(header), 8)) {
+            return false;
+        }
+        const uint64_t data = offset + 8;
+        const uint32_t size = header[1];
+        if (header[0] == FourCC("LIST") && !haveStream && file.read(reinterpret_cast<char*>(&header[2]), 4) &&
+            header[2] == FourCC("strl")) {
+            // Only the first stream is read; it has to be the video.
+            haveStream = ReadHeaderList(data + 4, std::min<uint64_t>(data + size, end));
+            if (!haveStream) {
+                return false;
+            }
+        }
+        else if (header[0] == FourCC("strh") && size >= kStrhSize) {
+            uint8_t strh[kStrhSize];
+            if (!file.read(reinterpret_cast<char*>(strh), sizeof(strh))) {
+                return false;
+            }
+            uint32_t type, scale, rate;
+            memcpy(&type, strh, 4);
+            memcpy(&scale, strh + 20, 4);
+            memcpy(&rate, strh + 24, 4);
+            if (type != FourCC("vids")) {
+                return false;
+            }
+            fps = scale ? static_cast<double>(rate) / scale : 0.0;
+        }
+        else if (header[0] == FourCC("strf") && size >= kStrfSize) {
+            uint8_t strf[kStrfSize];
+            if (!file.read(reinterpret_cast<char*>(strf), sizeof(strf))) {
+                return false;
+            }
+            int32_t width, height;
+            uint16_t bitCount;
+            uint32_t compression;
+            memcpy(&width, strf + 4, 4);
+            memcpy(&height, strf + 8, 4);
+            memcpy(&bitCount, strf + 14, 2);
+            memcpy(&compression, strf + 16, 4);
+            format.format = AviPixelFormat(compression, bitCount);
+            format.width = width;
+            format.height = height < 0 ? -height : height;
+            format.topDown = compression == 0 && height < 0;
+            format.stride = DefaultStride(format.format, format.width);
+            if (format.format == PixelFormat::Unknown || width <= 0 || height == 0) {
+                return false;
+            }
+        }
+        else if (header[0] == FourCC("indx") && size >= kIndexHeaderSize && data + size <= end) {
+            // Bounded by the list, and so by the file, before sizing the table
+            uint8_t indx[kIndexHeaderSize];
+            if (!file.read(reinterpret_cast<char*>(indx), sizeof(indx))) {
+                return false;
+            }
+            uint16_t longsPerEntry;
+            uint32_t entries;
+            memcpy(&longsPerEntry, indx, 2);
+            memcpy(&entries, indx + 4, 4);
+            if (longsPerEntry == 4 && indx[3] == kAviIndexOfIndexes && entries <= (size - kIndexHeaderSize) / 16) {
+                std::vector<uint8_t> table(16ull * entries);
+                if (file.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(table.size()))) {
+                    for (uint32_t i = 0; i < entries; ++i) {
+                        uint64_t chunk;
+                        uint32_t chunkSize;
+                        memcpy(&chunk, table.data() + 16 * i, 8);
+                        memcpy(&chunkSize, table.data() + 16 * i + 8, 4);
+                        superIndex.emplace_back(chunk, chunkSize);
+                    }
+                }
+            }
+        }
+        file.clear();
+        offset = data + size + (size & 1);
+    }
+    return haveStream || format.format != PixelFormat::Unknown;
+}
+
+bool AviReader::ReadSuperIndex() {
+    frames.clear();
+    for (const auto& [chunk, chunkSize] : superIndex) {
+        uint8_t header[8 + kIndexHeaderSize];
+        file.seekg(static_cast<std::streamoff>(chunk));
+        // The entry count is checked against chunkSize below, so a chunk
+        // inside the file bounds the table allocated for it.
+        if (chunk + chunkSize > fileSize || chunk + sizeof(header) > fileSize || !file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            return false;
+        }
+        uint32_t fourcc, entries;
+        uint16_t longsPerEntry;
+        uint64_t base;
+        memcpy(&fourcc, header, 4);
+        memcpy(&longsPerEntry, header + 8, 2);
+        memcpy(&entries, header + 12, 4);
+        memcpy(&base, header + 20, 8);
+        if ((fourcc & 0xFFFF) != (FourCC("ix00") & 0xFFFF) || longsPerEntry != 2 ||
+            header[11] != kAviIndexOfChunks || 8ull * entries + sizeof(header) > chunkSize) {
+            return false;
+        }
+        std::vector<uint32_t> table(2ull * entries);
+        if (!file.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(4 * table.size()))) {
+            return false;
+        }
+        for (uint32_t i = 0; i < entries; ++i) {
+            const Frame frame = { base + table[2 * i], table[2 * i + 1] & 0x7FFFFFFF };
+            if (frame.offset + frame.size > fileSize) {
+                return false;
+            }
+            frames.push_back(frame);
+        }
+    }
+    return !frames.empty();
+}
+
+bool AviReader::ReadLegacyIndex(uint64_t offset, uint32_t size, uint64_t moviOffset) {
+    frames.clear();
+    std::vector<uint32_t> table(size / 16 * 4);
+    file.seekg(static_cast<std::streamoff>(offset));
+    if (!file.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(4 * table.size()))) {
+        return false;
+    }
+    // Offsets are normally relative to the 'movi' fourcc, but some writers
+    // store file offsets; the first video chunk tells which.
+    uint64_t base = moviOffset;
+    bool baseChecked = false;
+    for (size_t i = 0; i + 3 < table.size(); i += 4) {
+        const uint32_t id = table[i];
+        if ((id & 0xFFFF) != (frameChunkId & 0xFFFF) || ((id >> 16) != ('d' | 'c' << 8) && (id >> 16) != ('d' | 'b' << 8))) {
+            continue;
+        }
+        if (!baseChecked) {
+            uint32_t found = 0;
+            file.seekg(static_cast<std::streamoff>(moviOffset + table[i + 2]));
+            if (!file.read(reinterpret_cast<char*>(&found), 4) || found != id) {
+                base = 0;
+            }
+            file.clear();
+            baseChecked = true;
+        }
+        const Frame frame = { base + table[i + 2] + 8, table[i + 3] };
+        if (frame.offset + frame.size > fileSize) {
+            return false;
+        }
+        frames.push_back(frame);
+    }
+    return !frames.empty();
+}
+
+void AviReader::ScanMovi(uint64_t offset, uint64_t end) {
+    while (offset + 8 <= end) {
+        uint32_t header[3];
+        file.seekg(static_cast<std::streamoff>(offset));
+        if (!file.read(reinterpret_cast<char*>(header), 8)) {
+            break;
+        }
+        if (header[0] == FourCC("LIST")) {
+            // 'rec ' lists group chunks; their contents count as well
+            ScanMovi(offset + 12, std::min<uint64_t>(offset + 8 + header[1], end));
+        }
+        else if ((header[0] == FourCC("00dc") || header[0] == FourCC("00db")) && offset + 8 + header[1] <= end) {
+            frames.push_back({ offset + 8, header[1] });
+        }
+        offset += 8 + header[1] + (header[1] & 1);
+    }
+    file.clear();
+}
+
+bool AviReader::ReadFrame(uint64_t index, std::vector<uint8_t>* data, size_t* size) {
+    if (index >= frames.size()) {
+        return false;
+    }
+    const Frame& frame = frames[index];
+    if (data->size() < frame.size) {
+        data->resize(frame.size);
+    }
+    file.seekg(static_cast<std::streamoff>(frame.offset));
+    if (!file.read(reinterpret_cast<char*>(data->data()), frame.size)) {
+        file.clear();
+        return false;
+    }
+    *size = frame.size;
+    return true;
+}
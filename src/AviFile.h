@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "VideoFrame.h"
+
+// A single video stream in an AVI file with the OpenDML (AVI 2.0)
+// extensions, readable by common players and editors: MJPEG, or raw frames
+// in any of our uncompressed formats in their DirectShow layout.
+//
+// Layout written by AviWriter:
+//   RIFF 'AVI '  hdrl (avih, strl with strh, strf and the 'indx' super
+//                index, odml/dmlh), movi, idx1
+//   RIFF 'AVIX'  movi                 ... as many as needed, ~1 GB each
+// Each movi list holds '00dc' frame chunks and an 'ix00' standard index
+// every kFramesPerIndexChunk frames. The super index in the header points
+// at every ix00; idx1 covers the first RIFF for players without OpenDML.
+
+class AviWriter {
+public:
+    // Frames indexed by each 'ix00' chunk; the super index holds
+    // kSuperIndexEntries of them, about 38 hours at 30 fps.
+    static constexpr uint32_t kFramesPerIndexChunk = 1024;
+    static constexpr uint32_t kSuperIndexEntries = 4096;
+
+    // Size at which a RIFF is closed and the next 'AVIX' one begins.
+    static constexpr uint64_t kMaxRiffBytes = 1ull << 30;
+
+    AviWriter() = default;
+    ~AviWriter() { Close(); }
+
+    AviWriter(const AviWriter&) = delete;
+    AviWriter& operator=(const AviWriter&) = delete;
+
+    // Start a file for frames of 'format' at 'fps'. Raw frames must use the
+    // format's DefaultStride(). Returns false if the file cannot be created
+    // or the format cannot be stored.
+    bool Open(const std::filesystem::path& path, const VideoFormat& format, double fps);
+
+    // Append one frame. Constant work per frame: the chunk is written at the
+    // end of the file and the index entry kept in memory until the next
+    // index chunk. Returns false on a write error or once the super index
+    // is full.
+    bool WriteFrame(const uint8_t* data, size_t size);
+
+    // Replace the frame rate given to Open(), e.g. with one measured from
+    // the frames' timestamps. Call before Close().
+    void SetFramesPerSecond(double fps);
+
+    // Write the remaining indexes and final sizes. Returns false if any
+    // write since Open() failed.
+    bool Close();
+
+    bool IsOpen() const { return file.is_open(); }
+    uint64_t FrameCount() const { return totalFrames; }
+    uint64_t BytesWritten() const { return position; }
+
+private:
+    struct StandardIndexEntry {
+        uint32_t offset;  // Frame data, relative to indexBase
+        uint32_t size;
+    };
+
+    struct LegacyIndexEntry {
+        uint32_t offset;  // Chunk header, relative to the first movi's 'movi'
+        uint32_t size;
+    };
+
+    void Append(const void* data, size_t size);
+    void Patch(uint64_t offset, uint32_t value);
+    void AppendChunkHeader(uint32_t fourcc, uint32_t size);
+    uint64_t BeginList(uint32_t listType, uint32_t fourcc);
+    void EndList(uint64_t sizeOffset);
+    void BeginRiff();
+    void EndRiff();
+    void FlushStandardIndex();
+    void PatchHeaders();
+
+    static constexpr size_t kStreamBufferBytes = 1u << 20;
+
+    std::ofstream file;
+    std::vector<char> streamBuffer;
+    bool failed = false;
+    uint64_t position = 0;  // End of the file, where the next write goes
+
+    VideoFormat format;
+    uint32_t frameChunkId = 0;     // '00dc'
+    uint32_t maxFrameBytes = 0;
+
+    // Where the fields that are only known later live
+    uint64_t avihRateOffset = 0;
+    uint64_t avihTotalFramesOffset = 0;
+    uint64_t avihBufferSizeOffset = 0;
+    uint64_t strhRateOffset = 0;
+    uint64_t strhLengthOffset = 0;
+    uint64_t strhBufferSizeOffset = 0;
+    uint64_t dmlhTotalFramesOffset = 0;
+    uint64_t superIndexOffset = 0;   // The 'indx' chunk header
+
+    // The RIFF and movi being written
+    int riffCount = 0;
+    uint64_t riffSizeOffset = 0;
+    uint64_t moviSizeOffset = 0;
+    uint64_t firstMoviOffset = 0;   // 'movi' fourcc of the first RIFF, the base of idx1
+    uint64_t firstRiffFrames = 0;
+
+    uint64_t totalFrames = 0;
+    uint64_t indexBase = 0;
+    std::vector<StandardIndexEntry> standardIndex;  // Since the last ix00
+    std::vector<LegacyIndexEntry> legacyIndex;      // First RIFF only
+    uint32_t superIndexUsed = 0;
+};
+
+// Reads AVI files with one video stream, as AviWriter writes them and as
+// most capture tools do: through the OpenDML super index when there is one,
+// else idx1, else by walking the movi lists.
+class AviReader {
+public:
+    enum class IndexSource {
+        None,
+        SuperIndex,
+        Legacy,  // idx1
+        Scan,
+    };
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    const VideoFormat& Format() const { return format; }
+    double FramesPerSecond() const { return fps; }
+    uint64_t FrameCount() const { return frames.size(); }
+    IndexSource Source() const { return source; }
+
+    // Read frame 'index' into 'data', reusing its storage.
+    bool ReadFrame(uint64_t index, std::vector<uint8_t>* data, size_t* size);
+
+private:
+    struct Frame {
+        uint64_t offset;  // Frame data
+        uint32_t size;
+    };
+
+    bool ReadHeaderList(uint64_t offset, uint64_t end);
+    bool ReadSuperIndex();
+    bool ReadLegacyIndex(uint64_t offset, uint32_t size, uint64_t moviOffset);
+    void ScanMovi(uint64_t offset, uint64_t end);
+
+    std::ifstream file;
+    uint64_t fileSize = 0;
+    VideoFormat format;
+    double fps = 0.0;
+    uint32_t frameChunkId = 0;
+    IndexSource source = IndexSource::None;
+    std::vector<Frame> frames;
+    std::vector<std::pair<uint64_t, uint32_t>> superIndex;  // ix00 chunks: offset and size
+};
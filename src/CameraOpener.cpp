@@ -0,0 +1,247 @@
+#include "CameraOpener.h"
+#include "Trace.h"
+#include "ThreadCpu.h"
+
+const char* CameraStateName(CameraState state) {
+    switch (state) {
+    case CameraState::Closed:  return "Closed";
+    case CameraState::Opening: return "Opening";
+    case CameraState::Open:    return "Open";
+    case CameraState::Closing: return "Closing";
+    case CameraState::Failed:  return "Failed";
+    }
+    return "Unknown";
+}
+
+bool CameraOpenContext::Cancelled() const {
+    return opener && (opener->latestRequest.load(std::memory_order_acquire) != request || opener->DeadlinePassed());
+}
+
+void CameraOpenContext::Step(const char* name) {
+    if (!opener) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(opener->mutex);
+    if (!Cancelled()) {
+        opener->status.step = name;
+        ++opener->status.stepIndex;
+    }
+}
+
+CameraOpener::CameraOpener(CameraDevice* device, int stepCount, std::chrono::milliseconds openTimeout)
+    : device(device), stepCount(stepCount), openTimeout(openTimeout) {
+    worker = std::thread(&CameraOpener::Run, this);
+}
+
+CameraOpener::~CameraOpener() {
+    Shutdown();
+}
+
+void CameraOpener::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        latestRequest.fetch_add(1, std::memory_order_acq_rel);
+    }
+    wakeup.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void CameraOpener::Open(const std::wstring& path) {
+    Post(Request::Open, path);
+}
+
+void CameraOpener::Close() {
+    Post(Request::Close, std::wstring());
+}
+
+void CameraOpener::Cancel() {
+    bool opening;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        opening = pending == Request::Open || status.state == CameraState::Opening;
+    }
+    if (opening) {
+        Post(Request::Close, std::wstring());
+    }
+}
+
+CameraStatus CameraOpener::Status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    CameraStatus snapshot = status;
+    // The worker may be stuck in the driver past the deadline; report the
+    // open as failed now rather than when the call returns.
+    if (snapshot.state == CameraState::Opening && DeadlinePassed()) {
+        snapshot.state = CameraState::Failed;
+        snapshot.result = kCameraOpenTimedOut;
+        snapshot.step = "";
+    }
+    return snapshot;
+}
+
+CameraOpenerStats CameraOpener::GetStats() const {
+    CameraOpenerStats stats;
+    stats.opened = opened.load(std::memory_order_relaxed);
+    stats.failed = failed.load(std::memory_order_relaxed);
+    stats.timedOut = timedOut.load(std::memory_order_relaxed);
+    stats.reconnects = reconnects.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void CameraOpener::NotifyFirstFrame() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (waitingForFirstFrame) {
+        waitingForFirstFrame = false;
+        status.firstFrameMs = MillisecondsSince(requestTime);
+    }
+}
+
+void CameraOpener::Post(Request request, const std::wstring& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        pending = request;
+        pendingPath = path;
+        pendingTime = Clock::now();
+        latestRequest.fetch_add(1, std::memory_order_acq_rel);
+    }
+    wakeup.notify_one();
+}
+
+void CameraOpener::SetState(CameraState state, long result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    status.state = state;
+    status.result = result;
+    status.step = "";
+    if (state != CameraState::Open) {
+        waitingForFirstFrame = false;
+    }
+    if (state == CameraState::Closed) {
+        status.path.clear();
+    }
+}
+
+double CameraOpener::MillisecondsSince(Clock::time_point start) const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool CameraOpener::DeadlinePassed() const {
+    const Clock::rep deadline = openDeadline.load(std::memory_order_acquire);
+    return deadline != 0 && Clock::now().time_since_epoch().count() >= deadline;
+}
+
+void CameraOpener::Run() {
+    TRACE_THREAD_NAME("Camera opener");
+    RegisterThreadCpu("Camera opener");
+    device->AttachWorkerThread();
+
+    bool deviceOpen = false;
+    for (;;) {
+        Request request;
+        std::wstring path;
+        uint64_t requestId;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this] { return stopping || pending != Request::None; });
+            if (stopping) {
+                break;
+            }
+            request = pending;
+            path = std::move(pendingPath);
+            requestId = latestRequest.load(std::memory_order_acquire);
+            pending = Request::None;
+
+            if (request == Request::Open) {
+                status = CameraStatus();
+                status.state = deviceOpen ? CameraState::Closing : CameraState::Opening;
+                status.path = path;
+                status.stepCount = stepCount;
+                requestTime = pendingTime;
+            }
+        }
+
+        // Switching cameras closes the old one first; the texture and decoder
+        // follow the new device's frames on their own.
+        if (deviceOpen) {
+            if (request == Request::Close) {
+                SetState(CameraState::Closing);
+            }
+            TRACE_SCOPE("CloseDevice");
+            device->CloseDevice();
+            deviceOpen = false;
+        }
+        if (request == Request::Close) {
+            SetState(CameraState::Closed);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            status.state = CameraState::Opening;
+            waitingForFirstFrame = true;
+            if (openTimeout.count() > 0) {
+                openDeadline.store((Clock::now() + openTimeout).time_since_epoch().count(), std::memory_order_release);
+            }
+        }
+        CameraOpenContext context(this, requestId);
+        long hr;
+        {
+            TRACE_SCOPE("OpenDevice");
+            hr = device->OpenDevice(path, context);
+        }
+        // An open that finished after Status() began reporting the timeout
+        // stays failed, so the UI never sees it change its mind. The state
+        // changes in the same step as the deadline goes away.
+        bool superseded;
+        bool expired;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            superseded = latestRequest.load(std::memory_order_acquire) != requestId;
+            expired = !superseded && DeadlinePassed();
+            openDeadline.store(0, std::memory_order_release);
+            if (expired) {
+                status.state = CameraState::Failed;
+                status.result = kCameraOpenTimedOut;
+                status.step = "";
+                waitingForFirstFrame = false;
+            }
+        }
+        if (superseded) {
+            device->CloseDevice();
+            SetState(CameraState::Closed);
+            continue;
+        }
+        if (expired) {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            timedOut.fetch_add(1, std::memory_order_relaxed);
+            device->CloseDevice();
+            continue;
+        }
+        if (hr < 0) {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            device->CloseDevice();
+            SetState(CameraState::Failed, hr);
+            continue;
+        }
+
+        deviceOpen = true;
+        opened.fetch_add(1, std::memory_order_relaxed);
+        if (path == lastOpenedPath) {
+            reconnects.fetch_add(1, std::memory_order_relaxed);
+        }
+        lastOpenedPath = path;
+        std::lock_guard<std::mutex> lock(mutex);
+        status.state = CameraState::Open;
+        status.step = "";
+        status.openMs = MillisecondsSince(requestTime);
+    }
+
+    if (deviceOpen) {
+        device->CloseDevice();
+    }
+    device->DetachWorkerThread();
+}
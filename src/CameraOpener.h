@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Where the camera is in its open/close life cycle.
+enum class CameraState {
+    Closed,
+    Opening,
+    Open,
+    Closing,
+    Failed,
+};
+
+const char* CameraStateName(CameraState state);
+
+// CameraStatus::result of an open that ran past its timeout.
+constexpr long kCameraOpenTimedOut = static_cast<int32_t>(0x800705B4u);  // HRESULT_FROM_WIN32(ERROR_TIMEOUT)
+
+// Snapshot of the opener for the UI.
+struct CameraStatus {
+    CameraState state = CameraState::Closed;
+    std::wstring path;          // Device being opened, or open
+    const char* step = "";      // Open step in progress
+    int stepIndex = 0;          // Steps started so far
+    int stepCount = 0;
+    long result = 0;            // HRESULT of the last failed open
+    double openMs = 0.0;        // Request until the device was running
+    double firstFrameMs = 0.0;  // Request until the first frame arrived; 0 until then
+};
+
+// Counters over the opener's lifetime. Lock-free to read.
+struct CameraOpenerStats {
+    uint64_t opened = 0;      // Opens that got the device running
+    uint64_t failed = 0;      // Opens the device refused or that timed out
+    uint64_t timedOut = 0;    // Opens abandoned at the timeout
+    uint64_t reconnects = 0;  // Opens of the device that was open last, e.g. after it dropped out
+};
+
+class CameraOpener;
+
+// Handed to CameraDevice::OpenDevice() to report progress and to learn that
+// the open has been superseded by a newer request. A default-constructed
+// context, for opening outside a CameraOpener, is never cancelled.
+class CameraOpenContext {
+public:
+    CameraOpenContext() : opener(nullptr), request(0) {}
+    CameraOpenContext(CameraOpener* opener, uint64_t request) : opener(opener), request(request) {}
+
+    bool Cancelled() const;
+    void Step(const char* name);
+
+private:
+    CameraOpener* opener;
+    uint64_t request;
+};
+
+// What CameraOpener drives. All calls arrive on the opener's worker thread.
+class CameraDevice {
+public:
+    virtual ~CameraDevice() = default;
+
+    // Per-thread setup and teardown for the worker, e.g. COM.
+    virtual void AttachWorkerThread() {}
+    virtual void DetachWorkerThread() {}
+
+    // Open the device and start streaming. Call context.Step() before each
+    // stage and return early once context.Cancelled(). Returns an HRESULT;
+    // a cancelled open may return anything.
+    virtual long OpenDevice(const std::wstring& path, CameraOpenContext& context) = 0;
+
+    // Stop streaming and release everything OpenDevice() acquired, including
+    // after a failed or cancelled open.
+    virtual void CloseDevice() = 0;
+};
+
+// Opens and closes a camera on a dedicated worker thread so graph building and
+// driver warm-up never block the render loop. The UI posts requests and polls
+// Status(). Only the newest request matters: opening another camera while an
+// open is in flight cancels it at its next step, and the worker goes straight
+// to the new device.
+//
+// An open still running 'openTimeout' after it started is abandoned: the
+// context reports it cancelled, and Status() shows it Failed with
+// kCameraOpenTimedOut from the deadline on, even while a driver call is still
+// stuck. The worker takes the next request once that call returns.
+class CameraOpener {
+public:
+    CameraOpener(CameraDevice* device, int stepCount,
+                 std::chrono::milliseconds openTimeout = std::chrono::milliseconds(0));
+    ~CameraOpener();
+
+    // Close the device and stop the worker. Later requests are ignored. Lets
+    // the owner shut down while the opener itself is still intact, since the
+    // device may call NotifyFirstFrame() until it is closed.
+    void Shutdown();
+
+    CameraOpener(const CameraOpener&) = delete;
+    CameraOpener& operator=(const CameraOpener&) = delete;
+
+    // Close whatever is open and open 'path'.
+    void Open(const std::wstring& path);
+
+    // Close the camera, cancelling an open in progress.
+    void Close();
+
+    // Abandon an open that has not finished yet. An open camera stays open.
+    void Cancel();
+
+    CameraStatus Status() const;
+    CameraOpenerStats GetStats() const;
+
+    // Called by the device for the first frame of each open. Thread-safe.
+    void NotifyFirstFrame();
+
+private:
+    friend class CameraOpenContext;
+
+    enum class Request {
+        None,
+        Open,
+        Close,
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    void Post(Request request, const std::wstring& path);
+    void Run();
+    void SetState(CameraState state, long result = 0);
+    double MillisecondsSince(Clock::time_point start) const;
+    bool DeadlinePassed() const;
+
+    CameraDevice* device;
+    const int stepCount;
+    const std::chrono::milliseconds openTimeout;  // 0: none
+
+    // Clock ticks at which the open in progress times out; 0 when none is
+    // in progress or there is no timeout.
+    std::atomic<Clock::rep> openDeadline{ 0 };
+
+    // Bumped by every request; an open in progress is cancelled as soon as
+    // this no longer matches the request it serves.
+    std::atomic<uint64_t> latestRequest{ 0 };
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    Request pending = Request::None;
+    std::wstring pendingPath;
+    Clock::time_point pendingTime;
+    bool stopping = false;
+
+    CameraStatus status;
+    Clock::time_point requestTime;  // When the current open was requested
+    bool waitingForFirstFrame = false;
+
+    std::atomic<uint64_t> opened{ 0 };
+    std::atomic<uint64_t> failed{ 0 };
+    std::atomic<uint64_t> timedOut{ 0 };
+    std::atomic<uint64_t> reconnects{ 0 };
+    std::wstring lastOpenedPath;  // Worker thread only
+
+    std::thread worker;
+};
@@ -0,0 +1,163 @@
+#include "CaptureCapabilities.h"
+
+const char* CaptureGoalName(CaptureGoal goal) {
+    switch (goal) {
+    case CaptureGoal::MaxResolution:   return "Max resolution";
+    case CaptureGoal::LowestLatency:   return "Lowest latency";
+    case CaptureGoal::LowestBandwidth: return "Lowest bandwidth";
+    }
+    return "Unknown";
+}
+
+CapturePolicy DefaultCapturePolicy() {
+    CapturePolicy policy;
+    policy.goal = CaptureGoal::MaxResolution;
+    policy.minFps = 30.0;
+    return policy;
+}
+
+CaptureCostModel::CaptureCostModel() {
+    for (double& cost : nsPerPixel) {
+        cost = 0.0;
+    }
+    nsPerPixel[static_cast<int>(PixelFormat::BGR24)] = 0.35;
+    nsPerPixel[static_cast<int>(PixelFormat::BGRA32)] = 0.25;
+    nsPerPixel[static_cast<int>(PixelFormat::YUY2)] = 0.6;
+    nsPerPixel[static_cast<int>(PixelFormat::NV12)] = 0.7;
+    nsPerPixel[static_cast<int>(PixelFormat::I420)] = 0.7;
+    nsPerPixel[static_cast<int>(PixelFormat::I422)] = 0.7;
+    nsPerPixel[static_cast<int>(PixelFormat::I444)] = 0.8;
+    nsPerPixel[static_cast<int>(PixelFormat::MJPEG)] = 6.0;
+}
+
+CaptureModeCost EstimateCaptureModeCost(const CaptureMode& mode, double fps, double busBytesPerSecond,
+                                        const CaptureCostModel& costs) {
+    CaptureModeCost cost;
+    const double pixels = static_cast<double>(mode.width) * mode.height;
+    const double nsPerPixel = costs.nsPerPixel[static_cast<int>(mode.format)];
+    const bool compressed = (mode.format == PixelFormat::MJPEG);
+
+    cost.fps = fps;
+    cost.bytesPerFrame = compressed
+        ? pixels * costs.mjpegBytesPerPixel
+        : static_cast<double>(FrameSize(mode.format, mode.height, DefaultStride(mode.format, mode.width)));
+    cost.bytesPerSecond = cost.bytesPerFrame * fps;
+    cost.cpuCores = pixels * nsPerPixel * fps * 1e-9;
+
+    // Only the MJPEG decoder spreads one frame over several threads.
+    const double threads = (compressed && costs.decodeThreads > 1.0) ? costs.decodeThreads : 1.0;
+    const double processingMs = pixels * nsPerPixel * 1e-6 / threads;
+    const double transferMs = busBytesPerSecond > 0.0 ? cost.bytesPerFrame / busBytesPerSecond * 1000.0 : 0.0;
+    cost.latencyMs = (fps > 0.0 ? 1000.0 / fps : 0.0) + transferMs + processingMs;
+    return cost;
+}
+
+void CaptureCapabilities::Add(const CaptureMode& mode) {
+    entries.push_back(mode);
+    for (CaptureMode& existing : modes) {
+        if (existing.format == mode.format && existing.width == mode.width && existing.height == mode.height) {
+            if (mode.maxFps > existing.maxFps) {
+                existing.maxFps = mode.maxFps;
+                existing.index = mode.index;
+            }
+            if (mode.minFps < existing.minFps) {
+                existing.minFps = mode.minFps;
+            }
+            return;
+        }
+    }
+    modes.push_back(mode);
+}
+
+// Whether 'candidate' serves the goal better than 'best'. Ties fall through
+// to the next criterion, so the result does not depend on enumeration order.
+static bool IsBetterMode(CaptureGoal goal, const CaptureMode& candidate, const CaptureModeCost& candidateCost,
+                         const CaptureMode& best, const CaptureModeCost& bestCost) {
+    const double candidatePixels = static_cast<double>(candidate.width) * candidate.height;
+    const double bestPixels = static_cast<double>(best.width) * best.height;
+
+    switch (goal) {
+    case CaptureGoal::MaxResolution:
+        if (candidatePixels != bestPixels) return candidatePixels > bestPixels;
+        if (candidateCost.fps != bestCost.fps) return candidateCost.fps > bestCost.fps;
+        return candidateCost.cpuCores < bestCost.cpuCores;
+    case CaptureGoal::LowestLatency:
+        if (candidateCost.latencyMs != bestCost.latencyMs) return candidateCost.latencyMs < bestCost.latencyMs;
+        return candidatePixels > bestPixels;
+    case CaptureGoal::LowestBandwidth:
+        if (candidateCost.bytesPerSecond != bestCost.bytesPerSecond) return candidateCost.bytesPerSecond < bestCost.bytesPerSecond;
+        if (candidatePixels != bestPixels) return candidatePixels > bestPixels;
+        return candidateCost.cpuCores < bestCost.cpuCores;
+    }
+    return false;
+}
+
+int CaptureCapabilities::Select(const CapturePolicy& policy, double* fps, const CaptureCostModel& costs) const {
+    int bestIndex = -1;
+    CaptureModeCost bestCost;
+
+    for (size_t i = 0; i < modes.size(); ++i) {
+        const CaptureMode& mode = modes[i];
+        if (mode.format == PixelFormat::Unknown || mode.width <= 0 || mode.height <= 0 || mode.maxFps <= 0.0) {
+            continue;
+        }
+        if (mode.maxFps < policy.minFps
+            || (policy.maxWidth > 0 && mode.width > policy.maxWidth)
+            || (policy.maxHeight > 0 && mode.height > policy.maxHeight)) {
+            continue;
+        }
+
+        // Run as fast as the mode allows, except when saving bandwidth, where
+        // the slowest rate that still meets the policy is enough.
+        double modeFps = mode.maxFps;
+        if (policy.goal == CaptureGoal::LowestBandwidth) {
+            modeFps = policy.minFps > mode.minFps ? policy.minFps : mode.minFps;
+            modeFps = modeFps > 0.0 ? SupportedFps(mode, modeFps) : mode.maxFps;
+        }
+
+        const CaptureModeCost cost = EstimateCaptureModeCost(mode, modeFps, policy.busBytesPerSecond, costs);
+        if ((policy.cpuBudget > 0.0 && cost.cpuCores > policy.cpuBudget)
+            || (policy.busBytesPerSecond > 0.0 && cost.bytesPerSecond > policy.busBytesPerSecond)) {
+            continue;
+        }
+
+        if (bestIndex < 0 || IsBetterMode(policy.goal, mode, cost, modes[bestIndex], bestCost)) {
+            bestIndex = static_cast<int>(i);
+            bestCost = cost;
+        }
+    }
+
+    if (fps && bestIndex >= 0) {
+        *fps = bestCost.fps;
+    }
+    return bestIndex;
+}
+
+double CaptureCapabilities::SupportedFps(const CaptureMode& mode, double fps) const {
+    // Merged ranges can have gaps, e.g. separate 15 and 30 fps entries
+    double supported = mode.maxFps;
+    for (const CaptureMode& entry : entries) {
+        if (entry.format != mode.format || entry.width != mode.width || entry.height != mode.height || entry.maxFps < fps) {
+            continue;
+        }
+        const double entryFps = fps > entry.minFps ? fps : entry.minFps;
+        if (entryFps < supported) {
+            supported = entryFps;
+        }
+    }
+    return supported;
+}
+
+CaptureMode CaptureCapabilities::ModeFor(int position, double fps) const {
+    CaptureMode mode = modes[position];
+    for (const CaptureMode& entry : entries) {
+        if (entry.format == mode.format && entry.width == mode.width && entry.height == mode.height
+            && fps >= entry.minFps - 1e-6 && fps <= entry.maxFps + 1e-6) {
+            mode.index = entry.index;
+            mode.minFps = entry.minFps;
+            mode.maxFps = entry.maxFps;
+            break;
+        }
+    }
+    return mode;
+}
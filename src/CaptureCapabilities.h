@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include "PixelConversion.h"
+
+// One output mode a capture device offers: a format, a frame size and the
+// frame rates it can run at. Built from IAMStreamConfig on Windows, but kept
+// free of DirectShow so the selection logic runs anywhere.
+struct CaptureMode {
+    int index = -1;          // Capability index on the device
+    PixelFormat format = PixelFormat::Unknown;
+    int width = 0;
+    int height = 0;
+    double minFps = 0.0;
+    double maxFps = 0.0;
+};
+
+// What the application wants from the camera.
+enum class CaptureGoal {
+    MaxResolution,   // Largest frame, then highest frame rate
+    LowestLatency,   // Shortest capture-to-display time
+    LowestBandwidth, // Least bus traffic, e.g. for several cameras on one hub
+};
+
+const char* CaptureGoalName(CaptureGoal goal);
+
+// A goal plus the constraints a mode has to meet. Zero means "no limit".
+struct CapturePolicy {
+    CaptureGoal goal = CaptureGoal::MaxResolution;
+    double minFps = 0.0;             // e.g. 60 for "lowest latency at >= 60 fps"
+    int maxWidth = 0;
+    int maxHeight = 0;
+    double cpuBudget = 0.0;          // Cores available for decode and conversion
+    double busBytesPerSecond = 0.0;  // Usable bus bandwidth
+};
+
+// Largest frame that still runs at 30 fps or more.
+CapturePolicy DefaultCapturePolicy();
+
+// Per-format costs the selector scores modes with. The defaults are rough
+// single-core figures for a current desktop CPU; benchmarks can measure the
+// real ones and pass them in.
+struct CaptureCostModel {
+    static constexpr int kFormatCount = static_cast<int>(PixelFormat::MJPEG) + 1;
+
+    double nsPerPixel[kFormatCount];  // Decode and conversion, indexed by PixelFormat
+    double mjpegBytesPerPixel = 0.25; // Typical compressed size at camera quality
+    double decodeThreads = 1.0;       // Parallelism available to the decode path
+
+    CaptureCostModel();
+};
+
+// Estimated cost of running a mode at a given frame rate.
+struct CaptureModeCost {
+    double fps = 0.0;
+    double bytesPerFrame = 0.0;
+    double bytesPerSecond = 0.0;
+    double cpuCores = 0.0;     // Decode plus conversion, in cores
+    double latencyMs = 0.0;    // Frame interval + bus transfer + processing
+};
+
+CaptureModeCost EstimateCaptureModeCost(const CaptureMode& mode, double fps, double busBytesPerSecond,
+                                        const CaptureCostModel& costs);
+
+// The capability index of one device: every mode, with duplicates removed.
+class CaptureCapabilities {
+public:
+    void Clear() { modes.clear(); entries.clear(); }
+
+    // Add a mode; a mode with the same format and size widens the frame
+    // rate range of the existing entry instead.
+    void Add(const CaptureMode& mode);
+
+    const std::vector<CaptureMode>& Modes() const { return modes; }
+    bool Empty() const { return modes.empty(); }
+
+    // Pick the mode that best serves the policy. Returns its position in
+    // Modes(), or -1 if no mode meets the constraints. 'fps' receives the
+    // frame rate to request.
+    int Select(const CapturePolicy& policy, double* fps = nullptr,
+               const CaptureCostModel& costs = CaptureCostModel()) const;
+
+    // The mode at 'position' in Modes() with the capability index of the
+    // device entry whose rate range covers 'fps'. A merged mode spans several
+    // entries, and only the covering one accepts that rate in SetFormat.
+    CaptureMode ModeFor(int position, double fps) const;
+
+private:
+    // The slowest rate of at least 'fps' that some entry of 'mode' runs at.
+    double SupportedFps(const CaptureMode& mode, double fps) const;
+
+    std::vector<CaptureMode> modes;
+    std::vector<CaptureMode> entries;  // As added, before merging
+};
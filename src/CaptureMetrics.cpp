@@ -0,0 +1,65 @@
+#include "CaptureMetrics.h"
+#include <cstdio>
+#include "MetricsServer.h"
+#include "ThreadCpu.h"
+
+void WriteCaptureMetrics(MetricsWriter& writer, const CaptureMetrics& metrics) {
+    writer.Gauge("camviex_camera_open", "1 while a camera is open and streaming.",
+        metrics.state == CameraState::Open ? 1.0 : 0.0);
+    writer.Counter("camviex_camera_opens_total", "Camera opens that got the device streaming.", metrics.camera.opened);
+    writer.Counter("camviex_camera_open_failures_total", "Camera opens the device refused or that timed out.", metrics.camera.failed);
+    writer.Counter("camviex_camera_open_timeouts_total", "Camera opens abandoned at the open timeout.", metrics.camera.timedOut);
+    writer.Counter("camviex_camera_reconnects_total", "Opens of the camera that was open last.", metrics.camera.reconnects);
+
+    writer.Counter("camviex_frames_captured_total", "Frames delivered by the camera and published.", metrics.display.published);
+    writer.Family("camviex_frames_dropped_total", "counter", "Frames that never reached the screen, by reason.");
+    writer.Sample("camviex_frames_dropped_total", "reason=\"display_behind\"", metrics.display.dropped);
+    writer.Sample("camviex_frames_dropped_total", "reason=\"pool_exhausted\"", metrics.pool.exhausted);
+    writer.Counter("camviex_frames_repeated_total", "Display frames that reused the previous camera frame.", metrics.display.repeated);
+
+    writer.Gauge("camviex_frame_pool_frames", "Frame buffers the pool owns.", static_cast<double>(metrics.pool.frames));
+    writer.Gauge("camviex_frame_pool_in_use", "Frame buffers held by the display or subscribers.",
+        static_cast<double>(metrics.pool.frames - metrics.pool.free));
+    writer.Counter("camviex_frame_pool_heap_allocations_total", "Frame headers and pixel buffers allocated.", metrics.pool.heapAllocations);
+
+    writer.Counter("camviex_recording_bytes_written_total", "Bytes written to disk by recordings.", metrics.recordingBytes);
+    writer.Gauge("camviex_history_seconds", "Seconds of capture held in memory for clips.", metrics.history.seconds);
+    writer.Gauge("camviex_history_bytes", "Memory taken by the frames held for clips.", static_cast<double>(metrics.history.storedBytes));
+    writer.Gauge("camviex_history_bytes_per_second", "Memory per second of clip history.", metrics.history.bytesPerSecond);
+
+    if (metrics.latency) {
+        const FrameLatencyCollector& latency = *metrics.latency;
+        writer.Counter("camviex_frames_displayed_total", "Frames presented on screen.",
+            latency.Latency(LatencyStage::EndToEnd).Count());
+
+        char labels[64];
+        const int stages = static_cast<int>(LatencyStage::Count);
+        writer.Family("camviex_frame_latency_seconds", "histogram", "Latency of each pipeline stage per frame.");
+        for (int i = 0; i < stages; ++i) {
+            snprintf(labels, sizeof(labels), "stage=\"%s\"", LatencyStageName(static_cast<LatencyStage>(i)));
+            writer.Histogram("camviex_frame_latency_seconds", labels, latency.Latency(static_cast<LatencyStage>(i)));
+        }
+        // Percentiles straight from the fine-grained histograms, which are
+        // far more precise than what a query can estimate from the buckets.
+        writer.Family("camviex_frame_latency_quantile_seconds", "gauge", "Latency percentiles of each pipeline stage since start.");
+        for (int i = 0; i < stages; ++i) {
+            snprintf(labels, sizeof(labels), "stage=\"%s\"", LatencyStageName(static_cast<LatencyStage>(i)));
+            writer.Quantiles("camviex_frame_latency_quantile_seconds", labels, latency.Latency(static_cast<LatencyStage>(i)).Summarize());
+        }
+        writer.Family("camviex_frame_jitter_seconds", "histogram", "Change in frame spacing from one frame to the next.");
+        for (int i = 0; i < static_cast<int>(JitterPoint::Count); ++i) {
+            snprintf(labels, sizeof(labels), "point=\"%s\"", JitterPointName(static_cast<JitterPoint>(i)));
+            writer.Histogram("camviex_frame_jitter_seconds", labels, latency.Jitter(static_cast<JitterPoint>(i)));
+        }
+    }
+
+    ThreadCpuUsage threads[kMaxCpuThreads];
+    const size_t threadCount = SampleThreadCpu(threads, kMaxCpuThreads);
+    writer.Family("camviex_thread_cpu_seconds_total", "counter", "User plus kernel CPU time per pipeline thread.");
+    for (size_t i = 0; i < threadCount; ++i) {
+        // Thread names are string literals of ours, with nothing to escape
+        char labels[96];
+        snprintf(labels, sizeof(labels), "thread=\"%s\",slot=\"%d\"", threads[i].name ? threads[i].name : "", threads[i].slot);
+        writer.Sample("camviex_thread_cpu_seconds_total", labels, threads[i].cpuSeconds);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include "CameraOpener.h"
+#include "FrameLatency.h"
+#include "FrameMailbox.h"
+#include "FrameHistory.h"
+#include "FramePool.h"
+
+class MetricsWriter;
+
+// Everything the capture pipeline exports for monitoring, read without
+// blocking the capture thread: the counters are lock-free snapshots and the
+// latency histograms are read in place.
+struct CaptureMetrics {
+    CameraState state = CameraState::Closed;
+    CameraOpenerStats camera;
+    FrameMailboxStats display;  // published: captured, consumed: picked up for display
+    FramePoolStats pool;
+    const FrameLatencyCollector* latency = nullptr;
+    uint64_t recordingBytes = 0;  // Written to disk by recordings so far
+    FrameHistoryStats history;    // All zero while no history is kept
+};
+
+// Writes 'metrics', plus CPU time of the registered threads, as Prometheus
+// metrics named camviex_*.
+void WriteCaptureMetrics(MetricsWriter& writer, const CaptureMetrics& metrics);
@@ -0,0 +1,36 @@
+#include "CaptureSource.h"
+#include "SyntheticCaptureSource.h"
+#include "ReplayCaptureSource.h"
+#if defined(_WIN32)
+#include "DirectShowCaptureSource.h"
+#endif
+
+static bool HasPrefix(const std::wstring& path, const wchar_t* prefix, std::wstring* rest) {
+    const std::wstring start(prefix);
+    if (path.compare(0, start.size(), start) != 0) {
+        return false;
+    }
+    *rest = path.substr(start.size());
+    return true;
+}
+
+std::unique_ptr<CaptureSource> CreateCaptureSource(const std::wstring& path) {
+    std::wstring rest;
+    if (HasPrefix(path, L"synthetic:", &rest)) {
+        SyntheticSourceConfig config;
+        if (!ParseSyntheticSourceConfig(rest, &config)) {
+            return nullptr;
+        }
+        return std::make_unique<SyntheticCaptureSource>(config);
+    }
+    if (HasPrefix(path, L"replay:", &rest)) {
+        ReplaySourceConfig config;
+        config.path = rest;
+        return std::make_unique<ReplayCaptureSource>(config);
+    }
+#if defined(_WIN32)
+    return std::make_unique<DirectShowCaptureSource>(path);
+#else
+    return nullptr;
+#endif
+}
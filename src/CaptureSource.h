@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "VideoFrame.h"
+#include "CaptureCapabilities.h"
+#include "CameraOpener.h"
+
+// HRESULT failure codes for the portable sources, which cannot include
+// <windows.h>. Same values as their Windows names.
+constexpr long kCaptureErrorFail = static_cast<int32_t>(0x80004005u);           // E_FAIL
+constexpr long kCaptureErrorInvalidArg = static_cast<int32_t>(0x80070057u);     // E_INVALIDARG
+constexpr long kCaptureErrorNotFound = static_cast<int32_t>(0x80070002u);       // ERROR_FILE_NOT_FOUND
+constexpr long kCaptureErrorBadFormat = static_cast<int32_t>(0x8004022Eu);      // VFW_E_INVALIDMEDIATYPE
+constexpr long kCaptureErrorAbort = static_cast<int32_t>(0x80004004u);          // E_ABORT
+
+// Receives the frames of a CaptureSource.
+class CaptureSink {
+public:
+    virtual ~CaptureSink() = default;
+
+    // Called on the source's streaming thread for every frame. 'data' is only
+    // valid during the call. Uncompressed frames hold at least FrameSize()
+    // bytes for 'format'; compressed ones are exactly 'size' bytes.
+    virtual void OnFrame(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) = 0;
+};
+
+// A producer of video frames: a camera, a test pattern or a recording.
+// Open(), Start() and Stop() are called from one control thread; frames are
+// delivered on a thread the source owns. Destroying the source closes it.
+class CaptureSource {
+public:
+    virtual ~CaptureSource() = default;
+
+    // Prepare the source, choosing a mode with 'policy' where there is a
+    // choice. Reports progress through 'context' and returns early once it is
+    // cancelled. Returns an HRESULT.
+    virtual long Open(const CapturePolicy& policy, CameraOpenContext& context) = 0;
+
+    // Deliver frames to 'sink' until Stop().
+    virtual long Start(CaptureSink* sink) = 0;
+
+    // Stop delivering. Once this returns no OnFrame() call is in progress.
+    virtual void Stop() = 0;
+
+    // Modes the source offers and the one Open() chose, or -1.
+    virtual const CaptureCapabilities& Capabilities() const = 0;
+    virtual int SelectedMode() const = 0;
+
+    // Layout negotiated by Open(). The stream may still change it later; each
+    // frame carries its own.
+    virtual VideoFormat Format() const = 0;
+};
+
+// Create the source for a device path:
+//   synthetic:<spec>  test pattern, see ParseSyntheticSourceConfig()
+//   replay:<file>     raw frame file, see RawFrameFile.h
+//   anything else     a DirectShow moniker display name (Windows only)
+// Returns null for a path no backend understands.
+std::unique_ptr<CaptureSource> CreateCaptureSource(const std::wstring& path);
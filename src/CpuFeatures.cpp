@@ -0,0 +1,70 @@
+#include "CpuFeatures.h"
+
+#if defined(CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(CPU_X86)
+static void QueryCpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<unsigned int>(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// The OS has to save the YMM registers on context switch before AVX can be used.
+static bool OsSupportsAvxState() {
+#if defined(_MSC_VER)
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+    return (xcr0 & 0x6) == 0x6;
+}
+#endif
+
+static CpuFeatures DetectCpuFeatures() {
+    CpuFeatures features;
+
+#if defined(CPU_X86)
+    unsigned int regs[4] = {};
+    QueryCpuid(0, 0, regs);
+    const unsigned int maxLeaf = regs[0];
+
+    if (maxLeaf >= 1) {
+        QueryCpuid(1, 0, regs);
+        features.sse2 = (regs[3] & (1u << 26)) != 0;
+        features.ssse3 = (regs[2] & (1u << 9)) != 0;
+        features.sse41 = (regs[2] & (1u << 19)) != 0;
+
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        const bool avx = (regs[2] & (1u << 28)) != 0;
+        if (maxLeaf >= 7 && osxsave && avx && OsSupportsAvxState()) {
+            QueryCpuid(7, 0, regs);
+            features.avx2 = (regs[1] & (1u << 5)) != 0;
+        }
+    }
+#endif
+
+#if defined(CPU_NEON)
+    features.neon = true;  // Mandatory on AArch64
+#endif
+
+    return features;
+}
+
+const CpuFeatures& GetCpuFeatures() {
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Architecture detection for the SIMD code paths.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define CPU_NEON 1
+#endif
+
+// MSVC exposes every intrinsic regardless of /arch, GCC and Clang need the
+// target enabled per function so the rest of the binary stays baseline.
+#if defined(CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#endif
+
+// Instruction set extensions usable on the running CPU.
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool avx2 = false;
+    bool neon = false;
+};
+
+// Detected once on first use; safe to call from any thread.
+const CpuFeatures& GetCpuFeatures();
@@ -0,0 +1,75 @@
+#include "DeviceRegistry.h"
+
+DeviceRegistry::DeviceRegistry(std::unique_ptr<DeviceEnumerator> enumerator)
+    : enumerator(std::move(enumerator)) {
+}
+
+static bool SameDevices(const std::vector<DeviceInfo>& a, const std::vector<DeviceInfo>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].path != b[i].path || a[i].name != b[i].name) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeviceRegistry::Rescan() {
+    // Clear the flag first so a notification arriving during the scan is not lost.
+    stale.store(false, std::memory_order_release);
+    ++scanCount;
+
+    std::vector<DeviceInfo> scanned;
+    if (!enumerator || !enumerator->Enumerate(&scanned)) {
+        return false;
+    }
+    if (SameDevices(scanned, devices)) {
+        return true;
+    }
+
+    devices = std::move(scanned);
+    labels.clear();
+    labels.reserve(devices.size());
+    for (size_t i = 0; i < devices.size(); ++i) {
+        int earlier = 0;
+        for (size_t j = 0; j < i; ++j) {
+            earlier += devices[j].name == devices[i].name ? 1 : 0;
+        }
+        labels.push_back(earlier == 0 ? devices[i].utf8Name : devices[i].utf8Name + " (" + std::to_string(earlier + 1) + ")");
+    }
+    names.clear();
+    names.reserve(labels.size());
+    for (const std::string& label : labels) {
+        names.push_back(label.c_str());
+    }
+    ++generation;
+    return true;
+}
+
+void DeviceRegistry::RefreshIfStale() {
+    if (stale.load(std::memory_order_acquire)) {
+        Rescan();
+    }
+}
+
+const std::vector<DeviceInfo>& DeviceRegistry::Devices() {
+    RefreshIfStale();
+    return devices;
+}
+
+const std::vector<const char*>& DeviceRegistry::Names() {
+    RefreshIfStale();
+    return names;
+}
+
+int DeviceRegistry::Find(const std::wstring& path) {
+    RefreshIfStale();
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (devices[i].path == path) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A capture device as the system reports it.
+struct DeviceInfo {
+    std::wstring name;     // Friendly name
+    std::wstring path;     // Stable identifier to open the device with (moniker display name)
+    std::wstring id;       // Short hardware ID, e.g. the USB serial number
+    std::string utf8Name;  // 'name' in UTF-8, for the UI
+};
+
+// Source of the device list. The DirectShow implementation walks the video
+// input category; tests can substitute a fake.
+class DeviceEnumerator {
+public:
+    virtual ~DeviceEnumerator() = default;
+
+    // Replace 'devices' with the current device list. Returns false if the
+    // system could not be queried, in which case the cache is kept.
+    virtual bool Enumerate(std::vector<DeviceInfo>* devices) = 0;
+};
+
+// Enumerates devices once and serves the cached list until something changes.
+// Invalidate() is cheap and thread-safe, so it can be called straight from a
+// WM_DEVICECHANGE handler; the next query rescans. Queries are for the UI
+// thread.
+class DeviceRegistry {
+public:
+    explicit DeviceRegistry(std::unique_ptr<DeviceEnumerator> enumerator);
+
+    // The device list, rescanned first if it was invalidated.
+    const std::vector<DeviceInfo>& Devices();
+
+    // UTF-8 names in device order, ready for ImGui::Combo. Devices sharing
+    // a friendly name, such as two cameras of the same model, are numbered
+    // "Name (2)" and so on, so the user can tell them apart. Stays valid
+    // until the next rescan.
+    const std::vector<const char*>& Names();
+
+    // Mark the cache stale; the next query rescans.
+    void Invalidate() { stale.store(true, std::memory_order_release); }
+
+    // Rescan now. Returns false if enumeration failed.
+    bool Rescan();
+
+    // Incremented by every rescan that changed the list, so callers can tell
+    // when indices they hold may refer to different devices.
+    uint64_t Generation() const { return generation; }
+
+    // Number of enumerations performed so far.
+    uint64_t ScanCount() const { return scanCount; }
+
+    // Position of the device with the given path, or -1.
+    int Find(const std::wstring& path);
+
+private:
+    void RefreshIfStale();
+
+    std::unique_ptr<DeviceEnumerator> enumerator;
+    std::atomic<bool> stale{ true };
+    std::vector<DeviceInfo> devices;
+    std::vector<std::string> labels;  // What 'names' points into
+    std::vector<const char*> names;
+    uint64_t generation = 0;
+    uint64_t scanCount = 0;
+};
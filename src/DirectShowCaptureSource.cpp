@@ -0,0 +1,367 @@
+#include "DirectShowCaptureSource.h"
+#include <dvdmedia.h>
+
+// Read the frame layout from a VIDEOINFOHEADER or VIDEOINFOHEADER2 media type.
+// biWidth is the allocated row length in pixels; rcTarget, when set, is the
+// part of it that holds the picture.
+static bool VideoFormatFromMediaType(const AM_MEDIA_TYPE& mt, VideoFormat* layout) {
+    const BITMAPINFOHEADER* bmi = nullptr;
+    const RECT* target = nullptr;
+    if (mt.formattype == FORMAT_VideoInfo && mt.cbFormat >= sizeof(VIDEOINFOHEADER) && mt.pbFormat) {
+        const VIDEOINFOHEADER* vih = reinterpret_cast<const VIDEOINFOHEADER*>(mt.pbFormat);
+        bmi = &vih->bmiHeader;
+        target = &vih->rcTarget;
+    }
+    else if (mt.formattype == FORMAT_VideoInfo2 && mt.cbFormat >= sizeof(VIDEOINFOHEADER2) && mt.pbFormat) {
+        const VIDEOINFOHEADER2* vih = reinterpret_cast<const VIDEOINFOHEADER2*>(mt.pbFormat);
+        bmi = &vih->bmiHeader;
+        target = &vih->rcTarget;
+    }
+    else {
+        return false;
+    }
+
+    const PixelFormat format = PixelFormatFromSubtype(mt.subtype);
+    if (format == PixelFormat::Unknown || bmi->biWidth <= 0 || bmi->biHeight == 0) {
+        return false;
+    }
+
+    const bool isRgb = (format == PixelFormat::BGR24 || format == PixelFormat::BGRA32);
+    layout->format = format;
+    layout->width = bmi->biWidth;
+    layout->height = bmi->biHeight < 0 ? -bmi->biHeight : bmi->biHeight;
+    layout->topDown = isRgb && bmi->biHeight < 0;
+    layout->stride = isRgb ? ((bmi->biWidth * bmi->biBitCount + 31) / 32) * 4 : DefaultStride(format, bmi->biWidth);
+
+    const int targetWidth = target->right - target->left;
+    const int targetHeight = target->bottom - target->top;
+    if (target->left == 0 && target->top == 0 && targetWidth > 0 && targetWidth <= layout->width
+        && targetHeight > 0 && targetHeight <= layout->height) {
+        layout->width = targetWidth;
+        layout->height = targetHeight;
+    }
+    return true;
+}
+
+static void FreeMediaTypeContents(AM_MEDIA_TYPE& mt) {
+    if (mt.cbFormat) {
+        CoTaskMemFree(mt.pbFormat);
+        mt.cbFormat = 0;
+        mt.pbFormat = nullptr;
+    }
+    if (mt.pUnk) {
+        mt.pUnk->Release();
+        mt.pUnk = nullptr;
+    }
+}
+
+DirectShowCaptureSource::DirectShowCaptureSource(const std::wstring& devicePath)
+    : devicePath(devicePath), is_initialized(false), callback(this) {
+}
+
+DirectShowCaptureSource::~DirectShowCaptureSource() {
+    Cleanup();
+}
+
+long DirectShowCaptureSource::Open(const CapturePolicy& policy, CameraOpenContext& context) {
+    Cleanup();
+
+    HRESULT hr;
+
+    // Create Filter Graph Manager
+    context.Step("Creating graph");
+    hr = pGraph.CoCreateInstance(CLSID_FilterGraph);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Create Capture Graph Builder
+    hr = pCaptureGraph.CoCreateInstance(CLSID_CaptureGraphBuilder2);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = pCaptureGraph->SetFiltergraph(pGraph);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Bind the device by its moniker display name, which stays valid when
+    // other cameras are plugged in or removed, unlike an enumeration index.
+    if (context.Cancelled()) {
+        return E_ABORT;
+    }
+    context.Step("Opening device");
+    CComPtr<IBindCtx> pBindCtx;
+    hr = CreateBindCtx(0, &pBindCtx);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    CComPtr<IMoniker> pMoniker;
+    ULONG eaten = 0;
+    hr = MkParseDisplayName(pBindCtx, devicePath.c_str(), &eaten, &pMoniker);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = pMoniker->BindToObject(pBindCtx, nullptr, IID_IBaseFilter, (void**)&pSourceFilter);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    if (!pSourceFilter) {
+        return E_FAIL;
+    }
+
+    hr = pGraph->AddFilter(pSourceFilter, L"Video Capture");
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Add Sample Grabber Filter
+    hr = AddFilterByCLSID(pGraph, CLSID_SampleGrabber, &pGrabberFilter, L"Sample Grabber");
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = pGrabberFilter->QueryInterface(IID_ISampleGrabber, (void**)&pGrabber);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    if (context.Cancelled()) {
+        return E_ABORT;
+    }
+    context.Step("Selecting mode");
+    GUID grabberSubtype = MEDIASUBTYPE_RGB24;
+    hr = SelectCaptureMode(policy, &grabberSubtype);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = ConfigureSampleGrabber(grabberSubtype);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Add Null Renderer Filter
+    hr = AddFilterByCLSID(pGraph, CLSID_NullRenderer, &pNullRenderer, L"Null Renderer");
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    if (context.Cancelled()) {
+        return E_ABORT;
+    }
+    context.Step("Connecting filters");
+
+    // Connect Filters: Source Filter -> Sample Grabber -> Null Renderer
+    hr = pCaptureGraph->RenderStream(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, pSourceFilter, pGrabberFilter, pNullRenderer);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = ReadConnectedFormat();
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Get Media Control Interface
+    hr = pGraph->QueryInterface(IID_IMediaControl, (void**)&pControl);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    is_initialized.store(true);
+    return S_OK;
+}
+
+long DirectShowCaptureSource::Start(CaptureSink* frameSink) {
+    if (!is_initialized.load()) {
+        return E_FAIL;
+    }
+
+    if (!pControl || !frameSink) {
+        return E_POINTER;
+    }
+
+    sink = frameSink;
+    HRESULT hr = pControl->Run();
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    return S_OK;
+}
+
+void DirectShowCaptureSource::Stop() {
+    // Stop() returns once the streaming thread has left the grabber callback.
+    if (pControl) {
+        pControl->Stop();
+    }
+}
+
+HRESULT DirectShowCaptureSource::AddFilterByCLSID(IGraphBuilder* pGraph, const GUID& clsid, IBaseFilter** ppF, const wchar_t* name) {
+    CComPtr<IBaseFilter> pFilter;
+    HRESULT hr = pFilter.CoCreateInstance(clsid);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = pGraph->AddFilter(pFilter, name);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    *ppF = pFilter.Detach();
+    return S_OK;
+}
+
+HRESULT DirectShowCaptureSource::SelectCaptureMode(const CapturePolicy& policy, GUID* subtype) {
+    // Index the capture pin's modes and switch it to the one the policy
+    // prefers. The grabber then accepts that subtype as is, so DirectShow does
+    // not insert its own decoder or color converter. Without a usable mode we
+    // keep the pin's current format, or fall back to RGB24.
+    *subtype = MEDIASUBTYPE_RGB24;
+    capabilities.Clear();
+    selectedMode = -1;
+
+    CComPtr<IAMStreamConfig> pConfig;
+    HRESULT hr = pCaptureGraph->FindInterface(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, pSourceFilter, IID_IAMStreamConfig, (void**)&pConfig);
+    if (FAILED(hr)) {
+        return S_OK;  // Not all sources expose IAMStreamConfig
+    }
+
+    double fps = 0.0;
+    if (SUCCEEDED(BuildCaptureCapabilities(pConfig, &capabilities))) {
+        selectedMode = capabilities.Select(policy, &fps);
+        if (selectedMode < 0) {
+            // Nothing meets the constraints; take the largest mode instead.
+            selectedMode = capabilities.Select(CapturePolicy(), &fps);
+        }
+    }
+
+    AM_MEDIA_TYPE* pmt = nullptr;
+    if (selectedMode >= 0) {
+        hr = GetCaptureModeMediaType(pConfig, capabilities.ModeFor(selectedMode, fps), fps, &pmt);
+        if (SUCCEEDED(hr) && FAILED(pConfig->SetFormat(pmt))) {
+            selectedMode = -1;
+        }
+    }
+    else {
+        hr = pConfig->GetFormat(&pmt);
+    }
+
+    if (SUCCEEDED(hr) && pmt) {
+        if (PixelFormatFromSubtype(pmt->subtype) != PixelFormat::Unknown) {
+            *subtype = pmt->subtype;
+        }
+        FreeMediaType(pmt);
+    }
+    return S_OK;
+}
+
+HRESULT DirectShowCaptureSource::ConfigureSampleGrabber(const GUID& subtype) {
+    AM_MEDIA_TYPE mt;
+    ZeroMemory(&mt, sizeof(AM_MEDIA_TYPE));
+    mt.majortype = MEDIATYPE_Video;
+    mt.subtype = subtype;
+    mt.formattype = FORMAT_VideoInfo;
+
+    HRESULT hr = pGrabber->SetMediaType(&mt);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = pGrabber->SetOneShot(FALSE);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Samples are handed to the sink in the callback; the grabber's own copy
+    // would never be read.
+    hr = pGrabber->SetBufferSamples(FALSE);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // SampleCB rather than BufferCB: the IMediaSample carries format changes.
+    hr = pGrabber->SetCallback(&callback, 0);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    return S_OK;
+}
+
+HRESULT DirectShowCaptureSource::ReadConnectedFormat() {
+    AM_MEDIA_TYPE mt;
+    ZeroMemory(&mt, sizeof(AM_MEDIA_TYPE));
+    HRESULT hr = pGrabber->GetConnectedMediaType(&mt);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    const bool known = VideoFormatFromMediaType(mt, &streamFormat);
+    FreeMediaTypeContents(mt);
+    return known ? S_OK : VFW_E_INVALIDMEDIATYPE;
+}
+
+HRESULT DirectShowCaptureSource::OnSample(double time, IMediaSample* sample) {
+    // A source that switches resolution mid-stream attaches the new media type
+    // to the first sample in that format. The sink gets the new layout with
+    // that very sample, so the graph never has to stop.
+    AM_MEDIA_TYPE* pmt = nullptr;
+    if (sample->GetMediaType(&pmt) == S_OK && pmt) {
+        VideoFormat changed;
+        if (VideoFormatFromMediaType(*pmt, &changed)) {
+            streamFormat = changed;
+        }
+        FreeMediaType(pmt);
+    }
+
+    BYTE* buffer = nullptr;
+    if (FAILED(sample->GetPointer(&buffer))) {
+        return E_FAIL;
+    }
+    const long length = sample->GetActualDataLength();
+    if (length <= 0) {
+        return E_FAIL;
+    }
+
+    sink->OnFrame(streamFormat, buffer, static_cast<size_t>(length), time);
+    return S_OK;
+}
+
+void DirectShowCaptureSource::Cleanup() {
+    // Also runs after a failed or cancelled open, so any subset of the graph
+    // may exist.
+    if (pControl) {
+        pControl->Stop();
+    }
+
+    if (pGraph) {
+        if (pNullRenderer) {
+            pGraph->RemoveFilter(pNullRenderer);
+        }
+        if (pGrabberFilter) {
+            pGraph->RemoveFilter(pGrabberFilter);
+        }
+        if (pSourceFilter) {
+            pGraph->RemoveFilter(pSourceFilter);
+        }
+    }
+
+    pGrabber.Release();
+    pGrabberFilter.Release();
+    pSourceFilter.Release();
+    pNullRenderer.Release();
+    pControl.Release();
+    pGraph.Release();
+    pCaptureGraph.Release();
+    pCamCtrl.Release();
+    pProcAmp.Release();
+
+    is_initialized.store(false);
+}
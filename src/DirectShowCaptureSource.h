@@ -0,0 +1,99 @@
+#pragma once
+
+#include <windows.h>
+#include <dshow.h>
+#include <atlbase.h>
+#include <atomic>
+#include <string>
+#include "graph.h"
+#include "CaptureSource.h"
+
+#pragma comment(lib, "strmiids.lib")
+
+// A DirectShow video capture device: source filter -> Sample Grabber -> Null
+// Renderer, with the grabber accepting the mode the policy picked so no
+// decoder or color converter is inserted. Frames are handed to the sink from
+// the grabber callback on the graph's streaming thread. COM must be
+// initialized on the thread that opens and closes the source.
+class DirectShowCaptureSource : public CaptureSource {
+public:
+    // 'devicePath' is the moniker display name (DeviceInfo::path).
+    explicit DirectShowCaptureSource(const std::wstring& devicePath);
+    ~DirectShowCaptureSource() override;
+
+    long Open(const CapturePolicy& policy, CameraOpenContext& context) override;
+    long Start(CaptureSink* sink) override;
+    void Stop() override;
+
+    const CaptureCapabilities& Capabilities() const override { return capabilities; }
+    int SelectedMode() const override { return selectedMode; }
+    VideoFormat Format() const override { return streamFormat; }
+
+private:
+    // COM interfaces
+    CComPtr<IGraphBuilder> pGraph;
+    CComPtr<ICaptureGraphBuilder2> pCaptureGraph;
+    CComPtr<IMediaControl> pControl;
+    CComPtr<IBaseFilter> pSourceFilter;
+    CComPtr<IBaseFilter> pGrabberFilter;
+    CComPtr<ISampleGrabber> pGrabber;
+    CComPtr<IBaseFilter> pNullRenderer;
+    CComPtr<IAMCameraControl> pCamCtrl;
+    CComPtr<IAMVideoProcAmp> pProcAmp;
+
+    std::wstring devicePath;
+    std::atomic<bool> is_initialized;
+    CaptureSink* sink = nullptr;
+
+    // Layout of the samples the grabber delivers. Set from the connected media
+    // type before the graph runs; afterwards only the streaming thread updates
+    // it, when a sample announces a format change.
+    VideoFormat streamFormat;
+
+    // Modes of the device and the one chosen by the policy
+    CaptureCapabilities capabilities;
+    int selectedMode = -1;
+
+    // Helper methods
+    HRESULT AddFilterByCLSID(IGraphBuilder* pGraph, const GUID& clsid, IBaseFilter** ppF, const wchar_t* name);
+    HRESULT SelectCaptureMode(const CapturePolicy& policy, GUID* subtype);
+    HRESULT ConfigureSampleGrabber(const GUID& subtype);
+    HRESULT ReadConnectedFormat();
+    void Cleanup();
+    HRESULT OnSample(double time, IMediaSample* sample);
+
+    // SampleGrabber Callback
+    class SampleGrabberCallback : public ISampleGrabberCB {
+    public:
+        SampleGrabberCallback(DirectShowCaptureSource* source) : source(source) {}
+
+        STDMETHODIMP SampleCB(double Time, IMediaSample* pSample) override {
+            return source->OnSample(Time, pSample);
+        }
+
+        STDMETHODIMP BufferCB(double Time, BYTE* pBuffer, long BufferLen) override {
+            return E_NOTIMPL;
+        }
+
+        STDMETHODIMP_(ULONG) AddRef() override {
+            return 1;
+        }
+
+        STDMETHODIMP_(ULONG) Release() override {
+            return 2;
+        }
+
+        STDMETHODIMP QueryInterface(REFIID riid, void** ppv) override {
+            if (riid == IID_ISampleGrabberCB || riid == IID_IUnknown) {
+                *ppv = static_cast<void*>(this);
+                return S_OK;
+            }
+            return E_NOINTERFACE;
+        }
+
+    private:
+        DirectShowCaptureSource* source;
+    };
+
+    SampleGrabberCallback callback;
+};
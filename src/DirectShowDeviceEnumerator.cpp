@@ -0,0 +1,42 @@
+#include "DirectShowDeviceEnumerator.h"
+#include "dshow_utils.h"
+#include "StringConversion.h"
+
+bool DirectShowDeviceEnumerator::Enumerate(std::vector<DeviceInfo>* devices) {
+    devices->clear();
+
+    CComPtr<ICreateDevEnum> pDevEnum;
+    HRESULT hr = pDevEnum.CoCreateInstance(CLSID_SystemDeviceEnum);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    // S_FALSE with a null enumerator means the category is empty.
+    CComPtr<IEnumMoniker> pEnum;
+    hr = pDevEnum->CreateClassEnumerator(CLSID_VideoInputDeviceCategory, &pEnum, 0);
+    if (FAILED(hr)) {
+        return false;
+    }
+    if (hr != S_OK || !pEnum) {
+        return true;
+    }
+
+    CComPtr<IMoniker> pMoniker;
+    while (pEnum->Next(1, &pMoniker, nullptr) == S_OK) {
+        CComBSTR name, path, id;
+        if (SUCCEEDED(GetMonikerName(pMoniker, &name)) && SUCCEEDED(GetMonikerPath(pMoniker, &path))) {
+            GetMonikerID(pMoniker, &id);
+
+            DeviceInfo device;
+            device.name.assign(name, name.Length());
+            device.path.assign(path, path.Length());
+            if (id) {
+                device.id.assign(id, id.Length());
+            }
+            device.utf8Name = wstringToString(device.name);
+            devices->push_back(std::move(device));
+        }
+        pMoniker.Release();
+    }
+    return true;
+}
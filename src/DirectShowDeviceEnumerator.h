@@ -0,0 +1,9 @@
+#pragma once
+
+#include "DeviceRegistry.h"
+
+// Lists the video input devices known to DirectShow in a single moniker walk.
+class DirectShowDeviceEnumerator : public DeviceEnumerator {
+public:
+    bool Enumerate(std::vector<DeviceInfo>* devices) override;
+};
@@ -0,0 +1,282 @@
+#include "FrameBroadcast.h"
+#include <algorithm>
+
+FrameSubscriber::FrameSubscriber(FrameBroadcast* broadcast, const SubscriberOptions& options, int index, uint64_t start)
+    : broadcast(broadcast), options(options), index(index), cursor(start), nextExpected(start) {
+    if (Gating()) {
+        queue = std::make_unique<Queued[]>(options.capacity);
+    }
+}
+
+FrameSubscriber::~FrameSubscriber() {
+    broadcast->Unsubscribe(this);
+}
+
+bool FrameSubscriber::TryPop(FrameRef* frame) {
+    return broadcast->Take(*this, frame);
+}
+
+bool FrameSubscriber::Pop(FrameRef* frame, std::chrono::microseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        // Read the head first so a publish between TryPop() and the wait is
+        // not missed.
+        const uint64_t seen = broadcast->head.load(std::memory_order_seq_cst);
+        if (TryPop(frame)) {
+            return true;
+        }
+        if (!broadcast->WaitForFrame(seen, deadline)) {
+            return false;
+        }
+    }
+}
+
+SubscriberStats FrameSubscriber::GetStats() const {
+    SubscriberStats stats;
+    const uint64_t head = broadcast->head.load(std::memory_order_acquire);
+    stats.received = received.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.timeouts = timeouts.load(std::memory_order_relaxed);
+    if (Gating()) {
+        stats.queued = queueHead.load(std::memory_order_acquire) - queueTail.load(std::memory_order_acquire);
+    }
+    else {
+        const uint64_t position = std::min(cursor.load(std::memory_order_acquire), head);
+        stats.queued = std::min<uint64_t>(head - position, options.capacity);
+    }
+    const uint64_t next = std::min(nextExpected.load(std::memory_order_relaxed), head);
+    stats.lag = head - next;
+    return stats;
+}
+
+FrameBroadcast::FrameBroadcast(size_t capacity)
+    : capacity(std::max<size_t>(capacity, 1)), slots(std::make_unique<Slot[]>(std::max<size_t>(capacity, 1))),
+      subscriberList(std::make_unique<SubscriberList>()) {
+}
+
+FrameBroadcast::~FrameBroadcast() {
+    Close();
+}
+
+std::unique_ptr<FrameSubscriber> FrameBroadcast::Subscribe(const SubscriberOptions& options) {
+    std::lock_guard<std::mutex> lock(changeMutex);
+    int index = 0;
+    while (index < kMaxSubscribers && subscribers[index]) {
+        ++index;
+    }
+    if (index == kMaxSubscribers) {
+        return nullptr;
+    }
+
+    SubscriberOptions clamped = options;
+    clamped.capacity = std::clamp<size_t>(options.capacity, 1, capacity);
+
+    std::unique_ptr<FrameSubscriber> subscriber(
+        new FrameSubscriber(this, clamped, index, head.load(std::memory_order_relaxed)));
+    subscribers[index] = subscriber.get();
+    // Only changers replace the list, so it can be read without registryMutex
+    auto next = std::make_unique<SubscriberList>(*subscriberList);
+    if (subscriber->Gating()) {
+        next->gating.push_back(subscriber.get());
+    }
+    else {
+        ++next->dropOldestCount;
+    }
+    ReplaceList(std::move(next));
+    return subscriber;
+}
+
+void FrameBroadcast::ReplaceList(std::unique_ptr<const SubscriberList> next) {
+    std::unique_ptr<const SubscriberList> retired;
+    std::unique_lock<std::mutex> lock(registryMutex);
+    retired = std::move(subscriberList);
+    subscriberList = std::move(next);
+    // A publish that picked up the old list may still be delivering to it
+    replacing.store(true, std::memory_order_seq_cst);
+    publishDone.wait(lock, [&] { return publishing.load(std::memory_order_seq_cst) != retired.get(); });
+    replacing.store(false, std::memory_order_relaxed);
+}
+
+void FrameBroadcast::Unsubscribe(FrameSubscriber* subscriber) {
+    std::lock_guard<std::mutex> lock(changeMutex);
+    subscribers[subscriber->index] = nullptr;
+    auto next = std::make_unique<SubscriberList>(*subscriberList);
+    if (subscriber->Gating()) {
+        next->gating.erase(std::find(next->gating.begin(), next->gating.end(), subscriber));
+    }
+    else {
+        --next->dropOldestCount;
+    }
+    // The last DropOldest subscriber leaving leaves the ring unread
+    const bool releaseSlots = next->dropOldestCount == 0 && !subscriber->Gating();
+
+    // Cut short a publisher waiting for this subscriber to make room
+    {
+        std::lock_guard<std::mutex> roomLock(subscriber->roomMutex);
+        subscriber->leaving.store(true, std::memory_order_release);
+    }
+    subscriber->room.notify_one();
+    // Once this returns the publisher no longer knows the subscriber
+    ReplaceList(std::move(next));
+
+    // With nobody left to read them, give the frames back to their pool;
+    // the new list no longer writes the ring.
+    if (releaseSlots) {
+        for (size_t i = 0; i < capacity; ++i) {
+            std::lock_guard<std::mutex> slotLock(slots[i].mutex);
+            slots[i].frame.Reset();
+            slots[i].sequence = UINT64_MAX;
+        }
+    }
+}
+
+bool FrameBroadcast::HasRoom(const FrameSubscriber& subscriber) const {
+    const uint64_t queued = subscriber.queueHead.load(std::memory_order_relaxed)
+        - subscriber.queueTail.load(std::memory_order_acquire);
+    return queued < subscriber.options.capacity;
+}
+
+void FrameBroadcast::Publish(const FrameRef& frame) {
+    if (closed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const SubscriberList* list;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        list = subscriberList.get();
+        publishing.store(list, std::memory_order_relaxed);
+    }
+
+    if (!list->Empty()) {
+        Deliver(*list, frame);
+    }
+
+    // Only a waiting ReplaceList() needs the lock to be woken
+    publishing.store(nullptr, std::memory_order_seq_cst);
+    if (replacing.load(std::memory_order_seq_cst)) {
+        { std::lock_guard<std::mutex> lock(registryMutex); }
+        publishDone.notify_all();
+    }
+}
+
+void FrameBroadcast::Deliver(const SubscriberList& list, const FrameRef& frame) {
+    const uint64_t sequence = head.load(std::memory_order_relaxed);
+    for (FrameSubscriber* subscriber : list.gating) {
+        if (subscriber->leaving.load(std::memory_order_acquire)) {
+            continue;
+        }
+        bool hasRoom = HasRoom(*subscriber);
+        if (!hasRoom && subscriber->options.policy == BackpressurePolicy::Block) {
+            std::unique_lock<std::mutex> roomLock(subscriber->roomMutex);
+            hasRoom = subscriber->room.wait_for(roomLock, subscriber->options.timeout,
+                [&] { return HasRoom(*subscriber) || subscriber->leaving.load(std::memory_order_relaxed); });
+            if (subscriber->leaving.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            if (!hasRoom) {
+                subscriber->timeouts.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (!hasRoom) {
+            subscriber->dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // The subscriber has moved the previous frame out of this entry.
+        const uint64_t queueHead = subscriber->queueHead.load(std::memory_order_relaxed);
+        FrameSubscriber::Queued& entry = subscriber->queue[queueHead % subscriber->options.capacity];
+        entry.frame = frame;
+        entry.sequence = sequence;
+        subscriber->queueHead.store(queueHead + 1, std::memory_order_release);
+    }
+
+    if (list.dropOldestCount > 0) {
+        FrameRef previous;
+        Slot& slot = slots[sequence % capacity];
+        {
+            std::lock_guard<std::mutex> slotLock(slot.mutex);
+            previous.Swap(slot.frame);
+            slot.frame = frame;
+            slot.sequence = sequence;
+        }
+        // 'previous' goes back to its pool outside the slot lock
+    }
+
+    head.store(sequence + 1, std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) > 0) {
+        { std::lock_guard<std::mutex> waitLock(waitMutex); }
+        frameReady.notify_all();
+    }
+}
+
+bool FrameBroadcast::Take(FrameSubscriber& subscriber, FrameRef* frame) {
+    frame->Reset();
+    uint64_t sequence = 0;
+
+    if (subscriber.Gating()) {
+        const uint64_t tail = subscriber.queueTail.load(std::memory_order_relaxed);
+        if (tail == subscriber.queueHead.load(std::memory_order_acquire)) {
+            return false;
+        }
+        FrameSubscriber::Queued& entry = subscriber.queue[tail % subscriber.options.capacity];
+        frame->Swap(entry.frame);
+        sequence = entry.sequence;
+        subscriber.queueTail.store(tail + 1, std::memory_order_release);
+
+        if (subscriber.options.policy == BackpressurePolicy::Block) {
+            { std::lock_guard<std::mutex> roomLock(subscriber.roomMutex); }
+            subscriber.room.notify_one();
+        }
+    }
+    else {
+        uint64_t position = subscriber.cursor.load(std::memory_order_relaxed);
+        for (;;) {
+            const uint64_t published = head.load(std::memory_order_acquire);
+            if (position >= published) {
+                return false;
+            }
+            // Skip whatever no longer fits in this subscriber's queue.
+            if (published - position > subscriber.options.capacity) {
+                const uint64_t skipTo = published - subscriber.options.capacity;
+                subscriber.dropped.fetch_add(skipTo - position, std::memory_order_relaxed);
+                position = skipTo;
+            }
+
+            Slot& slot = slots[position % capacity];
+            std::lock_guard<std::mutex> slotLock(slot.mutex);
+            if (slot.sequence == position) {
+                *frame = slot.frame;
+                break;
+            }
+            // The publisher lapped us since reading the head; the check
+            // above counts what was lost on the next pass.
+        }
+        sequence = position;
+        subscriber.cursor.store(position + 1, std::memory_order_release);
+    }
+
+    subscriber.nextExpected.store(sequence + 1, std::memory_order_relaxed);
+    subscriber.received.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool FrameBroadcast::WaitForFrame(uint64_t seen, std::chrono::steady_clock::time_point deadline) {
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool published = false;
+    {
+        std::unique_lock<std::mutex> lock(waitMutex);
+        published = frameReady.wait_until(lock, deadline, [&] {
+            return closed.load(std::memory_order_relaxed) || head.load(std::memory_order_seq_cst) != seen;
+        });
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+    return published && !closed.load(std::memory_order_relaxed);
+}
+
+void FrameBroadcast::Close() {
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        closed.store(true, std::memory_order_relaxed);
+    }
+    frameReady.notify_all();
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "FramePool.h"
+
+// What a subscriber does when frames arrive faster than it takes them.
+enum class BackpressurePolicy {
+    DropOldest,  // Skip ahead to the newest frames; never holds up the publisher
+    DropNewest,  // Keep the queued frames and miss new ones until there is room
+    Block,       // Make the publisher wait up to 'timeout' for room, then miss the frame
+};
+
+struct SubscriberOptions {
+    std::string name;
+    BackpressurePolicy policy = BackpressurePolicy::DropOldest;
+    size_t capacity = 4;  // Frames queued for this subscriber, at most the ring capacity
+
+    // Block only. This stalls the publishing thread, normally the capture
+    // callback, so keep it well below a frame interval.
+    std::chrono::microseconds timeout{ 2000 };
+};
+
+struct SubscriberStats {
+    uint64_t received = 0;  // Frames popped
+    uint64_t dropped = 0;   // Frames it will never see; DropOldest counts them on the next pop
+    uint64_t timeouts = 0;  // Block: publishes that gave up waiting for room
+    uint64_t queued = 0;    // Frames waiting to be popped
+    uint64_t lag = 0;       // Frames published after the one it popped last
+};
+
+class FrameBroadcast;
+
+// One consumer's view of a FrameBroadcast. Pop from a single thread; stats
+// may be read from any. Destroying the subscriber unsubscribes it.
+class FrameSubscriber {
+public:
+    ~FrameSubscriber();
+
+    FrameSubscriber(const FrameSubscriber&) = delete;
+    FrameSubscriber& operator=(const FrameSubscriber&) = delete;
+
+    // The oldest frame queued for this subscriber, if any.
+    bool TryPop(FrameRef* frame);
+
+    // Like TryPop(), waiting up to 'timeout' for a frame. Returns false on
+    // timeout and once the broadcast is closed.
+    bool Pop(FrameRef* frame, std::chrono::microseconds timeout);
+
+    SubscriberStats GetStats() const;
+    const SubscriberOptions& Options() const { return options; }
+
+private:
+    friend class FrameBroadcast;
+
+    FrameSubscriber(FrameBroadcast* broadcast, const SubscriberOptions& options, int index, uint64_t start);
+
+    // DropNewest and Block subscribers are checked by the publisher for room
+    bool Gating() const { return options.policy != BackpressurePolicy::DropOldest; }
+
+    FrameBroadcast* const broadcast;
+    const SubscriberOptions options;
+    const int index;
+
+    // DropOldest: next sequence to read. Only the subscriber writes it.
+    std::atomic<uint64_t> cursor;
+
+    // Gating subscribers: the frames the publisher accepted for this
+    // subscriber, as a single-producer/single-consumer ring. A slot is only
+    // reused once the subscriber has moved its frame out.
+    struct Queued {
+        FrameRef frame;
+        uint64_t sequence = 0;
+    };
+    std::unique_ptr<Queued[]> queue;
+    std::atomic<uint64_t> queueHead{ 0 };  // Written by the publisher
+    std::atomic<uint64_t> queueTail{ 0 };  // Written by the subscriber
+
+    // Block: the publisher waits here for room
+    std::mutex roomMutex;
+    std::condition_variable room;
+
+    // Set by Unsubscribe() so a publisher blocked on this subscriber lets go
+    std::atomic<bool> leaving{ false };
+
+    std::atomic<uint64_t> nextExpected;  // Sequence after the one popped last
+    std::atomic<uint64_t> received{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> timeouts{ 0 };
+};
+
+// Fans frames out from one producer to any number of consumers, each with its
+// own queue depth and backpressure policy. A publish stores the frame once in
+// a shared ring; DropOldest subscribers read the ring at their own pace and
+// cost the publisher nothing, so publishing stays flat however many of them
+// there are. DropNewest and Block subscribers have their own queue, which
+// costs the publisher a reference count increment each.
+//
+// The subscriber set is an immutable list, replaced whole by Subscribe() and
+// Unsubscribe(). Publish() takes the lock only to pick up the current list
+// and delivers without it, so subscribing never waits on a Block
+// subscriber's backpressure and the publisher never waits on an allocation.
+// A replaced list is freed once the publisher is done with it. When the
+// last DropOldest subscriber leaves, the ring's frames go back to their pool.
+//
+// Publish from a single thread. The broadcast must outlive its subscribers.
+class FrameBroadcast {
+public:
+    static constexpr int kMaxSubscribers = 64;
+
+    explicit FrameBroadcast(size_t capacity = 8);
+    ~FrameBroadcast();
+
+    FrameBroadcast(const FrameBroadcast&) = delete;
+    FrameBroadcast& operator=(const FrameBroadcast&) = delete;
+
+    // Returns null when kMaxSubscribers are subscribed already. The
+    // subscriber sees frames published from now on. Subscribing and
+    // unsubscribing wait out a publish in progress.
+    std::unique_ptr<FrameSubscriber> Subscribe(const SubscriberOptions& options);
+
+    // Hand 'frame' to every subscriber that has room for it. Only Block
+    // subscribers can make this wait.
+    void Publish(const FrameRef& frame);
+
+    // Wake every waiting Pop(); from now on Publish() does nothing.
+    void Close();
+
+    size_t Capacity() const { return capacity; }
+    uint64_t Published() const { return head.load(std::memory_order_relaxed); }
+
+private:
+    friend class FrameSubscriber;
+
+    struct Slot {
+        std::mutex mutex;
+        FrameRef frame;
+        uint64_t sequence = UINT64_MAX;
+    };
+
+    // Who Publish() delivers to. Never changed once published.
+    struct SubscriberList {
+        std::vector<FrameSubscriber*> gating;
+        int dropOldestCount = 0;
+
+        bool Empty() const { return gating.empty() && dropOldestCount == 0; }
+    };
+
+    void ReplaceList(std::unique_ptr<const SubscriberList> next);
+    void Deliver(const SubscriberList& list, const FrameRef& frame);
+    void Unsubscribe(FrameSubscriber* subscriber);
+    bool HasRoom(const FrameSubscriber& subscriber) const;
+    bool Take(FrameSubscriber& subscriber, FrameRef* frame);
+    bool WaitForFrame(uint64_t seen, std::chrono::steady_clock::time_point deadline);
+
+    const size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> head{ 0 };  // Sequence of the next frame to publish
+
+    // Serializes Subscribe() and Unsubscribe(), including their allocations
+    std::mutex changeMutex;
+    FrameSubscriber* subscribers[kMaxSubscribers] = {};  // Guarded by changeMutex
+
+    // Guards the list pointer; Publish() takes it once a frame to pick the
+    // list up, and again only to wake a waiting ReplaceList()
+    std::mutex registryMutex;
+    std::condition_variable publishDone;
+    std::unique_ptr<const SubscriberList> subscriberList;
+    std::atomic<const SubscriberList*> publishing{ nullptr };  // List the publisher is delivering to
+    std::atomic<bool> replacing{ false };                      // A replaced list waits for publishDone
+
+    // Pop() callers waiting for the next publish
+    std::mutex waitMutex;
+    std::condition_variable frameReady;
+    std::atomic<int> waiters{ 0 };
+    std::atomic<bool> closed{ false };
+};
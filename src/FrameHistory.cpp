@@ -0,0 +1,242 @@
+#include "FrameHistory.h"
+#include <cstring>
+#include "AviFile.h"
+#include "Log.h"
+#include "LosslessFrameCodec.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+
+// The AVI header claims this rate until the clip's frames give the real one
+static const double kNominalAviFps = 30.0;
+
+static bool SameLayout(const VideoFormat& a, const VideoFormat& b) {
+    return a.format == b.format && a.width == b.width && a.height == b.height && a.stride == b.stride &&
+        a.topDown == b.topDown;
+}
+
+const char* ClipExportStateName(ClipExportState state) {
+    switch (state) {
+    case ClipExportState::Idle:    return "Idle";
+    case ClipExportState::Running: return "Saving";
+    case ClipExportState::Done:    return "Saved";
+    case ClipExportState::Failed:  return "Failed";
+    }
+    return "Unknown";
+}
+
+FrameHistory::FrameHistory(const FrameHistoryOptions& options)
+    : options(options),
+      // Zero-filled, so every page is faulted in now rather than on the
+      // capture path during the first lap
+      storage(options.memoryBytes),
+      frames(options.maxFrames > 0 ? options.maxFrames : 1) {
+}
+
+FrameHistory::~FrameHistory() {
+    exportCancel.store(true, std::memory_order_relaxed);
+    if (exportThread.joinable()) {
+        exportThread.join();
+    }
+}
+
+bool FrameHistory::Add(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) {
+    // Compress before taking the lock; a raw frame that would not shrink is
+    // stored as it is.
+    const uint8_t* stored = data;
+    size_t storedSize = size;
+    bool compressed = false;
+    if (options.compressRaw && format.format != PixelFormat::MJPEG) {
+        const size_t bound = LosslessCompressBound(size);
+        if (compressBuffer.size() < bound) {
+            compressBuffer.resize(bound);
+        }
+        const size_t bytes = LosslessCompress(format.format, data, size, compressBuffer.data());
+        if (bytes < size) {
+            stored = compressBuffer.data();
+            storedSize = bytes;
+            compressed = true;
+        }
+    }
+
+    const uint64_t capacity = storage.size();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (storedSize == 0 || storedSize > capacity / 2 || size > UINT32_MAX) {
+        ++framesDropped;
+        return false;
+    }
+
+    // Frames never wrap: one that would is stored from the ring's start
+    uint64_t position = writePosition;
+    const uint64_t offset = position % capacity;
+    if (offset + storedSize > capacity) {
+        position += capacity - offset;
+    }
+    Evict(position + storedSize);
+
+    memcpy(storage.data() + position % capacity, stored, storedSize);
+    StoredFrame& frame = Frame(nextSequence);
+    frame.position = position;
+    frame.storedSize = static_cast<uint32_t>(storedSize);
+    frame.size = static_cast<uint32_t>(size);
+    frame.format = format;
+    frame.sampleTime = sampleTime;
+    frame.compressed = compressed;
+    ++nextSequence;
+    writePosition = position + storedSize;
+    storedBytes += storedSize;
+    rawBytes += size;
+    return true;
+}
+
+void FrameHistory::Evict(uint64_t end) {
+    // Make room for a frame ending at ring position 'end' and for its
+    // entry in 'frames'
+    const uint64_t capacity = storage.size();
+    while (firstSequence < nextSequence &&
+        (end - Frame(firstSequence).position > capacity || nextSequence - firstSequence >= frames.size())) {
+        const StoredFrame& oldest = Frame(firstSequence);
+        storedBytes -= oldest.storedSize;
+        rawBytes -= oldest.size;
+        ++firstSequence;
+        ++framesEvicted;
+    }
+}
+
+FrameHistoryStats FrameHistory::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    FrameHistoryStats stats;
+    stats.frames = nextSequence - firstSequence;
+    stats.storedBytes = storedBytes;
+    stats.framesAdded = nextSequence;
+    stats.framesEvicted = framesEvicted;
+    stats.framesDropped = framesDropped;
+    if (stats.frames >= 2) {
+        // Each frame stands for one frame interval, the newest included
+        const double span = Frame(nextSequence - 1).sampleTime - Frame(firstSequence).sampleTime;
+        stats.seconds = span * stats.frames / (stats.frames - 1);
+    }
+    if (stats.seconds > 0.0) {
+        stats.bytesPerSecond = storedBytes / stats.seconds;
+        stats.rawBytesPerSecond = rawBytes / stats.seconds;
+        stats.secondsAtBudget = storage.size() / stats.bytesPerSecond;
+    }
+    return stats;
+}
+
+bool FrameHistory::StartExport(const std::filesystem::path& path, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (exportStatus.state == ClipExportState::Running || firstSequence == nextSequence) {
+        return false;
+    }
+    // The last export has set its final state, the last thing it does
+    // under the lock, so joining it here cannot wait on us.
+    if (exportThread.joinable()) {
+        exportThread.join();
+    }
+
+    // The clip is the frames within 'seconds' of the newest one now; frames
+    // arriving during the export belong to the next clip.
+    const uint64_t last = nextSequence - 1;
+    const double cutoff = Frame(last).sampleTime - seconds;
+    uint64_t first = last;
+    while (first > firstSequence && Frame(first - 1).sampleTime > cutoff) {
+        --first;
+    }
+
+    exportStatus = ClipExportStatus();
+    exportStatus.state = ClipExportState::Running;
+    exportStatus.path = path;
+    exportStatus.framesTotal = last - first + 1;
+    exportCancel.store(false, std::memory_order_relaxed);
+    exportThread = std::thread(&FrameHistory::Export, this, first, last, Frame(last).format);
+    return true;
+}
+
+ClipExportStatus FrameHistory::GetExportStatus() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return exportStatus;
+}
+
+void FrameHistory::SetExportState(ClipExportState state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    exportStatus.state = state;
+}
+
+void FrameHistory::Export(uint64_t first, uint64_t last, VideoFormat format) {
+    TRACE_THREAD_NAME("Clip export");
+    RegisterThreadCpu("Clip export");
+    std::filesystem::path path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        path = exportStatus.path;
+    }
+
+    std::error_code error;
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path(), error);
+    }
+    AviWriter avi;
+    if (!avi.Open(path, format, kNominalAviFps)) {
+        LOG_ERROR("History", "Cannot save %dx%d %s frames to %s", format.width, format.height,
+            PixelFormatName(format.format), path.string().c_str());
+        SetExportState(ClipExportState::Failed);
+        return;
+    }
+
+    std::vector<uint8_t> stored;
+    std::vector<uint8_t> decompressed;
+    uint64_t written = 0;
+    double firstTime = 0.0;
+    double lastTime = 0.0;
+    bool failed = false;
+    for (uint64_t sequence = first; sequence <= last && !exportCancel.load(std::memory_order_relaxed); ++sequence) {
+        // Copy the frame out so Add() waits for one memcpy at most
+        StoredFrame frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (sequence < firstSequence || !SameLayout(Frame(sequence).format, format)) {
+                ++exportStatus.framesSkipped;
+                continue;
+            }
+            frame = Frame(sequence);
+            stored.resize(frame.storedSize);
+            memcpy(stored.data(), storage.data() + frame.position % storage.size(), frame.storedSize);
+        }
+
+        const uint8_t* data = stored.data();
+        if (frame.compressed) {
+            decompressed.resize(frame.size);
+            if (!LosslessDecompress(stored.data(), stored.size(), decompressed.data(), frame.size)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++exportStatus.framesSkipped;
+                continue;
+            }
+            data = decompressed.data();
+        }
+        if (!avi.WriteFrame(data, frame.size)) {
+            LOG_ERROR("History", "Write to %s failed", path.string().c_str());
+            failed = true;
+            break;
+        }
+        if (written++ == 0) {
+            firstTime = frame.sampleTime;
+        }
+        lastTime = frame.sampleTime;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        exportStatus.framesWritten = written;
+        exportStatus.bytesWritten = avi.BytesWritten();
+    }
+
+    if (written > 1 && lastTime > firstTime) {
+        avi.SetFramesPerSecond((written - 1) / (lastTime - firstTime));
+    }
+    failed = !avi.Close() || failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exportStatus.bytesWritten = avi.BytesWritten();
+        exportStatus.state = failed ? ClipExportState::Failed : ClipExportState::Done;
+        LOG_INFO("History", "Saved %llu frames to %s, %llu skipped", static_cast<unsigned long long>(written),
+            path.string().c_str(), static_cast<unsigned long long>(exportStatus.framesSkipped));
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VideoFrame.h"
+
+struct FrameHistoryOptions {
+    size_t memoryBytes = 256u << 20;  // Frame storage, allocated and touched up front
+    uint32_t maxFrames = 16384;       // Most frames held at once, whatever their size
+    bool compressRaw = true;          // Keep raw frames losslessly compressed (see LosslessFrameCodec.h)
+};
+
+struct FrameHistoryStats {
+    uint64_t frames = 0;             // Held now
+    uint64_t storedBytes = 0;        // Taken by the frames held
+    double seconds = 0.0;            // Of capture the frames held cover
+    double bytesPerSecond = 0.0;     // Memory per second of history, as stored
+    double rawBytesPerSecond = 0.0;  // ... and as the frames arrived
+    double secondsAtBudget = 0.0;    // History memoryBytes holds at the current rate
+    uint64_t framesAdded = 0;
+    uint64_t framesEvicted = 0;      // Overwritten to make room for newer ones
+    uint64_t framesDropped = 0;      // Larger than half the storage
+};
+
+enum class ClipExportState {
+    Idle,     // No export started yet
+    Running,
+    Done,
+    Failed,
+};
+
+const char* ClipExportStateName(ClipExportState state);
+
+struct ClipExportStatus {
+    ClipExportState state = ClipExportState::Idle;
+    std::filesystem::path path;
+    uint64_t framesTotal = 0;    // In the clip's window when it started
+    uint64_t framesWritten = 0;
+    uint64_t framesSkipped = 0;  // Overwritten before the export reached them, or of another layout
+    uint64_t bytesWritten = 0;
+};
+
+// The last stretch of capture held in memory, so that a clip of what led up
+// to an event can be saved after the fact.
+//
+// Frames go into one preallocated byte ring, oldest overwritten first.
+// MJPEG is stored as delivered; raw frames are compressed losslessly on the
+// way in, which roughly halves a camera frame. GetStats() reports what a
+// second of history costs, so the budget can be sized for the seconds
+// wanted.
+//
+// StartExport() writes the newest frames to an AVI file on a thread of its
+// own. It copies one frame at a time out of the ring under the lock, which
+// Add() takes only to store a frame, so capture carries on while the clip
+// is written; MJPEG goes to the file without being decoded again, raw
+// frames are decompressed into uncompressed AVI. Frames the ring overwrites
+// before the export reaches them are skipped and counted.
+//
+// Add() belongs to one thread; everything else is safe from any thread.
+class FrameHistory {
+public:
+    explicit FrameHistory(const FrameHistoryOptions& options);
+    ~FrameHistory();
+
+    FrameHistory(const FrameHistory&) = delete;
+    FrameHistory& operator=(const FrameHistory&) = delete;
+
+    // Store a frame, overwriting the oldest ones to make room. Returns false
+    // if it was dropped.
+    bool Add(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime);
+
+    FrameHistoryStats GetStats() const;
+
+    // Write the last 'seconds' of history to an AVI file at 'path', in the
+    // layout of the newest frame, creating its directory if missing.
+    // Returns false if an export is running already or nothing is held.
+    bool StartExport(const std::filesystem::path& path, double seconds);
+
+    ClipExportStatus GetExportStatus() const;
+
+    const FrameHistoryOptions& Options() const { return options; }
+
+private:
+    struct StoredFrame {
+        uint64_t position = 0;    // In the ring, counting every byte ever stored
+        uint32_t storedSize = 0;
+        uint32_t size = 0;        // Before compression
+        VideoFormat format;
+        double sampleTime = 0.0;
+        bool compressed = false;
+    };
+
+    StoredFrame& Frame(uint64_t sequence) { return frames[sequence % frames.size()]; }
+    const StoredFrame& Frame(uint64_t sequence) const { return frames[sequence % frames.size()]; }
+    void Evict(uint64_t end);
+    void Export(uint64_t first, uint64_t last, VideoFormat format);
+    void SetExportState(ClipExportState state);
+
+    const FrameHistoryOptions options;
+
+    std::vector<uint8_t> storage;
+    std::vector<StoredFrame> frames;   // Ring of maxFrames, by sequence
+    std::vector<uint8_t> compressBuffer;  // Add() only
+
+    mutable std::mutex mutex;
+    uint64_t firstSequence = 0;        // Oldest frame held
+    uint64_t nextSequence = 0;
+    uint64_t writePosition = 0;        // Ring position of the next frame
+    uint64_t storedBytes = 0;
+    uint64_t rawBytes = 0;
+    uint64_t framesEvicted = 0;
+    uint64_t framesDropped = 0;
+
+    // Export; 'exportStatus' is guarded by 'mutex'
+    std::thread exportThread;
+    std::atomic<bool> exportCancel{ false };
+    ClipExportStatus exportStatus;
+};
@@ -0,0 +1,124 @@
+#include "FrameLatency.h"
+#include <chrono>
+#include <cstdio>
+
+int64_t MonotonicNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* LatencyStageName(LatencyStage stage) {
+    switch (stage) {
+    case LatencyStage::Capture: return "capture";
+    case LatencyStage::Queue: return "queue";
+    case LatencyStage::Convert: return "convert";
+    case LatencyStage::Display: return "display";
+    case LatencyStage::EndToEnd: return "end_to_end";
+    default: return "unknown";
+    }
+}
+
+const char* JitterPointName(JitterPoint point) {
+    switch (point) {
+    case JitterPoint::Sample: return "sample";
+    case JitterPoint::Grab: return "grab";
+    case JitterPoint::Publish: return "publish";
+    case JitterPoint::Convert: return "convert";
+    case JitterPoint::Display: return "display";
+    default: return "unknown";
+    }
+}
+
+void FrameLatencyCollector::IntervalTracker::Add(int64_t time, LatencyHistogram& histogram) {
+    if (last >= 0) {
+        const int64_t interval = time - last;
+        if (lastInterval >= 0) {
+            const int64_t change = interval - lastInterval;
+            histogram.Record(change < 0 ? -change : change);
+        }
+        lastInterval = interval;
+    }
+    last = time;
+}
+
+void FrameLatencyCollector::RecordCapture(double sampleTime, int64_t grab, int64_t publish) {
+    if (resetRequests.load(std::memory_order_relaxed) & kResetCapture) {
+        resetRequests.fetch_and(~kResetCapture, std::memory_order_relaxed);
+        ResetCapture();
+    }
+    latency[static_cast<int>(LatencyStage::Capture)].Record(publish - grab);
+
+    const int64_t sampleNanos = static_cast<int64_t>(sampleTime * 1e9);
+    intervals[static_cast<int>(JitterPoint::Sample)].Add(sampleNanos, jitter[static_cast<int>(JitterPoint::Sample)]);
+    intervals[static_cast<int>(JitterPoint::Grab)].Add(grab, jitter[static_cast<int>(JitterPoint::Grab)]);
+    intervals[static_cast<int>(JitterPoint::Publish)].Add(publish, jitter[static_cast<int>(JitterPoint::Publish)]);
+}
+
+void FrameLatencyCollector::RecordDisplay(const FrameTimestamps& times) {
+    if (resetRequests.load(std::memory_order_relaxed) & kResetDisplay) {
+        resetRequests.fetch_and(~kResetDisplay, std::memory_order_relaxed);
+        ResetDisplay();
+    }
+    latency[static_cast<int>(LatencyStage::Queue)].Record(times.pickup - times.publish);
+    latency[static_cast<int>(LatencyStage::Convert)].Record(times.convert - times.pickup);
+    latency[static_cast<int>(LatencyStage::Display)].Record(times.display - times.convert);
+    latency[static_cast<int>(LatencyStage::EndToEnd)].Record(times.display - times.grab);
+
+    intervals[static_cast<int>(JitterPoint::Convert)].Add(times.convert, jitter[static_cast<int>(JitterPoint::Convert)]);
+    intervals[static_cast<int>(JitterPoint::Display)].Add(times.display, jitter[static_cast<int>(JitterPoint::Display)]);
+}
+
+void FrameLatencyCollector::RequestReset() {
+    resetRequests.fetch_or(kResetCapture | kResetDisplay, std::memory_order_relaxed);
+}
+
+void FrameLatencyCollector::ResetCapture() {
+    latency[static_cast<int>(LatencyStage::Capture)].Reset();
+    jitter[static_cast<int>(JitterPoint::Sample)].Reset();
+    jitter[static_cast<int>(JitterPoint::Grab)].Reset();
+    jitter[static_cast<int>(JitterPoint::Publish)].Reset();
+}
+
+void FrameLatencyCollector::ResetDisplay() {
+    latency[static_cast<int>(LatencyStage::Queue)].Reset();
+    latency[static_cast<int>(LatencyStage::Convert)].Reset();
+    latency[static_cast<int>(LatencyStage::Display)].Reset();
+    latency[static_cast<int>(LatencyStage::EndToEnd)].Reset();
+    jitter[static_cast<int>(JitterPoint::Convert)].Reset();
+    jitter[static_cast<int>(JitterPoint::Display)].Reset();
+}
+
+void FrameLatencyCollector::Reset() {
+    resetRequests.store(0, std::memory_order_relaxed);
+    ResetCapture();
+    ResetDisplay();
+}
+
+void AppendLatencySummaryJson(std::string& json, const LatencySummary& summary) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+        "{\"count\": %llu, \"min_us\": %.3f, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, "
+        "\"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f}",
+        static_cast<unsigned long long>(summary.count), summary.min, summary.mean,
+        summary.p50, summary.p90, summary.p99, summary.p999, summary.max);
+    json += buffer;
+}
+
+std::string FrameLatencyCollector::ToJson() const {
+    std::string json = "{\"latency\": {";
+    for (int i = 0; i < static_cast<int>(LatencyStage::Count); ++i) {
+        json += i ? ", \"" : "\"";
+        json += LatencyStageName(static_cast<LatencyStage>(i));
+        json += "\": ";
+        AppendLatencySummaryJson(json, latency[i].Summarize());
+    }
+    json += "}, \"jitter\": {";
+    for (int i = 0; i < static_cast<int>(JitterPoint::Count); ++i) {
+        json += i ? ", \"" : "\"";
+        json += JitterPointName(static_cast<JitterPoint>(i));
+        json += "\": ";
+        AppendLatencySummaryJson(json, jitter[i].Summarize());
+    }
+    json += "}}";
+    return json;
+}
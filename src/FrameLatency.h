@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "LatencyHistogram.h"
+
+// Monotonic clock for frame timestamps, in nanoseconds.
+int64_t MonotonicNanos();
+
+// Latency between two points of a frame's trip from the source to the screen.
+enum class LatencyStage {
+    Capture,   // Source callback -> published (copied into the pool and fanned out)
+    Queue,     // Published -> picked up by the UI thread
+    Convert,   // Picked up -> in the display texture (decode and color conversion)
+    Display,   // In the texture -> presented
+    EndToEnd,  // Source callback -> presented
+    Count
+};
+
+// Points at which the spacing of consecutive frames is measured. Jitter is
+// the change in that spacing from one frame to the next.
+enum class JitterPoint {
+    Sample,    // The source's own timestamps
+    Grab,      // Source callback
+    Publish,
+    Convert,
+    Display,
+    Count
+};
+
+const char* LatencyStageName(LatencyStage stage);
+const char* JitterPointName(JitterPoint point);
+
+// When a frame reached each point, from MonotonicNanos(). Zero for a point
+// not reached yet.
+struct FrameTimestamps {
+    double sampleTime = 0.0;  // Source stream time in seconds
+    int64_t grab = 0;
+    int64_t publish = 0;
+    int64_t pickup = 0;
+    int64_t convert = 0;
+    int64_t display = 0;
+};
+
+// Latency and jitter histograms for the capture pipeline. The capture side is
+// recorded on the source's streaming thread, the display side on the UI
+// thread; each side keeps its own previous-frame state, so a side must always
+// be recorded from the same thread. Summaries may be read from any thread.
+class FrameLatencyCollector {
+public:
+    // Every frame the source delivers.
+    void RecordCapture(double sampleTime, int64_t grab, int64_t publish);
+
+    // Every frame that reaches the screen, with all of its timestamps.
+    void RecordDisplay(const FrameTimestamps& times);
+
+    const LatencyHistogram& Latency(LatencyStage stage) const { return latency[static_cast<int>(stage)]; }
+    const LatencyHistogram& Jitter(JitterPoint point) const { return jitter[static_cast<int>(point)]; }
+
+    // Summaries of every histogram, in microseconds:
+    // {"latency": {"capture": {"count": n, "min_us": ..., "p50_us": ...}, ...},
+    //  "jitter": {"sample": {...}, ...}}
+    std::string ToJson() const;
+
+    // Clear the histograms from any thread. Each side clears its own on its
+    // next frame, on its own thread, so the single-writer rule holds; a side
+    // that records nothing keeps its histograms until it does.
+    void RequestReset();
+
+    // Clear the histograms at once. Only while neither side is recording,
+    // e.g. before the source starts. The interval state is kept, so the next
+    // jitter sample is still measured against the last frame.
+    void Reset();
+
+private:
+    static constexpr uint32_t kResetCapture = 1;
+    static constexpr uint32_t kResetDisplay = 2;
+
+    void ResetCapture();
+    void ResetDisplay();
+
+    // Spacing of consecutive frames at one point
+    struct IntervalTracker {
+        int64_t last = -1;
+        int64_t lastInterval = -1;
+
+        void Add(int64_t time, LatencyHistogram& histogram);
+    };
+
+    LatencyHistogram latency[static_cast<int>(LatencyStage::Count)];
+    LatencyHistogram jitter[static_cast<int>(JitterPoint::Count)];
+    IntervalTracker intervals[static_cast<int>(JitterPoint::Count)];
+    std::atomic<uint32_t> resetRequests{ 0 };  // kReset* bits of the sides yet to clear
+};
+
+// Appends 'summary' to 'json' as an object of microsecond fields.
+void AppendLatencySummaryJson(std::string& json, const LatencySummary& summary);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Counters describing how the producer and consumer of a FrameMailbox interact.
+struct FrameMailboxStats {
+    uint64_t published = 0; // Frames handed over by the producer
+    uint64_t consumed = 0;  // Frames picked up by the consumer
+    uint64_t dropped = 0;   // Frames overwritten by a newer one before being read
+    uint64_t repeated = 0;  // Consumer polls that found nothing new and reused the last frame
+};
+
+// Lock-free single-producer/single-consumer "latest value" mailbox built on a
+// triple buffer. The producer always owns a private slot to write into and
+// publishes without ever waiting on the consumer; the consumer always reads the
+// most recently completed slot. Neither side can observe a half-written value.
+//
+// Slot ownership is tracked by three indices: the producer's write slot, the
+// consumer's read slot and the shared "ready" slot that is exchanged atomically
+// between them. The high bit of the shared index marks a slot that has been
+// published but not yet picked up.
+template <typename T>
+class FrameMailbox {
+public:
+    FrameMailbox() = default;
+    FrameMailbox(const FrameMailbox&) = delete;
+    FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+    // Producer: the slot to fill for the next Publish(). Its previous contents
+    // are whatever frame last occupied it, so buffers can be reused in place.
+    T& WriteSlot() { return slots[writeIndex].value; }
+
+    // Producer: make the write slot visible to the consumer and take over the
+    // previously shared slot for the next frame. Never blocks.
+    void Publish() {
+        uint8_t previous = shared.exchange(static_cast<uint8_t>(writeIndex | kFreshBit), std::memory_order_acq_rel);
+        if (previous & kFreshBit) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        writeIndex = previous & kIndexMask;
+        published.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Consumer: swap in the newest published slot if there is one. Returns true
+    // when ReadSlot() now refers to a frame that has not been seen before.
+    bool Acquire() {
+        if ((shared.load(std::memory_order_relaxed) & kFreshBit) == 0) {
+            repeated.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        uint8_t previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & kIndexMask;
+        hasFrame = true;
+        consumed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer: the most recently acquired frame. Only meaningful once
+    // HasFrame() is true.
+    const T& ReadSlot() const { return slots[readIndex].value; }
+    bool HasFrame() const { return hasFrame; }
+
+    // Consumer: forget the last frame so HasFrame() reports false until the
+    // producer publishes again. Pending frames stay in the mailbox.
+    void ResetReader() { hasFrame = false; }
+
+    // Safe to call from any thread.
+    FrameMailboxStats GetStats() const {
+        FrameMailboxStats stats;
+        stats.published = published.load(std::memory_order_relaxed);
+        stats.consumed = consumed.load(std::memory_order_relaxed);
+        stats.dropped = dropped.load(std::memory_order_relaxed);
+        stats.repeated = repeated.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    static constexpr uint8_t kFreshBit = 0x80;
+    static constexpr uint8_t kIndexMask = 0x03;
+
+    // Each slot sits on its own cache line so the producer filling one slot
+    // does not invalidate the line the consumer is reading from.
+    struct alignas(64) Slot {
+        T value{};
+    };
+
+    Slot slots[3];
+
+    alignas(64) uint8_t writeIndex = 0;    // Producer only
+    alignas(64) uint8_t readIndex = 1;     // Consumer only
+    bool hasFrame = false;                 // Consumer only
+    alignas(64) std::atomic<uint8_t> shared{ 2 };
+
+    alignas(64) std::atomic<uint64_t> published{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    alignas(64) std::atomic<uint64_t> consumed{ 0 };
+    std::atomic<uint64_t> repeated{ 0 };
+};
@@ -0,0 +1,102 @@
+#include "FramePool.h"
+#include <cstdlib>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+static uint8_t* AllocateAligned(size_t bytes) {
+#if defined(_WIN32)
+    return static_cast<uint8_t*>(_aligned_malloc(bytes, FramePool::kAlignment));
+#else
+    return static_cast<uint8_t*>(std::aligned_alloc(FramePool::kAlignment, bytes));
+#endif
+}
+
+static void FreeAligned(uint8_t* data) {
+#if defined(_WIN32)
+    _aligned_free(data);
+#else
+    std::free(data);
+#endif
+}
+
+FramePool::FramePool(size_t maxFrames)
+    : maxFrames(maxFrames) {
+    frames.reserve(maxFrames);
+}
+
+FramePool::~FramePool() {
+    for (PooledFrame* frame : frames) {
+        FreeAligned(frame->pixels);
+        delete frame;
+    }
+}
+
+FrameRef FramePool::Acquire(const VideoFormat& layout, size_t bytes) {
+    PooledFrame* frame = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeList) {
+            frame = freeList;
+            freeList = frame->nextFree;
+            freeCount.store(freeCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        }
+        else if (frames.size() < maxFrames) {
+            frame = new PooledFrame;
+            frame->pool = this;
+            frames.push_back(frame);
+            frameCount.store(frames.size(), std::memory_order_release);
+            heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            exhausted.store(exhausted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return FrameRef();
+        }
+        acquired.store(acquired.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // The frame is ours alone now, so the buffer can grow outside the lock.
+    if (frame->capacity < bytes) {
+        const size_t capacity = (bytes + kAlignment - 1) & ~(kAlignment - 1);
+        uint8_t* pixels = AllocateAligned(capacity);
+        if (!pixels) {
+            Recycle(frame);
+            return FrameRef();
+        }
+        FreeAligned(frame->pixels);
+        frame->pixels = pixels;
+        frame->capacity = capacity;
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    frame->format = layout.format;
+    frame->width = layout.width;
+    frame->height = layout.height;
+    frame->stride = layout.stride;
+    frame->topDown = layout.topDown;
+    frame->size = bytes;
+    frame->sampleTime = 0.0;
+    frame->sequence = 0;
+    frame->grabTime = 0;
+    frame->publishTime = 0;
+    frame->refs.store(1, std::memory_order_relaxed);
+    return FrameRef(frame);
+}
+
+void FramePool::Recycle(PooledFrame* frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    frame->nextFree = freeList;
+    freeList = frame;
+    freeCount.store(freeCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+FramePoolStats FramePool::GetStats() const {
+    FramePoolStats stats;
+    // Free first: frames only grows, so free never exceeds frames.
+    stats.free = freeCount.load(std::memory_order_acquire);
+    stats.frames = frameCount.load(std::memory_order_acquire);
+    stats.acquired = acquired.load(std::memory_order_relaxed);
+    stats.exhausted = exhausted.load(std::memory_order_relaxed);
+    stats.heapAllocations = heapAllocations.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "VideoFrame.h"
+
+class FramePool;
+
+// A VideoFrame whose storage belongs to a FramePool. Reference counted in
+// place, so sharing it with another consumer is an atomic increment.
+class PooledFrame : public VideoFrame {
+private:
+    friend class FramePool;
+    friend class FrameRef;
+
+    std::atomic<uint32_t> refs{ 0 };
+    FramePool* pool = nullptr;
+    PooledFrame* nextFree = nullptr;
+};
+
+// Shared handle to a pooled frame. Copies add a reference; the frame goes
+// back to its pool when the last handle is destroyed or reset, on whichever
+// thread that happens. Whoever acquires a frame fills it before sharing it;
+// shared frames are read-only.
+class FrameRef {
+public:
+    FrameRef() = default;
+    FrameRef(const FrameRef& other) : frame(other.frame) { AddRef(); }
+    FrameRef(FrameRef&& other) noexcept : frame(other.frame) { other.frame = nullptr; }
+    ~FrameRef() { Release(); }
+
+    FrameRef& operator=(const FrameRef& other) {
+        if (frame != other.frame) {
+            FrameRef copy(other);
+            Swap(copy);
+        }
+        return *this;
+    }
+
+    FrameRef& operator=(FrameRef&& other) noexcept {
+        if (this != &other) {
+            Release();
+            frame = other.frame;
+            other.frame = nullptr;
+        }
+        return *this;
+    }
+
+    VideoFrame* get() const { return frame; }
+    VideoFrame* operator->() const { return frame; }
+    VideoFrame& operator*() const { return *frame; }
+    explicit operator bool() const { return frame != nullptr; }
+
+    void Reset() { Release(); }
+    void Swap(FrameRef& other) { std::swap(frame, other.frame); }
+
+    // Handles currently sharing the frame; for diagnostics only.
+    uint32_t UseCount() const { return frame ? frame->refs.load(std::memory_order_relaxed) : 0; }
+
+private:
+    friend class FramePool;
+
+    // Adopts a reference the pool has already counted.
+    explicit FrameRef(PooledFrame* adopted) : frame(adopted) {}
+
+    void AddRef() {
+        if (frame) {
+            frame->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    void Release();
+
+    PooledFrame* frame = nullptr;
+};
+
+struct FramePoolStats {
+    uint64_t frames = 0;          // Frames the pool owns
+    uint64_t free = 0;            // Frames waiting to be reused
+    uint64_t acquired = 0;        // Successful Acquire() calls
+    uint64_t exhausted = 0;       // Acquire() calls that found every frame in use
+    uint64_t heapAllocations = 0; // Frame headers and pixel buffers allocated
+};
+
+// Reusable, 64-byte aligned frame buffers for the capture path. Frames are
+// created on demand up to a limit and recycled when their last reference
+// drops, so once the pipeline has warmed up acquiring a frame never touches
+// the heap. A buffer only grows when a larger frame format arrives.
+//
+// Acquire() and release are thread-safe. The pool must outlive every
+// FrameRef it handed out.
+class FramePool {
+public:
+    static constexpr size_t kAlignment = 64;
+
+    explicit FramePool(size_t maxFrames = 16);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // A frame with room for 'bytes' bytes, laid out as 'layout', with
+    // size = bytes. Returns an empty handle when all maxFrames are in use.
+    FrameRef Acquire(const VideoFormat& layout, size_t bytes);
+
+    // Lock-free; the fields are read one at a time, so a snapshot taken
+    // while frames come and go may be off by a frame.
+    FramePoolStats GetStats() const;
+
+private:
+    friend class FrameRef;
+
+    void Recycle(PooledFrame* frame);
+
+    const size_t maxFrames;
+
+    std::mutex mutex;
+    std::vector<PooledFrame*> frames;  // Every frame, reserved up front
+    PooledFrame* freeList = nullptr;
+
+    // Written under the mutex but read without it, so GetStats() never
+    // holds up the capture thread.
+    std::atomic<uint64_t> frameCount{ 0 };
+    std::atomic<uint64_t> freeCount{ 0 };
+    std::atomic<uint64_t> acquired{ 0 };
+    std::atomic<uint64_t> exhausted{ 0 };
+    std::atomic<uint64_t> heapAllocations{ 0 };
+};
+
+inline void FrameRef::Release() {
+    if (frame) {
+        if (frame->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            frame->pool->Recycle(frame);
+        }
+        frame = nullptr;
+    }
+}
@@ -0,0 +1,452 @@
+#include "FrameRingFile.h"
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include "FrameLatency.h"
+#include "Log.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+static const char kRingMagic[8] = { 'Q', 'R', 'I', 'N', 'G', 'B', 'F', '1' };
+static const uint32_t kRingVersion = 1;
+static const uint32_t kRingFlagChecksums = 1;
+
+// The two commit records sit in different 512-byte sectors, so a torn
+// sector write can damage at most one of them.
+static const size_t kCommitOffsets[2] = { 512, 1024 };
+
+// Before each frame in the data area; a frame whose tag names another
+// sequence number has been overwritten.
+static const size_t kTagBytes = 16;
+static const uint64_t kTagMagic = 0x51524E4754414731ull;
+
+static const size_t kPageBytes = 4096;
+
+struct RingFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t dataBytes;
+    uint32_t indexEntries;
+    uint32_t reserved;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    uint64_t checksum;      // Of everything above
+};
+
+struct RingCommit {
+    uint64_t generation;
+    uint64_t firstSequence;
+    uint64_t nextSequence;
+    uint64_t writePosition;
+    uint64_t checksum;      // Of everything above
+};
+
+struct FrameRingFile::IndexEntry {
+    uint64_t sequence;      // 0 for an empty or discarded slot
+    uint64_t position;      // Ring position of the frame's tag
+    uint32_t size;
+    int32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t flags;         // Bit 0: VideoFormat::topDown
+    double sampleTime;
+    uint64_t dataChecksum;  // 0 when the ring has no frame checksums
+    uint64_t checksum;      // Of everything above
+};
+
+static_assert(sizeof(RingFileHeader) == 56 && sizeof(RingCommit) == 40, "Part of the file format");
+
+// Fletcher-style sum over 64-bit words: runs at memory speed and catches
+// pages that hold stale or zeroed data, which is what a power loss leaves.
+static uint64_t Checksum(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t a = 0x9E3779B97F4A7C15ull;
+    uint64_t b = size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        a += word;
+        b += a;
+    }
+    for (; i < size; ++i) {
+        a += bytes[i];
+        b += a;
+    }
+    return a ^ (b << 1 | b >> 63);
+}
+
+static uint64_t AlignUp(uint64_t bytes, uint64_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+bool FrameRingFile::Create(const std::filesystem::path& path, const FrameRingOptions& ringOptions) {
+    Close();
+    if (ringOptions.dataBytes < (1u << 20) || ringOptions.indexEntries < 16) {
+        return false;
+    }
+    options = ringOptions;
+    dataBytes = AlignUp(options.dataBytes, kPageBytes);
+    indexEntries = options.indexEntries;
+    indexOffset = kHeaderBytes;
+    dataOffset = indexOffset + AlignUp(static_cast<uint64_t>(indexEntries) * kIndexEntryBytes, kPageBytes);
+    checksums = options.checksumFrames;
+    if (!Map(path, dataOffset + dataBytes, true)) {
+        return false;
+    }
+
+    // A new file reads as zeros: no commit records and an empty index
+    RingFileHeader header = {};
+    memcpy(header.magic, kRingMagic, sizeof(kRingMagic));
+    header.version = kRingVersion;
+    header.flags = checksums ? kRingFlagChecksums : 0;
+    header.dataBytes = dataBytes;
+    header.indexEntries = indexEntries;
+    header.indexOffset = indexOffset;
+    header.dataOffset = dataOffset;
+    header.checksum = Checksum(&header, offsetof(RingFileHeader, checksum));
+    memcpy(base, &header, sizeof(header));
+
+    generation = 0;
+    firstSequence = 1;
+    nextSequence = 1;
+    writePosition = 0;
+    recovery = FrameRingRecovery();
+    Commit();
+    Sync(true);
+    return true;
+}
+
+bool FrameRingFile::Open(const std::filesystem::path& path, const FrameRingOptions& ringOptions) {
+    Close();
+    std::error_code error;
+    const uint64_t size = std::filesystem::file_size(path, error);
+    if (error || size < kHeaderBytes || !Map(path, size, false)) {
+        return false;
+    }
+
+    RingFileHeader header;
+    memcpy(&header, base, sizeof(header));
+    const bool valid = memcmp(header.magic, kRingMagic, sizeof(kRingMagic)) == 0 &&
+        header.version == kRingVersion &&
+        header.checksum == Checksum(&header, offsetof(RingFileHeader, checksum)) &&
+        header.indexOffset == kHeaderBytes && header.indexEntries > 0 &&
+        header.dataOffset >= header.indexOffset + static_cast<uint64_t>(header.indexEntries) * kIndexEntryBytes &&
+        header.dataOffset + header.dataBytes == size;
+    if (!valid) {
+        LOG_ERROR("FrameRing", "%s is not a frame ring file", path.string().c_str());
+        Close();
+        return false;
+    }
+    options = ringOptions;
+    dataBytes = header.dataBytes;
+    indexEntries = header.indexEntries;
+    indexOffset = header.indexOffset;
+    dataOffset = header.dataOffset;
+    checksums = (header.flags & kRingFlagChecksums) != 0;
+    options.dataBytes = dataBytes;
+    options.indexEntries = indexEntries;
+    options.checksumFrames = checksums;
+
+    Recover();
+    LOG_INFO("FrameRing", "Recovered %llu frames from %s (%llu rolled forward, %llu discarded)",
+        static_cast<unsigned long long>(recovery.framesRecovered), path.string().c_str(),
+        static_cast<unsigned long long>(recovery.rolledForward), static_cast<unsigned long long>(recovery.framesDiscarded));
+    return true;
+}
+
+void FrameRingFile::Close() {
+    if (!IsOpen()) {
+        return;
+    }
+    Sync(true);
+    Unmap();
+}
+
+FrameRingFile::IndexEntry* FrameRingFile::Entry(uint64_t sequence) const {
+    static_assert(sizeof(IndexEntry) == kIndexEntryBytes, "IndexEntry is part of the file format");
+    return reinterpret_cast<IndexEntry*>(base + indexOffset) + sequence % indexEntries;
+}
+
+uint8_t* FrameRingFile::DataAt(uint64_t position) const {
+    return base + dataOffset + position % dataBytes;
+}
+
+bool FrameRingFile::FrameIntact(uint64_t sequence, bool checkData) const {
+    const IndexEntry* entry = Entry(sequence);
+    if (entry->sequence != sequence || entry->checksum != Checksum(entry, offsetof(IndexEntry, checksum))) {
+        return false;
+    }
+    const uint64_t length = AlignUp(kTagBytes + entry->size, kFrameAlignment);
+    if (entry->size == 0 || length > dataBytes / 2 || entry->position % dataBytes + length > dataBytes) {
+        return false;
+    }
+    uint64_t tag[2];
+    memcpy(tag, DataAt(entry->position), sizeof(tag));
+    if (tag[0] != sequence || tag[1] != (entry->size ^ kTagMagic)) {
+        return false;
+    }
+    return !checkData || !checksums || Checksum(DataAt(entry->position) + kTagBytes, entry->size) == entry->dataChecksum;
+}
+
+bool FrameRingFile::Append(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) {
+    if (!IsOpen() || size == 0 || size > UINT32_MAX) {
+        return false;
+    }
+    const uint64_t length = AlignUp(kTagBytes + size, kFrameAlignment);
+    if (length > dataBytes / 2) {
+        return false;
+    }
+    // Frames never wrap; one that would goes to the start of the ring
+    uint64_t position = writePosition;
+    const uint64_t offset = position % dataBytes;
+    if (offset + length > dataBytes) {
+        position += dataBytes - offset;
+    }
+
+    // Drop the frames the new one overwrites, and the one whose index slot
+    // it takes, and commit that before any of their bytes change.
+    bool evicted = false;
+    while (firstSequence < nextSequence) {
+        const IndexEntry* oldest = Entry(firstSequence);
+        const bool held = oldest->sequence == firstSequence;  // Recovery clears damaged ones
+        if (held && oldest->position + dataBytes >= position + length && nextSequence - firstSequence < indexEntries) {
+            break;
+        }
+        ++firstSequence;
+        evicted = true;
+    }
+    if (evicted) {
+        Commit();
+    }
+
+    uint8_t* out = DataAt(position);
+    const uint64_t tag[2] = { nextSequence, size ^ kTagMagic };
+    memcpy(out, tag, sizeof(tag));
+    memcpy(out + kTagBytes, data, size);
+
+    IndexEntry entry;
+    entry.sequence = nextSequence;
+    entry.position = position;
+    entry.size = static_cast<uint32_t>(size);
+    entry.format = static_cast<int32_t>(format.format);
+    entry.width = format.width;
+    entry.height = format.height;
+    entry.stride = format.stride;
+    entry.flags = format.topDown ? 1u : 0u;
+    entry.sampleTime = sampleTime;
+    entry.dataChecksum = checksums ? Checksum(data, size) : 0;
+    entry.checksum = Checksum(&entry, offsetof(IndexEntry, checksum));
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(Entry(nextSequence), &entry, sizeof(entry));
+
+    writePosition = position + length;
+    ++nextSequence;
+    Commit();
+
+    if (options.syncSeconds > 0.0 && MonotonicNanos() - lastSync >= static_cast<int64_t>(options.syncSeconds * 1e9)) {
+        Sync(false);
+    }
+    return true;
+}
+
+bool FrameRingFile::GetFrame(uint64_t sequence, FrameRingEntry* frame) const {
+    if (!IsOpen() || sequence < firstSequence || sequence >= nextSequence || !FrameIntact(sequence, false)) {
+        return false;
+    }
+    const IndexEntry* entry = Entry(sequence);
+    frame->sequence = sequence;
+    frame->format.format = static_cast<PixelFormat>(entry->format);
+    frame->format.width = entry->width;
+    frame->format.height = entry->height;
+    frame->format.stride = entry->stride;
+    frame->format.topDown = (entry->flags & 1u) != 0;
+    frame->sampleTime = entry->sampleTime;
+    frame->data = DataAt(entry->position) + kTagBytes;
+    frame->size = entry->size;
+    return true;
+}
+
+void FrameRingFile::Commit() {
+    // Everything the record names is in the mapping before the record is
+    std::atomic_thread_fence(std::memory_order_release);
+    RingCommit commit;
+    commit.generation = ++generation;
+    commit.firstSequence = firstSequence;
+    commit.nextSequence = nextSequence;
+    commit.writePosition = writePosition;
+    commit.checksum = Checksum(&commit, offsetof(RingCommit, checksum));
+    memcpy(base + kCommitOffsets[generation & 1], &commit, sizeof(commit));
+}
+
+void FrameRingFile::Recover() {
+    recovery = FrameRingRecovery();
+
+    // The newer of the two commit records that are whole
+    RingCommit best = {};
+    for (size_t offset : kCommitOffsets) {
+        RingCommit commit;
+        memcpy(&commit, base + offset, sizeof(commit));
+        if (commit.checksum == Checksum(&commit, offsetof(RingCommit, checksum)) && commit.generation > best.generation &&
+            commit.firstSequence >= 1 && commit.firstSequence <= commit.nextSequence) {
+            best = commit;
+        }
+    }
+    generation = best.generation;
+    firstSequence = best.generation ? best.firstSequence : 1;
+    nextSequence = best.generation ? best.nextSequence : 1;
+    writePosition = best.writePosition;
+
+    // Frames finished after the last commit record: each one whole, right
+    // where the writer would have put it
+    while (FrameIntact(nextSequence, true)) {
+        const IndexEntry* entry = Entry(nextSequence);
+        const uint64_t length = AlignUp(kTagBytes + entry->size, kFrameAlignment);
+        uint64_t expected = writePosition;
+        if (expected % dataBytes + length > dataBytes) {
+            expected += dataBytes - expected % dataBytes;
+        }
+        if (entry->position != expected) {
+            break;
+        }
+        writePosition = expected + length;
+        ++nextSequence;
+        ++recovery.rolledForward;
+    }
+    if (nextSequence - firstSequence > indexEntries) {
+        firstSequence = nextSequence - indexEntries;
+    }
+
+    // Keep what is intact. A frame lost to a power loss, or overwritten by
+    // one rolled forward, is cleared so the index never names it again.
+    for (uint64_t sequence = firstSequence; sequence < nextSequence; ++sequence) {
+        IndexEntry* entry = Entry(sequence);
+        const bool inRing = entry->position + dataBytes >= writePosition;
+        if (inRing && FrameIntact(sequence, true)) {
+            ++recovery.framesRecovered;
+        }
+        else {
+            if (entry->sequence == sequence) {
+                entry->sequence = 0;
+            }
+            ++recovery.framesDiscarded;
+        }
+    }
+    while (firstSequence < nextSequence && Entry(firstSequence)->sequence != firstSequence) {
+        ++firstSequence;
+    }
+    Commit();
+    Sync(true);
+}
+
+void FrameRingFile::Sync(bool wait) {
+    if (!IsOpen()) {
+        return;
+    }
+    lastSync = MonotonicNanos();
+#if defined(_WIN32)
+    // Queues the dirty pages for writing; only FlushFileBuffers() waits
+    FlushViewOfFile(base, 0);
+    if (wait) {
+        FlushFileBuffers(file);
+    }
+#elif defined(__linux__)
+    if (wait) {
+        msync(base, mappedBytes, MS_SYNC);
+    }
+    else {
+        // msync(MS_ASYNC) does nothing on Linux; this starts the writeback
+        sync_file_range(file, 0, 0, SYNC_FILE_RANGE_WRITE);
+    }
+#else
+    msync(base, mappedBytes, wait ? MS_SYNC : MS_ASYNC);
+#endif
+}
+
+bool FrameRingFile::Map(const std::filesystem::path& path, uint64_t size, bool create) {
+#if defined(_WIN32)
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("FrameRing", "Cannot open %s: %lu", path.string().c_str(), GetLastError());
+        return false;
+    }
+    file = handle;
+    if (create) {
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) || !SetEndOfFile(handle)) {
+            LOG_ERROR("FrameRing", "Cannot size %s: %lu", path.string().c_str(), GetLastError());
+            Unmap();
+            return false;
+        }
+    }
+    mapping = CreateFileMappingW(handle, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+    if (mapping) {
+        base = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+    }
+    if (!base) {
+        LOG_ERROR("FrameRing", "Cannot map %s: %lu", path.string().c_str(), GetLastError());
+        Unmap();
+        return false;
+    }
+#else
+    file = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0), 0644);
+    if (file < 0) {
+        LOG_ERROR("FrameRing", "Cannot open %s: %d", path.string().c_str(), errno);
+        return false;
+    }
+    // Reserve the disk space now, so a full disk shows up here rather than
+    // as a fault in the middle of a frame copy.
+    if (create && posix_fallocate(file, 0, static_cast<off_t>(size)) != 0 && ftruncate(file, static_cast<off_t>(size)) != 0) {
+        LOG_ERROR("FrameRing", "Cannot size %s: %d", path.string().c_str(), errno);
+        Unmap();
+        return false;
+    }
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+        LOG_ERROR("FrameRing", "Cannot map %s: %d", path.string().c_str(), errno);
+        Unmap();
+        return false;
+    }
+    base = static_cast<uint8_t*>(view);
+#endif
+    mappedBytes = size;
+    return true;
+}
+
+void FrameRingFile::Unmap() {
+#if defined(_WIN32)
+    if (base) {
+        UnmapViewOfFile(base);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file) {
+        CloseHandle(file);
+        file = nullptr;
+    }
+#else
+    if (base) {
+        munmap(base, mappedBytes);
+    }
+    if (file >= 0) {
+        close(file);
+        file = -1;
+    }
+#endif
+    base = nullptr;
+    mappedBytes = 0;
+}
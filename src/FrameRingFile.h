@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include "VideoFrame.h"
+
+struct FrameRingOptions {
+    uint64_t dataBytes = 1ull << 30;  // Frame storage; at 30 MB/s, 1 GiB keeps about 35 s
+    uint32_t indexEntries = 65536;    // Most frames held at once, whatever their size
+    double syncSeconds = 1.0;         // Start writing dirty pages back this often; 0 to leave it to the OS
+    bool checksumFrames = true;       // Lets recovery after a power loss reject torn frames
+};
+
+// What Open() found in an existing ring file.
+struct FrameRingRecovery {
+    uint64_t framesRecovered = 0;
+    uint64_t framesDiscarded = 0;  // Indexed but damaged or partly overwritten
+    uint64_t rolledForward = 0;    // Complete frames written after the last commit
+};
+
+// A frame held in the ring. 'data' points into the mapping and stays valid
+// until the frame is overwritten or the file closed.
+struct FrameRingEntry {
+    uint64_t sequence = 0;
+    VideoFormat format;
+    double sampleTime = 0.0;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// A fixed-size, memory-mapped file holding the most recent frames, as a
+// DVR buffer: the oldest frames are overwritten as new ones arrive, and
+// what it holds survives the process crashing or the machine losing power.
+//
+// Layout:
+//   header   4 KiB: geometry, then two commit records in separate sectors
+//   index    indexEntries x 64 bytes: per frame its sequence number, ring
+//            position, size, layout, sample time and checksums
+//   data     dataBytes of ring storage; each frame is a 16-byte tag (its
+//            sequence number) and the frame bytes, at 64-byte alignment
+//
+// Append() is a memcpy into the mapping, the index entry and then a commit
+// record naming the frames held; the two commit records alternate, so one
+// is always whole. Dirty pages are written back asynchronously every
+// syncSeconds, never waited for. After a crash the OS still has every page,
+// so Open() gets back every committed frame and rolls forward the complete
+// ones written since. After a power loss pages may reach the disk in any
+// order; the checksums and tags let Open() keep exactly the frames that are
+// intact.
+//
+// Append() copies and checksums on the calling thread, a few milliseconds
+// for a large raw frame while pages fault in on the first lap, so feed it
+// from a subscriber thread rather than the capture callback. Not
+// thread-safe: Append() and the readers belong to one thread.
+class FrameRingFile {
+public:
+    static constexpr size_t kHeaderBytes = 4096;
+    static constexpr size_t kIndexEntryBytes = 64;
+    static constexpr size_t kFrameAlignment = 64;
+
+    FrameRingFile() = default;
+    ~FrameRingFile() { Close(); }
+
+    FrameRingFile(const FrameRingFile&) = delete;
+    FrameRingFile& operator=(const FrameRingFile&) = delete;
+
+    // Create an empty ring, replacing any file at 'path'. The file gets its
+    // full size and disk space up front.
+    bool Create(const std::filesystem::path& path, const FrameRingOptions& options);
+
+    // Map an existing ring and recover its frames; Append() continues after
+    // them. 'options' supplies syncSeconds; the geometry comes from the file.
+    bool Open(const std::filesystem::path& path, const FrameRingOptions& options = FrameRingOptions());
+
+    // Write back everything and unmap.
+    void Close();
+
+    bool IsOpen() const { return base != nullptr; }
+
+    // Store a frame, overwriting the oldest ones to make room. Returns false
+    // for a frame larger than half the ring.
+    bool Append(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime);
+
+    // Sequence numbers of the frames held are FirstSequence() up to, not
+    // including, NextSequence(); frames discarded by recovery leave gaps.
+    uint64_t FirstSequence() const { return firstSequence; }
+    uint64_t NextSequence() const { return nextSequence; }
+
+    // Look up a frame. Returns false if it was overwritten or discarded.
+    bool GetFrame(uint64_t sequence, FrameRingEntry* entry) const;
+
+    // Start writing dirty pages back; with 'wait', return once they are on
+    // the disk.
+    void Sync(bool wait);
+
+    const FrameRingRecovery& Recovery() const { return recovery; }
+    uint64_t DataBytes() const { return dataBytes; }
+
+private:
+    struct IndexEntry;
+
+    bool Map(const std::filesystem::path& path, uint64_t size, bool create);
+    void Unmap();
+    IndexEntry* Entry(uint64_t sequence) const;
+    uint8_t* DataAt(uint64_t position) const;
+    bool FrameIntact(uint64_t sequence, bool checkData) const;
+    void Commit();
+    void Recover();
+
+    uint8_t* base = nullptr;
+    uint64_t mappedBytes = 0;
+#if defined(_WIN32)
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int file = -1;
+#endif
+
+    FrameRingOptions options;
+    uint64_t dataBytes = 0;
+    uint32_t indexEntries = 0;
+    uint64_t indexOffset = 0;
+    uint64_t dataOffset = 0;
+    bool checksums = true;
+
+    uint64_t generation = 0;     // Of the last commit record written
+    uint64_t firstSequence = 1;
+    uint64_t nextSequence = 1;
+    uint64_t writePosition = 0;  // Ring position of the next frame, counting every byte ever written
+    int64_t lastSync = 0;
+    FrameRingRecovery recovery;
+};
@@ -1,4 +1,6 @@
 #include "ImGuiModaler.h"
+#include <stdexcept>
+#include "Log.h"
 
 // Static members initialization
 std::queue<std::unique_ptr<ImGuiModaler>> ImGuiModaler::modalQueue;
@@ -12,33 +14,33 @@ ImGuiModaler::ImGuiModaler(const std::string& id, std::function<void()> contentF
     if (!this->contentFunc) {
         throw std::invalid_argument("Content function cannot be null");
     }
-    std::cerr << "[ImGuiModaler] Created modal with ID: " << id << std::endl;
+    LOG_DEBUG("ImGuiModaler", "Created modal with ID: %s", id);
 }
 
 void ImGuiModaler::ShowModal(std::unique_ptr<ImGuiModaler> modal) {
-    std::cerr << "[ImGuiModaler] ShowModal called for ID: " << modal->id << std::endl;
+    LOG_DEBUG("ImGuiModaler", "ShowModal called for ID: %s", modal->id);
 
     if (activeModal && activeModal->isOpen.load()) {
-        std::cerr << "[ImGuiModaler] Another modal is active, adding to queue: " << modal->id << std::endl;
+        LOG_DEBUG("ImGuiModaler", "Another modal is active, adding to queue: %s", modal->id);
         modalQueue.push(std::move(modal));
     }
     else {
-        std::cerr << "[ImGuiModaler] No active modal, displaying: " << modal->id << std::endl;
+        LOG_DEBUG("ImGuiModaler", "No active modal, displaying: %s", modal->id);
         activeModal = std::move(modal);
         activeModal->isOpen.store(true);  // Set the modal as open
     }
 }
 
 void ImGuiModaler::CloseCurrentModal() {
-    std::cerr << "[ImGuiModaler] CloseCurrentModal called" << std::endl;
+    LOG_DEBUG("ImGuiModaler", "CloseCurrentModal called");
 
     if (!activeModal) {
-        std::cerr << "[ImGuiModaler] No active modal to close" << std::endl;
+        LOG_DEBUG("ImGuiModaler", "No active modal to close");
         return;
     }
 
     if (activeModal->isOpen.load()) {
-        std::cerr << "[ImGuiModaler] Closing modal with ID: " << activeModal->id << std::endl;
+        LOG_DEBUG("ImGuiModaler", "Closing modal with ID: %s", activeModal->id);
         activeModal->isOpen.store(false);  // Set the modal as closed
         activeModal.reset();  // Destroy the current modal
 
@@ -46,26 +48,26 @@ void ImGuiModaler::CloseCurrentModal() {
         if (!modalQueue.empty()) {
             activeModal = std::move(modalQueue.front());
             modalQueue.pop();
-            std::cerr << "[ImGuiModaler] Opening next modal from queue with ID: " << activeModal->id << std::endl;
+            LOG_DEBUG("ImGuiModaler", "Opening next modal from queue with ID: %s", activeModal->id);
             activeModal->isOpen.store(true);  // Open the next modal
         }
         else {
-            std::cerr << "[ImGuiModaler] No more modals in the queue." << std::endl;
+            LOG_DEBUG("ImGuiModaler", "No more modals in the queue.");
             activeModal = nullptr;
         }
     }
     else {
-        std::cerr << "[ImGuiModaler] Modal was already closed." << std::endl;
+        LOG_DEBUG("ImGuiModaler", "Modal was already closed.");
     }
 }
 
 void ImGuiModaler::RenderActiveModal() {
     if (!activeModal || !activeModal->isOpen.load()) {
-        std::cerr << "[ImGuiModaler] No active modal to render" << std::endl;
+        LOG_TRACE("ImGuiModaler", "No active modal to render");
         return;
     }
 
-    std::cerr << "[ImGuiModaler] Rendering active modal with ID: " << activeModal->id << std::endl;
+    LOG_TRACE("ImGuiModaler", "Rendering active modal with ID: %s", activeModal->id);
     if (activeModal->backdropEnabled) {
         activeModal->RenderBackdrop();
     }
@@ -73,13 +75,13 @@ void ImGuiModaler::RenderActiveModal() {
 }
 
 void ImGuiModaler::SetBackdrop(bool enabled, float alpha) {
-    std::cerr << "[ImGuiModaler] SetBackdrop called for ID: " << id << std::endl;
+    LOG_DEBUG("ImGuiModaler", "SetBackdrop called for ID: %s", id);
     backdropEnabled = enabled;
     backdropAlpha = alpha;
 }
 
 void ImGuiModaler::RenderBackdrop() {
-    std::cerr << "[ImGuiModaler] Rendering backdrop for modal with ID: " << id << std::endl;
+    LOG_TRACE("ImGuiModaler", "Rendering backdrop for modal with ID: %s", id);
     ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
     ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize, ImGuiCond_Always);
 
@@ -95,7 +97,7 @@ void ImGuiModaler::RenderBackdrop() {
 }
 
 void ImGuiModaler::RenderModal() {
-    std::cerr << "[ImGuiModaler] Rendering modal with ID: " << id << std::endl;
+    LOG_TRACE("ImGuiModaler", "Rendering modal with ID: %s", id);
 
     ImVec2 windowSize(400, 300);
     ImGui::SetNextWindowPos(ImVec2((ImGui::GetIO().DisplaySize.x - windowSize.x) * 0.5f, (ImGui::GetIO().DisplaySize.y - windowSize.y) * 0.5f), ImGuiCond_Always);
@@ -111,7 +113,7 @@ void ImGuiModaler::RenderModal() {
         ImGui::SetWindowFocus();
 
         if (ImGui::Button("Close")) {
-            std::cerr << "[ImGuiModaler] Close button clicked for modal with ID: " << id << std::endl;
+            LOG_DEBUG("ImGuiModaler", "Close button clicked for modal with ID: %s", id);
             CloseCurrentModal();  // Close modal safely
         }
         ImGui::End();
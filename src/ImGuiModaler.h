@@ -6,7 +6,6 @@
 #include <functional>
 #include <string>
 #include <atomic>
-#include <iostream>
 #include "imgui.h"
 
 class ImGuiModaler {
@@ -0,0 +1,131 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <bit>
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+        return static_cast<size_t>(value);  // Exact below 32 ns
+    }
+    // Keep the leading one and the kSubBucketBits bits after it.
+    const int shift = std::bit_width(value) - (kSubBucketBits + 1);
+    const size_t mantissa = static_cast<size_t>(value >> shift) - kSubBuckets;
+    return kSubBuckets + static_cast<size_t>(shift) * kSubBuckets + mantissa;
+}
+
+uint64_t LatencyHistogram::BucketLowest(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const size_t shift = (index - kSubBuckets) / kSubBuckets;
+    const uint64_t mantissa = kSubBuckets + (index - kSubBuckets) % kSubBuckets;
+    return mantissa << shift;
+}
+
+uint64_t LatencyHistogram::BucketWidth(size_t index) {
+    if (index < kSubBuckets) {
+        return 1;
+    }
+    return uint64_t(1) << ((index - kSubBuckets) / kSubBuckets);
+}
+
+void LatencyHistogram::Record(int64_t nanoseconds) {
+    const uint64_t largest = (uint64_t(1) << kMaxValueBits) - 1;
+    const uint64_t value = std::min<uint64_t>(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0, largest);
+
+    // Single writer, so no read-modify-write is needed.
+    std::atomic<uint64_t>& bucket = buckets[BucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if (value < minimum.load(std::memory_order_relaxed)) {
+        minimum.store(value, std::memory_order_relaxed);
+    }
+    if (value > maximum.load(std::memory_order_relaxed)) {
+        maximum.store(value, std::memory_order_relaxed);
+    }
+}
+
+double LatencyHistogram::Percentile(const uint64_t* counts, uint64_t total, double percentile) const {
+    if (total == 0) {
+        return 0.0;
+    }
+    // Rank of the value we want, 1-based
+    const double clamped = std::clamp(percentile, 0.0, 100.0);
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * total + 0.5));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // Middle of the bucket, kept within what was actually recorded
+            const double middle = BucketLowest(i) + (BucketWidth(i) - 1) / 2.0;
+            const double lowest = static_cast<double>(minimum.load(std::memory_order_relaxed));
+            const double highest = static_cast<double>(maximum.load(std::memory_order_relaxed));
+            return std::clamp(middle, std::min(lowest, highest), highest);
+        }
+    }
+    return static_cast<double>(maximum.load(std::memory_order_relaxed));
+}
+
+double LatencyHistogram::Percentile(double percentile) const {
+    uint64_t counts[kBucketCount];
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    return Percentile(counts, total, percentile);
+}
+
+uint64_t LatencyHistogram::CumulativeCounts(const uint64_t* bounds, size_t boundCount, uint64_t* counts) const {
+    uint64_t total = 0;
+    size_t bound = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        // Close every bound below this bucket before counting it
+        while (bound < boundCount && BucketLowest(i) > bounds[bound]) {
+            counts[bound++] = total;
+        }
+        total += buckets[i].load(std::memory_order_relaxed);
+    }
+    while (bound < boundCount) {
+        counts[bound++] = total;
+    }
+    return total;
+}
+
+LatencySummary LatencyHistogram::Summarize() const {
+    // One copy of the buckets, so the percentiles agree with each other even
+    // while values are being recorded. On the stack, so the performance panel
+    // can summarize without allocating.
+    uint64_t counts[kBucketCount];
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    LatencySummary summary;
+    summary.count = total;
+    if (total == 0) {
+        return summary;
+    }
+    const double toMicroseconds = 1e-3;
+    summary.min = minimum.load(std::memory_order_relaxed) * toMicroseconds;
+    summary.max = maximum.load(std::memory_order_relaxed) * toMicroseconds;
+    summary.mean = static_cast<double>(sum.load(std::memory_order_relaxed)) / total * toMicroseconds;
+    summary.p50 = Percentile(counts, total, 50.0) * toMicroseconds;
+    summary.p90 = Percentile(counts, total, 90.0) * toMicroseconds;
+    summary.p99 = Percentile(counts, total, 99.0) * toMicroseconds;
+    summary.p999 = Percentile(counts, total, 99.9) * toMicroseconds;
+    return summary;
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    minimum.store(UINT64_MAX, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Percentiles of a LatencyHistogram, in microseconds.
+struct LatencySummary {
+    uint64_t count = 0;
+    double min = 0.0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+    double max = 0.0;
+};
+
+// Lock-free histogram of durations in nanoseconds with log-linear buckets in
+// the style of HdrHistogram: every power of two is split into 32 buckets, so
+// a recorded value is off by at most 1/32 (about 3%) from the one reported,
+// from a nanosecond up to about 18 minutes.
+//
+// Each histogram has a single writer: Record() must always be called from the
+// same thread (or under the caller's lock). That lets it use plain relaxed
+// loads and stores instead of locked read-modify-write instructions, which
+// keeps it to a few nanoseconds. Readers on other threads never block it.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxValueBits = 40;
+    static constexpr size_t kBucketCount = kSubBuckets + (kMaxValueBits - kSubBucketBits) * kSubBuckets;
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    // Negative values count as zero; values past the range as the largest.
+    void Record(int64_t nanoseconds);
+
+    uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+
+    // Total of the recorded values, in nanoseconds.
+    uint64_t Sum() const { return sum.load(std::memory_order_relaxed); }
+
+    // How many values fall at or below each of 'boundCount' ascending
+    // 'bounds' (nanoseconds), from one copy of the buckets, as cumulative
+    // Prometheus buckets want them. A bucket counts in full once its lowest
+    // value is within a bound. Returns the total over all buckets.
+    uint64_t CumulativeCounts(const uint64_t* bounds, size_t boundCount, uint64_t* counts) const;
+
+    // Value below which 'percentile' percent of the recorded values fall, in
+    // nanoseconds. Zero when nothing was recorded.
+    double Percentile(double percentile) const;
+
+    LatencySummary Summarize() const;
+
+    // Meant for the writer's thread. From another thread, concurrent
+    // Record() calls may survive the reset or be lost.
+    void Reset();
+
+    static size_t BucketIndex(uint64_t value);
+    static uint64_t BucketLowest(size_t index);
+    static uint64_t BucketWidth(size_t index);
+
+private:
+    // Percentile over a copy of the buckets taken by the caller
+    double Percentile(const uint64_t* buckets, uint64_t total, double percentile) const;
+
+    std::atomic<uint64_t> buckets[kBucketCount] = {};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> sum{ 0 };
+    std::atomic<uint64_t> minimum{ UINT64_MAX };
+    std::atomic<uint64_t> maximum{ 0 };
+};
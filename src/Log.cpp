@@ -0,0 +1,418 @@
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FrameLatency.h"
+
+// Messages each thread can have waiting for the sink. A power of two.
+static const uint64_t kLogQueueCapacity = 512;
+
+// How often the sink looks for messages when nobody wakes it
+static const auto kLogSinkInterval = std::chrono::milliseconds(20);
+
+struct LogRecord {
+    const LogSite* site;
+    const char* format;
+    int64_t time;
+    uint32_t threadId;
+    uint32_t suppressed;
+    size_t argSize;
+    uint8_t args[LogArgs::kCapacity];
+};
+
+// Single producer (the owning thread), single consumer (the sink).
+struct LogQueue {
+    uint32_t threadId = 0;
+    std::atomic<bool> owned{ true };  // False once the thread has exited
+    alignas(64) std::atomic<uint64_t> head{ 0 };  // Written by the thread
+    alignas(64) std::atomic<uint64_t> tail{ 0 };  // Written by the sink
+    std::unique_ptr<LogRecord[]> records = std::make_unique<LogRecord[]>(kLogQueueCapacity);
+};
+
+struct LogState {
+    std::mutex mutex;  // Guards queues, and the sink's flags below
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<std::unique_ptr<LogQueue>> queues;
+    uint32_t nextThreadId = 1;
+
+    std::thread sink;
+    bool stopping = false;
+    bool stopped = false;
+    uint64_t flushRequested = 0;
+    uint64_t flushCompleted = 0;
+
+    std::atomic<FILE*> output{ stderr };
+    std::atomic<uint32_t> siteBurst{ kLogSiteBurst };
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> suppressed{ 0 };
+    const int64_t startTime = MonotonicNanos();
+
+    ~LogState() { LogShutdown(); }
+};
+
+static LogState& State() {
+    static LogState state;
+    return state;
+}
+
+const char* LogLevelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace: return "TRACE";
+    case LogLevel::Debug: return "DEBUG";
+    case LogLevel::Info: return "INFO";
+    case LogLevel::Warning: return "WARN";
+    case LogLevel::Error: return "ERROR";
+    default: return "?";
+    }
+}
+
+void LogArgs::Add(std::string_view value) {
+    // Room for the type and length bytes, and at least one character
+    if (size + 3 > kCapacity) {
+        return;
+    }
+    const size_t length = std::min({ value.size(), kCapacity - size - 2, size_t(255) });
+    data[size] = static_cast<uint8_t>(LogArgType::String);
+    data[size + 1] = static_cast<uint8_t>(length);
+    memcpy(data + size + 2, value.data(), length);
+    size += 2 + length;
+}
+
+// Formats 'format' with the arguments in 'data', one printf conversion at a
+// time. Each conversion is adapted to the type actually recorded, so a
+// mismatched format prints something sensible instead of garbage.
+static void FormatLogMessage(std::string& out, const char* format, const uint8_t* data, size_t size) {
+    size_t offset = 0;
+    char spec[32];
+    char text[256];
+    std::string scratch;
+
+    const auto append = [&out](const char* spec, auto value) {
+        char buffer[256];
+        const int length = snprintf(buffer, sizeof(buffer), spec, value);
+        if (length < 0) {
+            return;
+        }
+        if (static_cast<size_t>(length) < sizeof(buffer)) {
+            out.append(buffer, length);
+            return;
+        }
+        const size_t start = out.size();
+        out.resize(start + length + 1);
+        snprintf(&out[start], length + 1, spec, value);
+        out.resize(start + length);
+    };
+
+    for (const char* c = format; *c; ++c) {
+        if (*c != '%') {
+            out += *c;
+            continue;
+        }
+        if (c[1] == '%') {
+            out += '%';
+            ++c;
+            continue;
+        }
+
+        // Flags, width and precision are kept; length modifiers are replaced
+        // to suit the recorded type.
+        size_t specLength = 0;
+        spec[specLength++] = '%';
+        ++c;
+        while (*c && strchr("-+ #0123456789.", *c) && specLength < sizeof(spec) - 4) {
+            spec[specLength++] = *c++;
+        }
+        while (*c && strchr("hljztL", *c)) {
+            ++c;
+        }
+        if (!*c) {
+            break;
+        }
+        const char conversion = *c;
+        const bool wantsFloat = strchr("fFeEgGaA", conversion) != nullptr;
+        const bool wantsInteger = strchr("diouxXc", conversion) != nullptr;
+
+        if (offset >= size) {
+            out += '?';
+            continue;
+        }
+        const LogArgType type = static_cast<LogArgType>(data[offset++]);
+        const auto finish = [&](const char* suffix) {
+            memcpy(spec + specLength, suffix, strlen(suffix) + 1);
+            return spec;
+        };
+        switch (type) {
+        case LogArgType::Int:
+        case LogArgType::UInt: {
+            int64_t bits;
+            memcpy(&bits, data + offset, sizeof(bits));
+            offset += sizeof(bits);
+            const bool isSigned = type == LogArgType::Int;
+            if (wantsFloat) {
+                const char suffix[2] = { conversion, 0 };
+                append(finish(suffix), isSigned ? static_cast<double>(bits) : static_cast<double>(static_cast<uint64_t>(bits)));
+            }
+            else if (conversion == 'c') {
+                append(finish("c"), static_cast<int>(bits));
+            }
+            else if (wantsInteger && conversion != 'd' && conversion != 'i') {
+                const char suffix[4] = { 'l', 'l', conversion, 0 };
+                append(finish(suffix), static_cast<unsigned long long>(bits));
+            }
+            else if (isSigned) {
+                append(finish("lld"), static_cast<long long>(bits));
+            }
+            else {
+                append(finish("llu"), static_cast<unsigned long long>(bits));
+            }
+            break;
+        }
+        case LogArgType::Double: {
+            double value;
+            memcpy(&value, data + offset, sizeof(value));
+            offset += sizeof(value);
+            if (wantsInteger) {
+                append(finish("lld"), static_cast<long long>(value));
+            }
+            else {
+                const char suffix[2] = { wantsFloat ? conversion : 'g', 0 };
+                append(finish(suffix), value);
+            }
+            break;
+        }
+        case LogArgType::String: {
+            const size_t length = data[offset++];
+            scratch.assign(reinterpret_cast<const char*>(data + offset), length);
+            offset += length;
+            append(finish("s"), scratch.c_str());
+            break;
+        }
+        case LogArgType::Pointer: {
+            const void* value;
+            memcpy(&value, data + offset, sizeof(value));
+            offset += sizeof(value);
+            snprintf(text, sizeof(text), "%p", value);
+            out += text;
+            break;
+        }
+        default:
+            offset = size;  // Corrupt; stop reading arguments
+            out += '?';
+            break;
+        }
+    }
+}
+
+static void FormatLogRecord(std::string& out, const LogRecord& record, int64_t startTime) {
+    char prefix[96];
+    snprintf(prefix, sizeof(prefix), "%10.6f %-5s %2u [%s] ", (record.time - startTime) / 1e9,
+        LogLevelName(record.site->level), record.threadId, record.site->tag);
+    out += prefix;
+    FormatLogMessage(out, record.format, record.args, record.argSize);
+    if (record.suppressed) {
+        snprintf(prefix, sizeof(prefix), " (%u similar messages suppressed)", record.suppressed);
+        out += prefix;
+    }
+    out += '\n';
+}
+
+// Moves everything queued so far into 'batch', oldest first.
+static void CollectLogRecords(LogState& state, std::vector<LogRecord>& batch) {
+    batch.clear();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (const std::unique_ptr<LogQueue>& queue : state.queues) {
+        const uint64_t tail = queue->tail.load(std::memory_order_relaxed);
+        const uint64_t head = queue->head.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; ++i) {
+            batch.push_back(queue->records[i & (kLogQueueCapacity - 1)]);
+        }
+        queue->tail.store(head, std::memory_order_release);
+    }
+    // Queues are in order per thread; interleave the threads by time.
+    std::stable_sort(batch.begin(), batch.end(), [](const LogRecord& a, const LogRecord& b) { return a.time < b.time; });
+}
+
+static void RunLogSink(LogState& state) {
+    std::vector<LogRecord> batch;
+    std::string text;
+    uint64_t reportedDrops = 0;
+    for (;;) {
+        uint64_t flushTarget;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.wake.wait_for(lock, kLogSinkInterval,
+                [&state] { return state.stopping || state.flushRequested != state.flushCompleted; });
+            flushTarget = state.flushRequested;
+            stopping = state.stopping;
+        }
+
+        CollectLogRecords(state, batch);
+        text.clear();
+        for (const LogRecord& record : batch) {
+            FormatLogRecord(text, record, state.startTime);
+        }
+        const uint64_t dropped = state.dropped.load(std::memory_order_relaxed);
+        if (dropped != reportedDrops) {
+            char line[96];
+            snprintf(line, sizeof(line), "%10.6f WARN      [Log] %llu messages dropped, queue full\n",
+                (MonotonicNanos() - state.startTime) / 1e9, static_cast<unsigned long long>(dropped - reportedDrops));
+            text += line;
+            reportedDrops = dropped;
+        }
+        if (!text.empty()) {
+            FILE* output = state.output.load(std::memory_order_relaxed);
+            fwrite(text.data(), 1, text.size(), output);
+            fflush(output);
+            state.written.fetch_add(batch.size(), std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.flushCompleted = flushTarget;
+        }
+        state.flushed.notify_all();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+static LogQueue* AcquireLogQueue() {
+    LogState& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.sink.joinable() && !state.stopped) {
+        state.sink = std::thread(RunLogSink, std::ref(state));
+    }
+    for (const std::unique_ptr<LogQueue>& queue : state.queues) {
+        // An exited thread's queue is reused once the sink has emptied it.
+        if (!queue->owned.load(std::memory_order_acquire) &&
+            queue->tail.load(std::memory_order_relaxed) == queue->head.load(std::memory_order_relaxed)) {
+            queue->threadId = state.nextThreadId++;
+            queue->owned.store(true, std::memory_order_relaxed);
+            return queue.get();
+        }
+    }
+    state.queues.push_back(std::make_unique<LogQueue>());
+    state.queues.back()->threadId = state.nextThreadId++;
+    return state.queues.back().get();
+}
+
+// Gives the thread's queue back when the thread exits
+struct LogThreadHandle {
+    LogQueue* queue = nullptr;
+
+    ~LogThreadHandle() {
+        if (queue) {
+            queue->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local LogThreadHandle logThread;
+
+bool LogAllow(LogSite& site, int64_t* time, uint32_t* suppressed) {
+    const int64_t now = MonotonicNanos();
+    const uint32_t burst = State().siteBurst.load(std::memory_order_relaxed);
+    if (burst == 0) {
+        *time = now;
+        *suppressed = 0;
+        return true;
+    }
+    int64_t windowStart = site.windowStart.load(std::memory_order_relaxed);
+    if (now - windowStart >= 1000000000) {
+        // One thread wins the new window; a message or two may land in the
+        // old one, which is fine for a rate limit.
+        if (site.windowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+            site.inWindow.store(0, std::memory_order_relaxed);
+        }
+    }
+    if (site.inWindow.fetch_add(1, std::memory_order_relaxed) >= burst) {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        State().suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    *time = now;
+    *suppressed = site.suppressed.load(std::memory_order_relaxed) ? site.suppressed.exchange(0, std::memory_order_relaxed) : 0;
+    return true;
+}
+
+void LogSubmit(const LogSite& site, const char* format, int64_t time, uint32_t suppressed, const LogArgs& args) {
+    if (!logThread.queue) {
+        logThread.queue = AcquireLogQueue();
+    }
+    LogQueue& queue = *logThread.queue;
+    LogState& state = State();
+
+    const uint64_t head = queue.head.load(std::memory_order_relaxed);
+    const uint64_t queued = head - queue.tail.load(std::memory_order_acquire);
+    if (queued >= kLogQueueCapacity) {
+        state.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogRecord& record = queue.records[head & (kLogQueueCapacity - 1)];
+    record.site = &site;
+    record.format = format;
+    record.time = time;
+    record.threadId = queue.threadId;
+    record.suppressed = suppressed;
+    record.argSize = args.Size();
+    memcpy(record.args, args.Data(), args.Size());
+    queue.head.store(head + 1, std::memory_order_release);
+
+    if (site.level >= LogLevel::Error || queued == kLogQueueCapacity / 2) {
+        // Errors go out now rather than on the sink's next round, and so
+        // does a burst that would otherwise fill the queue.
+        state.wake.notify_one();
+    }
+}
+
+void LogSetOutput(FILE* stream) {
+    LogFlush();
+    State().output.store(stream ? stream : stderr, std::memory_order_relaxed);
+}
+
+void LogSetRateLimit(uint32_t perSite) {
+    State().siteBurst.store(perSite, std::memory_order_relaxed);
+}
+
+void LogFlush() {
+    LogState& state = State();
+    std::unique_lock<std::mutex> lock(state.mutex);
+    if (!state.sink.joinable()) {
+        return;
+    }
+    const uint64_t target = ++state.flushRequested;
+    state.wake.notify_one();
+    state.flushed.wait(lock, [&state, target] { return state.flushCompleted >= target || state.stopped; });
+}
+
+void LogShutdown() {
+    LogState& state = State();
+    std::thread sink;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stopping = true;
+        state.stopped = true;
+        sink = std::move(state.sink);
+    }
+    state.wake.notify_one();
+    if (sink.joinable()) {
+        sink.join();  // The sink writes out what is queued before it returns.
+    }
+}
+
+LogStats GetLogStats() {
+    LogState& state = State();
+    LogStats stats;
+    stats.written = state.written.load(std::memory_order_relaxed);
+    stats.dropped = state.dropped.load(std::memory_order_relaxed);
+    stats.suppressed = state.suppressed.load(std::memory_order_relaxed);
+    return stats;
+}
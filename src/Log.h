@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logging. A log call copies its arguments in binary form into
+// a lock-free queue owned by the calling thread and returns; a background
+// thread formats the messages and writes them out. Nothing on the calling
+// thread formats text, takes a lock or touches the console.
+//
+//   LOG_INFO("Camera", "Opened %s in %.0f ms", name, ms);
+//
+// The format string must be a string literal, with printf conversions.
+// Arguments may be integers, enums, floating point values, pointers, C
+// strings and std::string/std::string_view; strings are copied, so
+// temporaries are fine. A message holds about 200 bytes of arguments and is
+// truncated beyond that.
+//
+// Levels below LOG_MIN_LEVEL are compiled out, arguments included. Each call
+// site logs at most kLogSiteBurst messages per second (see LogSetRateLimit()); the next message that
+// gets through says how many were suppressed. If a thread's queue is full the
+// message is dropped and counted rather than waiting.
+
+enum class LogLevel : uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off,
+};
+
+#ifndef LOG_MIN_LEVEL
+#if defined(NDEBUG)
+#define LOG_MIN_LEVEL Info
+#else
+#define LOG_MIN_LEVEL Debug
+#endif
+#endif
+
+constexpr LogLevel kLogMinLevel = LogLevel::LOG_MIN_LEVEL;
+constexpr uint32_t kLogSiteBurst = 20;  // Default messages per second per site
+
+const char* LogLevelName(LogLevel level);
+
+// One LOG_* statement: its level, tag and rate limit state.
+struct LogSite {
+    LogLevel level;
+    const char* tag;
+
+    std::atomic<int64_t> windowStart{ 0 };
+    std::atomic<uint32_t> inWindow{ 0 };
+    std::atomic<uint32_t> suppressed{ 0 };
+
+    LogSite(LogLevel level, const char* tag) : level(level), tag(tag) {}
+};
+
+enum class LogArgType : uint8_t {
+    Int,
+    UInt,
+    Double,
+    String,
+    Pointer,
+};
+
+// Binary encoding of a message's arguments: a type byte followed by the
+// value, or for strings a length byte followed by the characters.
+class LogArgs {
+public:
+    static constexpr size_t kCapacity = 216;
+
+    void Add(int64_t value) { Put(LogArgType::Int, &value, sizeof(value)); }
+    void Add(uint64_t value) { Put(LogArgType::UInt, &value, sizeof(value)); }
+    void Add(double value) { Put(LogArgType::Double, &value, sizeof(value)); }
+    void Add(const void* value) { Put(LogArgType::Pointer, &value, sizeof(value)); }
+    void Add(std::string_view value);
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    void Put(LogArgType type, const void* value, size_t bytes) {
+        if (size + 1 + bytes > kCapacity) {
+            return;  // Truncated; the formatter prints what is missing as "?"
+        }
+        data[size] = static_cast<uint8_t>(type);
+        memcpy(data + size + 1, value, bytes);
+        size += 1 + bytes;
+    }
+
+    uint8_t data[kCapacity];
+    size_t size = 0;
+};
+
+template <typename T>
+void EncodeLogArg(LogArgs& args, const T& value) {
+    using Type = std::decay_t<T>;
+    if constexpr (std::is_same_v<Type, bool>) {
+        args.Add(static_cast<int64_t>(value));
+    }
+    else if constexpr (std::is_enum_v<Type>) {
+        args.Add(static_cast<int64_t>(value));
+    }
+    else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>) {
+        args.Add(static_cast<int64_t>(value));
+    }
+    else if constexpr (std::is_integral_v<Type>) {
+        args.Add(static_cast<uint64_t>(value));
+    }
+    else if constexpr (std::is_floating_point_v<Type>) {
+        args.Add(static_cast<double>(value));
+    }
+    else if constexpr (std::is_same_v<Type, const char*> || std::is_same_v<Type, char*>) {
+        args.Add(std::string_view(value ? value : "(null)"));
+    }
+    else if constexpr (std::is_convertible_v<const Type&, std::string_view>) {
+        args.Add(std::string_view(value));
+    }
+    else {
+        static_assert(std::is_pointer_v<Type>, "Unsupported log argument type");
+        args.Add(static_cast<const void*>(value));
+    }
+}
+
+// String literals and char arrays are never null, so they skip the check
+// above.
+template <size_t N>
+void EncodeLogArg(LogArgs& args, const char (&value)[N]) {
+    args.Add(std::string_view(value));
+}
+
+// Rate limit check for 'site'. Returns false when the message should be
+// suppressed; otherwise sets '*time' to the message's timestamp and
+// '*suppressed' to the number skipped since the last one that got through.
+bool LogAllow(LogSite& site, int64_t* time, uint32_t* suppressed);
+
+// Queue a message on the calling thread's queue.
+void LogSubmit(const LogSite& site, const char* format, int64_t time, uint32_t suppressed, const LogArgs& args);
+
+template <typename... Args>
+void LogWrite(LogSite& site, const char* format, const Args&... values) {
+    int64_t time = 0;
+    uint32_t suppressed = 0;
+    if (!LogAllow(site, &time, &suppressed)) {
+        return;
+    }
+    LogArgs args;
+    (EncodeLogArg(args, values), ...);
+    LogSubmit(site, format, time, suppressed, args);
+}
+
+#define LOG_AT(level, tag, ...)                                 \
+    do {                                                        \
+        if constexpr (LogLevel::level >= kLogMinLevel) {        \
+            static LogSite logSite(LogLevel::level, tag);       \
+            LogWrite(logSite, __VA_ARGS__);                     \
+        }                                                       \
+    } while (0)
+
+#define LOG_TRACE(tag, ...) LOG_AT(Trace, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) LOG_AT(Debug, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...) LOG_AT(Info, tag, __VA_ARGS__)
+#define LOG_WARNING(tag, ...) LOG_AT(Warning, tag, __VA_ARGS__)
+#define LOG_ERROR(tag, ...) LOG_AT(Error, tag, __VA_ARGS__)
+
+// Where formatted messages go; stderr unless changed. The stream must stay
+// open until LogShutdown() or the next LogSetOutput().
+void LogSetOutput(FILE* stream);
+
+// Messages per second allowed from each call site; 0 turns the limit off.
+void LogSetRateLimit(uint32_t perSite);
+
+// Block until every message queued before the call has been written.
+void LogFlush();
+
+// Flush and stop the background thread. Messages logged afterwards are
+// dropped.
+void LogShutdown();
+
+struct LogStats {
+    uint64_t written = 0;     // Messages written out
+    uint64_t dropped = 0;     // Messages lost to a full queue
+    uint64_t suppressed = 0;  // Messages held back by a call site's rate limit
+};
+
+LogStats GetLogStats();
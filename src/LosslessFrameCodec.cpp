@@ -0,0 +1,126 @@
+#include "LosslessFrameCodec.h"
+#include <cstring>
+
+// Stream layout: one byte with the prediction distance, then per group of
+// kGroup residuals a byte with their bit width (0 to 8) and 2 x width bytes
+// of packed values. The last group is padded with zero residuals.
+static const size_t kGroup = 16;
+
+// Bytes between a byte and the one it is predicted from: the same
+// component of the pixel to the left. Planar formats predict each plane
+// from itself; where planes meet the prediction is merely poorer.
+static uint8_t PredictionDistance(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::BGR24:  return 3;
+    case PixelFormat::BGRA32: return 4;
+    case PixelFormat::YUY2:   return 4;  // Y0 U Y1 V: each byte from the macropixel before
+    case PixelFormat::NV12:   return 2;  // Chroma pairs; luma loses little from the distance
+    default:                  return 1;
+    }
+}
+
+static inline uint8_t ZigZag(uint8_t residual) {
+    const int8_t value = static_cast<int8_t>(residual);
+    return static_cast<uint8_t>((value << 1) ^ (value >> 7));
+}
+
+static inline uint8_t UnZigZag(uint8_t coded) {
+    return static_cast<uint8_t>((coded >> 1) ^ (0 - (coded & 1)));
+}
+
+static inline int BitWidth(uint8_t bits) {
+    int width = 0;
+    while (bits) {
+        ++width;
+        bits >>= 1;
+    }
+    return width;
+}
+
+size_t LosslessCompressBound(size_t size) {
+    // Every group may need its full 8 bits; the packing writes 8 bytes at a
+    // time, so a little slack follows the last group.
+    return 1 + (size + kGroup - 1) / kGroup * (1 + kGroup) + 8;
+}
+
+size_t LosslessCompress(PixelFormat format, const uint8_t* data, size_t size, uint8_t* out) {
+    const size_t distance = PredictionDistance(format);
+    uint8_t* const start = out;
+    *out++ = static_cast<uint8_t>(distance);
+
+    uint8_t residuals[kGroup];
+    for (size_t group = 0; group < size; group += kGroup) {
+        const size_t count = size - group < kGroup ? size - group : kGroup;
+        uint8_t all = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const size_t at = group + i;
+            const uint8_t predicted = at >= distance ? data[at - distance] : 0;
+            residuals[i] = ZigZag(static_cast<uint8_t>(data[at] - predicted));
+            all |= residuals[i];
+        }
+        for (size_t i = count; i < kGroup; ++i) {
+            residuals[i] = 0;
+        }
+
+        const int width = BitWidth(all);
+        *out++ = static_cast<uint8_t>(width);
+        if (width == 8) {
+            memcpy(out, residuals, kGroup);
+        }
+        else if (width > 0) {
+            // Two halves of 8 values, each 8 x width bits, at most 56
+            for (size_t half = 0; half < kGroup; half += 8) {
+                uint64_t packed = 0;
+                for (size_t i = 0; i < 8; ++i) {
+                    packed |= static_cast<uint64_t>(residuals[half + i]) << (i * width);
+                }
+                memcpy(out + half / 8 * width, &packed, sizeof(packed));
+            }
+        }
+        out += 2 * width;
+    }
+    return static_cast<size_t>(out - start);
+}
+
+bool LosslessDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t size) {
+    if (inSize < 1 || in[0] == 0) {
+        return false;
+    }
+    const size_t distance = in[0];
+    const uint8_t* const end = in + inSize;
+    ++in;
+
+    uint8_t residuals[kGroup];
+    for (size_t group = 0; group < size; group += kGroup) {
+        if (in >= end || *in > 8 || end - in < 1 + 2 * *in) {
+            return false;
+        }
+        const int width = *in++;
+        if (width == 8) {
+            memcpy(residuals, in, kGroup);
+        }
+        else if (width == 0) {
+            memset(residuals, 0, kGroup);
+        }
+        else {
+            const uint64_t mask = (1u << width) - 1;
+            for (size_t half = 0; half < kGroup; half += 8) {
+                // Reading 8 bytes could run past the stream; copy what is there
+                uint64_t packed = 0;
+                memcpy(&packed, in + half / 8 * width, static_cast<size_t>(width));
+                for (size_t i = 0; i < 8; ++i) {
+                    residuals[half + i] = static_cast<uint8_t>(packed >> (i * width) & mask);
+                }
+            }
+        }
+        in += 2 * width;
+
+        const size_t count = size - group < kGroup ? size - group : kGroup;
+        for (size_t i = 0; i < count; ++i) {
+            const size_t at = group + i;
+            const uint8_t predicted = at >= distance ? out[at - distance] : 0;
+            out[at] = static_cast<uint8_t>(predicted + UnZigZag(residuals[i]));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "PixelConversion.h"
+
+// A fast lossless codec for raw frames kept in memory. Each byte is
+// predicted from the same component of the pixel to its left; the
+// residuals, zigzag-coded so small ones in either direction stay small, are
+// bit-packed in groups of 16 at the width the largest of them needs.
+// Camera noise typically leaves 3 to 5 bits per byte, flat areas none.
+// There is no entropy coding, so both directions run at a few hundred MB/s
+// on one core: a 1080p YUY2 frame takes about 12 ms.
+
+// Largest output LosslessCompress() can produce for 'size' input bytes.
+size_t LosslessCompressBound(size_t size);
+
+// Compress a frame of 'format' into 'out', which must hold
+// LosslessCompressBound(size) bytes. Returns the bytes written.
+size_t LosslessCompress(PixelFormat format, const uint8_t* data, size_t size, uint8_t* out);
+
+// Restore exactly 'size' bytes from 'in'. Returns false if 'in' is not
+// valid LosslessCompress() output of that size.
+bool LosslessDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t size);
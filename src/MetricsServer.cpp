@@ -0,0 +1,316 @@
+#include "MetricsServer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include "Log.h"
+#include "ThreadCpu.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+using SocketLength = int;
+static void CloseSocket(uintptr_t socket) { closesocket(static_cast<SOCKET>(socket)); }
+static int SocketError() { return WSAGetLastError(); }
+static const int kSendFlags = 0;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+using SocketLength = socklen_t;
+static void CloseSocket(uintptr_t socket) { close(static_cast<int>(socket)); }
+static int SocketError() { return errno; }
+static const int kSendFlags = MSG_NOSIGNAL;  // A client that hung up must not raise SIGPIPE
+#endif
+
+// Sockets are kept as uintptr_t so the header needs no socket headers;
+// SOCKET on Windows is a UINT_PTR and INVALID_SOCKET is all ones.
+static const uintptr_t kNoSocket = static_cast<uintptr_t>(-1);
+
+// How long the server thread waits for a connection before checking for
+// Stop(), and how long a client may take to send its request.
+static const int kAcceptPollMs = 200;
+static const int kClientTimeoutMs = 2000;
+static const size_t kMaxRequestBytes = 8192;
+
+static void FormatDouble(char* buffer, size_t size, double value) {
+    if (std::isnan(value)) {
+        snprintf(buffer, size, "NaN");
+    }
+    else if (std::isinf(value)) {
+        snprintf(buffer, size, value > 0 ? "+Inf" : "-Inf");
+    }
+    else {
+        snprintf(buffer, size, "%.9g", value);
+    }
+}
+
+void MetricsWriter::Family(const char* name, const char* type, const char* help) {
+    text += "# HELP ";
+    text += name;
+    text += ' ';
+    text += help;
+    text += "\n# TYPE ";
+    text += name;
+    text += ' ';
+    text += type;
+    text += '\n';
+}
+
+void MetricsWriter::AppendSample(const char* name, const char* suffix, const char* labels, const char* extraLabel, const char* value) {
+    text += name;
+    text += suffix;
+    const bool hasLabels = labels && *labels;
+    if (hasLabels || extraLabel) {
+        text += '{';
+        if (hasLabels) {
+            text += labels;
+        }
+        if (extraLabel) {
+            if (hasLabels) {
+                text += ',';
+            }
+            text += extraLabel;
+        }
+        text += '}';
+    }
+    text += ' ';
+    text += value;
+    text += '\n';
+}
+
+void MetricsWriter::Sample(const char* name, const char* labels, double value) {
+    char buffer[32];
+    FormatDouble(buffer, sizeof(buffer), value);
+    AppendSample(name, "", labels, nullptr, buffer);
+}
+
+void MetricsWriter::Sample(const char* name, const char* labels, uint64_t value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+    AppendSample(name, "", labels, nullptr, buffer);
+}
+
+void MetricsWriter::Counter(const char* name, const char* help, uint64_t value) {
+    Family(name, "counter", help);
+    Sample(name, nullptr, value);
+}
+
+void MetricsWriter::Gauge(const char* name, const char* help, double value) {
+    Family(name, "gauge", help);
+    Sample(name, nullptr, value);
+}
+
+void MetricsWriter::Histogram(const char* name, const char* labels, const LatencyHistogram& histogram) {
+    constexpr size_t kBounds = std::size(kLatencyBoundsSeconds);
+    uint64_t bounds[kBounds];
+    for (size_t i = 0; i < kBounds; ++i) {
+        bounds[i] = static_cast<uint64_t>(kLatencyBoundsSeconds[i] * 1e9);
+    }
+    // _count comes from the same copy of the buckets as the bucket lines, so
+    // the +Inf bucket always matches it.
+    uint64_t counts[kBounds];
+    const uint64_t total = histogram.CumulativeCounts(bounds, kBounds, counts);
+
+    char value[32];
+    char le[48];
+    for (size_t i = 0; i < kBounds; ++i) {
+        char bound[24];
+        FormatDouble(bound, sizeof(bound), kLatencyBoundsSeconds[i]);
+        snprintf(le, sizeof(le), "le=\"%s\"", bound);
+        snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(counts[i]));
+        AppendSample(name, "_bucket", labels, le, value);
+    }
+    snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(total));
+    AppendSample(name, "_bucket", labels, "le=\"+Inf\"", value);
+    FormatDouble(value, sizeof(value), histogram.Sum() * 1e-9);
+    AppendSample(name, "_sum", labels, nullptr, value);
+    snprintf(value, sizeof(value), "%llu", static_cast<unsigned long long>(total));
+    AppendSample(name, "_count", labels, nullptr, value);
+}
+
+void MetricsWriter::Quantiles(const char* name, const char* labels, const LatencySummary& summary) {
+    const struct {
+        const char* label;
+        double microseconds;
+    } quantiles[] = {
+        { "quantile=\"0.5\"", summary.p50 },
+        { "quantile=\"0.9\"", summary.p90 },
+        { "quantile=\"0.99\"", summary.p99 },
+        { "quantile=\"0.999\"", summary.p999 },
+    };
+    char value[32];
+    for (const auto& quantile : quantiles) {
+        FormatDouble(value, sizeof(value), quantile.microseconds * 1e-6);
+        AppendSample(name, "", labels, quantile.label, value);
+    }
+}
+
+MetricsServer::MetricsServer(Collector collect)
+    : collect(std::move(collect)), listener(kNoSocket) {
+}
+
+MetricsServer::~MetricsServer() {
+    Stop();
+}
+
+bool MetricsServer::Start(const std::string& address, int port) {
+    if (Running()) {
+        return true;
+    }
+#if defined(_WIN32)
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        LOG_ERROR("Metrics", "WSAStartup failed");
+        return false;
+    }
+    networkStarted = true;
+#endif
+
+    sockaddr_in bindAddress = {};
+    bindAddress.sin_family = AF_INET;
+    bindAddress.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr) != 1) {
+        LOG_ERROR("Metrics", "Not an IPv4 address: %s", address.c_str());
+        Stop();
+        return false;
+    }
+
+    listener = static_cast<uintptr_t>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (listener == kNoSocket) {
+        LOG_ERROR("Metrics", "socket() failed: %d", SocketError());
+        Stop();
+        return false;
+    }
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&bindAddress), sizeof(bindAddress)) != 0 ||
+        listen(listener, 8) != 0) {
+        LOG_ERROR("Metrics", "Cannot listen on %s:%d: %d", address.c_str(), port, SocketError());
+        Stop();
+        return false;
+    }
+
+    sockaddr_in bound = {};
+    SocketLength length = sizeof(bound);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&bound), &length);
+    boundPort = ntohs(bound.sin_port);
+
+    stopping.store(false, std::memory_order_relaxed);
+    worker = std::thread(&MetricsServer::Run, this);
+    LOG_INFO("Metrics", "Serving metrics on http://%s:%d/metrics", address.c_str(), boundPort);
+    return true;
+}
+
+void MetricsServer::Stop() {
+    stopping.store(true, std::memory_order_relaxed);
+    if (worker.joinable()) {
+        worker.join();
+    }
+    if (listener != kNoSocket) {
+        CloseSocket(listener);
+        listener = kNoSocket;
+    }
+#if defined(_WIN32)
+    if (networkStarted) {
+        WSACleanup();
+        networkStarted = false;
+    }
+#endif
+    boundPort = 0;
+}
+
+void MetricsServer::Run() {
+    RegisterThreadCpu("Metrics");
+    while (!stopping.load(std::memory_order_relaxed)) {
+        // Wait with a timeout rather than blocking in accept(), so Stop()
+        // is noticed without having to wake the thread.
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        timeval timeout = { 0, kAcceptPollMs * 1000 };
+        if (select(static_cast<int>(listener + 1), &readable, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+        const uintptr_t client = static_cast<uintptr_t>(accept(listener, nullptr, nullptr));
+        if (client == kNoSocket) {
+            continue;
+        }
+        Serve(client);
+        CloseSocket(client);
+    }
+}
+
+static bool SendAll(uintptr_t client, const char* data, size_t size) {
+    while (size > 0) {
+        const int chunk = static_cast<int>(size < (1 << 20) ? size : (1 << 20));
+        const auto sent = send(client, data, chunk, kSendFlags);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+void MetricsServer::Serve(uintptr_t client) {
+#if defined(_WIN32)
+    const DWORD timeout = kClientTimeoutMs;
+#else
+    const timeval timeout = { kClientTimeoutMs / 1000, (kClientTimeoutMs % 1000) * 1000 };
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+    // Only the request line matters; read until the end of the headers.
+    request.clear();
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+        const auto received = recv(client, buffer, static_cast<int>(sizeof(buffer)), 0);
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    const char* status = "200 OK";
+    const char* error = nullptr;
+    const bool get = request.compare(0, 4, "GET ") == 0;
+    const size_t pathEnd = request.find_first_of(" ?", 4);
+    const bool metricsPath = get && request.compare(4, pathEnd - 4, "/metrics") == 0;
+    if (!get) {
+        status = "405 Method Not Allowed";
+        error = "Only GET is supported\n";
+    }
+    else if (!metricsPath) {
+        status = "404 Not Found";
+        error = "Metrics are at /metrics\n";
+    }
+
+    if (!error) {
+        writer.Clear();
+        collect(writer);
+        const uint64_t served = scrapes.load(std::memory_order_relaxed) + 1;
+        writer.Counter("camviex_metrics_scrapes_total", "Metrics pages served, including this one.", served);
+        scrapes.store(served, std::memory_order_relaxed);
+    }
+    const char* page = error ? error : writer.Text().data();
+    const size_t pageSize = error ? strlen(error) : writer.Text().size();
+
+    char header[256];
+    const int headerSize = snprintf(header, sizeof(header),
+        "HTTP/1.1 %s\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n"
+        "\r\n",
+        status, pageSize);
+    if (SendAll(client, header, static_cast<size_t>(headerSize))) {
+        SendAll(client, page, pageSize);
+    }
+}
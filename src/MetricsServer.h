@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include "LatencyHistogram.h"
+
+// Builds a page in the Prometheus text exposition format (version 0.0.4):
+//
+//   # HELP camviex_frames_captured_total Frames delivered by the camera.
+//   # TYPE camviex_frames_captured_total counter
+//   camviex_frames_captured_total 1234
+//
+// Each metric family starts with Family(), followed by its samples. Labels
+// are passed preformatted without braces, e.g. "stage=\"capture\"", and
+// must already be escaped. The text buffer is reused between pages, so a
+// writer that is kept around stops allocating once it has grown.
+class MetricsWriter {
+public:
+    void Clear() { text.clear(); }
+    const std::string& Text() const { return text; }
+
+    // '# HELP' and '# TYPE' lines. 'type' is "counter", "gauge",
+    // "histogram", "summary" or "untyped".
+    void Family(const char* name, const char* type, const char* help);
+
+    // One sample line; 'labels' may be null.
+    void Sample(const char* name, const char* labels, double value);
+    void Sample(const char* name, const char* labels, uint64_t value);
+
+    // A family with a single unlabelled sample
+    void Counter(const char* name, const char* help, uint64_t value);
+    void Gauge(const char* name, const char* help, double value);
+
+    // Cumulative _bucket lines at kLatencyBoundsSeconds, then _sum and
+    // _count, in seconds, under the current family of type "histogram".
+    void Histogram(const char* name, const char* labels, const LatencyHistogram& histogram);
+
+    // Quantile samples 0.5 to 0.999 of 'summary', converted to seconds,
+    // under the current family.
+    void Quantiles(const char* name, const char* labels, const LatencySummary& summary);
+
+    // Upper bounds of the latency histogram buckets: sub-millisecond up to
+    // a few frame intervals at 30 fps and well past them.
+    static constexpr double kLatencyBoundsSeconds[] = {
+        0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.05, 0.1, 0.25, 0.5, 1.0,
+    };
+
+private:
+    void AppendSample(const char* name, const char* suffix, const char* labels, const char* extraLabel, const char* value);
+
+    std::string text;
+};
+
+// Minimal HTTP server for Prometheus scrapes. One background thread accepts
+// connections on a local address and answers GET /metrics with the page
+// 'collect' writes; anything else gets 404. Requests are served one at a
+// time, and a client that stalls is dropped after a short timeout.
+//
+// 'collect' runs on the server thread, so it must only read state that is
+// safe to read from another thread without holding up its writers: atomics,
+// lock-free counters and LatencyHistogram. A scrape never waits on the
+// capture thread.
+class MetricsServer {
+public:
+    using Collector = std::function<void(MetricsWriter& writer)>;
+
+    explicit MetricsServer(Collector collect);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // Listen on 'address' (an IPv4 address, "127.0.0.1" for this machine
+    // only) and 'port', 0 for any free port. Returns false, and logs why,
+    // if the socket could not be bound.
+    bool Start(const std::string& address, int port);
+
+    // Stop listening and join the server thread. Called by the destructor.
+    void Stop();
+
+    bool Running() const { return worker.joinable(); }
+
+    // Port actually bound, which differs from the one asked for when that
+    // was 0.
+    int Port() const { return boundPort; }
+
+    uint64_t Scrapes() const { return scrapes.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+    void Serve(uintptr_t client);
+
+    Collector collect;
+    MetricsWriter writer;  // Server thread only
+    std::string request;   // Server thread only
+
+    uintptr_t listener;
+    int boundPort = 0;
+    bool networkStarted = false;  // WSAStartup() to balance, on Windows
+    std::atomic<bool> stopping{ false };
+    std::atomic<uint64_t> scrapes{ 0 };
+    std::thread worker;
+};
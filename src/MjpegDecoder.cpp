@@ -0,0 +1,795 @@
+#include "MjpegDecoder.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// SSE2 and NEON are part of the x64 and AArch64 baselines, so the IDCT uses
+// them directly instead of going through runtime dispatch.
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MJPEG_IDCT_SSE2 1
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define MJPEG_IDCT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Natural (row-major) index of the n-th coefficient in zigzag order.
+static const uint8_t kZigzag[64 + 16] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+    // Corrupt run lengths can step past 63; park them on the last entry.
+    63, 63, 63, 63, 63, 63, 63, 63,
+    63, 63, 63, 63, 63, 63, 63, 63,
+};
+
+// Standard Huffman tables from ITU-T T.81 Annex K.3, used by MJPEG streams
+// that omit DHT.
+static const uint8_t kDcLumaCounts[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t kDcChromaCounts[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t kDcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t kAcLumaCounts[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t kAcLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t kAcChromaCounts[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t kAcChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static inline int ReadBigEndian16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+// ---------------------------------------------------------------------------
+// Entropy decoding
+// ---------------------------------------------------------------------------
+
+// MSB-first bit reader over one restart interval. Removes 0xFF00 byte
+// stuffing and feeds zeros past the end, so corrupt data cannot read out of
+// bounds; it just decodes as garbage.
+struct JpegBitReader {
+    const uint8_t* ptr;
+    const uint8_t* end;
+    uint64_t bits = 0;
+    int count = 0;
+
+    JpegBitReader(const uint8_t* begin, const uint8_t* finish) : ptr(begin), end(finish) {}
+
+    void Fill() {
+        while (count <= 56) {
+            uint64_t byte = 0;
+            if (ptr < end) {
+                byte = *ptr++;
+                if (byte == 0xFF) {
+                    if (ptr < end && *ptr == 0x00) {
+                        ++ptr;
+                    }
+                    else {
+                        ptr = end;  // A marker ends the interval
+                        byte = 0;
+                    }
+                }
+            }
+            bits |= byte << (56 - count);
+            count += 8;
+        }
+    }
+
+    uint32_t Peek(int n) const { return static_cast<uint32_t>(bits >> (64 - n)); }
+    void Skip(int n) { bits <<= n; count -= n; }
+
+    // Read n bits (n <= 16) and sign-extend them as JPEG magnitude categories do.
+    int Receive(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        const int value = static_cast<int>(Peek(n));
+        Skip(n);
+        return value < (1 << (n - 1)) ? value - (1 << n) + 1 : value;
+    }
+};
+
+bool MjpegDecoder::BuildHuffmanTable(HuffmanTable& table, const uint8_t counts[16], const uint8_t* symbols) {
+    // Reject counts that need more codes of a length than it has; their codes
+    // would index past the fast table.
+    int total = 0;
+    int lastCode = 0;
+    for (int length = 1; length <= 16; ++length) {
+        lastCode += counts[length - 1];
+        if (lastCode > (1 << length)) {
+            return false;
+        }
+        lastCode <<= 1;
+        total += counts[length - 1];
+    }
+    total = std::min(total, 256);
+    memcpy(table.values, symbols, total);
+    memset(table.fast, 0, sizeof(table.fast));
+
+    // Canonical code assignment (T.81 Annex C).
+    int code = 0;
+    int index = 0;
+    for (int length = 1; length <= 16; ++length) {
+        table.valueOffset[length] = index - code;
+        for (int i = 0; i < counts[length - 1] && index < total; ++i, ++index, ++code) {
+            if (length <= kFastBits) {
+                const int shift = kFastBits - length;
+                const int first = code << shift;
+                for (int j = 0; j < (1 << shift); ++j) {
+                    table.fast[first + j] = static_cast<uint16_t>((length << 8) | table.values[index]);
+                }
+            }
+        }
+        table.maxCode[length] = counts[length - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table.maxCode[17] = 0x7FFFFFFF;
+    table.present = true;
+    return true;
+}
+
+static inline int DecodeHuffman(JpegBitReader& reader, const uint16_t* fast, const int32_t* maxCode,
+                                const int32_t* valueOffset, const uint8_t* values) {
+    const uint16_t entry = fast[reader.Peek(9)];
+    if (entry) {
+        reader.Skip(entry >> 8);
+        return entry & 0xFF;
+    }
+    for (int length = 10; length <= 16; ++length) {
+        const int32_t code = static_cast<int32_t>(reader.Peek(length));
+        if (code <= maxCode[length]) {
+            reader.Skip(length);
+            return values[(code + valueOffset[length]) & 0xFF];
+        }
+    }
+    reader.Skip(16);  // Invalid code
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Inverse DCT: the AAN float algorithm (as in libjpeg's jidctflt.c), written
+// once as a template so the SIMD versions run the exact same butterflies on
+// four columns at a time.
+// ---------------------------------------------------------------------------
+
+template <typename T>
+static inline void Idct8(T& d0, T& d1, T& d2, T& d3, T& d4, T& d5, T& d6, T& d7) {
+    // Even part
+    T tmp10 = d0 + d4;
+    T tmp11 = d0 - d4;
+    T tmp13 = d2 + d6;
+    T tmp12 = (d2 - d6) * 1.414213562f - tmp13;
+
+    T tmp0 = tmp10 + tmp13;
+    T tmp3 = tmp10 - tmp13;
+    T tmp1 = tmp11 + tmp12;
+    T tmp2 = tmp11 - tmp12;
+
+    // Odd part
+    T z13 = d5 + d3;
+    T z10 = d5 - d3;
+    T z11 = d1 + d7;
+    T z12 = d1 - d7;
+
+    T tmp7 = z11 + z13;
+    T tmp11b = (z11 - z13) * 1.414213562f;
+    T z5 = (z10 + z12) * 1.847759065f;
+    T tmp10b = z5 - z12 * 1.082392200f;
+    T tmp12b = z5 - z10 * 2.613125930f;
+
+    T tmp6 = tmp12b - tmp7;
+    T tmp5 = tmp11b - tmp6;
+    T tmp4 = tmp10b - tmp5;
+
+    d0 = tmp0 + tmp7;
+    d7 = tmp0 - tmp7;
+    d1 = tmp1 + tmp6;
+    d6 = tmp1 - tmp6;
+    d2 = tmp2 + tmp5;
+    d5 = tmp2 - tmp5;
+    d3 = tmp3 + tmp4;
+    d4 = tmp3 - tmp4;
+}
+
+#if defined(MJPEG_IDCT_SSE2)
+
+struct Float4 {
+    __m128 v;
+};
+static inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+static inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+static inline Float4 operator*(Float4 a, float b) { return { _mm_mul_ps(a.v, _mm_set1_ps(b)) }; }
+
+static inline Float4 LoadDequantized(const int16_t* coef, const float* q) {
+    const __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(coef));
+    const __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+    return { _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_load_ps(q)) };
+}
+
+static inline void Transpose4(Float4& a, Float4& b, Float4& c, Float4& d) {
+    _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+}
+
+// Round, level shift and saturate eight samples to bytes.
+static inline void StoreRow(Float4 lo, Float4 hi, uint8_t* out) {
+    const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(lo.v), _mm_cvtps_epi32(hi.v));
+    const __m128i shifted = _mm_add_epi16(packed, _mm_set1_epi16(128));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(shifted, shifted));
+}
+
+#elif defined(MJPEG_IDCT_NEON)
+
+struct Float4 {
+    float32x4_t v;
+};
+static inline Float4 operator+(Float4 a, Float4 b) { return { vaddq_f32(a.v, b.v) }; }
+static inline Float4 operator-(Float4 a, Float4 b) { return { vsubq_f32(a.v, b.v) }; }
+static inline Float4 operator*(Float4 a, float b) { return { vmulq_n_f32(a.v, b) }; }
+
+static inline Float4 LoadDequantized(const int16_t* coef, const float* q) {
+    return { vmulq_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(coef))), vld1q_f32(q)) };
+}
+
+static inline void Transpose4(Float4& a, Float4& b, Float4& c, Float4& d) {
+    const float32x4x2_t ab = vtrnq_f32(a.v, b.v);
+    const float32x4x2_t cd = vtrnq_f32(c.v, d.v);
+    a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+static inline void StoreRow(Float4 lo, Float4 hi, uint8_t* out) {
+    const int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(lo.v)), vqmovn_s32(vcvtnq_s32_f32(hi.v)));
+    vst1_u8(out, vqmovun_s16(vaddq_s16(packed, vdupq_n_s16(128))));
+}
+
+#endif
+
+#if defined(MJPEG_IDCT_SSE2) || defined(MJPEG_IDCT_NEON)
+
+// Rows are held as two vectors: m[row][0] = columns 0-3, m[row][1] = columns 4-7.
+static inline void IdctColumns(Float4 m[8][2]) {
+    for (int half = 0; half < 2; ++half) {
+        Idct8(m[0][half], m[1][half], m[2][half], m[3][half], m[4][half], m[5][half], m[6][half], m[7][half]);
+    }
+}
+
+static inline void Transpose8x8(Float4 m[8][2]) {
+    Transpose4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    Transpose4(m[4][1], m[5][1], m[6][1], m[7][1]);
+    Transpose4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    Transpose4(m[4][0], m[5][0], m[6][0], m[7][0]);
+    for (int i = 0; i < 4; ++i) {
+        std::swap(m[i][1], m[i + 4][0]);
+    }
+}
+
+static void IdctBlock(const int16_t* coef, const float* q, uint8_t* out, int stride) {
+    Float4 m[8][2];
+    for (int row = 0; row < 8; ++row) {
+        m[row][0] = LoadDequantized(coef + row * 8, q + row * 8);
+        m[row][1] = LoadDequantized(coef + row * 8 + 4, q + row * 8 + 4);
+    }
+
+    IdctColumns(m);
+    Transpose8x8(m);
+    IdctColumns(m);
+    Transpose8x8(m);
+
+    for (int row = 0; row < 8; ++row) {
+        StoreRow(m[row][0], m[row][1], out + row * stride);
+    }
+}
+
+#else
+
+static void IdctBlock(const int16_t* coef, const float* q, uint8_t* out, int stride) {
+    float m[64];
+    for (int i = 0; i < 64; ++i) {
+        m[i] = coef[i] * q[i];
+    }
+    for (int col = 0; col < 8; ++col) {
+        float* c = m + col;
+        Idct8(c[0], c[8], c[16], c[24], c[32], c[40], c[48], c[56]);
+    }
+    for (int row = 0; row < 8; ++row) {
+        float* r = m + row * 8;
+        Idct8(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7]);
+        for (int col = 0; col < 8; ++col) {
+            const long value = std::lrint(r[col]) + 128;
+            out[row * stride + col] = static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+    }
+}
+
+#endif
+
+// A block with only a DC coefficient is flat; skip the transform.
+static void FillDcBlock(int dc, float q, uint8_t* out, int stride) {
+    const long value = std::lrint(dc * q) + 128;
+    const uint8_t sample = static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    for (int row = 0; row < 8; ++row) {
+        memset(out + row * stride, sample, 8);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Decoder
+// ---------------------------------------------------------------------------
+
+MjpegDecoder::MjpegDecoder(WorkerPool* pool) : pool(pool) {
+    memset(quant, 0, sizeof(quant));
+}
+
+bool MjpegDecoder::ReadFrameSize(const uint8_t* data, size_t size, int* frameWidth, int* frameHeight) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            ++pos;  // Fill byte
+            continue;
+        }
+        const size_t length = ReadBigEndian16(data + pos + 2);
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (pos + 9 > size) {
+                return false;
+            }
+            *frameHeight = ReadBigEndian16(data + pos + 5);
+            *frameWidth = ReadBigEndian16(data + pos + 7);
+            return true;
+        }
+        if (marker == 0xDA || marker == 0xD9) {
+            return false;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+bool MjpegDecoder::ParseQuantizationTables(const uint8_t* p, size_t length) {
+    // Scale factors of the AAN IDCT: 1 for k = 0, cos(k*pi/16) * sqrt(2) otherwise.
+    static const double kAanScale[8] = {
+        1.0, 1.387039845, 1.306562965, 1.175875602,
+        1.0, 0.785694958, 0.541196100, 0.275899379,
+    };
+
+    while (length > 0) {
+        const int precision = p[0] >> 4;
+        const int index = p[0] & 0x0F;
+        const size_t tableBytes = precision ? 128 : 64;
+        if (index > 3 || length < 1 + tableBytes) {
+            return false;
+        }
+        for (int i = 0; i < 64; ++i) {
+            const int value = precision ? ReadBigEndian16(p + 1 + i * 2) : p[1 + i];
+            const int natural = kZigzag[i];
+            const int row = natural / 8;
+            const int col = natural % 8;
+            // The final 1/8 of the 2-D transform is folded in as well.
+            quant[index][natural] = static_cast<float>(value * kAanScale[row] * kAanScale[col] / 8.0);
+        }
+        quantPresent[index] = true;
+        p += 1 + tableBytes;
+        length -= 1 + tableBytes;
+    }
+    return true;
+}
+
+bool MjpegDecoder::ParseHuffmanTables(const uint8_t* p, size_t length) {
+    while (length >= 17) {
+        const int tableClass = p[0] >> 4;
+        const int index = p[0] & 0x0F;
+        if (tableClass > 1 || index > 3) {
+            return false;
+        }
+        int total = 0;
+        for (int i = 0; i < 16; ++i) {
+            total += p[1 + i];
+        }
+        if (total > 256 || length < 17 + static_cast<size_t>(total)) {
+            return false;
+        }
+        if (!BuildHuffmanTable(tableClass ? acTables[index] : dcTables[index], p + 1, p + 17)) {
+            return false;
+        }
+        p += 17 + total;
+        length -= 17 + total;
+    }
+    huffmanPresentInFrame = true;
+    return length == 0;
+}
+
+bool MjpegDecoder::ParseFrameHeader(const uint8_t* p, size_t length) {
+    if (length < 6 || p[0] != 8) {
+        return false;  // Only 8-bit samples
+    }
+    height = ReadBigEndian16(p + 1);
+    width = ReadBigEndian16(p + 3);
+    componentCount = p[5];
+    if (width == 0 || height == 0 || (componentCount != 1 && componentCount != 3) || length < 6 + 3 * static_cast<size_t>(componentCount)) {
+        return false;
+    }
+
+    maxH = 1;
+    maxV = 1;
+    for (int i = 0; i < componentCount; ++i) {
+        Component& component = components[i];
+        component.id = p[6 + i * 3];
+        component.h = p[7 + i * 3] >> 4;
+        component.v = p[7 + i * 3] & 0x0F;
+        component.quantIndex = p[8 + i * 3] & 0x03;
+        if (componentCount == 1) {
+            component.h = component.v = 1;  // A single-component scan is never interleaved
+        }
+        maxH = std::max(maxH, component.h);
+        maxV = std::max(maxV, component.v);
+    }
+
+    // Luma may be subsampled 1x1, 2x1 or 2x2 against single-sampled chroma.
+    if (componentCount == 3) {
+        const Component& luma = components[0];
+        const bool lumaOk = (luma.h == 1 && luma.v == 1) || (luma.h == 2 && luma.v == 1) || (luma.h == 2 && luma.v == 2);
+        if (!lumaOk || components[1].h != 1 || components[1].v != 1 || components[2].h != 1 || components[2].v != 1) {
+            return false;
+        }
+    }
+
+    mcusX = (width + 8 * maxH - 1) / (8 * maxH);
+    mcusY = (height + 8 * maxV - 1) / (8 * maxV);
+    return true;
+}
+
+bool MjpegDecoder::ParseScanHeader(const uint8_t* p, size_t length) {
+    if (length < 1) {
+        return false;
+    }
+    scanComponentCount = p[0];
+    if (scanComponentCount != componentCount || length < 1 + 2 * static_cast<size_t>(scanComponentCount) + 3) {
+        return false;  // Non-interleaved multi-scan images are not used by MJPEG
+    }
+    for (int i = 0; i < scanComponentCount; ++i) {
+        const int id = p[1 + i * 2];
+        const int tables = p[2 + i * 2];
+        int found = -1;
+        for (int c = 0; c < componentCount; ++c) {
+            if (components[c].id == id) {
+                found = c;
+            }
+        }
+        if (found < 0) {
+            return false;
+        }
+        components[found].dcTable = (tables >> 4) & 0x03;
+        components[found].acTable = tables & 0x03;
+        scanOrder[i] = found;
+    }
+    return true;
+}
+
+bool MjpegDecoder::ParseHeaders(const uint8_t* data, size_t size, const uint8_t** scanData, size_t* scanSize) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    huffmanPresentInFrame = false;
+    restartInterval = 0;
+    componentCount = 0;
+
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            ++pos;
+            continue;
+        }
+        const size_t length = ReadBigEndian16(data + pos + 2);
+        if (length < 2 || pos + 2 + length > size) {
+            return false;
+        }
+        const uint8_t* payload = data + pos + 4;
+        const size_t payloadLength = length - 2;
+
+        bool ok = true;
+        switch (marker) {
+        case 0xDB:
+            ok = ParseQuantizationTables(payload, payloadLength);
+            break;
+        case 0xC4:
+            ok = ParseHuffmanTables(payload, payloadLength);
+            break;
+        case 0xC0: // Baseline
+        case 0xC1: // Extended sequential, Huffman
+            ok = ParseFrameHeader(payload, payloadLength);
+            break;
+        case 0xDD:
+            ok = payloadLength >= 2;
+            if (ok) {
+                restartInterval = ReadBigEndian16(payload);
+            }
+            break;
+        case 0xDA:
+            if (componentCount == 0 || !ParseScanHeader(payload, payloadLength)) {
+                return false;
+            }
+            *scanData = payload + payloadLength;
+            *scanSize = size - (pos + 2 + length);
+            return true;
+        default:
+            // Progressive, lossless and arithmetic-coded frames are unsupported;
+            // everything else (APPn, COM, ...) is skipped.
+            if ((marker >= 0xC2 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                return false;
+            }
+            break;
+        }
+        if (!ok) {
+            return false;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+void MjpegDecoder::InstallDefaultHuffmanTables() {
+    BuildHuffmanTable(dcTables[0], kDcLumaCounts, kDcValues);
+    BuildHuffmanTable(dcTables[1], kDcChromaCounts, kDcValues);
+    BuildHuffmanTable(acTables[0], kAcLumaCounts, kAcLumaValues);
+    BuildHuffmanTable(acTables[1], kAcChromaCounts, kAcChromaValues);
+}
+
+bool MjpegDecoder::AllocatePlanes() {
+    // A corrupt SOF can claim up to 65535x65535; refuse it rather than
+    // allocate gigabytes on the thread that decodes.
+    if (static_cast<int64_t>(mcusX) * maxH * 8 * mcusY * maxV * 8 > kMaxPixels) {
+        return false;
+    }
+    for (int c = 0; c < componentCount; ++c) {
+        Component& component = components[c];
+        if (!quantPresent[component.quantIndex]) {
+            return false;
+        }
+        component.planeStride = mcusX * component.h * 8;
+        component.planeRows = mcusY * component.v * 8;
+        const size_t required = static_cast<size_t>(component.planeStride) * component.planeRows;
+        if (component.plane.size() < required) {
+            component.plane.resize(required);
+        }
+    }
+    return true;
+}
+
+void MjpegDecoder::SplitSegments(const uint8_t* scanData, size_t scanSize) {
+    segments.clear();
+    const uint8_t* begin = scanData;
+    const uint8_t* p = scanData;
+    const uint8_t* end = scanData + scanSize;
+
+    while (p + 1 < end) {
+        p = static_cast<const uint8_t*>(memchr(p, 0xFF, end - p - 1));
+        if (!p) {
+            break;
+        }
+        const uint8_t next = p[1];
+        if (next == 0x00 || next == 0xFF) {
+            p += (next == 0x00) ? 2 : 1;  // Stuffed byte or fill byte
+            continue;
+        }
+        if (next >= 0xD0 && next <= 0xD7) {
+            segments.push_back({ begin, p });
+            p += 2;
+            begin = p;
+            continue;
+        }
+        end = p;  // EOI or another marker ends the scan
+        break;
+    }
+    segments.push_back({ begin, end });
+}
+
+void MjpegDecoder::DecodeSegments(int first, int last) {
+    alignas(16) int16_t block[64];
+    const int totalMcus = mcusX * mcusY;
+    const int mcusPerSegment = restartInterval > 0 && segments.size() > 1 ? restartInterval : totalMcus;
+
+    for (int s = first; s < last; ++s) {
+        JpegBitReader reader(segments[s].begin, segments[s].end);
+        int dcPredictor[3] = {};
+
+        const int mcuBegin = s * mcusPerSegment;
+        const int mcuEnd = std::min(mcuBegin + mcusPerSegment, totalMcus);
+        for (int mcu = mcuBegin; mcu < mcuEnd; ++mcu) {
+            const int mcuX = mcu % mcusX;
+            const int mcuY = mcu / mcusX;
+
+            for (int i = 0; i < scanComponentCount; ++i) {
+                const int c = scanOrder[i];
+                Component& component = components[c];
+                const HuffmanTable& dc = dcTables[component.dcTable];
+                const HuffmanTable& ac = acTables[component.acTable];
+                const float* q = quant[component.quantIndex];
+
+                for (int by = 0; by < component.v; ++by) {
+                    for (int bx = 0; bx < component.h; ++bx) {
+                        uint8_t* out = component.plane.data()
+                            + static_cast<size_t>((mcuY * component.v + by) * 8) * component.planeStride
+                            + (mcuX * component.h + bx) * 8;
+
+                        reader.Fill();
+                        const int category = DecodeHuffman(reader, dc.fast, dc.maxCode, dc.valueOffset, dc.values);
+                        dcPredictor[c] += reader.Receive(std::min(category, 16));
+
+                        // AC coefficients; most blocks end after a handful.
+                        bool hasAc = false;
+                        for (int k = 1; k < 64;) {
+                            reader.Fill();
+                            const int symbol = DecodeHuffman(reader, ac.fast, ac.maxCode, ac.valueOffset, ac.values);
+                            const int run = symbol >> 4;
+                            const int magnitude = symbol & 0x0F;
+                            if (magnitude == 0) {
+                                if (run != 15) {
+                                    break;  // End of block
+                                }
+                                k += 16;
+                                continue;
+                            }
+                            k += run;
+                            if (!hasAc) {
+                                memset(block, 0, sizeof(block));
+                                hasAc = true;
+                            }
+                            block[kZigzag[k]] = static_cast<int16_t>(reader.Receive(magnitude));
+                            ++k;
+                        }
+
+                        if (hasAc) {
+                            block[0] = static_cast<int16_t>(dcPredictor[c]);
+                            IdctBlock(block, q, out, component.planeStride);
+                        }
+                        else {
+                            FillDcBlock(dcPredictor[c], q[0], out, component.planeStride);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void MjpegDecoder::DescribePlanes() {
+    planes = ImagePlanes();
+    planes.width = width;
+    planes.height = height;
+    planes.data[0] = components[0].plane.data();
+    planes.stride[0] = components[0].planeStride;
+
+    if (componentCount == 1) {
+        // Greyscale: point both chroma planes at one neutral row with stride 0.
+        if (neutralChroma.size() < static_cast<size_t>(width)) {
+            neutralChroma.assign(width, 128);
+        }
+        planes.format = PixelFormat::I444;
+        planes.data[1] = planes.data[2] = neutralChroma.data();
+        planes.stride[1] = planes.stride[2] = 0;
+        return;
+    }
+
+    const Component& luma = components[0];
+    planes.format = (luma.h == 1) ? PixelFormat::I444 : (luma.v == 1 ? PixelFormat::I422 : PixelFormat::I420);
+    for (int c = 1; c < 3; ++c) {
+        planes.data[c] = components[c].plane.data();
+        planes.stride[c] = components[c].planeStride;
+    }
+}
+
+bool MjpegDecoder::Decode(const uint8_t* data, size_t size) {
+    const uint8_t* scanData = nullptr;
+    size_t scanSize = 0;
+    if (!ParseHeaders(data, size, &scanData, &scanSize)) {
+        return false;
+    }
+    if (!huffmanPresentInFrame) {
+        InstallDefaultHuffmanTables();
+    }
+    for (int i = 0; i < scanComponentCount; ++i) {
+        const Component& component = components[scanOrder[i]];
+        if (!dcTables[component.dcTable].present || !acTables[component.acTable].present) {
+            return false;
+        }
+    }
+    if (!AllocatePlanes()) {
+        return false;
+    }
+
+    SplitSegments(scanData, scanSize);
+
+    // Restart intervals only help if the marker count matches the header;
+    // otherwise treat the scan as one segment.
+    const int totalMcus = mcusX * mcusY;
+    const int expectedSegments = restartInterval > 0 ? (totalMcus + restartInterval - 1) / restartInterval : 1;
+    if (static_cast<int>(segments.size()) != expectedSegments) {
+        const uint8_t* end = segments.back().end;
+        segments.resize(1);
+        segments[0].end = end;
+    }
+    sliceCount = static_cast<int>(segments.size());
+
+    if (pool && sliceCount > 1) {
+        // Hand each task a contiguous run of intervals; a few tasks per
+        // thread keeps the load balanced when intervals differ in cost.
+        const int taskCount = std::min(sliceCount, pool->Concurrency() * 4);
+        pool->ParallelFor(taskCount, [&](int task) {
+            DecodeSegments(task * sliceCount / taskCount, (task + 1) * sliceCount / taskCount);
+        });
+    }
+    else {
+        DecodeSegments(0, sliceCount);
+    }
+
+    DescribePlanes();
+    return true;
+}
+
+void MjpegDecoder::ConvertToRGBA(uint8_t* dst, ptrdiff_t dstStride, FrameOrientation orientation) const {
+    // JFIF is full range BT.601.
+    const YuvColorSpace jfif = { YuvMatrix::BT601, YuvRange::Full };
+
+    const int bandCount = pool ? std::min(pool->Concurrency(), std::max(1, planes.height / 16)) : 1;
+    if (bandCount <= 1) {
+        ::ConvertToRGBA(planes, dst, dstStride, jfif, orientation);
+        return;
+    }
+
+    pool->ParallelFor(bandCount, [&](int band) {
+        // Band edges fall on even rows so 4:2:0 chroma rows line up.
+        const int top = (band * planes.height / bandCount) & ~1;
+        const int bottom = (band + 1 == bandCount) ? planes.height : (((band + 1) * planes.height / bandCount) & ~1);
+        ConvertRowsToRGBA(planes, top, bottom - top, dst, dstStride, jfif, orientation);
+    });
+}
+
+bool MjpegDecoder::DecodeToRGBA(const uint8_t* data, size_t size, uint8_t* dst, ptrdiff_t dstStride, FrameOrientation orientation) {
+    if (!Decode(data, size)) {
+        return false;
+    }
+    ConvertToRGBA(dst, dstStride, orientation);
+    return true;
+}
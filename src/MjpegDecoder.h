@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PixelConversion.h"
+
+class WorkerPool;
+
+// In-process decoder for the Motion JPEG frames UVC cameras send. Handles
+// baseline and extended sequential Huffman JPEGs with 8-bit samples: greyscale
+// or YCbCr at 4:4:4, 4:2:2 and 4:2:0. Frames without a DHT segment, as
+// MJPEG allows, use the standard Huffman tables.
+//
+// When the encoder emitted restart markers the entropy-coded data is split at
+// each RSTn and the intervals are decoded in parallel on the worker pool.
+// Color conversion to RGBA is split into bands on the same pool.
+class MjpegDecoder {
+public:
+    // 'pool' may be nullptr to decode on the calling thread only.
+    explicit MjpegDecoder(WorkerPool* pool = nullptr);
+
+    // Decode one frame into the internal YCbCr planes. Returns false for
+    // malformed input and unsupported variants (progressive, arithmetic
+    // coding, 12-bit samples).
+    bool Decode(const uint8_t* data, size_t size);
+
+    // Decode and convert to RGBA in one call. The destination must hold the
+    // frame at its OrientedSize().
+    bool DecodeToRGBA(const uint8_t* data, size_t size, uint8_t* dst, ptrdiff_t dstStride,
+                      FrameOrientation orientation = FrameOrientation());
+
+    // Convert the last decoded frame to RGBA.
+    void ConvertToRGBA(uint8_t* dst, ptrdiff_t dstStride, FrameOrientation orientation = FrameOrientation()) const;
+
+    // Planes of the last decoded frame: I420, I422 or I444 in full range BT.601.
+    const ImagePlanes& GetPlanes() const { return planes; }
+    int Width() const { return planes.width; }
+    int Height() const { return planes.height; }
+
+    // Number of independently decoded restart intervals in the last frame;
+    // 1 when the frame had no restart markers and was decoded serially.
+    int LastSliceCount() const { return sliceCount; }
+
+    // Read the frame dimensions from the SOF header without decoding.
+    static bool ReadFrameSize(const uint8_t* data, size_t size, int* width, int* height);
+
+private:
+    static constexpr int kFastBits = 9;
+    // Largest frame decoded, in pixels: 8K UHD
+    static constexpr int64_t kMaxPixels = 7680LL * 4320;
+
+    struct HuffmanTable {
+        bool present = false;
+        // (code length << 8) | symbol for codes of up to kFastBits bits, 0 otherwise
+        uint16_t fast[1 << kFastBits];
+        // Canonical decoding for longer codes, indexed by code length
+        int32_t maxCode[18];
+        int32_t valueOffset[17];
+        uint8_t values[256];
+    };
+
+    struct Component {
+        int id = 0;
+        int h = 1;
+        int v = 1;
+        int quantIndex = 0;
+        int dcTable = 0;
+        int acTable = 0;
+        int planeStride = 0;
+        int planeRows = 0;
+        std::vector<uint8_t> plane;
+    };
+
+    // A run of entropy-coded bytes between restart markers.
+    struct Segment {
+        const uint8_t* begin;
+        const uint8_t* end;
+    };
+
+    bool ParseHeaders(const uint8_t* data, size_t size, const uint8_t** scanData, size_t* scanSize);
+    bool ParseQuantizationTables(const uint8_t* p, size_t length);
+    bool ParseHuffmanTables(const uint8_t* p, size_t length);
+    bool ParseFrameHeader(const uint8_t* p, size_t length);
+    bool ParseScanHeader(const uint8_t* p, size_t length);
+    bool BuildHuffmanTable(HuffmanTable& table, const uint8_t counts[16], const uint8_t* symbols);
+    void InstallDefaultHuffmanTables();
+    bool AllocatePlanes();
+    void SplitSegments(const uint8_t* scanData, size_t scanSize);
+    void DecodeSegments(int first, int last);
+    void DescribePlanes();
+
+    WorkerPool* pool;
+
+    // Dequantization tables with the AAN IDCT scale factors folded in.
+    alignas(16) float quant[4][64];
+    bool quantPresent[4] = {};
+    HuffmanTable dcTables[4];
+    HuffmanTable acTables[4];
+    bool huffmanPresentInFrame = false;
+
+    int width = 0;
+    int height = 0;
+    int componentCount = 0;
+    Component components[3];
+    int scanOrder[3] = {};
+    int scanComponentCount = 0;
+    int maxH = 1;
+    int maxV = 1;
+    int mcusX = 0;
+    int mcusY = 0;
+    int restartInterval = 0;
+
+    std::vector<Segment> segments;
+    int sliceCount = 0;
+
+    std::vector<uint8_t> neutralChroma;  // Chroma row for greyscale frames
+    ImagePlanes planes;
+};
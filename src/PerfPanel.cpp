@@ -0,0 +1,141 @@
+#include "PerfPanel.h"
+#include <algorithm>
+#include <cstdio>
+#include "imgui.h"
+
+void PerfPanel::History::Push(float value) {
+    values[next] = value;
+    next = (next + 1) % kHistory;
+    count = std::min(count + 1, kHistory);
+}
+
+void PerfPanel::History::Clear() {
+    next = 0;
+    count = 0;
+}
+
+float PerfPanel::History::Max() const {
+    float highest = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        highest = std::max(highest, values[i]);
+    }
+    return highest;
+}
+
+void PerfPanel::History::Plot(const char* id, const char* format) const {
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), format, Latest());
+    // Until the ring has wrapped the oldest sample is at index 0.
+    const int offset = count < kHistory ? 0 : next;
+    const float scale = std::max(Max() * 1.1f, 1.0f);
+    ImGui::PlotLines(id, values, count, offset, overlay, 0.0f, scale, ImVec2(-1.0f, 36.0f));
+}
+
+PerfPanel::PerfPanel(double sampleSeconds)
+    : sampleSeconds(sampleSeconds) {
+}
+
+void PerfPanel::AddSample(const PerfCounters& counters, double now) {
+    const bool first = lastTime < 0.0;
+    const double elapsed = now - lastTime;
+    if (!first && elapsed > 0.0) {
+        const auto rate = [elapsed](uint64_t current, uint64_t previous) {
+            // Counters only grow, but don't trust a sample taken mid-reset
+            return current >= previous ? static_cast<float>((current - previous) / elapsed) : 0.0f;
+        };
+        captureFps.Push(rate(counters.display.published, last.display.published));
+        displayFps.Push(rate(counters.display.consumed, last.display.consumed));
+        droppedPerSecond.Push(rate(counters.display.dropped, last.display.dropped));
+        repeatedPerSecond.Push(rate(counters.display.repeated, last.display.repeated));
+        poolInUse.Push(static_cast<float>(counters.pool.frames - counters.pool.free));
+        endToEndP99.Push(static_cast<float>(counters.latency[static_cast<int>(LatencyStage::EndToEnd)].p99 / 1000.0));
+
+        for (ThreadHistory& thread : threads) {
+            thread.active = false;
+        }
+        for (size_t i = 0; i < counters.threadCount; ++i) {
+            const ThreadCpuUsage& usage = counters.threads[i];
+            ThreadHistory& thread = threads[usage.slot];
+            thread.active = true;
+            thread.name = usage.name;
+            if (thread.generation != usage.generation) {
+                // A new thread took the slot; its first sample has no baseline
+                thread.generation = usage.generation;
+                thread.cpuPercent.Clear();
+                continue;
+            }
+            double previous = usage.cpuSeconds;
+            for (size_t j = 0; j < last.threadCount; ++j) {
+                if (last.threads[j].slot == usage.slot) {
+                    previous = last.threads[j].cpuSeconds;
+                }
+            }
+            thread.cpuPercent.Push(static_cast<float>(std::max(usage.cpuSeconds - previous, 0.0) / elapsed * 100.0));
+        }
+    }
+    else {
+        for (size_t i = 0; i < counters.threadCount; ++i) {
+            ThreadHistory& thread = threads[counters.threads[i].slot];
+            thread.active = true;
+            thread.name = counters.threads[i].name;
+            thread.generation = counters.threads[i].generation;
+        }
+    }
+    last = counters;
+    lastTime = now;
+}
+
+void PerfPanel::Draw() const {
+    ImGui::Text("Capture %.1f fps", captureFps.Latest());
+    captureFps.Plot("##CaptureFps", "%.1f fps");
+    ImGui::Text("Display %.1f fps", displayFps.Latest());
+    displayFps.Plot("##DisplayFps", "%.1f fps");
+
+    ImGui::Text("Dropped %llu, repeated %llu",
+        static_cast<unsigned long long>(last.display.dropped), static_cast<unsigned long long>(last.display.repeated));
+    droppedPerSecond.Plot("##Dropped", "%.1f dropped/s");
+    repeatedPerSecond.Plot("##Repeated", "%.1f repeated/s");
+
+    ImGui::Text("Frame pool %llu/%llu in use, %llu exhausted",
+        static_cast<unsigned long long>(last.pool.frames - last.pool.free), static_cast<unsigned long long>(last.pool.frames),
+        static_cast<unsigned long long>(last.pool.exhausted));
+    poolInUse.Plot("##PoolInUse", "%.0f frames");
+
+    // Latency percentiles in milliseconds
+    if (ImGui::BeginTable("Latency", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("Stage (ms)");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p90");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("max");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < static_cast<int>(LatencyStage::Count); ++i) {
+            const LatencySummary& summary = last.latency[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(LatencyStageName(static_cast<LatencyStage>(i)));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", summary.p50 / 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", summary.p90 / 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", summary.p99 / 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", summary.max / 1000.0);
+        }
+        ImGui::EndTable();
+    }
+    endToEndP99.Plot("##EndToEnd", "end to end p99 %.1f ms");
+
+    ImGui::Text("CPU per thread (%% of one core)");
+    for (int i = 0; i < kMaxCpuThreads; ++i) {
+        const ThreadHistory& thread = threads[i];
+        if (!thread.active) {
+            continue;
+        }
+        ImGui::PushID(i);
+        ImGui::Text("%s %.1f%%", thread.name ? thread.name : "Thread", thread.cpuPercent.Latest());
+        thread.cpuPercent.Plot("##Cpu", "%.1f%%");
+        ImGui::PopID();
+    }
+}
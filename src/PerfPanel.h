@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include "FrameLatency.h"
+#include "FrameMailbox.h"
+#include "FramePool.h"
+#include "ThreadCpu.h"
+
+// Cumulative counters of the capture pipeline at one point in time. The
+// panel turns the difference between two of these into rates.
+struct PerfCounters {
+    FrameMailboxStats display;  // published: captured, consumed: displayed
+    FramePoolStats pool;
+    LatencySummary latency[static_cast<int>(LatencyStage::Count)];
+    ThreadCpuUsage threads[kMaxCpuThreads];
+    size_t threadCount = 0;
+};
+
+// Live performance view for the sidebar: capture and display rates, dropped
+// and repeated frames, latency percentiles per stage, frame pool occupancy
+// and CPU time per thread, with a rolling history of each.
+//
+// All history lives in fixed arrays, so sampling and drawing do not
+// allocate. Only ImGui is needed, so the panel also draws into a headless
+// ImGui context.
+class PerfPanel {
+public:
+    static constexpr int kHistory = 120;  // Samples kept per sparkline
+
+    explicit PerfPanel(double sampleSeconds = 0.25);
+
+    // Whether AddSample() should be called for time 'now' (seconds).
+    // Gathering counters costs a little, so callers check this first.
+    bool SampleDue(double now) const { return lastTime < 0.0 || now - lastTime >= sampleSeconds; }
+
+    void AddSample(const PerfCounters& counters, double now);
+
+    // Widgets for the current ImGui window.
+    void Draw() const;
+
+private:
+    // Fixed-size ring of samples for one sparkline
+    class History {
+    public:
+        void Push(float value);
+        void Clear();
+        float Latest() const { return count ? values[(next + kHistory - 1) % kHistory] : 0.0f; }
+        float Max() const;
+
+        // Sparkline with the latest value formatted as 'format' on top
+        void Plot(const char* id, const char* format) const;
+
+    private:
+        float values[kHistory] = {};
+        int next = 0;
+        int count = 0;
+    };
+
+    const double sampleSeconds;
+    double lastTime = -1.0;
+    PerfCounters last;
+
+    History captureFps;
+    History displayFps;
+    History droppedPerSecond;
+    History repeatedPerSecond;
+    History poolInUse;
+    History endToEndP99;
+
+    // CPU use in percent of one core, per ThreadCpuUsage::slot
+    struct ThreadHistory {
+        const char* name = nullptr;
+        unsigned generation = 0;
+        bool active = false;
+        History cpuPercent;
+    };
+    ThreadHistory threads[kMaxCpuThreads];
+};
@@ -0,0 +1,447 @@
+#include "PixelConversion.h"
+#include "PixelKernels.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+static const PixelKernels* KernelsForIsa(PixelIsa isa) {
+    const CpuFeatures& cpu = GetCpuFeatures();
+    switch (isa) {
+    case PixelIsa::Scalar:
+        return GetScalarPixelKernels();
+    case PixelIsa::SSSE3:
+        return cpu.ssse3 ? GetSsse3PixelKernels() : nullptr;
+    case PixelIsa::AVX2:
+        return cpu.avx2 ? GetAvx2PixelKernels() : nullptr;
+    case PixelIsa::NEON:
+        return cpu.neon ? GetNeonPixelKernels() : nullptr;
+    }
+    return nullptr;
+}
+
+static std::atomic<PixelIsa>& ActiveIsa() {
+    static std::atomic<PixelIsa> isa{ GetBestPixelIsa() };
+    return isa;
+}
+
+static const PixelKernels* ActiveKernels() {
+    const PixelKernels* kernels = KernelsForIsa(ActiveIsa().load(std::memory_order_relaxed));
+    return kernels ? kernels : GetScalarPixelKernels();
+}
+
+const char* PixelIsaName(PixelIsa isa) {
+    switch (isa) {
+    case PixelIsa::Scalar: return "Scalar";
+    case PixelIsa::SSSE3:  return "SSSE3";
+    case PixelIsa::AVX2:   return "AVX2";
+    case PixelIsa::NEON:   return "NEON";
+    }
+    return "Unknown";
+}
+
+PixelIsa GetBestPixelIsa() {
+    const PixelIsa preference[] = { PixelIsa::AVX2, PixelIsa::NEON, PixelIsa::SSSE3 };
+    for (PixelIsa isa : preference) {
+        if (KernelsForIsa(isa)) {
+            return isa;
+        }
+    }
+    return PixelIsa::Scalar;
+}
+
+PixelIsa GetPixelIsa() {
+    return ActiveIsa().load(std::memory_order_relaxed);
+}
+
+bool SetPixelIsa(PixelIsa isa) {
+    if (!KernelsForIsa(isa)) {
+        return false;
+    }
+    ActiveIsa().store(isa, std::memory_order_relaxed);
+    return true;
+}
+
+void ConvertBGR24ToRGBA(const uint8_t* src, ptrdiff_t srcStride,
+                        uint8_t* dst, ptrdiff_t dstStride,
+                        int width, int height) {
+    const auto rowKernel = ActiveKernels()->bgr24ToRgba;
+    for (int y = 0; y < height; ++y) {
+        rowKernel(src, dst, width);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+const char* PixelFormatName(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::Unknown: return "Unknown";
+    case PixelFormat::BGR24:   return "RGB24";
+    case PixelFormat::BGRA32:  return "RGB32";
+    case PixelFormat::YUY2:    return "YUY2";
+    case PixelFormat::NV12:    return "NV12";
+    case PixelFormat::I420:    return "I420";
+    case PixelFormat::I422:    return "I422";
+    case PixelFormat::I444:    return "I444";
+    case PixelFormat::MJPEG:   return "MJPG";
+    }
+    return "Unknown";
+}
+
+YuvColorSpace DefaultYuvColorSpace(int width, int height) {
+    YuvColorSpace colorSpace;
+    colorSpace.matrix = (width >= 1280 || height >= 720) ? YuvMatrix::BT709 : YuvMatrix::BT601;
+    colorSpace.range = YuvRange::Limited;
+    return colorSpace;
+}
+
+static YuvCoefficients MakeYuvCoefficients(YuvColorSpace colorSpace) {
+    // Luma weights of the red and blue primaries.
+    const double kr = (colorSpace.matrix == YuvMatrix::BT709) ? 0.2126 : 0.299;
+    const double kb = (colorSpace.matrix == YuvMatrix::BT709) ? 0.0722 : 0.114;
+    const double kg = 1.0 - kr - kb;
+
+    const bool limited = (colorSpace.range == YuvRange::Limited);
+    const double lumaScale = limited ? 255.0 / 219.0 : 1.0;
+    const double chromaScale = limited ? 255.0 / 224.0 : 1.0;
+    const double one = static_cast<double>(1 << kYuvShift);
+
+    auto fixed = [one](double value) { return static_cast<int16_t>(std::lround(value * one)); };
+
+    YuvCoefficients k;
+    k.yOffset = limited ? 16 : 0;
+    k.yGain = fixed(lumaScale);
+    k.rV = fixed(2.0 * (1.0 - kr) * chromaScale);
+    k.gU = fixed(-2.0 * (1.0 - kb) * kb / kg * chromaScale);
+    k.gV = fixed(-2.0 * (1.0 - kr) * kr / kg * chromaScale);
+    k.bU = fixed(2.0 * (1.0 - kb) * chromaScale);
+    return k;
+}
+
+static const YuvCoefficients& GetYuvCoefficients(YuvColorSpace colorSpace) {
+    static const YuvCoefficients table[2][2] = {
+        { MakeYuvCoefficients({ YuvMatrix::BT601, YuvRange::Limited }), MakeYuvCoefficients({ YuvMatrix::BT601, YuvRange::Full }) },
+        { MakeYuvCoefficients({ YuvMatrix::BT709, YuvRange::Limited }), MakeYuvCoefficients({ YuvMatrix::BT709, YuvRange::Full }) },
+    };
+    return table[colorSpace.matrix == YuvMatrix::BT709 ? 1 : 0][colorSpace.range == YuvRange::Full ? 1 : 0];
+}
+
+int DefaultStride(PixelFormat format, int width) {
+    switch (format) {
+    case PixelFormat::BGR24:  return (width * 3 + 3) & ~3;
+    case PixelFormat::BGRA32: return width * 4;
+    case PixelFormat::YUY2:   return ((width + 1) & ~1) * 2;
+    case PixelFormat::NV12:
+    case PixelFormat::I420:
+    case PixelFormat::I422:   return (width + 1) & ~1;
+    case PixelFormat::I444:   return width;
+    default:                  return 0;
+    }
+}
+
+size_t FrameSize(PixelFormat format, int height, int stride) {
+    const size_t lumaSize = static_cast<size_t>(stride) * static_cast<size_t>(height);
+    const size_t chromaRows = static_cast<size_t>((height + 1) / 2);
+    switch (format) {
+    case PixelFormat::BGR24:
+    case PixelFormat::BGRA32:
+    case PixelFormat::YUY2:
+        return lumaSize;
+    case PixelFormat::NV12:
+        return lumaSize + static_cast<size_t>(stride) * chromaRows;
+    case PixelFormat::I420:
+        return lumaSize + 2 * static_cast<size_t>(stride / 2) * chromaRows;
+    case PixelFormat::I422:
+        return lumaSize + 2 * static_cast<size_t>(stride / 2) * static_cast<size_t>(height);
+    case PixelFormat::I444:
+        return 3 * lumaSize;
+    default:
+        return 0;
+    }
+}
+
+bool DescribeFrame(PixelFormat format, const uint8_t* data, size_t size,
+                   int width, int height, int stride, ImagePlanes* planes) {
+    const size_t required = FrameSize(format, height, stride);
+    if (required == 0 || size < required || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    *planes = ImagePlanes();
+    planes->format = format;
+    planes->width = width;
+    planes->height = height;
+
+    const size_t lumaSize = static_cast<size_t>(stride) * static_cast<size_t>(height);
+    switch (format) {
+    case PixelFormat::BGR24:
+    case PixelFormat::BGRA32:
+        // Bottom-up DIB: start at the last row and walk backwards
+        planes->data[0] = data + lumaSize - stride;
+        planes->stride[0] = -static_cast<ptrdiff_t>(stride);
+        break;
+    case PixelFormat::YUY2:
+        planes->data[0] = data;
+        planes->stride[0] = stride;
+        break;
+    case PixelFormat::NV12:
+        planes->data[0] = data;
+        planes->stride[0] = stride;
+        planes->data[1] = data + lumaSize;
+        planes->stride[1] = stride;
+        break;
+    case PixelFormat::I420:
+    case PixelFormat::I422:
+    case PixelFormat::I444: {
+        const int chromaStride = (format == PixelFormat::I444) ? stride : stride / 2;
+        const int chromaRows = (format == PixelFormat::I420) ? (height + 1) / 2 : height;
+        planes->data[0] = data;
+        planes->stride[0] = stride;
+        planes->data[1] = data + lumaSize;
+        planes->stride[1] = chromaStride;
+        planes->data[2] = planes->data[1] + static_cast<size_t>(chromaStride) * static_cast<size_t>(chromaRows);
+        planes->stride[2] = chromaStride;
+        break;
+    }
+    default:
+        return false;
+    }
+    return true;
+}
+
+bool ConvertToRGBA(const ImagePlanes& src, uint8_t* dst, ptrdiff_t dstStride, YuvColorSpace colorSpace) {
+    switch (src.format) {
+    case PixelFormat::BGR24:
+        ConvertBGR24ToRGBA(src.data[0], src.stride[0], dst, dstStride, src.width, src.height);
+        return true;
+    case PixelFormat::BGRA32:
+        ConvertBGRA32ToRGBA(src.data[0], src.stride[0], dst, dstStride, src.width, src.height);
+        return true;
+    case PixelFormat::YUY2:
+        ConvertYUY2ToRGBA(src.data[0], src.stride[0], dst, dstStride, src.width, src.height, colorSpace);
+        return true;
+    case PixelFormat::NV12:
+        ConvertNV12ToRGBA(src.data[0], src.stride[0], src.data[1], src.stride[1],
+                          dst, dstStride, src.width, src.height, colorSpace);
+        return true;
+    case PixelFormat::I420:
+    case PixelFormat::I422:
+    case PixelFormat::I444: {
+        const int shiftX = (src.format == PixelFormat::I444) ? 0 : 1;
+        const int shiftY = (src.format == PixelFormat::I420) ? 1 : 0;
+        ConvertYUVPlanarToRGBA(src.data[0], src.stride[0], src.data[1], src.stride[1], src.data[2], src.stride[2],
+                               dst, dstStride, src.width, src.height, shiftX, shiftY, colorSpace);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+const char* FrameRotationName(FrameRotation rotation) {
+    switch (rotation) {
+    case FrameRotation::None:      return "0";
+    case FrameRotation::Rotate90:  return "90";
+    case FrameRotation::Rotate180: return "180";
+    case FrameRotation::Rotate270: return "270";
+    }
+    return "Unknown";
+}
+
+static bool SwapsDimensions(FrameRotation rotation) {
+    return rotation == FrameRotation::Rotate90 || rotation == FrameRotation::Rotate270;
+}
+
+void OrientedSize(FrameOrientation orientation, int width, int height, int* orientedWidth, int* orientedHeight) {
+    const bool swap = SwapsDimensions(orientation.rotation);
+    *orientedWidth = swap ? height : width;
+    *orientedHeight = swap ? width : height;
+}
+
+bool SliceImageRows(const ImagePlanes& src, int firstRow, int rowCount, ImagePlanes* slice) {
+    if (firstRow < 0 || rowCount < 0 || firstRow + rowCount > src.height || (firstRow & 1)) {
+        return false;
+    }
+
+    *slice = src;
+    slice->height = rowCount;
+    slice->data[0] += firstRow * src.stride[0];
+
+    switch (src.format) {
+    case PixelFormat::NV12:
+        slice->data[1] += (firstRow / 2) * src.stride[1];
+        break;
+    case PixelFormat::I420:
+    case PixelFormat::I422:
+    case PixelFormat::I444: {
+        const int chromaRow = (src.format == PixelFormat::I420) ? firstRow / 2 : firstRow;
+        slice->data[1] += chromaRow * src.stride[1];
+        slice->data[2] += chromaRow * src.stride[2];
+        break;
+    }
+    default:
+        break;
+    }
+    return true;
+}
+
+// Rows converted at a time when the result has to be reordered: small enough
+// that the RGBA strip stays in L2 at 4K, and a multiple of the 4x4 transpose.
+static constexpr int kOrientationBandRows = 16;
+
+bool ConvertToRGBA(const ImagePlanes& src, uint8_t* dst, ptrdiff_t dstStride,
+                   YuvColorSpace colorSpace, FrameOrientation orientation) {
+    return ConvertRowsToRGBA(src, 0, src.height, dst, dstStride, colorSpace, orientation);
+}
+
+bool ConvertRowsToRGBA(const ImagePlanes& src, int firstRow, int rowCount,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       YuvColorSpace colorSpace, FrameOrientation orientation) {
+    const int width = src.width;
+    const int height = src.height;
+
+    // Express every orientation as an optional transpose plus reversal of the
+    // source x and y axes in the destination.
+    bool transpose = false;
+    bool reverseX = orientation.mirror;
+    bool reverseY = orientation.flipVertical;
+    switch (orientation.rotation) {
+    case FrameRotation::None:
+        break;
+    case FrameRotation::Rotate90:
+        transpose = true;
+        reverseY = !reverseY;
+        break;
+    case FrameRotation::Rotate180:
+        reverseX = !reverseX;
+        reverseY = !reverseY;
+        break;
+    case FrameRotation::Rotate270:
+        transpose = true;
+        reverseX = !reverseX;
+        break;
+    }
+
+    ImagePlanes rows;
+    if (!SliceImageRows(src, firstRow, rowCount, &rows)) {
+        return false;
+    }
+
+    // Without a transpose the source row y lands on destination row y, or
+    // height - 1 - y; a negative stride does the vertical flip for free.
+    if (!transpose && !reverseX) {
+        uint8_t* dstRow = dst + (reverseY ? height - 1 - firstRow : firstRow) * dstStride;
+        return ConvertToRGBA(rows, dstRow, reverseY ? -dstStride : dstStride, colorSpace);
+    }
+
+    const PixelKernels* kernels = ActiveKernels();
+    const ptrdiff_t stripStride = static_cast<ptrdiff_t>(width) * 4;
+    thread_local std::vector<uint8_t> strip;
+    if (strip.size() < static_cast<size_t>(stripStride) * kOrientationBandRows) {
+        strip.resize(static_cast<size_t>(stripStride) * kOrientationBandRows);
+    }
+
+    for (int y = firstRow; y < firstRow + rowCount; y += kOrientationBandRows) {
+        const int bandRows = std::min(kOrientationBandRows, firstRow + rowCount - y);
+        ImagePlanes band;
+        SliceImageRows(src, y, bandRows, &band);
+
+        if (!transpose) {
+            // Mirror: convert into the strip, then copy each row reversed.
+            if (!ConvertToRGBA(band, strip.data(), stripStride, colorSpace)) {
+                return false;
+            }
+            for (int i = 0; i < bandRows; ++i) {
+                const int dstY = reverseY ? height - 1 - (y + i) : y + i;
+                kernels->reverseRgba(strip.data() + i * stripStride, dst + dstY * dstStride, width);
+            }
+            continue;
+        }
+
+        // Rotation: source rows become destination columns. Storing the strip
+        // bottom-up when y is reversed makes every destination run ascend.
+        uint8_t* stripTop = strip.data();
+        ptrdiff_t stripStep = stripStride;
+        if (reverseY) {
+            stripTop += (bandRows - 1) * stripStride;
+            stripStep = -stripStride;
+        }
+        if (!ConvertToRGBA(band, stripTop, stripStep, colorSpace)) {
+            return false;
+        }
+
+        const int dstX = reverseY ? height - y - bandRows : y;
+        uint8_t* dstBlock = dst + dstX * 4;
+        ptrdiff_t dstStep = dstStride;
+        if (reverseX) {
+            dstBlock += (width - 1) * dstStride;
+            dstStep = -dstStride;
+        }
+        kernels->transposeRgba(strip.data(), stripStride, dstBlock, dstStep, width, bandRows);
+    }
+    return true;
+}
+
+void ConvertBGRA32ToRGBA(const uint8_t* src, ptrdiff_t srcStride,
+                         uint8_t* dst, ptrdiff_t dstStride,
+                         int width, int height) {
+    const auto rowKernel = ActiveKernels()->bgra32ToRgba;
+    for (int y = 0; y < height; ++y) {
+        rowKernel(src, dst, width);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+void ConvertYUY2ToRGBA(const uint8_t* src, ptrdiff_t srcStride,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       int width, int height, YuvColorSpace colorSpace) {
+    const auto rowKernel = ActiveKernels()->yuy2ToRgba;
+    const YuvCoefficients& k = GetYuvCoefficients(colorSpace);
+    for (int y = 0; y < height; ++y) {
+        rowKernel(src, dst, width, k);
+        src += srcStride;
+        dst += dstStride;
+    }
+}
+
+void ConvertNV12ToRGBA(const uint8_t* srcY, ptrdiff_t strideY,
+                       const uint8_t* srcUV, ptrdiff_t strideUV,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       int width, int height, YuvColorSpace colorSpace) {
+    const auto rowKernel = ActiveKernels()->nv12ToRgba;
+    const YuvCoefficients& k = GetYuvCoefficients(colorSpace);
+    for (int y = 0; y < height; ++y) {
+        rowKernel(srcY, srcUV + (y / 2) * strideUV, dst, width, k);
+        srcY += strideY;
+        dst += dstStride;
+    }
+}
+
+void ConvertI420ToRGBA(const uint8_t* srcY, ptrdiff_t strideY,
+                       const uint8_t* srcU, ptrdiff_t strideU,
+                       const uint8_t* srcV, ptrdiff_t strideV,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       int width, int height, YuvColorSpace colorSpace) {
+    ConvertYUVPlanarToRGBA(srcY, strideY, srcU, strideU, srcV, strideV,
+                           dst, dstStride, width, height, 1, 1, colorSpace);
+}
+
+void ConvertYUVPlanarToRGBA(const uint8_t* srcY, ptrdiff_t strideY,
+                            const uint8_t* srcU, ptrdiff_t strideU,
+                            const uint8_t* srcV, ptrdiff_t strideV,
+                            uint8_t* dst, ptrdiff_t dstStride,
+                            int width, int height,
+                            int chromaShiftX, int chromaShiftY,
+                            YuvColorSpace colorSpace) {
+    const PixelKernels* kernels = ActiveKernels();
+    const auto rowKernel = chromaShiftX ? kernels->i420ToRgba : kernels->i444ToRgba;
+    const YuvCoefficients& k = GetYuvCoefficients(colorSpace);
+    for (int y = 0; y < height; ++y) {
+        const ptrdiff_t chromaRow = y >> chromaShiftY;
+        rowKernel(srcY, srcU + chromaRow * strideU, srcV + chromaRow * strideV, dst, width, k);
+        srcY += strideY;
+        dst += dstStride;
+    }
+}
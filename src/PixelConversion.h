@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Instruction sets the pixel conversion kernels are available for.
+enum class PixelIsa {
+    Scalar,
+    SSSE3,
+    AVX2,
+    NEON,
+};
+
+const char* PixelIsaName(PixelIsa isa);
+
+// The best instruction set supported by the running CPU.
+PixelIsa GetBestPixelIsa();
+
+// The instruction set currently used by the conversion functions. Defaults to
+// GetBestPixelIsa(); benchmarks can force a slower one with SetPixelIsa().
+PixelIsa GetPixelIsa();
+bool SetPixelIsa(PixelIsa isa);
+
+// Uncompressed capture formats the converters understand.
+enum class PixelFormat {
+    Unknown,
+    BGR24,  // DirectShow RGB24, bottom-up
+    BGRA32, // DirectShow RGB32, bottom-up, alpha undefined
+    YUY2,   // Packed 4:2:2, Y0 U Y1 V
+    NV12,   // Planar Y followed by interleaved UV at half resolution
+    I420,   // Planar Y, U, V with chroma at half resolution (also IYUV)
+    I422,   // Planar Y, U, V with chroma at half width, full height
+    I444,   // Planar Y, U, V at full resolution
+    MJPEG,  // Motion JPEG; compressed, decoded by MjpegDecoder
+};
+
+const char* PixelFormatName(PixelFormat format);
+
+enum class YuvMatrix {
+    BT601,
+    BT709,
+};
+
+enum class YuvRange {
+    Limited, // Y in [16, 235], chroma in [16, 240]
+    Full,    // Y and chroma in [0, 255]
+};
+
+struct YuvColorSpace {
+    YuvMatrix matrix = YuvMatrix::BT601;
+    YuvRange range = YuvRange::Limited;
+};
+
+// Cameras rarely report their color space; the convention is BT.601 for SD
+// and BT.709 for HD, both in limited range.
+YuvColorSpace DefaultYuvColorSpace(int width, int height);
+
+// Plane pointers and strides of a frame in one of the formats above. Packed
+// formats only use the first plane. Strides may be negative.
+struct ImagePlanes {
+    PixelFormat format = PixelFormat::Unknown;
+    int width = 0;
+    int height = 0;
+    const uint8_t* data[3] = {};
+    ptrdiff_t stride[3] = {};
+};
+
+// Clockwise rotation of the displayed image.
+enum class FrameRotation {
+    None,
+    Rotate90,
+    Rotate180,
+    Rotate270,
+};
+
+// How a camera's image is turned upright for display. The flips are applied
+// to the captured image first, then the rotation.
+struct FrameOrientation {
+    FrameRotation rotation = FrameRotation::None;
+    bool mirror = false;       // Swap left and right
+    bool flipVertical = false; // Swap top and bottom
+};
+
+const char* FrameRotationName(FrameRotation rotation);
+
+// Size of a width x height image after reorientation.
+void OrientedSize(FrameOrientation orientation, int width, int height, int* orientedWidth, int* orientedHeight);
+
+// Natural row pitch of a frame as DirectShow lays it out: RGB DIB rows are
+// padded to four bytes, YUV formats use the width of the luma plane.
+// Compressed formats have no stride and return 0.
+int DefaultStride(PixelFormat format, int width);
+
+// Number of bytes a contiguous frame occupies for the given luma row pitch,
+// or 0 for compressed formats.
+size_t FrameSize(PixelFormat format, int height, int stride);
+
+// Describe a contiguous frame in the DirectShow layout: chroma planes follow
+// the luma plane and RGB DIBs are stored bottom-up. Returns false if the
+// format is unknown or 'size' is too small for the frame.
+bool DescribeFrame(PixelFormat format, const uint8_t* data, size_t size,
+                   int width, int height, int stride, ImagePlanes* planes);
+
+// Convert any supported frame to 32-bit RGBA with opaque alpha. The
+// destination stride can be any pitch of at least width * 4 bytes, for example
+// a mapped texture's RowPitch. Returns false for unsupported formats.
+bool ConvertToRGBA(const ImagePlanes& src, uint8_t* dst, ptrdiff_t dstStride,
+                   YuvColorSpace colorSpace = YuvColorSpace());
+
+// Convert and reorient in the same pass. 'dst' receives the image at its
+// OrientedSize(). Mirrors and 90/270 degree rotations go through a 16-row
+// RGBA strip that stays in cache, so there is still only one trip through
+// memory per frame.
+bool ConvertToRGBA(const ImagePlanes& src, uint8_t* dst, ptrdiff_t dstStride,
+                   YuvColorSpace colorSpace, FrameOrientation orientation);
+
+// Convert source rows [firstRow, firstRow + rowCount) of the oriented
+// conversion above, so a frame can be split into bands across threads. Each
+// band writes only its own part of 'dst'. firstRow must be even.
+bool ConvertRowsToRGBA(const ImagePlanes& src, int firstRow, int rowCount,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       YuvColorSpace colorSpace, FrameOrientation orientation);
+
+// Narrow 'src' to rows [firstRow, firstRow + rowCount). firstRow must be even
+// so subsampled chroma rows stay aligned. Returns false if out of range.
+bool SliceImageRows(const ImagePlanes& src, int firstRow, int rowCount, ImagePlanes* slice);
+
+// Convert packed 24-bit BGR (the DirectShow RGB24 layout) to 32-bit RGBA with
+// opaque alpha. Strides are in bytes and may be negative, which lets bottom-up
+// DIBs be converted by passing a pointer to the last row.
+void ConvertBGR24ToRGBA(const uint8_t* src, ptrdiff_t srcStride,
+                        uint8_t* dst, ptrdiff_t dstStride,
+                        int width, int height);
+
+// Same for 32-bit BGRx; the source alpha byte is ignored.
+void ConvertBGRA32ToRGBA(const uint8_t* src, ptrdiff_t srcStride,
+                         uint8_t* dst, ptrdiff_t dstStride,
+                         int width, int height);
+
+void ConvertYUY2ToRGBA(const uint8_t* src, ptrdiff_t srcStride,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       int width, int height, YuvColorSpace colorSpace);
+
+void ConvertNV12ToRGBA(const uint8_t* srcY, ptrdiff_t strideY,
+                       const uint8_t* srcUV, ptrdiff_t strideUV,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       int width, int height, YuvColorSpace colorSpace);
+
+void ConvertI420ToRGBA(const uint8_t* srcY, ptrdiff_t strideY,
+                       const uint8_t* srcU, ptrdiff_t strideU,
+                       const uint8_t* srcV, ptrdiff_t strideV,
+                       uint8_t* dst, ptrdiff_t dstStride,
+                       int width, int height, YuvColorSpace colorSpace);
+
+// Any planar YUV layout: chroma planes are subsampled by 2^chromaShiftX
+// horizontally and 2^chromaShiftY vertically (I420 is 1, 1; I422 is 1, 0).
+void ConvertYUVPlanarToRGBA(const uint8_t* srcY, ptrdiff_t strideY,
+                            const uint8_t* srcU, ptrdiff_t strideU,
+                            const uint8_t* srcV, ptrdiff_t strideV,
+                            uint8_t* dst, ptrdiff_t dstStride,
+                            int width, int height,
+                            int chromaShiftX, int chromaShiftY,
+                            YuvColorSpace colorSpace);
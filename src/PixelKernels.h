@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-point YUV to RGB coefficients in Q13. With y' = Y - yOffset and
+// centred chroma u' = U - 128, v' = V - 128:
+//   R = (yGain*y' + rV*v' + round) >> 13
+//   G = (yGain*y' + gU*u' + gV*v' + round) >> 13
+//   B = (yGain*y' + bU*u' + round) >> 13
+// Every kernel evaluates exactly this expression in 32-bit integers, so the
+// SIMD paths are bit-exact with the scalar reference.
+struct YuvCoefficients {
+    int16_t yOffset;
+    int16_t yGain;
+    int16_t rV;
+    int16_t gU;
+    int16_t gV;
+    int16_t bU;
+};
+
+constexpr int kYuvShift = 13;
+constexpr int kYuvRound = 1 << (kYuvShift - 1);
+
+// Per-ISA row kernels behind PixelConversion.h. Each kernel converts a single
+// row; the public functions walk the rows and handle strides. Chroma pointers
+// of 4:2:x formats cover width / 2 samples; the I420 row kernel also serves
+// I422, which only differs in how chroma rows are stepped.
+//
+// The orientation kernels move RGBA pixels after conversion: reverseRgba
+// copies a row in reverse pixel order, transposeRgba writes column i of a
+// width x height block to row i of the destination. Strides may be negative.
+struct PixelKernels {
+    const char* name;
+    void (*bgr24ToRgba)(const uint8_t* src, uint8_t* dst, int width);
+    void (*bgra32ToRgba)(const uint8_t* src, uint8_t* dst, int width);
+    void (*yuy2ToRgba)(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& k);
+    void (*nv12ToRgba)(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& k);
+    void (*i420ToRgba)(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k);
+    void (*i444ToRgba)(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k);
+    void (*reverseRgba)(const uint8_t* src, uint8_t* dst, int width);
+    void (*transposeRgba)(const uint8_t* src, ptrdiff_t srcStride, uint8_t* dst, ptrdiff_t dstStride, int width, int height);
+};
+
+const PixelKernels* GetScalarPixelKernels();
+
+// These return nullptr when the kernels were not compiled for this target.
+const PixelKernels* GetSsse3PixelKernels();
+const PixelKernels* GetAvx2PixelKernels();
+const PixelKernels* GetNeonPixelKernels();
+
+// Scalar row kernels, also used for the tails of the SIMD loops. The YUV tails
+// must start on an even pixel.
+void Bgr24ToRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width);
+void Bgra32ToRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width);
+void Yuy2ToRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& k);
+void Nv12ToRgbaRowScalar(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& k);
+void I420ToRgbaRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k);
+void I444ToRgbaRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k);
+void ReverseRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width);
+void TransposeRgbaScalar(const uint8_t* src, ptrdiff_t srcStride, uint8_t* dst, ptrdiff_t dstStride, int width, int height);
+
+inline uint8_t ClampToByte(int value) {
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+inline void YuvToRgbaPixel(int y, int u, int v, const YuvCoefficients& k, uint8_t* dst) {
+    const int luma = k.yGain * (y - k.yOffset) + kYuvRound;
+    u -= 128;
+    v -= 128;
+    dst[0] = ClampToByte((luma + k.rV * v) >> kYuvShift);
+    dst[1] = ClampToByte((luma + k.gU * u + k.gV * v) >> kYuvShift);
+    dst[2] = ClampToByte((luma + k.bU * u) >> kYuvShift);
+    dst[3] = 0xFF;
+}
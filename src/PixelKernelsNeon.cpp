@@ -0,0 +1,181 @@
+#include "PixelKernels.h"
+#include "CpuFeatures.h"
+
+#if defined(CPU_NEON)
+
+#include <arm_neon.h>
+
+static void Bgr24ToRgbaRowNeon(const uint8_t* src, uint8_t* dst, int width) {
+    const uint8x16_t alpha = vdupq_n_u8(0xFF);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x3_t bgr = vld3q_u8(src);
+        uint8x16x4_t rgba;
+        rgba.val[0] = bgr.val[2];
+        rgba.val[1] = bgr.val[1];
+        rgba.val[2] = bgr.val[0];
+        rgba.val[3] = alpha;
+        vst4q_u8(dst, rgba);
+        src += 48;
+        dst += 64;
+    }
+
+    Bgr24ToRgbaRowScalar(src, dst, width - x);
+}
+
+static void Bgra32ToRgbaRowNeon(const uint8_t* src, uint8_t* dst, int width) {
+    const uint8x16_t alpha = vdupq_n_u8(0xFF);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x4_t bgra = vld4q_u8(src);
+        uint8x16x4_t rgba;
+        rgba.val[0] = bgra.val[2];
+        rgba.val[1] = bgra.val[1];
+        rgba.val[2] = bgra.val[0];
+        rgba.val[3] = alpha;
+        vst4q_u8(dst, rgba);
+        src += 64;
+        dst += 64;
+    }
+
+    Bgra32ToRgbaRowScalar(src, dst, width - x);
+}
+
+// clamp((yGain*y + k1*c1 + k2*c2 + round) >> 13) for 8 pixels, the same
+// 32-bit integer expression as YuvToRgbaPixel().
+static inline uint8x8_t YuvChannel8(int16x8_t y, int16_t yGain, int16x8_t c1, int16_t k1, int16x8_t c2, int16_t k2) {
+    const int32x4_t round = vdupq_n_s32(kYuvRound);
+    int32x4_t lo = vmlal_n_s16(round, vget_low_s16(y), yGain);
+    int32x4_t hi = vmlal_n_s16(round, vget_high_s16(y), yGain);
+    lo = vmlal_n_s16(lo, vget_low_s16(c1), k1);
+    hi = vmlal_n_s16(hi, vget_high_s16(c1), k1);
+    lo = vmlal_n_s16(lo, vget_low_s16(c2), k2);
+    hi = vmlal_n_s16(hi, vget_high_s16(c2), k2);
+    const int16x8_t packed = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, kYuvShift)), vqmovn_s32(vshrq_n_s32(hi, kYuvShift)));
+    return vqmovun_s16(packed);
+}
+
+// 8 pixels with one chroma value per pixel; writes 32 bytes of RGBA.
+static inline void StoreYuvAsRgba8(uint8x8_t luma, uint8x8_t cb, uint8x8_t cr, const YuvCoefficients& k, uint8_t* dst) {
+    const int16x8_t y = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(luma)), vdupq_n_s16(k.yOffset));
+    const int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cb)), vdupq_n_s16(128));
+    const int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cr)), vdupq_n_s16(128));
+
+    uint8x8x4_t rgba;
+    rgba.val[0] = YuvChannel8(y, k.yGain, v, k.rV, v, 0);
+    rgba.val[1] = YuvChannel8(y, k.yGain, u, k.gU, v, k.gV);
+    rgba.val[2] = YuvChannel8(y, k.yGain, u, k.bU, u, 0);
+    rgba.val[3] = vdup_n_u8(0xFF);
+    vst4_u8(dst, rgba);
+}
+
+// 16 pixels from 16 luma bytes and 8 chroma samples per plane.
+static inline void StoreYuv422AsRgba16(uint8x16_t luma, uint8x8_t cb, uint8x8_t cr, const YuvCoefficients& k, uint8_t* dst) {
+    const uint8x8x2_t u = vzip_u8(cb, cb);
+    const uint8x8x2_t v = vzip_u8(cr, cr);
+    StoreYuvAsRgba8(vget_low_u8(luma), u.val[0], v.val[0], k, dst);
+    StoreYuvAsRgba8(vget_high_u8(luma), u.val[1], v.val[1], k, dst + 32);
+}
+
+static void Yuy2ToRgbaRowNeon(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& k) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        // val[0] = even Y, val[1] = U, val[2] = odd Y, val[3] = V
+        const uint8x8x4_t yuyv = vld4_u8(src);
+        const uint8x8x2_t luma = vzip_u8(yuyv.val[0], yuyv.val[2]);
+        StoreYuv422AsRgba16(vcombine_u8(luma.val[0], luma.val[1]), yuyv.val[1], yuyv.val[3], k, dst);
+        src += 32;
+        dst += 64;
+    }
+
+    Yuy2ToRgbaRowScalar(src, dst, width - x, k);
+}
+
+static void Nv12ToRgbaRowNeon(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& k) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x8x2_t chroma = vld2_u8(uv + x);
+        StoreYuv422AsRgba16(vld1q_u8(y + x), chroma.val[0], chroma.val[1], k, dst);
+        dst += 64;
+    }
+
+    Nv12ToRgbaRowScalar(y + x, uv + x, dst, width - x, k);
+}
+
+static void I420ToRgbaRowNeon(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        StoreYuv422AsRgba16(vld1q_u8(y + x), vld1_u8(u + x / 2), vld1_u8(v + x / 2), k, dst);
+        dst += 64;
+    }
+
+    I420ToRgbaRowScalar(y + x, u + x / 2, v + x / 2, dst, width - x, k);
+}
+
+static void I444ToRgbaRowNeon(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16_t luma = vld1q_u8(y + x);
+        const uint8x16_t cb = vld1q_u8(u + x);
+        const uint8x16_t cr = vld1q_u8(v + x);
+        StoreYuvAsRgba8(vget_low_u8(luma), vget_low_u8(cb), vget_low_u8(cr), k, dst);
+        StoreYuvAsRgba8(vget_high_u8(luma), vget_high_u8(cb), vget_high_u8(cr), k, dst + 32);
+        dst += 64;
+    }
+
+    I444ToRgbaRowScalar(y + x, u + x, v + x, dst, width - x, k);
+}
+
+static void ReverseRgbaRowNeon(const uint8_t* src, uint8_t* dst, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const uint32x4_t pixels = vrev64q_u32(vld1q_u32(reinterpret_cast<const uint32_t*>(src + x * 4)));
+        vst1q_u32(reinterpret_cast<uint32_t*>(dst + (width - x - 4) * 4), vextq_u32(pixels, pixels, 2));
+    }
+    ReverseRgbaRowScalar(src + x * 4, dst, width - x);
+}
+
+static void TransposeRgbaNeon(const uint8_t* src, ptrdiff_t srcStride, uint8_t* dst, ptrdiff_t dstStride, int width, int height) {
+    const int blockWidth = width & ~3;
+    const int blockHeight = height & ~3;
+    for (int x = 0; x < blockWidth; x += 4) {
+        const uint8_t* in = src + x * 4;
+        uint8_t* out = dst + x * dstStride;
+        for (int y = 0; y < blockHeight; y += 4) {
+            const uint32x4x2_t t01 = vtrnq_u32(vld1q_u32(reinterpret_cast<const uint32_t*>(in + (y + 0) * srcStride)),
+                                               vld1q_u32(reinterpret_cast<const uint32_t*>(in + (y + 1) * srcStride)));
+            const uint32x4x2_t t23 = vtrnq_u32(vld1q_u32(reinterpret_cast<const uint32_t*>(in + (y + 2) * srcStride)),
+                                               vld1q_u32(reinterpret_cast<const uint32_t*>(in + (y + 3) * srcStride)));
+            vst1q_u32(reinterpret_cast<uint32_t*>(out + 0 * dstStride + y * 4), vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+            vst1q_u32(reinterpret_cast<uint32_t*>(out + 1 * dstStride + y * 4), vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+            vst1q_u32(reinterpret_cast<uint32_t*>(out + 2 * dstStride + y * 4), vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+            vst1q_u32(reinterpret_cast<uint32_t*>(out + 3 * dstStride + y * 4), vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+        }
+    }
+
+    TransposeRgbaScalar(src + blockHeight * srcStride, srcStride, dst + blockHeight * 4, dstStride, blockWidth, height - blockHeight);
+    TransposeRgbaScalar(src + blockWidth * 4, srcStride, dst + blockWidth * dstStride, dstStride, width - blockWidth, height);
+}
+
+const PixelKernels* GetNeonPixelKernels() {
+    static const PixelKernels kernels = {
+        "NEON",
+        Bgr24ToRgbaRowNeon,
+        Bgra32ToRgbaRowNeon,
+        Yuy2ToRgbaRowNeon,
+        Nv12ToRgbaRowNeon,
+        I420ToRgbaRowNeon,
+        I444ToRgbaRowNeon,
+        ReverseRgbaRowNeon,
+        TransposeRgbaNeon,
+    };
+    return &kernels;
+}
+
+#else
+
+const PixelKernels* GetNeonPixelKernels() { return nullptr; }
+
+#endif
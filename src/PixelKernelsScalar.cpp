@@ -0,0 +1,93 @@
+#include "PixelKernels.h"
+#include <cstring>
+
+void Bgr24ToRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width) {
+    for (int x = 0; x < width; ++x) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = 0xFF;
+        src += 3;
+        dst += 4;
+    }
+}
+
+void Bgra32ToRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width) {
+    for (int x = 0; x < width; ++x) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = 0xFF;
+        src += 4;
+        dst += 4;
+    }
+}
+
+void Yuy2ToRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& k) {
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        YuvToRgbaPixel(src[0], src[1], src[3], k, dst);
+        YuvToRgbaPixel(src[2], src[1], src[3], k, dst + 4);
+        src += 4;
+        dst += 8;
+    }
+    if (x < width) {
+        YuvToRgbaPixel(src[0], src[1], src[3], k, dst);
+    }
+}
+
+void Nv12ToRgbaRowScalar(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& k) {
+    for (int x = 0; x < width; ++x) {
+        const uint8_t* chroma = uv + (x & ~1);
+        YuvToRgbaPixel(y[x], chroma[0], chroma[1], k, dst);
+        dst += 4;
+    }
+}
+
+void I420ToRgbaRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k) {
+    for (int x = 0; x < width; ++x) {
+        YuvToRgbaPixel(y[x], u[x >> 1], v[x >> 1], k, dst);
+        dst += 4;
+    }
+}
+
+void I444ToRgbaRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k) {
+    for (int x = 0; x < width; ++x) {
+        YuvToRgbaPixel(y[x], u[x], v[x], k, dst);
+        dst += 4;
+    }
+}
+
+void ReverseRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width) {
+    dst += static_cast<ptrdiff_t>(width) * 4;
+    for (int x = 0; x < width; ++x) {
+        dst -= 4;
+        memcpy(dst, src, 4);
+        src += 4;
+    }
+}
+
+void TransposeRgbaScalar(const uint8_t* src, ptrdiff_t srcStride, uint8_t* dst, ptrdiff_t dstStride, int width, int height) {
+    for (int x = 0; x < width; ++x) {
+        uint8_t* out = dst + x * dstStride;
+        const uint8_t* in = src + x * 4;
+        for (int y = 0; y < height; ++y) {
+            memcpy(out + y * 4, in + y * srcStride, 4);
+        }
+    }
+}
+
+const PixelKernels* GetScalarPixelKernels() {
+    static const PixelKernels kernels = {
+        "Scalar",
+        Bgr24ToRgbaRowScalar,
+        Bgra32ToRgbaRowScalar,
+        Yuy2ToRgbaRowScalar,
+        Nv12ToRgbaRowScalar,
+        I420ToRgbaRowScalar,
+        I444ToRgbaRowScalar,
+        ReverseRgbaRowScalar,
+        TransposeRgbaScalar,
+    };
+    return &kernels;
+}
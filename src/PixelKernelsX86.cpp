@@ -0,0 +1,320 @@
+#include "PixelKernels.h"
+#include "CpuFeatures.h"
+
+#if defined(CPU_X86)
+
+#include <immintrin.h>
+
+// Byte shuffle turning four BGR pixels in the low 12 bytes into four RGBx pixels.
+#define BGR24_TO_RGBA_SHUFFLE 2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128
+
+TARGET_SSSE3 static void Bgr24ToRgbaRowSsse3(const uint8_t* src, uint8_t* dst, int width) {
+    const __m128i shuffle = _mm_setr_epi8(BGR24_TO_RGBA_SHUFFLE);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    // 16 pixels per iteration from three aligned-size loads, no over-read.
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+
+        const __m128i p0 = a;
+        const __m128i p1 = _mm_alignr_epi8(b, a, 12);
+        const __m128i p2 = _mm_alignr_epi8(c, b, 8);
+        const __m128i p3 = _mm_srli_si128(c, 4);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(_mm_shuffle_epi8(p0, shuffle), alpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_or_si128(_mm_shuffle_epi8(p1, shuffle), alpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_or_si128(_mm_shuffle_epi8(p2, shuffle), alpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), _mm_or_si128(_mm_shuffle_epi8(p3, shuffle), alpha));
+
+        src += 48;
+        dst += 64;
+    }
+
+    Bgr24ToRgbaRowScalar(src, dst, width - x);
+}
+
+// Load 8 BGR pixels as two 12-byte groups, one per 128-bit lane. Reads 4 bytes
+// past the last pixel, so callers keep at least two pixels in reserve.
+TARGET_AVX2 static inline __m256i LoadBgr24x8(const uint8_t* src) {
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+TARGET_AVX2 static void Bgr24ToRgbaRowAvx2(const uint8_t* src, uint8_t* dst, int width) {
+    const __m256i shuffle = _mm256_setr_epi8(BGR24_TO_RGBA_SHUFFLE, BGR24_TO_RGBA_SHUFFLE);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+    int x = 0;
+    for (; x + 34 <= width; x += 32) {
+        for (int i = 0; i < 4; ++i) {
+            const __m256i pixels = LoadBgr24x8(src + i * 24);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 32),
+                                _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+        }
+        src += 96;
+        dst += 128;
+    }
+    for (; x + 10 <= width; x += 8) {
+        const __m256i pixels = LoadBgr24x8(src);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst),
+                            _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+        src += 24;
+        dst += 32;
+    }
+
+    Bgr24ToRgbaRowScalar(src, dst, width - x);
+}
+
+#define BGRA32_TO_RGBA_SHUFFLE 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+
+TARGET_SSSE3 static void Bgra32ToRgbaRowSsse3(const uint8_t* src, uint8_t* dst, int width) {
+    const __m128i shuffle = _mm_setr_epi8(BGRA32_TO_RGBA_SHUFFLE);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+        src += 16;
+        dst += 16;
+    }
+
+    Bgra32ToRgbaRowScalar(src, dst, width - x);
+}
+
+TARGET_AVX2 static void Bgra32ToRgbaRowAvx2(const uint8_t* src, uint8_t* dst, int width) {
+    const __m256i shuffle = _mm256_setr_epi8(BGRA32_TO_RGBA_SHUFFLE, BGRA32_TO_RGBA_SHUFFLE);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+        src += 32;
+        dst += 32;
+    }
+
+    Bgra32ToRgbaRowScalar(src, dst, width - x);
+}
+
+// YUV coefficients broadcast as the 16-bit pairs _mm_madd_epi16 consumes.
+// Pixels are interleaved with the matching chroma (or the constant 1) so one
+// madd yields yGain*y' + coef*c' per 32-bit lane.
+struct YuvConstantsSse {
+    __m128i yOffset;
+    __m128i chromaBias;
+    __m128i yR;      // (yGain, rV)
+    __m128i yG;      // (yGain, gU)
+    __m128i yB;      // (yGain, bU)
+    __m128i vRoundG; // (gV, round)
+    __m128i round;
+};
+
+TARGET_SSSE3 static inline __m128i PairConstant(int lo, int hi) {
+    return _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(hi) << 16) | static_cast<uint16_t>(lo)));
+}
+
+TARGET_SSSE3 static YuvConstantsSse MakeYuvConstantsSse(const YuvCoefficients& k) {
+    YuvConstantsSse c;
+    c.yOffset = _mm_set1_epi16(k.yOffset);
+    c.chromaBias = _mm_set1_epi16(128);
+    c.yR = PairConstant(k.yGain, k.rV);
+    c.yG = PairConstant(k.yGain, k.gU);
+    c.yB = PairConstant(k.yGain, k.bU);
+    c.vRoundG = PairConstant(k.gV, kYuvRound);
+    c.round = _mm_set1_epi32(kYuvRound);
+    return c;
+}
+
+// 8 pixels: y, u and v hold one signed 16-bit value per pixel (luma already
+// offset, chroma already centred). Writes 32 bytes of RGBA.
+TARGET_SSSE3 static inline void StoreYuvAsRgba8(__m128i y, __m128i u, __m128i v, const YuvConstantsSse& c, uint8_t* dst) {
+    const __m128i one = _mm_set1_epi16(1);
+
+    const __m128i yuLo = _mm_unpacklo_epi16(y, u);
+    const __m128i yuHi = _mm_unpackhi_epi16(y, u);
+    const __m128i yvLo = _mm_unpacklo_epi16(y, v);
+    const __m128i yvHi = _mm_unpackhi_epi16(y, v);
+    const __m128i v1Lo = _mm_unpacklo_epi16(v, one);
+    const __m128i v1Hi = _mm_unpackhi_epi16(v, one);
+
+    const __m128i r = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvLo, c.yR), c.round), kYuvShift),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvHi, c.yR), c.round), kYuvShift));
+    const __m128i g = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuLo, c.yG), _mm_madd_epi16(v1Lo, c.vRoundG)), kYuvShift),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuHi, c.yG), _mm_madd_epi16(v1Hi, c.vRoundG)), kYuvShift));
+    const __m128i b = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuLo, c.yB), c.round), kYuvShift),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuHi, c.yB), c.round), kYuvShift));
+
+    // Saturate to bytes and interleave to R G B A.
+    const __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), _mm_packus_epi16(g, g));
+    const __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_set1_epi8(-1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+// 16 pixels from 16 luma bytes and 8 chroma samples per plane (16-bit lanes,
+// not yet centred). Each chroma sample covers two neighbouring pixels.
+TARGET_SSSE3 static inline void StoreYuv422AsRgba16(__m128i luma, __m128i u, __m128i v, const YuvConstantsSse& c, uint8_t* dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i yLo = _mm_sub_epi16(_mm_unpacklo_epi8(luma, zero), c.yOffset);
+    const __m128i yHi = _mm_sub_epi16(_mm_unpackhi_epi8(luma, zero), c.yOffset);
+    u = _mm_sub_epi16(u, c.chromaBias);
+    v = _mm_sub_epi16(v, c.chromaBias);
+    StoreYuvAsRgba8(yLo, _mm_unpacklo_epi16(u, u), _mm_unpacklo_epi16(v, v), c, dst);
+    StoreYuvAsRgba8(yHi, _mm_unpackhi_epi16(u, u), _mm_unpackhi_epi16(v, v), c, dst + 32);
+}
+
+TARGET_SSSE3 static void Yuy2ToRgbaRowSsse3(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& k) {
+    const YuvConstantsSse c = MakeYuvConstantsSse(k);
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        const __m128i luma = _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes));
+        const __m128i chroma = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        StoreYuv422AsRgba16(luma, _mm_and_si128(chroma, lowBytes), _mm_srli_epi16(chroma, 8), c, dst);
+        src += 32;
+        dst += 64;
+    }
+
+    Yuy2ToRgbaRowScalar(src, dst, width - x, k);
+}
+
+TARGET_SSSE3 static void Nv12ToRgbaRowSsse3(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& k) {
+    const YuvConstantsSse c = MakeYuvConstantsSse(k);
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+        const __m128i chroma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + x));
+        StoreYuv422AsRgba16(luma, _mm_and_si128(chroma, lowBytes), _mm_srli_epi16(chroma, 8), c, dst);
+        dst += 64;
+    }
+
+    Nv12ToRgbaRowScalar(y + x, uv + x, dst, width - x, k);
+}
+
+TARGET_SSSE3 static void I420ToRgbaRowSsse3(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k) {
+    const YuvConstantsSse c = MakeYuvConstantsSse(k);
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+        const __m128i cb = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2)), zero);
+        const __m128i cr = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2)), zero);
+        StoreYuv422AsRgba16(luma, cb, cr, c, dst);
+        dst += 64;
+    }
+
+    I420ToRgbaRowScalar(y + x, u + x / 2, v + x / 2, dst, width - x, k);
+}
+
+TARGET_SSSE3 static void I444ToRgbaRowSsse3(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& k) {
+    const YuvConstantsSse c = MakeYuvConstantsSse(k);
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+        const __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x));
+        const __m128i cr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x));
+        StoreYuvAsRgba8(_mm_sub_epi16(_mm_unpacklo_epi8(luma, zero), c.yOffset),
+                        _mm_sub_epi16(_mm_unpacklo_epi8(cb, zero), c.chromaBias),
+                        _mm_sub_epi16(_mm_unpacklo_epi8(cr, zero), c.chromaBias), c, dst);
+        StoreYuvAsRgba8(_mm_sub_epi16(_mm_unpackhi_epi8(luma, zero), c.yOffset),
+                        _mm_sub_epi16(_mm_unpackhi_epi8(cb, zero), c.chromaBias),
+                        _mm_sub_epi16(_mm_unpackhi_epi8(cr, zero), c.chromaBias), c, dst + 32);
+        dst += 64;
+    }
+
+    I444ToRgbaRowScalar(y + x, u + x, v + x, dst, width - x, k);
+}
+
+// SSE2 is enough for moving whole pixels; these share the SSSE3 and AVX2 tables.
+TARGET_SSSE3 static void ReverseRgbaRowSsse3(const uint8_t* src, uint8_t* dst, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (width - x - 4) * 4), _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    ReverseRgbaRowScalar(src + x * 4, dst, width - x);
+}
+
+// Transpose in 4x4 pixel blocks. Walking the destination rows four at a time
+// keeps the writes to whole cache lines when the block is 16 pixels high.
+TARGET_SSSE3 static void TransposeRgbaSsse3(const uint8_t* src, ptrdiff_t srcStride, uint8_t* dst, ptrdiff_t dstStride, int width, int height) {
+    const int blockWidth = width & ~3;
+    const int blockHeight = height & ~3;
+    for (int x = 0; x < blockWidth; x += 4) {
+        const uint8_t* in = src + x * 4;
+        uint8_t* out = dst + x * dstStride;
+        for (int y = 0; y < blockHeight; y += 4) {
+            const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (y + 0) * srcStride));
+            const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (y + 1) * srcStride));
+            const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (y + 2) * srcStride));
+            const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + (y + 3) * srcStride));
+            const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 0 * dstStride + y * 4), _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 1 * dstStride + y * 4), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * dstStride + y * 4), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3 * dstStride + y * 4), _mm_unpackhi_epi64(t2, t3));
+        }
+    }
+
+    // Ragged right and bottom edges
+    TransposeRgbaScalar(src + blockHeight * srcStride, srcStride, dst + blockHeight * 4, dstStride, blockWidth, height - blockHeight);
+    TransposeRgbaScalar(src + blockWidth * 4, srcStride, dst + blockWidth * dstStride, dstStride, width - blockWidth, height);
+}
+
+const PixelKernels* GetSsse3PixelKernels() {
+    static const PixelKernels kernels = {
+        "SSSE3",
+        Bgr24ToRgbaRowSsse3,
+        Bgra32ToRgbaRowSsse3,
+        Yuy2ToRgbaRowSsse3,
+        Nv12ToRgbaRowSsse3,
+        I420ToRgbaRowSsse3,
+        I444ToRgbaRowSsse3,
+        ReverseRgbaRowSsse3,
+        TransposeRgbaSsse3,
+    };
+    return &kernels;
+}
+
+const PixelKernels* GetAvx2PixelKernels() {
+    static const PixelKernels kernels = {
+        "AVX2",
+        Bgr24ToRgbaRowAvx2,
+        Bgra32ToRgbaRowAvx2,
+        // The YUV kernels are bound by the chroma upsampling shuffles, which
+        // AVX2 can only do within 128-bit lanes; the SSSE3 versions are used.
+        Yuy2ToRgbaRowSsse3,
+        Nv12ToRgbaRowSsse3,
+        I420ToRgbaRowSsse3,
+        I444ToRgbaRowSsse3,
+        ReverseRgbaRowSsse3,
+        TransposeRgbaSsse3,
+    };
+    return &kernels;
+}
+
+#else
+
+const PixelKernels* GetSsse3PixelKernels() { return nullptr; }
+const PixelKernels* GetAvx2PixelKernels() { return nullptr; }
+
+#endif
@@ -0,0 +1,143 @@
+#include "RawFrameFile.h"
+#include <cstring>
+
+static const char kRawMagic[8] = { 'Q', 'R', 'A', 'W', 'C', 'A', 'P', '1' };
+static const uint32_t kRawVersion = 1;
+
+#pragma pack(push, 1)
+struct RawFrameRecord {
+    uint32_t size;
+    int32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t flags;
+    double sampleTime;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(RawFrameRecord) == kRawRecordHeaderSize, "RawFrameRecord is part of the file format");
+
+void EncodeRawFileHeader(uint8_t* out) {
+    memset(out, 0, kRawFileHeaderSize);
+    memcpy(out, kRawMagic, sizeof(kRawMagic));
+    memcpy(out + 8, &kRawVersion, sizeof(kRawVersion));
+}
+
+void EncodeRawRecordHeader(uint8_t* out, const VideoFormat& format, size_t size, double sampleTime) {
+    RawFrameRecord record;
+    record.size = static_cast<uint32_t>(size);
+    record.format = static_cast<int32_t>(format.format);
+    record.width = format.width;
+    record.height = format.height;
+    record.stride = format.stride;
+    record.flags = format.topDown ? 1u : 0u;
+    record.sampleTime = sampleTime;
+    memcpy(out, &record, sizeof(record));
+}
+
+bool DecodeRawRecordHeader(const uint8_t* in, VideoFormat* format, size_t* size, double* sampleTime) {
+    RawFrameRecord record;
+    memcpy(&record, in, sizeof(record));
+    if (record.size == 0 || record.size > kRawMaxFrameSize || record.format <= 0
+        || record.format > static_cast<int32_t>(PixelFormat::MJPEG)) {
+        return false;
+    }
+    format->format = static_cast<PixelFormat>(record.format);
+    format->width = record.width;
+    format->height = record.height;
+    format->stride = record.stride;
+    format->topDown = (record.flags & 1u) != 0;
+    *size = record.size;
+    *sampleTime = record.sampleTime;
+    return true;
+}
+
+bool RawFrameWriter::Open(const std::filesystem::path& path) {
+    Close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    uint8_t header[kRawFileHeaderSize];
+    EncodeRawFileHeader(header);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    return static_cast<bool>(file);
+}
+
+bool RawFrameWriter::Write(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) {
+    if (!file.is_open() || size > kRawMaxFrameSize) {
+        return false;
+    }
+
+    uint8_t record[kRawRecordHeaderSize];
+    EncodeRawRecordHeader(record, format, size, sampleTime);
+    file.write(reinterpret_cast<const char*>(record), sizeof(record));
+    file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    return static_cast<bool>(file);
+}
+
+void RawFrameWriter::Close() {
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+bool RawFrameReader::Open(const std::filesystem::path& path) {
+    Close();
+    file.open(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    char header[kRawFileHeaderSize];
+    uint32_t version = 0;
+    if (!file.read(header, sizeof(header)) || memcmp(header, kRawMagic, sizeof(kRawMagic)) != 0) {
+        Close();
+        return false;
+    }
+    memcpy(&version, header + 8, sizeof(version));
+    if (version != kRawVersion) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void RawFrameReader::Close() {
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+bool RawFrameReader::Next(VideoFormat* format, std::vector<uint8_t>* data, size_t* size, double* sampleTime) {
+    uint8_t record[kRawRecordHeaderSize];
+    VideoFormat layout;
+    size_t bytes = 0;
+    double time = 0.0;
+    if (!file.read(reinterpret_cast<char*>(record), sizeof(record)) ||
+        !DecodeRawRecordHeader(record, &layout, &bytes, &time)) {
+        return false;
+    }
+
+    if (data->size() < bytes) {
+        data->resize(bytes);
+    }
+    if (!file.read(reinterpret_cast<char*>(data->data()), static_cast<std::streamsize>(bytes))) {
+        return false;
+    }
+    *format = layout;
+    *size = bytes;
+    *sampleTime = time;
+    return true;
+}
+
+bool RawFrameReader::Rewind() {
+    if (!file.is_open()) {
+        return false;
+    }
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(kRawFileHeaderSize));
+    return static_cast<bool>(file);
+}
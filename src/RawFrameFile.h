@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include "VideoFrame.h"
+
+// A capture stream stored frame by frame, exactly as the source delivered
+// it, for replaying through the frame path without a camera.
+//
+// Layout, little-endian:
+//   header  "QRAWCAP1" (8 bytes), uint32 version, uint32 reserved
+//   frame   uint32 size, int32 format, width, height, stride, uint32 flags,
+//           double sampleTime, then 'size' bytes of frame data
+// Each frame carries its own layout, so format changes survive a recording.
+// flags bit 0 is VideoFormat::topDown.
+
+// For writers that lay the file out in their own buffers, such as
+// SegmentedRecorder: a file starts with EncodeRawFileHeader(), then each
+// frame is EncodeRawRecordHeader() followed by the frame data.
+constexpr size_t kRawFileHeaderSize = 16;
+constexpr size_t kRawRecordHeaderSize = 32;
+constexpr size_t kRawMaxFrameSize = 256u << 20;  // Larger records mean a damaged file
+
+void EncodeRawFileHeader(uint8_t* out);
+void EncodeRawRecordHeader(uint8_t* out, const VideoFormat& format, size_t size, double sampleTime);
+
+// Returns false for a record header no writer produces.
+bool DecodeRawRecordHeader(const uint8_t* in, VideoFormat* format, size_t* size, double* sampleTime);
+
+class RawFrameWriter {
+public:
+    bool Open(const std::filesystem::path& path);
+    bool Write(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime);
+    void Close();
+    bool IsOpen() const { return file.is_open(); }
+
+private:
+    std::ofstream file;
+};
+
+class RawFrameReader {
+public:
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    // Read the next frame into 'data', reusing its storage. Returns false at
+    // the end of the file or on a damaged record.
+    bool Next(VideoFormat* format, std::vector<uint8_t>* data, size_t* size, double* sampleTime);
+
+    // Go back to the first frame.
+    bool Rewind();
+
+private:
+    std::ifstream file;
+};
@@ -1,4 +1,6 @@
 #include "Renderer.h"
+#include "AllocationTracker.h"
+#include "Trace.h"
 
 Renderer::Renderer() {}
 
@@ -50,10 +52,13 @@ void Renderer::Cleanup() {
 }
 
 void Renderer::Render() {
+    TRACE_SCOPE("Renderer::Render");
+    ALLOC_SCOPE("Display");
     const float clear_color_with_alpha[4] = { 0.0f, 0.0f, 0.0f, 1.00f };
     g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, nullptr);
     g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color_with_alpha);
     ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    TRACE_SCOPE("Present");
     g_pSwapChain->Present(1, 0); // Present with vsync
 }
 
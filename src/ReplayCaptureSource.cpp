@@ -0,0 +1,121 @@
+#include "ReplayCaptureSource.h"
+#include <chrono>
+#include "Trace.h"
+
+ReplayCaptureSource::ReplayCaptureSource(const ReplaySourceConfig& config)
+    : config(config) {
+}
+
+ReplayCaptureSource::~ReplayCaptureSource() {
+    Stop();
+}
+
+long ReplayCaptureSource::Open(const CapturePolicy&, CameraOpenContext& context) {
+    context.Step("Opening recording");
+    if (!reader.Open(config.path)) {
+        return kCaptureErrorNotFound;
+    }
+
+    // The first two frames give the layout and the frame rate.
+    size_t size = 0;
+    double first = 0.0;
+    double second = 0.0;
+    if (!reader.Next(&layout, &buffer, &size, &first)) {
+        return kCaptureErrorBadFormat;
+    }
+    VideoFormat next;
+    const bool haveSecond = reader.Next(&next, &buffer, &size, &second);
+    if (!reader.Rewind()) {
+        return kCaptureErrorFail;
+    }
+
+    CaptureMode mode;
+    mode.index = 0;
+    mode.format = layout.format;
+    mode.width = layout.width;
+    mode.height = layout.height;
+    if (haveSecond && second > first) {
+        mode.minFps = mode.maxFps = 1.0 / (second - first);
+    }
+    capabilities.Clear();
+    capabilities.Add(mode);
+    return 0;
+}
+
+long ReplayCaptureSource::Start(CaptureSink* frameSink) {
+    if (!frameSink || capabilities.Empty()) {
+        return kCaptureErrorInvalidArg;
+    }
+    Stop();
+    reader.Rewind();
+
+    sink = frameSink;
+    stopping = false;
+    delivered.store(0, std::memory_order_relaxed);
+    worker = std::thread(&ReplayCaptureSource::Run, this);
+    return 0;
+}
+
+void ReplayCaptureSource::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void ReplayCaptureSource::Run() {
+    TRACE_THREAD_NAME("Replay source");
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point start = Clock::now();
+    double firstTime = 0.0;
+    double lastTime = 0.0;
+    double lastInterval = 1.0 / 30.0;
+    double loopOffset = 0.0;  // Added to the recorded times of the current pass
+    bool firstOfPass = true;
+
+    VideoFormat format;
+    size_t size = 0;
+    double recorded = 0.0;
+    for (uint64_t i = 0; config.frameLimit == 0 || i < config.frameLimit; ++i) {
+        if (!reader.Next(&format, &buffer, &size, &recorded)) {
+            if (!config.loop || firstOfPass || !reader.Rewind()) {
+                break;  // End of file, or a file without a single frame
+            }
+            loopOffset += lastTime - firstTime + lastInterval;
+            firstOfPass = true;
+            --i;
+            continue;
+        }
+        if (firstOfPass) {
+            firstTime = recorded;
+            firstOfPass = false;
+        }
+        else if (recorded > lastTime) {
+            lastInterval = recorded - lastTime;
+        }
+        lastTime = recorded;
+
+        const double sampleTime = recorded - firstTime + loopOffset;
+        if (config.realtime) {
+            const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(sampleTime));
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wakeup.wait_until(lock, deadline, [this] { return stopping; })) {
+                break;
+            }
+        }
+        else {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+        }
+
+        sink->OnFrame(format, buffer.data(), size, sampleTime);
+        delivered.fetch_add(1, std::memory_order_relaxed);
+    }
+}
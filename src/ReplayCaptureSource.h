@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CaptureSource.h"
+#include "RawFrameFile.h"
+
+struct ReplaySourceConfig {
+    std::filesystem::path path;
+    bool realtime = true;     // Pace by the recorded timestamps; false delivers back to back
+    bool loop = true;         // Start over at the end of the file
+    uint64_t frameLimit = 0;  // Stop after this many frames; 0 for no limit
+};
+
+// Plays back a raw frame file (see RawFrameFile.h) as if it came from the
+// camera that recorded it. Timestamps keep increasing across loops.
+class ReplayCaptureSource : public CaptureSource {
+public:
+    explicit ReplayCaptureSource(const ReplaySourceConfig& config);
+    ~ReplayCaptureSource() override;
+
+    long Open(const CapturePolicy& policy, CameraOpenContext& context) override;
+    long Start(CaptureSink* sink) override;
+    void Stop() override;
+
+    const CaptureCapabilities& Capabilities() const override { return capabilities; }
+    int SelectedMode() const override { return capabilities.Empty() ? -1 : 0; }
+    VideoFormat Format() const override { return layout; }
+
+    uint64_t FramesDelivered() const { return delivered.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+
+    ReplaySourceConfig config;
+    RawFrameReader reader;
+    VideoFormat layout;
+    CaptureCapabilities capabilities;
+    std::vector<uint8_t> buffer;
+
+    CaptureSink* sink = nullptr;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+    std::atomic<uint64_t> delivered{ 0 };
+};
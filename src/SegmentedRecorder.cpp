@@ -0,0 +1,498 @@
+#include "SegmentedRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "FrameLatency.h"
+#include "Log.h"
+#include "RawFrameFile.h"
+#include "ThreadCpu.h"
+#include "Trace.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Writes are split into calls of at most this size, so one call never ties
+// up the I/O thread for long and the write latency histogram stays useful.
+static const size_t kMaxWriteBytes = 8u << 20;
+
+// File space is reserved in steps of this size, up to segmentBytes.
+static const uint64_t kPreallocateStep = 256ull << 20;
+
+// AVI headers claim this rate until a segment's frames give the real one
+static const double kNominalAviFps = 30.0;
+
+const char* RecordingContainerName(RecordingContainer container) {
+    switch (container) {
+    case RecordingContainer::Raw: return "Raw (.qraw)";
+    case RecordingContainer::Avi: return "AVI (.avi)";
+    }
+    return "Unknown";
+}
+
+static bool SameLayout(const VideoFormat& a, const VideoFormat& b) {
+    return a.format == b.format && a.width == b.width && a.height == b.height && a.stride == b.stride &&
+        a.topDown == b.topDown;
+}
+
+static uint8_t* AllocateAligned(size_t bytes) {
+#if defined(_WIN32)
+    return static_cast<uint8_t*>(_aligned_malloc(bytes, SegmentedRecorder::kAlignment));
+#else
+    return static_cast<uint8_t*>(std::aligned_alloc(SegmentedRecorder::kAlignment, bytes));
+#endif
+}
+
+static void FreeAligned(uint8_t* data) {
+#if defined(_WIN32)
+    _aligned_free(data);
+#else
+    std::free(data);
+#endif
+}
+
+static size_t AlignUp(size_t bytes) {
+    return (bytes + SegmentedRecorder::kAlignment - 1) & ~(SegmentedRecorder::kAlignment - 1);
+}
+
+SegmentedRecorder::SegmentedRecorder(const RecorderOptions& options)
+    : options(options) {
+}
+
+SegmentedRecorder::~SegmentedRecorder() {
+    Stop();
+    for (WriteBuffer& buffer : buffers) {
+        FreeAligned(buffer.data);
+    }
+}
+
+std::filesystem::path SegmentedRecorder::SegmentPath(uint64_t index) const {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "-%04llu%s", static_cast<unsigned long long>(index),
+        options.container == RecordingContainer::Avi ? ".avi" : ".qraw");
+    return options.directory / (options.baseName + suffix);
+}
+
+bool SegmentedRecorder::Start() {
+    if (Running()) {
+        return true;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(options.directory, error);
+    if (error) {
+        LOG_ERROR("Recorder", "Cannot create %s: %s", options.directory.string().c_str(), error.message().c_str());
+        return false;
+    }
+
+    // Room for the padding of a segment's last, unaligned write
+    const size_t capacity = AlignUp(options.bufferBytes) + kAlignment;
+    for (WriteBuffer& buffer : buffers) {
+        if (!buffer.data) {
+            buffer.data = AllocateAligned(capacity);
+            if (!buffer.data) {
+                LOG_ERROR("Recorder", "Cannot allocate %zu byte write buffers", capacity);
+                return false;
+            }
+            // Touch every page now rather than on the first pass of Enqueue()
+            memset(buffer.data, 0, capacity);
+        }
+        buffer.state.store(BufferState::Free, std::memory_order_relaxed);
+    }
+    current = -1;
+    next = 0;
+    ioNext = 0;
+    segmentIndex = 0;
+    segmentFilled = 0;
+    rollPending = false;
+    carryBytes = 0;
+    stopping = false;
+    ioThread = std::thread(&SegmentedRecorder::Run, this);
+    return true;
+}
+
+void SegmentedRecorder::Stop() {
+    if (!Running()) {
+        return;
+    }
+    if (segmentFilled != 0) {
+        // Close the last segment with whatever is left, waiting for a buffer
+        // if need be; only Enqueue() must never wait.
+        while (current < 0 && !BeginBuffer()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        HandOff(true);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    ioThread.join();
+}
+
+RecorderStats SegmentedRecorder::GetStats() const {
+    RecorderStats stats;
+    stats.framesRecorded = framesRecorded.load(std::memory_order_relaxed);
+    stats.framesDropped = framesDropped.load(std::memory_order_relaxed);
+    stats.bytesWritten = bytesWritten.load(std::memory_order_relaxed);
+    stats.segments = segments.load(std::memory_order_relaxed);
+    stats.writeErrors = writeErrors.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool SegmentedRecorder::SegmentFull(size_t recordBytes, int64_t now) const {
+    if (options.segmentBytes > 0 && segmentFilled > kRawFileHeaderSize &&
+        segmentFilled + recordBytes > options.segmentBytes) {
+        return true;
+    }
+    return options.segmentSeconds > 0.0 && now - segmentStart >= static_cast<int64_t>(options.segmentSeconds * 1e9);
+}
+
+bool SegmentedRecorder::Enqueue(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) {
+    if (!Running()) {
+        return false;
+    }
+    const auto drop = [this] {
+        framesDropped.store(framesDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    };
+
+    // A record must fit in an empty buffer behind a segment header and the
+    // carried-over tail of the previous buffer.
+    const size_t recordBytes = kRawRecordHeaderSize + size;
+    if (size == 0 || size > kRawMaxFrameSize || recordBytes + kRawFileHeaderSize + kAlignment > options.bufferBytes) {
+        return drop();
+    }
+
+    const int64_t now = MonotonicNanos();
+    const bool formatChanged = options.container == RecordingContainer::Avi && segmentIndex != 0 &&
+        !SameLayout(format, segmentFormat);
+    if (segmentIndex == 0 || rollPending || formatChanged || SegmentFull(recordBytes, now)) {
+        if (segmentIndex != 0) {
+            // The segment's last bytes leave in a buffer flagged to close it
+            if (current < 0 && !BeginBuffer()) {
+                rollPending = true;
+                return drop();
+            }
+            HandOff(true);
+        }
+        rollPending = false;
+        ++segmentIndex;
+        segmentFilled = 0;
+        segmentStart = now;
+        segmentFormat = format;
+    }
+
+    if (current >= 0 && buffers[current].used + recordBytes > options.bufferBytes) {
+        HandOff(false);
+    }
+    if (current < 0 && !BeginBuffer()) {
+        return drop();  // The disk is behind and both buffers are queued
+    }
+
+    WriteBuffer& buffer = buffers[current];
+    EncodeRawRecordHeader(buffer.data + buffer.used, format, size, sampleTime);
+    memcpy(buffer.data + buffer.used + kRawRecordHeaderSize, data, size);
+    buffer.used += recordBytes;
+    segmentFilled += recordBytes;
+    framesRecorded.store(framesRecorded.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // Don't let a slow trickle of frames sit in memory
+    if (options.flushSeconds > 0.0 && buffer.used >= kAlignment &&
+        now - bufferStart >= static_cast<int64_t>(options.flushSeconds * 1e9)) {
+        HandOff(false);
+    }
+    return true;
+}
+
+bool SegmentedRecorder::BeginBuffer() {
+    WriteBuffer& buffer = buffers[next];
+    if (buffer.state.load(std::memory_order_acquire) != BufferState::Free) {
+        return false;
+    }
+    buffer.state.store(BufferState::Filling, std::memory_order_relaxed);
+    buffer.segment = segmentIndex;
+    buffer.endsSegment = false;
+    buffer.startsSegment = segmentFilled == 0;
+    if (buffer.startsSegment && options.container == RecordingContainer::Avi) {
+        buffer.used = 0;  // The AviWriter writes the file's headers
+    }
+    else if (buffer.startsSegment) {
+        EncodeRawFileHeader(buffer.data);
+        buffer.used = kRawFileHeaderSize;
+        segmentFilled = kRawFileHeaderSize;
+    }
+    else {
+        memcpy(buffer.data, carry, carryBytes);
+        buffer.used = carryBytes;
+    }
+    carryBytes = 0;
+    current = next;
+    next ^= 1;
+    bufferStart = MonotonicNanos();
+    return true;
+}
+
+void SegmentedRecorder::HandOff(bool endSegment) {
+    WriteBuffer& buffer = buffers[current];
+    buffer.endsSegment = endSegment;
+    if (!endSegment && options.container == RecordingContainer::Raw) {
+        // Only whole blocks go out; the rest starts the next buffer, so every
+        // write lands at an aligned file offset.
+        const size_t aligned = buffer.used & ~(kAlignment - 1);
+        carryBytes = buffer.used - aligned;
+        memcpy(carry, buffer.data + aligned, carryBytes);
+        buffer.used = aligned;
+    }
+    // The I/O thread only takes the mutex to go to sleep, so it is locked
+    // here only to wake a thread that has, never behind a write.
+    buffer.state.store(BufferState::Queued, std::memory_order_seq_cst);
+    if (ioWaiting.load(std::memory_order_seq_cst)) {
+        { std::lock_guard<std::mutex> lock(mutex); }
+        wakeup.notify_one();
+    }
+    current = -1;
+}
+
+void SegmentedRecorder::Run() {
+    TRACE_THREAD_NAME("Recorder I/O");
+    RegisterThreadCpu("Recorder I/O");
+    for (;;) {
+        WriteBuffer& buffer = buffers[ioNext];
+        if (buffer.state.load(std::memory_order_acquire) != BufferState::Queued) {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Set before checking, so a hand-off either is seen here or sees
+            // the flag and notifies.
+            ioWaiting.store(true, std::memory_order_seq_cst);
+            wakeup.wait(lock, [&] { return stopping || buffer.state.load(std::memory_order_seq_cst) == BufferState::Queued; });
+            ioWaiting.store(false, std::memory_order_relaxed);
+            if (buffer.state.load(std::memory_order_acquire) != BufferState::Queued) {
+                break;  // Stopping with nothing left to write
+            }
+        }
+        WriteBufferToDisk(buffer);
+        buffer.state.store(BufferState::Free, std::memory_order_release);
+        ioNext ^= 1;
+    }
+    CloseSegment();
+}
+
+void SegmentedRecorder::WriteBufferToDisk(WriteBuffer& buffer) {
+    TRACE_SCOPE("SegmentedRecorder::WriteBufferToDisk");
+    if (buffer.startsSegment) {
+        CloseSegment();
+        segmentFailed = options.container == RecordingContainer::Avi ? !OpenAviSegment(buffer) : !OpenSegment(buffer.segment);
+    }
+    if (!segmentFailed && options.container == RecordingContainer::Avi) {
+        WriteFramesToAvi(buffer);
+    }
+    else if (!segmentFailed && buffer.used > 0) {
+        // The segment's last write is padded to a whole block; the file is
+        // cut back to its real size when it is closed.
+        const size_t bytes = buffer.endsSegment ? AlignUp(buffer.used) : buffer.used;
+        memset(buffer.data + buffer.used, 0, bytes - buffer.used);
+        if (WriteAligned(buffer.data, bytes)) {
+            segmentBytesWritten += buffer.used;
+            bytesWritten.fetch_add(buffer.used, std::memory_order_relaxed);
+        }
+        else {
+            LOG_ERROR("Recorder", "Write to %s failed; dropping the rest of the segment",
+                SegmentPath(buffer.segment).string().c_str());
+            writeErrors.fetch_add(1, std::memory_order_relaxed);
+            segmentFailed = true;
+        }
+    }
+    if (buffer.endsSegment) {
+        CloseSegment();
+    }
+}
+
+bool SegmentedRecorder::OpenSegment(uint64_t index) {
+    const std::filesystem::path path = SegmentPath(index);
+    fileOffset = 0;
+    preallocated = 0;
+    preallocateFailed = false;
+    segmentBytesWritten = 0;
+
+#if defined(_WIN32)
+    const DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    if (options.unbuffered) {
+        handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, flags | FILE_FLAG_NO_BUFFERING, nullptr);
+    }
+    fileUnbuffered = handle != INVALID_HANDLE_VALUE;
+    if (!fileUnbuffered) {
+        handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, flags, nullptr);
+    }
+    if (handle == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Recorder", "Cannot create %s: %lu", path.string().c_str(), GetLastError());
+        writeErrors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    file = handle;
+#else
+    int fd = -1;
+#if defined(O_DIRECT)
+    if (options.unbuffered) {
+        // Some file systems, tmpfs among them, refuse O_DIRECT
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+    }
+#endif
+    fileUnbuffered = fd >= 0;
+    if (fd < 0) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) {
+        LOG_ERROR("Recorder", "Cannot create %s: %d", path.string().c_str(), errno);
+        writeErrors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    file = fd;
+#endif
+    segments.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO("Recorder", "Recording to %s%s", path.string().c_str(), fileUnbuffered ? " (unbuffered)" : "");
+    return true;
+}
+
+bool SegmentedRecorder::OpenAviSegment(const WriteBuffer& buffer) {
+    // The segment takes the layout of its first frame
+    const std::filesystem::path path = SegmentPath(buffer.segment);
+    segmentBytesWritten = 0;
+    aviFrames = 0;
+
+    VideoFormat format;
+    size_t size = 0;
+    double sampleTime = 0.0;
+    if (buffer.used < kRawRecordHeaderSize || !DecodeRawRecordHeader(buffer.data, &format, &size, &sampleTime)) {
+        return false;
+    }
+    if (!avi.Open(path, format, kNominalAviFps)) {
+        LOG_ERROR("Recorder", "Cannot record %dx%d %s frames to %s", format.width, format.height,
+            PixelFormatName(format.format), path.string().c_str());
+        writeErrors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    segments.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO("Recorder", "Recording to %s", path.string().c_str());
+    return true;
+}
+
+void SegmentedRecorder::WriteFramesToAvi(const WriteBuffer& buffer) {
+    // The buffer holds whole records; only the frame data goes to the file.
+    size_t offset = 0;
+    while (offset + kRawRecordHeaderSize <= buffer.used) {
+        VideoFormat format;
+        size_t size = 0;
+        double sampleTime = 0.0;
+        if (!DecodeRawRecordHeader(buffer.data + offset, &format, &size, &sampleTime)) {
+            break;
+        }
+        const int64_t start = MonotonicNanos();
+        if (!avi.WriteFrame(buffer.data + offset + kRawRecordHeaderSize, size)) {
+            LOG_ERROR("Recorder", "Write to %s failed; dropping the rest of the segment",
+                SegmentPath(buffer.segment).string().c_str());
+            writeErrors.fetch_add(1, std::memory_order_relaxed);
+            segmentFailed = true;
+            break;
+        }
+        writeLatency.Record(MonotonicNanos() - start);
+        if (aviFrames++ == 0) {
+            aviFirstTime = sampleTime;
+        }
+        aviLastTime = sampleTime;
+        offset += kRawRecordHeaderSize + size;
+    }
+    bytesWritten.fetch_add(avi.BytesWritten() - segmentBytesWritten, std::memory_order_relaxed);
+    segmentBytesWritten = avi.BytesWritten();
+}
+
+void SegmentedRecorder::CloseSegment() {
+    if (avi.IsOpen()) {
+        // AVI has one frame rate per stream; take the average over the segment
+        if (aviFrames > 1 && aviLastTime > aviFirstTime) {
+            avi.SetFramesPerSecond((aviFrames - 1) / (aviLastTime - aviFirstTime));
+        }
+        const uint64_t before = avi.BytesWritten();
+        if (!avi.Close() && !segmentFailed) {
+            writeErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+        bytesWritten.fetch_add(avi.BytesWritten() - before, std::memory_order_relaxed);
+        return;
+    }
+#if defined(_WIN32)
+    if (!file) {
+        return;
+    }
+    // Drop the padding and the space reserved past the end
+    FILE_END_OF_FILE_INFO end = {};
+    end.EndOfFile.QuadPart = static_cast<LONGLONG>(segmentBytesWritten);
+    SetFileInformationByHandle(file, FileEndOfFileInfo, &end, sizeof(end));
+    CloseHandle(file);
+    file = nullptr;
+#else
+    if (file < 0) {
+        return;
+    }
+    if (ftruncate(file, static_cast<off_t>(segmentBytesWritten)) != 0) {
+        LOG_WARNING("Recorder", "Cannot trim segment %llu: %d", static_cast<unsigned long long>(segments.load()), errno);
+    }
+    close(file);
+    file = -1;
+#endif
+}
+
+bool SegmentedRecorder::WriteAligned(const uint8_t* data, size_t bytes) {
+    // Reserve space ahead of the writes, so the file system can lay the
+    // segment out in long extents and a full disk shows up early.
+    if (fileOffset + bytes > preallocated && !preallocateFailed) {
+        uint64_t target = preallocated + std::max<uint64_t>(kPreallocateStep, bytes);
+        if (options.segmentBytes > 0) {
+            target = std::max<uint64_t>(std::min<uint64_t>(target, AlignUp(options.segmentBytes) + kAlignment), fileOffset + bytes);
+        }
+#if defined(_WIN32)
+        FILE_ALLOCATION_INFO allocation = {};
+        allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(target);
+        if (!SetFileInformationByHandle(file, FileAllocationInfo, &allocation, sizeof(allocation))) {
+            LOG_WARNING("Recorder", "Cannot reserve %llu bytes for segment %llu: %lu", static_cast<unsigned long long>(target),
+                static_cast<unsigned long long>(segments.load()), GetLastError());
+            preallocateFailed = true;
+        }
+#elif defined(__linux__)
+        // Keep the size, so a crash leaves no stretch of zeros behind the frames
+        if (fallocate(file, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(target)) != 0) {
+            LOG_WARNING("Recorder", "Cannot reserve %llu bytes for segment %llu: %d", static_cast<unsigned long long>(target),
+                static_cast<unsigned long long>(segments.load()), errno);
+            preallocateFailed = true;
+        }
+#endif
+        preallocated = target;
+    }
+
+    while (bytes > 0) {
+        const size_t chunk = std::min(bytes, kMaxWriteBytes);
+        const int64_t start = MonotonicNanos();
+#if defined(_WIN32)
+        DWORD written = 0;
+        if (!WriteFile(file, data, static_cast<DWORD>(chunk), &written, nullptr) || written != chunk) {
+            return false;
+        }
+#else
+        const ssize_t written = write(file, data, chunk);
+        if (written != static_cast<ssize_t>(chunk)) {
+            return false;
+        }
+#endif
+        writeLatency.Record(MonotonicNanos() - start);
+        data += chunk;
+        bytes -= chunk;
+        fileOffset += chunk;
+    }
+    return true;
+}
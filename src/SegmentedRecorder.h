@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "AviFile.h"
+#include "LatencyHistogram.h"
+#include "VideoFrame.h"
+
+enum class RecordingContainer {
+    Raw,  // Raw frame files (.qraw): any mix of formats, written unbuffered
+    Avi,  // OpenDML AVI (.avi) that players open; compressed frames stored as delivered
+};
+
+const char* RecordingContainerName(RecordingContainer container);
+
+struct RecorderOptions {
+    std::filesystem::path directory;      // Created if missing
+    std::string baseName = "capture";     // Segments are <baseName>-0001.qraw (or .avi), -0002, ...
+    RecordingContainer container = RecordingContainer::Raw;
+    double segmentSeconds = 300.0;        // Start a new segment after this long; 0 for no limit
+    uint64_t segmentBytes = 2ull << 30;   // ... or before one grows past this; 0 for no limit
+    size_t bufferBytes = 16u << 20;       // Each of the two write buffers; the largest frame that fits
+    double flushSeconds = 1.0;            // Hand a partly filled buffer to the disk after this long
+    bool unbuffered = true;               // Bypass the OS file cache where the file system allows it; Raw only
+};
+
+struct RecorderStats {
+    uint64_t framesRecorded = 0;  // Copied into a write buffer
+    uint64_t framesDropped = 0;   // Both buffers waiting for the disk, or the frame larger than a buffer
+    uint64_t bytesWritten = 0;    // Reached the file, segment headers included
+    uint64_t segments = 0;        // Segment files opened
+    uint64_t writeErrors = 0;
+};
+
+// Records frames to disk as a series of raw frame files (see RawFrameFile.h)
+// without ever making the caller wait for the disk.
+//
+// Enqueue() copies each frame into one of two large, page-aligned buffers.
+// A full buffer goes to a dedicated I/O thread, which writes it with a few
+// large aligned writes, unbuffered where possible, while the caller fills
+// the other one. When the disk falls so far behind that both buffers are
+// waiting, frames are dropped and counted instead of queueing more memory.
+//
+// Each segment's file space is preallocated ahead of the writes, and a new
+// segment starts when the current one reaches segmentSeconds or would pass
+// segmentBytes. Every segment is a complete file that ReplayCaptureSource
+// can play.
+//
+// With RecordingContainer::Avi the I/O thread hands the frames to an
+// AviWriter instead, one AVI file per segment, so MJPEG from the camera goes
+// to disk without ever being decoded. AVI holds one frame layout per file:
+// a format change starts a new segment.
+class SegmentedRecorder {
+public:
+    static constexpr size_t kAlignment = 4096;  // File offsets and write sizes, for unbuffered I/O
+
+    explicit SegmentedRecorder(const RecorderOptions& options);
+    ~SegmentedRecorder();
+
+    SegmentedRecorder(const SegmentedRecorder&) = delete;
+    SegmentedRecorder& operator=(const SegmentedRecorder&) = delete;
+
+    // Allocate the buffers and start the I/O thread. Returns false, and logs
+    // why, if the directory cannot be created. The first segment file is
+    // opened with the first frame.
+    bool Start();
+
+    // Write out everything enqueued, close the segment and stop the thread.
+    // Call from the thread that enqueues, or once it has stopped.
+    void Stop();
+
+    bool Running() const { return ioThread.joinable(); }
+
+    // Add a frame to the recording. Never waits for the disk: the cost is
+    // the copy into the buffer, plus waking the I/O thread when it sleeps.
+    // Returns false when the frame was dropped. Call from one thread at a
+    // time.
+    bool Enqueue(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime);
+
+    // Path of the segment with the given 1-based index.
+    std::filesystem::path SegmentPath(uint64_t index) const;
+
+    // Safe to call from any thread.
+    RecorderStats GetStats() const;
+
+    // Duration of each write call on the I/O thread
+    const LatencyHistogram& WriteLatency() const { return writeLatency; }
+
+private:
+    enum class BufferState : int {
+        Free,     // Available to the producer
+        Filling,  // The producer is writing frames into it
+        Queued,   // Handed to the I/O thread
+    };
+
+    struct WriteBuffer {
+        uint8_t* data = nullptr;
+        size_t used = 0;
+        uint64_t segment = 0;      // Segment the bytes belong to
+        bool startsSegment = false;
+        bool endsSegment = false;
+        std::atomic<BufferState> state{ BufferState::Free };
+    };
+
+    // Producer side
+    bool BeginBuffer();
+    void HandOff(bool endSegment);
+    bool SegmentFull(size_t recordBytes, int64_t now) const;
+
+    // I/O thread
+    void Run();
+    void WriteBufferToDisk(WriteBuffer& buffer);
+    bool OpenSegment(uint64_t index);
+    bool OpenAviSegment(const WriteBuffer& buffer);
+    void CloseSegment();
+    bool WriteAligned(const uint8_t* data, size_t bytes);
+    void WriteFramesToAvi(const WriteBuffer& buffer);
+
+    const RecorderOptions options;
+
+    WriteBuffer buffers[2];
+
+    // Producer state. 'current' is the buffer being filled, or -1 while
+    // waiting for one to come back from the I/O thread.
+    int current = -1;
+    int next = 0;                   // Buffer to take after the current one
+    uint64_t segmentIndex = 0;      // Segment being filled, 0 before the first frame
+    uint64_t segmentFilled = 0;     // Bytes put into the segment so far
+    int64_t segmentStart = 0;       // MonotonicNanos() of the segment's first frame
+    int64_t bufferStart = 0;        // When the current buffer got its first bytes
+    VideoFormat segmentFormat;      // Layout of the segment's first frame
+    bool rollPending = false;       // The segment is full but no buffer was free to end it
+    uint8_t carry[kAlignment];      // Unaligned tail of the last buffer, prepended to the next
+    size_t carryBytes = 0;
+
+    // I/O thread state
+#if defined(_WIN32)
+    void* file = nullptr;
+#else
+    int file = -1;
+#endif
+    bool fileUnbuffered = false;
+    bool segmentFailed = false;     // Stop writing the segment after an error
+    uint64_t fileOffset = 0;        // Aligned bytes written to the segment
+    uint64_t preallocated = 0;      // Bytes of file space reserved
+    bool preallocateFailed = false; // The file system refused; write without it
+    uint64_t segmentBytesWritten = 0;
+    int ioNext = 0;                 // Buffer the I/O thread writes next
+    AviWriter avi;                  // The segment being written, for RecordingContainer::Avi
+    uint64_t aviFrames = 0;
+    double aviFirstTime = 0.0;      // Sample times of the segment's first and last frames
+    double aviLastTime = 0.0;
+    LatencyHistogram writeLatency;
+
+    // Only for the I/O thread's sleep; hand-offs go through the buffer states
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> ioWaiting{ false };  // The I/O thread is asleep, or about to be
+    bool stopping = false;
+    std::thread ioThread;
+
+    std::atomic<uint64_t> framesRecorded{ 0 };
+    std::atomic<uint64_t> framesDropped{ 0 };
+    std::atomic<uint64_t> bytesWritten{ 0 };
+    std::atomic<uint64_t> segments{ 0 };
+    std::atomic<uint64_t> writeErrors{ 0 };
+};
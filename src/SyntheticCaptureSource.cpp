@@ -0,0 +1,367 @@
+#include "SyntheticCaptureSource.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include "Trace.h"
+
+// A color in both representations the pattern may be written in.
+struct PatternColor {
+    uint8_t r, g, b;
+    uint8_t y, u, v;
+};
+
+static PatternColor MakePatternColor(uint8_t r, uint8_t g, uint8_t b, YuvColorSpace colorSpace) {
+    // Limited-range encode with the matrix the display path decodes with.
+    const double kr = (colorSpace.matrix == YuvMatrix::BT709) ? 0.2126 : 0.299;
+    const double kb = (colorSpace.matrix == YuvMatrix::BT709) ? 0.0722 : 0.114;
+    const double luma = kr * r + (1.0 - kr - kb) * g + kb * b;
+
+    auto clamp = [](double value) { return static_cast<uint8_t>(std::min(255.0, std::max(0.0, std::round(value)))); };
+
+    PatternColor color;
+    color.r = r;
+    color.g = g;
+    color.b = b;
+    color.y = clamp(16.0 + luma * 219.0 / 255.0);
+    color.u = clamp(128.0 + (b - luma) / (2.0 * (1.0 - kb)) * 224.0 / 255.0);
+    color.v = clamp(128.0 + (r - luma) / (2.0 * (1.0 - kr)) * 224.0 / 255.0);
+    return color;
+}
+
+// One plane's part of a rectangle of the frame.
+struct PlaneRegion {
+    size_t offset;     // First byte of the top row
+    ptrdiff_t stride;  // Bytes to the next row down; negative for bottom-up RGB
+    int rows;
+    int bytes;         // Bytes per row
+    uint8_t fill[4];   // Byte pattern of one color, repeated along the row
+    int fillSize;
+};
+
+// Split the rectangle (x, y, w, h), all even, into its plane regions.
+static int GetPlaneRegions(const VideoFormat& layout, int x, int y, int w, int h, const PatternColor& color,
+                           PlaneRegion* regions) {
+    const size_t stride = static_cast<size_t>(layout.stride);
+    const size_t lumaSize = stride * layout.height;
+
+    auto set = [](PlaneRegion& region, size_t offset, ptrdiff_t rowStride, int rows, int bytes,
+                  std::initializer_list<uint8_t> fill) {
+        region.offset = offset;
+        region.stride = rowStride;
+        region.rows = rows;
+        region.bytes = bytes;
+        region.fillSize = 0;
+        for (uint8_t value : fill) {
+            region.fill[region.fillSize++] = value;
+        }
+    };
+
+    switch (layout.format) {
+    case PixelFormat::BGR24:
+    case PixelFormat::BGRA32: {
+        const int bpp = (layout.format == PixelFormat::BGR24) ? 3 : 4;
+        const size_t row = layout.topDown ? y : layout.height - 1 - y;
+        const ptrdiff_t rowStride = layout.topDown ? layout.stride : -layout.stride;
+        if (bpp == 3) {
+            set(regions[0], row * stride + x * 3, rowStride, h, w * 3, { color.b, color.g, color.r });
+        }
+        else {
+            set(regions[0], row * stride + x * 4, rowStride, h, w * 4, { color.b, color.g, color.r, 0xFF });
+        }
+        return 1;
+    }
+    case PixelFormat::YUY2:
+        set(regions[0], y * stride + x * 2, layout.stride, h, w * 2, { color.y, color.u, color.y, color.v });
+        return 1;
+    case PixelFormat::NV12:
+        set(regions[0], y * stride + x, layout.stride, h, w, { color.y });
+        set(regions[1], lumaSize + (y / 2) * stride + x, layout.stride, h / 2, w, { color.u, color.v });
+        return 2;
+    case PixelFormat::I420:
+    case PixelFormat::I422:
+    case PixelFormat::I444: {
+        const bool fullWidth = (layout.format == PixelFormat::I444);
+        const bool halfHeight = (layout.format == PixelFormat::I420);
+        const size_t chromaStride = fullWidth ? stride : stride / 2;
+        const size_t chromaRows = halfHeight ? layout.height / 2 : layout.height;
+        const int cx = fullWidth ? x : x / 2;
+        const int cy = halfHeight ? y / 2 : y;
+        const int cw = fullWidth ? w : w / 2;
+        const int ch = halfHeight ? h / 2 : h;
+        const size_t uOffset = lumaSize + cy * chromaStride + cx;
+        set(regions[0], y * stride + x, layout.stride, h, w, { color.y });
+        set(regions[1], uOffset, chromaStride, ch, cw, { color.u });
+        set(regions[2], uOffset + chromaStride * chromaRows, chromaStride, ch, cw, { color.v });
+        return 3;
+    }
+    default:
+        return 0;
+    }
+}
+
+static void FillRect(const VideoFormat& layout, uint8_t* data, int x, int y, int w, int h, const PatternColor& color) {
+    PlaneRegion regions[3];
+    const int count = GetPlaneRegions(layout, x, y, w, h, color, regions);
+    for (int p = 0; p < count; ++p) {
+        const PlaneRegion& region = regions[p];
+        uint8_t* row = data + region.offset;
+        for (int r = 0; r < region.rows; ++r, row += region.stride) {
+            for (int i = 0; i < region.bytes; ++i) {
+                row[i] = region.fill[i % region.fillSize];
+            }
+        }
+    }
+}
+
+static void CopyRect(const VideoFormat& layout, const uint8_t* from, uint8_t* to, int x, int y, int w, int h) {
+    PlaneRegion regions[3];
+    const int count = GetPlaneRegions(layout, x, y, w, h, PatternColor(), regions);
+    for (int p = 0; p < count; ++p) {
+        const PlaneRegion& region = regions[p];
+        for (int r = 0; r < region.rows; ++r) {
+            const ptrdiff_t offset = static_cast<ptrdiff_t>(region.offset) + r * region.stride;
+            memcpy(to + offset, from + offset, region.bytes);
+        }
+    }
+}
+
+// Position along a back-and-forth sweep of [0, range].
+static int Bounce(uint64_t step, int range) {
+    if (range <= 0) {
+        return 0;
+    }
+    const uint64_t period = 2 * static_cast<uint64_t>(range);
+    const int position = static_cast<int>(step % period);
+    return position <= range ? position : static_cast<int>(period) - position;
+}
+
+// Parse a number that makes up all of 'text'.
+static bool ParseNumber(const std::string& text, double* value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    *value = strtod(text.c_str(), &end);
+    return end == text.c_str() + text.size();
+}
+
+bool ParseSyntheticSourceConfig(const std::wstring& spec, SyntheticSourceConfig* config) {
+    static const PixelFormat formats[] = {
+        PixelFormat::BGR24, PixelFormat::BGRA32, PixelFormat::YUY2, PixelFormat::NV12,
+        PixelFormat::I420, PixelFormat::I422, PixelFormat::I444,
+    };
+
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t end = spec.find(L',', start);
+        if (end == std::wstring::npos) {
+            end = spec.size();
+        }
+
+        // The spec is ASCII; anything else is not ours.
+        std::string field;
+        for (size_t i = start; i < end; ++i) {
+            if (spec[i] > 0x7F) {
+                return false;
+            }
+            field += static_cast<char>(tolower(static_cast<int>(spec[i])));
+        }
+        start = end + 1;
+        if (field.empty()) {
+            continue;
+        }
+
+        double number;
+        const size_t equals = field.find('=');
+        const size_t times = field.find('x');
+        if (equals != std::string::npos) {
+            const std::string key = field.substr(0, equals);
+            if (!ParseNumber(field.substr(equals + 1), &number) || number < 0.0) {
+                return false;
+            }
+            if (key == "jitter") {
+                config->jitterMs = number;
+            }
+            else if (key == "seed") {
+                config->seed = static_cast<uint32_t>(number);
+            }
+            else if (key == "frames") {
+                config->frameLimit = static_cast<uint64_t>(number);
+            }
+            else {
+                return false;
+            }
+        }
+        else if (times != std::string::npos && isdigit(static_cast<unsigned char>(field[0]))) {
+            const size_t at = field.find('@');
+            double width, height;
+            if (!ParseNumber(field.substr(0, times), &width)
+                || !ParseNumber(field.substr(times + 1, at == std::string::npos ? std::string::npos : at - times - 1), &height)) {
+                return false;
+            }
+            if (at != std::string::npos && !ParseNumber(field.substr(at + 1), &config->fps)) {
+                return false;
+            }
+            config->width = static_cast<int>(width);
+            config->height = static_cast<int>(height);
+        }
+        else if (field == "fast") {
+            config->realtime = false;
+        }
+        else {
+            bool known = false;
+            for (PixelFormat format : formats) {
+                std::string name = PixelFormatName(format);
+                std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+                if (field == name) {
+                    config->format = format;
+                    known = true;
+                }
+            }
+            if (!known) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+SyntheticCaptureSource::SyntheticCaptureSource(const SyntheticSourceConfig& config)
+    : config(config) {
+}
+
+SyntheticCaptureSource::~SyntheticCaptureSource() {
+    Stop();
+}
+
+long SyntheticCaptureSource::Open(const CapturePolicy&, CameraOpenContext& context) {
+    // One fixed mode, so the policy has nothing to choose from.
+    context.Step("Generating pattern");
+    if (config.width <= 0 || config.height <= 0 || (config.width | config.height) & 1 || !(config.fps > 0.0)) {
+        return kCaptureErrorInvalidArg;
+    }
+
+    layout = VideoFormat();
+    layout.format = config.format;
+    layout.width = config.width;
+    layout.height = config.height;
+    layout.stride = DefaultStride(config.format, config.width);
+    const size_t size = FrameSize(config.format, config.height, layout.stride);
+    if (size == 0) {
+        return kCaptureErrorBadFormat;  // Compressed or unknown
+    }
+
+    // 75% color bars over the top three quarters, a gray ramp below.
+    static const uint8_t bars[][3] = {
+        { 191, 191, 191 }, { 191, 191, 0 }, { 0, 191, 191 }, { 0, 191, 0 },
+        { 191, 0, 191 }, { 191, 0, 0 }, { 0, 0, 191 },
+    };
+    const int barCount = sizeof(bars) / sizeof(bars[0]);
+    const int rampSteps = 8;
+    const YuvColorSpace colorSpace = DefaultYuvColorSpace(layout.width, layout.height);
+    const int barHeight = (layout.height * 3 / 4) & ~1;
+
+    pattern.assign(size, 0);
+    for (int i = 0; i < barCount; ++i) {
+        const int x0 = (i * layout.width / barCount) & ~1;
+        const int x1 = ((i + 1) * layout.width / barCount) & ~1;
+        FillRect(layout, pattern.data(), x0, 0, x1 - x0, barHeight,
+                 MakePatternColor(bars[i][0], bars[i][1], bars[i][2], colorSpace));
+    }
+    for (int i = 0; i < rampSteps; ++i) {
+        const int x0 = (i * layout.width / rampSteps) & ~1;
+        const int x1 = ((i + 1) * layout.width / rampSteps) & ~1;
+        const uint8_t level = static_cast<uint8_t>(i * 255 / (rampSteps - 1));
+        FillRect(layout, pattern.data(), x0, barHeight, x1 - x0, layout.height - barHeight,
+                 MakePatternColor(level, level, level, colorSpace));
+    }
+    frame = pattern;
+    boxSize = std::max(2, (layout.height / 8) & ~1);
+    boxX = 0;
+    boxY = 0;
+
+    CaptureMode mode;
+    mode.index = 0;
+    mode.format = layout.format;
+    mode.width = layout.width;
+    mode.height = layout.height;
+    mode.minFps = config.fps;
+    mode.maxFps = config.fps;
+    capabilities.Clear();
+    capabilities.Add(mode);
+    return 0;
+}
+
+long SyntheticCaptureSource::Start(CaptureSink* frameSink) {
+    if (!frameSink || pattern.empty()) {
+        return kCaptureErrorInvalidArg;
+    }
+    Stop();
+
+    sink = frameSink;
+    stopping = false;
+    delivered.store(0, std::memory_order_relaxed);
+    jitterRandom.seed(config.seed);
+    worker = std::thread(&SyntheticCaptureSource::Run, this);
+    return 0;
+}
+
+void SyntheticCaptureSource::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void SyntheticCaptureSource::DrawBox(uint64_t frameIndex) {
+    static const PatternColor white = { 255, 255, 255, 235, 128, 128 };
+
+    CopyRect(layout, pattern.data(), frame.data(), boxX, boxY, boxSize, boxSize);
+    boxX = Bounce(frameIndex * 8, layout.width - boxSize) & ~1;
+    boxY = Bounce(frameIndex * 4, layout.height - boxSize) & ~1;
+    FillRect(layout, frame.data(), boxX, boxY, boxSize, boxSize, white);
+}
+
+void SyntheticCaptureSource::Run() {
+    TRACE_THREAD_NAME("Synthetic source");
+    using Clock = std::chrono::steady_clock;
+
+    // Timestamps are exact multiples of the frame interval, as from a camera
+    // clock; jitter only moves the delivery.
+    const Clock::time_point start = Clock::now();
+    const double interval = 1.0 / config.fps;
+    std::uniform_real_distribution<double> jitter(-config.jitterMs, config.jitterMs);
+
+    for (uint64_t i = 0; config.frameLimit == 0 || i < config.frameLimit; ++i) {
+        const double sampleTime = static_cast<double>(i) * interval;
+        if (config.realtime) {
+            double due = sampleTime;
+            if (config.jitterMs > 0.0) {
+                due = std::max(0.0, due + jitter(jitterRandom) / 1000.0);
+            }
+            const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(due));
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wakeup.wait_until(lock, deadline, [this] { return stopping; })) {
+                break;
+            }
+        }
+        else {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+        }
+
+        DrawBox(i);
+        sink->OnFrame(layout, frame.data(), frame.size(), sampleTime);
+        delivered.fetch_add(1, std::memory_order_relaxed);
+    }
+}
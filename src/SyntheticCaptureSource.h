@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "CaptureSource.h"
+
+// What the test pattern source produces.
+struct SyntheticSourceConfig {
+    PixelFormat format = PixelFormat::YUY2;  // Any uncompressed format
+    int width = 1280;                        // Even
+    int height = 720;                        // Even
+    double fps = 30.0;
+    double jitterMs = 0.0;     // Each frame is delivered up to this much early or late
+    bool realtime = true;      // false: deliver back to back, as fast as the sink takes them
+    uint32_t seed = 1;         // Seeds the jitter, so runs are repeatable
+    uint64_t frameLimit = 0;   // Stop after this many frames; 0 for no limit
+};
+
+// Parse the part of a "synthetic:" device path after the colon, e.g.
+// "1920x1080@60,nv12,jitter=2,fast". Every field is optional:
+//   WxH[@fps]   frame size and rate
+//   <format>    rgb24, rgb32, yuy2, nv12, i420, i422 or i444
+//   jitter=ms   delivery jitter
+//   seed=n      jitter seed
+//   frames=n    frame limit
+//   fast        not paced to the frame rate
+bool ParseSyntheticSourceConfig(const std::wstring& spec, SyntheticSourceConfig* config);
+
+// Generates color bars with a gray ramp and a moving box, so consecutive
+// frames differ but generating one costs only the box. Deterministic for a
+// given config: frame N always has the same content and timestamp.
+class SyntheticCaptureSource : public CaptureSource {
+public:
+    explicit SyntheticCaptureSource(const SyntheticSourceConfig& config);
+    ~SyntheticCaptureSource() override;
+
+    long Open(const CapturePolicy& policy, CameraOpenContext& context) override;
+    long Start(CaptureSink* sink) override;
+    void Stop() override;
+
+    const CaptureCapabilities& Capabilities() const override { return capabilities; }
+    int SelectedMode() const override { return capabilities.Empty() ? -1 : 0; }
+    VideoFormat Format() const override { return layout; }
+
+    // Frames delivered since Start().
+    uint64_t FramesDelivered() const { return delivered.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+    void DrawBox(uint64_t frameIndex);
+
+    SyntheticSourceConfig config;
+    VideoFormat layout;
+    CaptureCapabilities capabilities;
+
+    std::vector<uint8_t> pattern;  // The frame without the box
+    std::vector<uint8_t> frame;    // Pattern plus the box at its current position
+    int boxX = 0;
+    int boxY = 0;
+    int boxSize = 0;
+
+    CaptureSink* sink = nullptr;
+    std::mt19937 jitterRandom;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+    std::atomic<uint64_t> delivered{ 0 };
+};
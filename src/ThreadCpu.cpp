@@ -0,0 +1,133 @@
+#include "ThreadCpu.h"
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+struct ThreadCpuSlot {
+    const char* name = nullptr;
+    unsigned generation = 0;
+    bool used = false;
+#if defined(_WIN32)
+    HANDLE thread = nullptr;
+#else
+    clockid_t clock = 0;
+#endif
+};
+
+static std::mutex threadCpuMutex;
+static ThreadCpuSlot threadCpuSlots[kMaxCpuThreads];
+
+// Frees the calling thread's slot when the thread exits
+struct ThreadCpuRegistration {
+    int slot = -1;
+
+    ~ThreadCpuRegistration() {
+        if (slot < 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(threadCpuMutex);
+        ThreadCpuSlot& entry = threadCpuSlots[slot];
+#if defined(_WIN32)
+        CloseHandle(entry.thread);
+        entry.thread = nullptr;
+#endif
+        entry.used = false;
+    }
+};
+
+static thread_local ThreadCpuRegistration threadCpuRegistration;
+static thread_local bool threadCpuAttempted = false;
+
+void RegisterThreadCpu(const char* name) {
+    if (threadCpuAttempted) {
+        // Only this thread writes its slot's name, so reading it unlocked is safe.
+        const int slot = threadCpuRegistration.slot;
+        if (slot >= 0 && threadCpuSlots[slot].name != name) {
+            std::lock_guard<std::mutex> lock(threadCpuMutex);
+            threadCpuSlots[slot].name = name;
+        }
+        return;
+    }
+    threadCpuAttempted = true;
+
+    std::lock_guard<std::mutex> lock(threadCpuMutex);
+    for (int i = 0; i < kMaxCpuThreads; ++i) {
+        ThreadCpuSlot& entry = threadCpuSlots[i];
+        if (entry.used) {
+            continue;
+        }
+#if defined(_WIN32)
+        entry.thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+        if (!entry.thread) {
+            return;
+        }
+#else
+        if (pthread_getcpuclockid(pthread_self(), &entry.clock) != 0) {
+            return;
+        }
+#endif
+        entry.name = name;
+        entry.used = true;
+        ++entry.generation;
+        threadCpuRegistration.slot = i;
+        return;
+    }
+}
+
+double CurrentThreadCpuSeconds() {
+#if defined(_WIN32)
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) {
+        return 0.0;
+    }
+    const auto ticks = [](const FILETIME& time) {
+        return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+    timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0.0;
+    }
+    return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+size_t SampleThreadCpu(ThreadCpuUsage* usage, size_t capacity) {
+    std::lock_guard<std::mutex> lock(threadCpuMutex);
+    size_t count = 0;
+    for (int i = 0; i < kMaxCpuThreads && count < capacity; ++i) {
+        const ThreadCpuSlot& entry = threadCpuSlots[i];
+        if (!entry.used) {
+            continue;
+        }
+        double seconds = 0.0;
+#if defined(_WIN32)
+        FILETIME created, exited, kernel, user;
+        if (!GetThreadTimes(entry.thread, &created, &exited, &kernel, &user)) {
+            continue;
+        }
+        const auto ticks = [](const FILETIME& time) {
+            return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+        };
+        seconds = (ticks(kernel) + ticks(user)) * 1e-7;  // 100 ns units
+#else
+        timespec time;
+        if (clock_gettime(entry.clock, &time) != 0) {
+            continue;
+        }
+        seconds = time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+        usage[count].name = entry.name;
+        usage[count].slot = i;
+        usage[count].generation = entry.generation;
+        usage[count].cpuSeconds = seconds;
+        ++count;
+    }
+    return count;
+}
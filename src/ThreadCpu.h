@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// CPU time used by one registered thread.
+struct ThreadCpuUsage {
+    const char* name = nullptr;
+    int slot = -1;              // Stable while the thread lives; reused afterwards
+    unsigned generation = 0;    // Changes whenever the slot gets a new thread
+    double cpuSeconds = 0.0;    // User plus kernel time since the thread started
+};
+
+// Threads whose CPU time the performance panel shows. Slots are preallocated,
+// so registering and sampling never allocate.
+constexpr int kMaxCpuThreads = 16;
+
+// Track the calling thread under 'name' (a string literal) until it exits.
+// Later calls from the same thread only rename it, so this can be called on
+// every frame. Threads beyond kMaxCpuThreads are not tracked.
+void RegisterThreadCpu(const char* name);
+
+// User plus kernel time the calling thread has used, whether registered or
+// not. Windows updates it at the scheduler tick, so time long runs with it.
+double CurrentThreadCpuSeconds();
+
+// The registered threads and their CPU time so far. Returns how many entries
+// were written to 'usage', at most 'capacity'.
+size_t SampleThreadCpu(ThreadCpuUsage* usage, size_t capacity);
@@ -0,0 +1,217 @@
+#include "Trace.h"
+
+#if defined(ENABLE_TRACING)
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "FrameLatency.h"
+
+// Events kept per thread; older ones are overwritten. A power of two.
+static const uint64_t kTraceEventsPerThread = 16384;
+
+enum class TraceEventType : uint8_t {
+    Complete,
+    Counter,
+};
+
+// Fields are atomics so WriteChromeTrace() can read a buffer while its thread
+// writes to it. The stores are relaxed, which costs the same as plain stores.
+struct TraceEvent {
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<int64_t> timestamp{ 0 };
+    std::atomic<int64_t> value{ 0 };  // Duration of a span, or the counter value
+    std::atomic<TraceEventType> type{ TraceEventType::Complete };
+};
+
+struct TraceBuffer {
+    uint32_t threadId = 0;
+    std::atomic<const char*> threadName{ nullptr };
+    std::atomic<bool> owned{ true };     // False once the thread has exited
+    std::atomic<uint64_t> head{ 0 };     // Events written so far
+    std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(kTraceEventsPerThread);
+};
+
+// Every buffer ever handed out. Buffers of exited threads are reused, so
+// short-lived threads such as a camera's streaming thread don't pile up.
+static std::mutex& TraceRegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<std::unique_ptr<TraceBuffer>>& TraceBuffers() {
+    static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    return buffers;
+}
+
+static TraceBuffer* AcquireTraceBuffer() {
+    static uint32_t nextThreadId = 1;
+    std::lock_guard<std::mutex> lock(TraceRegistryMutex());
+    for (const std::unique_ptr<TraceBuffer>& buffer : TraceBuffers()) {
+        if (!buffer->owned.load(std::memory_order_acquire)) {
+            // The previous thread's events go with it.
+            buffer->threadId = nextThreadId++;
+            buffer->threadName.store(nullptr, std::memory_order_relaxed);
+            buffer->head.store(0, std::memory_order_relaxed);
+            buffer->owned.store(true, std::memory_order_relaxed);
+            return buffer.get();
+        }
+    }
+    TraceBuffers().push_back(std::make_unique<TraceBuffer>());
+    TraceBuffers().back()->threadId = nextThreadId++;
+    return TraceBuffers().back().get();
+}
+
+// Gives the thread's buffer back when the thread exits
+struct TraceThreadHandle {
+    TraceBuffer* buffer = nullptr;
+
+    ~TraceThreadHandle() {
+        if (buffer) {
+            buffer->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local TraceThreadHandle traceThread;
+
+static TraceBuffer* ThreadTraceBuffer() {
+    if (!traceThread.buffer) {
+        traceThread.buffer = AcquireTraceBuffer();
+    }
+    return traceThread.buffer;
+}
+
+static void EmitTraceEvent(TraceEventType type, const char* name, int64_t timestamp, int64_t value) {
+    TraceBuffer* buffer = ThreadTraceBuffer();
+    const uint64_t index = buffer->head.load(std::memory_order_relaxed);
+
+    // A reader that sees any of these stores also sees the head of the
+    // previous event, which tells it this slot is being rewritten.
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent& event = buffer->events[index & (kTraceEventsPerThread - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.timestamp.store(timestamp, std::memory_order_relaxed);
+    event.value.store(value, std::memory_order_relaxed);
+    event.type.store(type, std::memory_order_relaxed);
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+TraceSpan::TraceSpan(const char* name)
+    : name(name), start(MonotonicNanos()) {
+}
+
+TraceSpan::~TraceSpan() {
+    EmitTraceEvent(TraceEventType::Complete, name, start, MonotonicNanos() - start);
+}
+
+void TraceCounter(const char* name, int64_t value) {
+    EmitTraceEvent(TraceEventType::Counter, name, MonotonicNanos(), value);
+}
+
+void TraceSetThreadName(const char* name) {
+    ThreadTraceBuffer()->threadName.store(name, std::memory_order_relaxed);
+}
+
+static void AppendJsonString(std::string& out, const char* text) {
+    out += '"';
+    for (const char* c = text ? text : ""; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+            out += *c;
+        }
+        else if (static_cast<unsigned char>(*c) < 0x20) {
+            out += ' ';
+        }
+        else {
+            out += *c;
+        }
+    }
+    out += '"';
+}
+
+struct TraceEventCopy {
+    const char* name;
+    int64_t timestamp;
+    int64_t value;
+    TraceEventType type;
+};
+
+bool WriteChromeTrace(const std::filesystem::path& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    std::string json = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    char number[160];
+    std::vector<TraceEventCopy> events;
+    events.reserve(kTraceEventsPerThread);
+
+    // New threads wait for the dump; threads already tracing carry on.
+    std::lock_guard<std::mutex> lock(TraceRegistryMutex());
+    for (const std::unique_ptr<TraceBuffer>& buffer : TraceBuffers()) {
+        const uint64_t before = buffer->head.load(std::memory_order_acquire);
+        const uint64_t begin = before > kTraceEventsPerThread ? before - kTraceEventsPerThread : 0;
+        events.clear();
+        for (uint64_t i = begin; i < before; ++i) {
+            const TraceEvent& event = buffer->events[i & (kTraceEventsPerThread - 1)];
+            events.push_back({ event.name.load(std::memory_order_relaxed), event.timestamp.load(std::memory_order_relaxed),
+                event.value.load(std::memory_order_relaxed), event.type.load(std::memory_order_relaxed) });
+        }
+
+        // Drop the slots the thread may have been rewriting while we copied,
+        // including the one it could be in the middle of.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t after = buffer->head.load(std::memory_order_relaxed);
+        const uint64_t valid = after + 1 > kTraceEventsPerThread ? after + 1 - kTraceEventsPerThread : 0;
+        const size_t skip = static_cast<size_t>(valid > begin ? std::min(valid - begin, before - begin) : 0);
+
+        if (const char* threadName = buffer->threadName.load(std::memory_order_relaxed)) {
+            json += first ? "" : ",\n";
+            first = false;
+            snprintf(number, sizeof(number), "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": ", buffer->threadId);
+            json += number;
+            AppendJsonString(json, threadName);
+            json += "}}";
+        }
+        for (size_t i = skip; i < events.size(); ++i) {
+            const TraceEventCopy& event = events[i];
+            json += first ? "" : ",\n";
+            first = false;
+            json += "{\"ph\": \"";
+            json += event.type == TraceEventType::Complete ? 'X' : 'C';
+            json += "\", \"name\": ";
+            AppendJsonString(json, event.name);
+            if (event.type == TraceEventType::Complete) {
+                snprintf(number, sizeof(number), ", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                    buffer->threadId, event.timestamp / 1000.0, event.value / 1000.0);
+            }
+            else {
+                snprintf(number, sizeof(number), ", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"args\": {\"value\": %lld}}",
+                    buffer->threadId, event.timestamp / 1000.0, static_cast<long long>(event.value));
+            }
+            json += number;
+        }
+        file.write(json.data(), static_cast<std::streamsize>(json.size()));
+        json.clear();
+    }
+
+    json += "\n]}\n";
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    return static_cast<bool>(file);
+}
+
+#else
+
+bool WriteChromeTrace(const std::filesystem::path&) {
+    return false;
+}
+
+#endif
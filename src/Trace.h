@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+// Lightweight tracing of where time goes across the capture, conversion and
+// UI threads. Define ENABLE_TRACING for the whole build to turn it on;
+// otherwise the macros below expand to nothing and no tracing code runs.
+//
+//   TRACE_SCOPE("UploadFrame");             // Span from here to end of scope
+//   TRACE_COUNTER("Pool free", freeFrames); // Counter sample
+//   TRACE_THREAD_NAME("Capture");           // Label for the calling thread
+//
+// Names must be string literals (or otherwise live forever); only the
+// pointer is recorded. Each thread writes to its own fixed-size ring of
+// events without locking. WriteChromeTrace() saves the retained events in
+// the Chrome trace event format, which chrome://tracing and Perfetto open.
+
+#if defined(ENABLE_TRACING)
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_COUNTER(name, value) TraceCounter(name, static_cast<int64_t>(value))
+#define TRACE_THREAD_NAME(name) TraceSetThreadName(name)
+
+// Records a complete event from construction to destruction.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+void TraceCounter(const char* name, int64_t value);
+void TraceSetThreadName(const char* name);
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+// True when the build records traces.
+constexpr bool TracingEnabled() {
+#if defined(ENABLE_TRACING)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Write every thread's retained events to 'path' as Chrome trace JSON.
+// Threads keep tracing meanwhile; events they overwrite during the dump are
+// left out. Returns false when tracing is disabled or the file cannot be
+// written.
+bool WriteChromeTrace(const std::filesystem::path& path);
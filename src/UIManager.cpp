@@ -1,49 +1,73 @@
 #include "UIManager.h"
+#include "AllocationTracker.h"
 #include "StringConversion.h"  // Include the header where the wstringToString function is declared
 #include "imgui.h"
-#include <iostream>
+#include <chrono>
+#include <format>
+#include <fstream>
 #include "WebcamController.h"
+#include "DirectShowDeviceEnumerator.h"
+#include "Log.h"
+#include "Trace.h"
 
 // Initialize the WebcamController with Direct3D device and context
 UIManager::UIManager(ID3D11Device* device, ID3D11DeviceContext* context)
-    : webcam(device, context) {
+    : webcam(device, context), devices(std::make_unique<DirectShowDeviceEnumerator>()),
+      metricsServer([this](MetricsWriter& writer) { WriteCaptureMetrics(writer, webcam.GetMetrics()); }) {
     CreateModals();
 }
 
+void UIManager::OnDeviceChange() {
+    devices.Invalidate();
+}
+
 void UIManager::CreateModals() {
     // This method is kept in case you want to initialize or preload modals if necessary.
 }
 
 void UIManager::Render() {
+    TRACE_SCOPE("UIManager::Render");
     // Top Menu
     ImGui::BeginMainMenuBar();
     if (ImGui::MenuItem("Exit")) {
-        std::cerr << "[UIManager] Exit selected" << std::endl;
+        LOG_DEBUG("UIManager", "Exit selected");
     }
     if (ImGui::MenuItem("Select Camera")) {
-        std::cerr << "[UIManager] 'Select Camera' selected" << std::endl;
+        LOG_DEBUG("UIManager", "'Select Camera' selected");
         auto selectCameraModal = std::make_unique<ImGuiModaler>("SelectCameraModal", [this]() {
             ImGui::Text("Select Camera");
 
-            // Get the list of available cameras
-            auto devices = webcam.ListAvailableCameras();
-            if (devices.empty()) {
+            // The registry caches the device list and only rescans after a
+            // device change, so drawing the modal every frame stays cheap.
+            const std::vector<DeviceInfo>& cameras = devices.Devices();
+            const std::vector<const char*>& cameraNames = devices.Names();
+            if (ImGui::Button("Rescan")) {
+                devices.Invalidate();
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Test pattern")) {
+                // Synthetic source, for checking the display path without a camera
+                selectedDevicePath.clear();
+                webcam.OpenCamera(L"synthetic:1280x720@30,yuy2");
+                ImGuiModaler::CloseCurrentModal();
+            }
+            if (cameras.empty()) {
                 ImGui::Text("No cameras found.");
                 return;
             }
 
+            // Keep the highlighted camera when the list changes under us.
             static int currentCameraIndex = 0;
-            std::vector<const char*> cameraNames;
-
-            // Convert std::wstring to std::string and store it in cameraNames
-            std::vector<std::string> cameraNamesStrings;
-            for (const auto& cam : devices) {
-                cameraNamesStrings.push_back(wstringToString(cam)); // Use the conversion function
+            static uint64_t seenGeneration = 0;
+            if (seenGeneration != devices.Generation()) {
+                seenGeneration = devices.Generation();
+                const int found = devices.Find(selectedDevicePath);
+                if (found >= 0) {
+                    currentCameraIndex = found;
+                }
             }
-
-            // Convert std::string to const char* and store it in cameraNames for ImGui::Combo
-            for (const auto& camName : cameraNamesStrings) {
-                cameraNames.push_back(camName.c_str());
+            if (currentCameraIndex >= static_cast<int>(cameras.size())) {
+                currentCameraIndex = 0;
             }
 
             // Create a combo box for camera selection
@@ -52,13 +76,9 @@ void UIManager::Render() {
             // Place "Select" and "Close" buttons in a group
             ImGui::BeginGroup();
             if (ImGui::Button("Select") && currentCameraIndex >= 0) {
-                if (!SUCCEEDED(webcam.Initialize(currentCameraIndex))) {
-                    std::cerr << "Failed to initialize the webcam." << std::endl;
-                }
-                else {
-                    std::cout << "Webcam initialized." << std::endl;
-                    webcam.StartCapture();  // Start capturing immediately
-                }
+                // Opens on the camera worker; the feed pane shows progress.
+                selectedDevicePath = cameras[currentCameraIndex].path;
+                webcam.OpenCamera(selectedDevicePath);
                 ImGuiModaler::CloseCurrentModal();
             }
 
@@ -76,11 +96,30 @@ void UIManager::Render() {
         selectCameraModal->SetBackdrop(true, 0.9f);  // Set backdrop properties
         ImGuiModaler::ShowModal(std::move(selectCameraModal));
     }
+    if (TracingEnabled() && ImGui::MenuItem("Save Trace")) {
+        // Open the file in chrome://tracing or ui.perfetto.dev
+        const bool saved = WriteChromeTrace("trace.json");
+        if (saved) {
+            LOG_INFO("UIManager", "Trace saved to trace.json");
+        }
+        else {
+            LOG_ERROR("UIManager", "Could not write trace.json");
+        }
+    }
+    if (AllocationTrackingEnabled() && ImGui::MenuItem("Save Allocation Report")) {
+        std::ofstream file("allocations.txt", std::ios::trunc);
+        if (file << FormatAllocationReport()) {
+            LOG_INFO("UIManager", "Allocation report saved to allocations.txt");
+        }
+        else {
+            LOG_ERROR("UIManager", "Could not write allocations.txt");
+        }
+    }
     if (ImGui::MenuItem("Settings")) {
-        std::cerr << "[UIManager] 'Settings' selected" << std::endl;
+        LOG_DEBUG("UIManager", "'Settings' selected");
         auto settingsModal = std::make_unique<ImGuiModaler>("SettingsModal", [this]() {
             ImGui::Text("Settings");
-            // Implement settings UI here
+            RenderSettings();
             });
         settingsModal->SetBackdrop(true, 0.9f);  // Set backdrop properties
         ImGuiModaler::ShowModal(std::move(settingsModal));
@@ -96,10 +135,43 @@ void UIManager::Render() {
     ImGui::Begin("Camera Feed", nullptr, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
 
     if (ID3D11ShaderResourceView* tex = webcam.GetFrameTexture()) {
-        ImGui::Image(tex, ImVec2(640, 480)); // Adjust size as necessary
+        // Fit the (possibly rotated) frame into the pane, keeping its aspect ratio.
+        const ImVec2 avail = ImGui::GetContentRegionAvail();
+        const float frameWidth = static_cast<float>(webcam.GetDisplayWidth());
+        const float frameHeight = static_cast<float>(webcam.GetDisplayHeight());
+        float scale = 1.0f;
+        if (frameWidth > 0.0f && frameHeight > 0.0f) {
+            scale = (avail.x / frameWidth < avail.y / frameHeight) ? avail.x / frameWidth : avail.y / frameHeight;
+        }
+        ImGui::Image(tex, ImVec2(frameWidth * scale, frameHeight * scale));
     }
     else {
-        ImGui::Text("No frame available");
+        // Camera open runs on a worker thread; show where it is.
+        const CameraStatus status = webcam.GetStatus();
+        switch (status.state) {
+        case CameraState::Opening:
+        case CameraState::Closing:
+            ImGui::Text("%s: %s", CameraStateName(status.state), status.step);
+            ImGui::ProgressBar(status.stepCount > 0 ? static_cast<float>(status.stepIndex) / status.stepCount : 0.0f);
+            if (ImGui::Button("Cancel")) {
+                webcam.CancelOpen();
+            }
+            break;
+        case CameraState::Open:
+            ImGui::Text("Waiting for first frame...");
+            break;
+        case CameraState::Failed:
+            if (status.result == kCameraOpenTimedOut) {
+                ImGui::Text("The camera did not start in time.");
+            }
+            else {
+                ImGui::Text("Failed to open the camera (HRESULT 0x%08lX).", static_cast<unsigned long>(status.result));
+            }
+            break;
+        default:
+            ImGui::Text("No frame available");
+            break;
+        }
     }
 
 
@@ -110,11 +182,195 @@ void UIManager::Render() {
     ImGui::SetNextWindowSize(ImVec2(ImGui::GetIO().DisplaySize.x * 0.3f, ImGui::GetIO().DisplaySize.y), ImGuiCond_Always);
     ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
 
-    // Implement settings UI here
+    RenderSettings();
+    RenderRecording();
+    RenderHistory();
+
+    SamplePerformance();
+    if (ImGui::CollapsingHeader("Performance", ImGuiTreeNodeFlags_DefaultOpen)) {
+        perfPanel.Draw();
+    }
 
     ImGui::End();
 }
 
+void UIManager::RenderRecording() {
+    if (!ImGui::CollapsingHeader("Recording")) {
+        return;
+    }
+    if (!webcam.IsRecording()) {
+        // AVI keeps MJPEG as the camera sent it and plays anywhere; raw
+        // files replay through the frame path.
+        static const RecordingContainer containers[] = { RecordingContainer::Raw, RecordingContainer::Avi };
+        if (ImGui::BeginCombo("Container", RecordingContainerName(recordingContainer))) {
+            for (RecordingContainer container : containers) {
+                if (ImGui::Selectable(RecordingContainerName(container), container == recordingContainer)) {
+                    recordingContainer = container;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        if (ImGui::Button("Start recording")) {
+            // One set of segments per recording, named after its start in UTC
+            RecorderOptions options;
+            options.directory = "recordings";
+            options.container = recordingContainer;
+            options.baseName = std::format("capture-{:%Y%m%d-%H%M%S}",
+                std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+            if (!webcam.StartRecording(options)) {
+                LOG_ERROR("UIManager", "Could not start recording");
+            }
+        }
+        return;
+    }
+    if (ImGui::Button("Stop recording")) {
+        webcam.StopRecording();
+        return;
+    }
+    const RecorderStats stats = webcam.GetRecorderStats();
+    ImGui::Text("%llu frames, %llu dropped", static_cast<unsigned long long>(stats.framesRecorded),
+        static_cast<unsigned long long>(stats.framesDropped));
+    ImGui::Text("%.1f MB in %llu segments", stats.bytesWritten / 1e6, static_cast<unsigned long long>(stats.segments));
+    if (stats.writeErrors > 0) {
+        ImGui::Text("%llu write errors", static_cast<unsigned long long>(stats.writeErrors));
+    }
+}
+
+void UIManager::RenderHistory() {
+    if (!ImGui::CollapsingHeader("History")) {
+        return;
+    }
+    if (!webcam.IsHistoryRunning()) {
+        // The memory is taken up front, when the history starts
+        ImGui::SliderInt("Budget (MB)", &historyBudgetMegabytes, 64, 4096);
+        ImGui::Checkbox("Compress raw frames", &historyCompressRaw);
+        if (ImGui::Button("Start history")) {
+            FrameHistoryOptions options;
+            options.memoryBytes = static_cast<size_t>(historyBudgetMegabytes) << 20;
+            options.compressRaw = historyCompressRaw;
+            webcam.StartHistory(options);
+        }
+        return;
+    }
+    if (ImGui::Button("Stop history")) {
+        webcam.StopHistory();
+        return;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Save last 30 s")) {
+        // Clips go next to the recordings, named after the moment of saving in UTC
+        const std::string name = std::format("clip-{:%Y%m%d-%H%M%S}.avi",
+            std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+        if (!webcam.SaveClip(std::filesystem::path("recordings") / name, 30.0)) {
+            LOG_WARNING("UIManager", "Could not save a clip: none held, or one is being saved");
+        }
+    }
+
+    const FrameHistoryStats stats = webcam.GetHistoryStats();
+    ImGui::Text("%.1f s held, %.1f s fit in %d MB", stats.seconds, stats.secondsAtBudget, historyBudgetMegabytes);
+    ImGui::Text("%.2f MB per second (%.2f MB raw)", stats.bytesPerSecond / 1e6, stats.rawBytesPerSecond / 1e6);
+    if (stats.framesDropped > 0) {
+        ImGui::Text("%llu frames too large to keep", static_cast<unsigned long long>(stats.framesDropped));
+    }
+    const ClipExportStatus clip = webcam.GetClipStatus();
+    if (clip.state != ClipExportState::Idle) {
+        ImGui::Text("%s %s: %llu of %llu frames", ClipExportStateName(clip.state), clip.path.filename().string().c_str(),
+            static_cast<unsigned long long>(clip.framesWritten), static_cast<unsigned long long>(clip.framesTotal));
+    }
+}
+
+void UIManager::SamplePerformance() {
+    const double now = ImGui::GetTime();
+    if (!perfPanel.SampleDue(now)) {
+        return;
+    }
+    PerfCounters counters;
+    counters.display = webcam.GetFrameStats();
+    counters.pool = webcam.GetFramePoolStats();
+    const FrameLatencyCollector& latency = webcam.GetLatency();
+    for (int i = 0; i < static_cast<int>(LatencyStage::Count); ++i) {
+        counters.latency[i] = latency.Latency(static_cast<LatencyStage>(i)).Summarize();
+    }
+    counters.threadCount = SampleThreadCpu(counters.threads, kMaxCpuThreads);
+    perfPanel.AddSample(counters, now);
+}
+
+void UIManager::RenderSettings() {
+    if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
+        const CameraStatus status = webcam.GetStatus();
+        ImGui::Text("State: %s", CameraStateName(status.state));
+        if (status.state == CameraState::Open) {
+            ImGui::Text("Opened in %.0f ms", status.openMs);
+            if (status.firstFrameMs > 0.0) {
+                ImGui::Text("First frame after %.0f ms", status.firstFrameMs);
+            }
+            if (ImGui::Button("Close camera")) {
+                webcam.CloseCamera();
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Capture mode")) {
+        CapturePolicy policy = webcam.GetCapturePolicy();
+        bool changed = false;
+
+        static const CaptureGoal goals[] = {
+            CaptureGoal::MaxResolution, CaptureGoal::LowestLatency, CaptureGoal::LowestBandwidth,
+        };
+        if (ImGui::BeginCombo("Goal", CaptureGoalName(policy.goal))) {
+            for (CaptureGoal goal : goals) {
+                if (ImGui::Selectable(CaptureGoalName(goal), goal == policy.goal)) {
+                    policy.goal = goal;
+                    changed = true;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        float minFps = static_cast<float>(policy.minFps);
+        if (ImGui::SliderFloat("Min fps", &minFps, 0.0f, 120.0f, "%.0f")) {
+            policy.minFps = minFps;
+            changed = true;
+        }
+        if (changed) {
+            webcam.SetCapturePolicy(policy);
+        }
+        ImGui::TextDisabled("Applies when a camera is selected");
+
+        const CaptureCapabilities capabilities = webcam.GetCapabilities();
+        const int selectedMode = webcam.GetSelectedMode();
+        const std::vector<CaptureMode>& modes = capabilities.Modes();
+        for (size_t i = 0; i < modes.size(); ++i) {
+            const CaptureMode& mode = modes[i];
+            ImGui::Text("%s %4s %dx%d @ %.0f-%.0f fps", static_cast<int>(i) == selectedMode ? ">" : " ",
+                        PixelFormatName(mode.format), mode.width, mode.height, mode.minFps, mode.maxFps);
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Orientation", ImGuiTreeNodeFlags_DefaultOpen)) {
+        FrameOrientation orientation = webcam.GetOrientation();
+        bool changed = false;
+
+        static const FrameRotation rotations[] = {
+            FrameRotation::None, FrameRotation::Rotate90, FrameRotation::Rotate180, FrameRotation::Rotate270,
+        };
+        if (ImGui::BeginCombo("Rotation", FrameRotationName(orientation.rotation))) {
+            for (FrameRotation rotation : rotations) {
+                if (ImGui::Selectable(FrameRotationName(rotation), rotation == orientation.rotation)) {
+                    orientation.rotation = rotation;
+                    changed = true;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        changed |= ImGui::Checkbox("Mirror", &orientation.mirror);
+        changed |= ImGui::Checkbox("Flip vertically", &orientation.flipVertical);
+
+        if (changed) {
+            webcam.SetOrientation(orientation);
+        }
+    }
+}
+
 void UIManager::HandleOverlays() {
     // Render modals if they are open
     ImGuiModaler::RenderActiveModal();
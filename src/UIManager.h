@@ -2,7 +2,10 @@
 
 #include <memory>
 #include "WebcamController.h"
+#include "DeviceRegistry.h"
 #include "imgui.h"
+#include "PerfPanel.h"
+#include "MetricsServer.h"
 #include "ImGuiModaler.h"  // Assuming you have a modal handling utility like ImGuiModaler
 
 class UIManager {
@@ -13,13 +16,56 @@ public:
     // Main render function for the UI
     void Render();
 
+    // Called on WM_DEVICECHANGE; the camera list is rescanned on next use.
+    void OnDeviceChange();
+
+    // Called after each Present(), for frame latency measurements.
+    void OnPresented() { webcam.OnPresented(); }
+
+    // Serve Prometheus metrics at http://address:port/metrics until the
+    // UIManager is destroyed. Returns false if the port could not be bound.
+    bool StartMetrics(const std::string& address, int port) { return metricsServer.Start(address, port); }
+
 private:
     // Webcam controller instance
     WebcamController webcam;
 
+    // Cached list of capture devices
+    DeviceRegistry devices;
+
+    // Path of the camera last opened, to keep it selected across rescans
+    std::wstring selectedDevicePath;
+
+    // Live pipeline statistics in the sidebar
+    PerfPanel perfPanel;
+
+    // Scrape endpoint for unattended stations. Declared after the webcam so
+    // its thread stops before the webcam it reads from goes away.
+    MetricsServer metricsServer;
+
+    // Container chosen for the next recording
+    RecordingContainer recordingContainer = RecordingContainer::Raw;
+
+    // Settings for the next pre-trigger history
+    int historyBudgetMegabytes = 256;
+    bool historyCompressRaw = true;
+
     // Function to create modals (e.g., for camera selection)
     void CreateModals();
 
+    // Camera, capture mode and orientation controls, shared by the settings
+    // modal and the sidebar
+    void RenderSettings();
+
+    // Start and stop recording, with the recorder's counters
+    void RenderRecording();
+
+    // Keep a history in memory and save clips from it
+    void RenderHistory();
+
+    // Feed the performance panel when a sample is due
+    void SamplePerformance();
+
     // Function to handle overlays such as modals
     void HandleOverlays();
 };
@@ -0,0 +1,117 @@
+#include "UiBenchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "FrameLatency.h"
+#include "ThreadCpu.h"
+#include "imgui.h"
+
+std::string UiBenchmarkResult::ToJson() const {
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+        "{\"frames\": %d, \"wall_ms_per_frame\": %.4f, \"cpu_ms_per_frame\": %.4f, \"frame_time\": ",
+        frames, wallMsPerFrame, cpuMsPerFrame);
+    std::string json = buffer;
+    AppendLatencySummaryJson(json, frameTime);
+    snprintf(buffer, sizeof(buffer),
+        ", \"vertices\": {\"mean\": %.1f, \"max\": %d}, \"indices\": {\"mean\": %.1f, \"max\": %d}, "
+        "\"draw_lists\": %.2f, \"draw_commands\": %.2f}",
+        meanVertices, maxVertices, meanIndices, maxIndices, meanDrawLists, meanDrawCommands);
+    json += buffer;
+    return json;
+}
+
+// Mouse position for 'frame': a slow Lissajous sweep that crosses every
+// part of the display, so hover states keep changing as they would in use.
+static ImVec2 SyntheticMousePosition(int frame, float width, float height) {
+    const double t = frame / 60.0;
+    const float x = static_cast<float>(0.5 + 0.48 * std::sin(t * 0.9));
+    const float y = static_cast<float>(0.5 + 0.48 * std::sin(t * 1.3 + 0.5));
+    return ImVec2(x * width, y * height);
+}
+
+UiBenchmarkResult RunUiBenchmark(const UiBenchmarkOptions& options, const std::function<void(int frame)>& drawFrame) {
+    ImGuiContext* previous = ImGui::GetCurrentContext();
+    ImGuiContext* context = ImGui::CreateContext();
+    ImGui::SetCurrentContext(context);
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.LogFilename = nullptr;
+    io.DisplaySize = ImVec2(options.width, options.height);
+    io.DeltaTime = 1.0f / 60.0f;
+    ImGui::StyleColorsDark();
+
+    // Without a renderer backend nobody builds the font atlas; NewFrame()
+    // needs it built, and the texture ID only has to be non-null.
+    unsigned char* pixels = nullptr;
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &atlasWidth, &atlasHeight);
+    io.Fonts->SetTexID(reinterpret_cast<ImTextureID>(static_cast<intptr_t>(1)));
+
+    LatencyHistogram frameTimes;
+    UiBenchmarkResult result;
+    double vertices = 0.0;
+    double indices = 0.0;
+    double drawLists = 0.0;
+    double drawCommands = 0.0;
+    int64_t wallStart = 0;
+    double cpuStart = 0.0;
+
+    const int totalFrames = options.warmupFrames + options.frames;
+    for (int frame = 0; frame < totalFrames; ++frame) {
+        const bool measured = frame >= options.warmupFrames;
+        if (frame == options.warmupFrames) {
+            wallStart = MonotonicNanos();
+            cpuStart = CurrentThreadCpuSeconds();
+        }
+
+        // Input is queued before the frame, as a platform backend would.
+        if (options.syntheticInput) {
+            const ImVec2 mouse = SyntheticMousePosition(frame, options.width, options.height);
+            io.AddMousePosEvent(mouse.x, mouse.y);
+            if (options.clickEvery > 0) {
+                const int phase = frame % options.clickEvery;
+                if (phase == 0 || phase == 1) {
+                    io.AddMouseButtonEvent(ImGuiMouseButton_Left, phase == 0);
+                }
+            }
+        }
+
+        const int64_t start = MonotonicNanos();
+        ImGui::NewFrame();
+        drawFrame(frame);
+        ImGui::Render();
+        const int64_t end = MonotonicNanos();
+        if (!measured) {
+            continue;
+        }
+
+        frameTimes.Record(end - start);
+        const ImDrawData* drawData = ImGui::GetDrawData();
+        vertices += drawData->TotalVtxCount;
+        indices += drawData->TotalIdxCount;
+        drawLists += drawData->CmdListsCount;
+        for (int i = 0; i < drawData->CmdListsCount; ++i) {
+            drawCommands += drawData->CmdLists[i]->CmdBuffer.Size;
+        }
+        result.maxVertices = std::max(result.maxVertices, drawData->TotalVtxCount);
+        result.maxIndices = std::max(result.maxIndices, drawData->TotalIdxCount);
+    }
+
+    if (options.frames > 0) {
+        result.frames = options.frames;
+        result.wallMsPerFrame = (MonotonicNanos() - wallStart) / 1e6 / options.frames;
+        result.cpuMsPerFrame = (CurrentThreadCpuSeconds() - cpuStart) * 1e3 / options.frames;
+        result.frameTime = frameTimes.Summarize();
+        result.meanVertices = vertices / options.frames;
+        result.meanIndices = indices / options.frames;
+        result.meanDrawLists = drawLists / options.frames;
+        result.meanDrawCommands = drawCommands / options.frames;
+    }
+
+    ImGui::DestroyContext(context);
+    ImGui::SetCurrentContext(previous);
+    return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include "LatencyHistogram.h"
+
+// Times UI frames in an ImGui context with no platform or renderer backend,
+// so the cost of building the UI, from ImGui::NewFrame() to ImGui::Render(),
+// can be measured without a window or a GPU and on any OS. Draw data is
+// produced as usual and then dropped.
+struct UiBenchmarkOptions {
+    int frames = 2000;
+    int warmupFrames = 120;    // Run first and not measured, so windows and caches settle
+    float width = 1280.0f;
+    float height = 800.0f;
+    bool syntheticInput = true;  // Sweep the mouse over the display
+    int clickEvery = 60;       // Frames between clicks at the mouse position; 0 for none
+};
+
+struct UiBenchmarkResult {
+    int frames = 0;
+    double wallMsPerFrame = 0.0;
+    double cpuMsPerFrame = 0.0;   // Thread CPU time, which excludes preemption
+    LatencySummary frameTime;     // NewFrame() through Render(), in microseconds
+
+    // ImDrawData per frame
+    double meanVertices = 0.0;
+    double meanIndices = 0.0;
+    double meanDrawLists = 0.0;
+    double meanDrawCommands = 0.0;
+    int maxVertices = 0;
+    int maxIndices = 0;
+
+    // {"frames": n, "wall_ms_per_frame": ..., "frame_time": {...}, "vertices": {...}, ...}
+    std::string ToJson() const;
+};
+
+// Run 'drawFrame' between ImGui::NewFrame() and ImGui::Render() for the
+// warmup and measured frames, in a context of its own that is destroyed
+// afterwards. The caller's current context, if any, is restored. The frame
+// number is passed in, counting the warmup frames.
+UiBenchmarkResult RunUiBenchmark(const UiBenchmarkOptions& options, const std::function<void(int frame)>& drawFrame);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include "PixelConversion.h"
+
+// Layout of the frames a capture stream delivers, as negotiated with the
+// source. Changes when the source switches formats mid-stream.
+struct VideoFormat {
+    PixelFormat format = PixelFormat::Unknown;
+    int width = 0;
+    int height = 0;
+    int stride = 0;        // Bytes per row of the first plane; 0 when compressed
+    bool topDown = false;  // RGB rows stored top-down (negative biHeight)
+};
+
+// A CPU-side video frame in its capture format, as handed from the capture
+// thread to the display and other consumers. The storage belongs to whoever
+// handed the frame out, normally a FramePool, and is reused between frames.
+struct VideoFrame {
+    uint8_t* pixels = nullptr;
+    size_t capacity = 0;     // Bytes allocated at 'pixels'
+    PixelFormat format = PixelFormat::Unknown;
+    int width = 0;
+    int height = 0;
+    int stride = 0;          // Bytes per row of the first plane
+    bool topDown = false;    // See VideoFormat::topDown
+    size_t size = 0;         // Bytes of 'pixels' in use
+    double sampleTime = 0.0; // Source stream time in seconds
+    uint64_t sequence = 0;   // Monotonic per-stream frame counter
+    int64_t grabTime = 0;    // MonotonicNanos() when the source delivered it
+    int64_t publishTime = 0; // MonotonicNanos() just before it was handed to consumers
+
+    VideoFormat Layout() const {
+        VideoFormat layout;
+        layout.format = format;
+        layout.width = width;
+        layout.height = height;
+        layout.stride = stride;
+        layout.topDown = topDown;
+        return layout;
+    }
+
+    // Plane layout of the frame for the pixel converters. Fails for compressed
+    // frames, which have to be decoded first.
+    bool GetPlanes(ImagePlanes* planes) const {
+        if (!DescribeFrame(format, pixels, size, width, height, stride, planes)) {
+            return false;
+        }
+        if (topDown && planes->stride[0] < 0) {
+            // DescribeFrame assumes a bottom-up DIB
+            planes->data[0] = pixels;
+            planes->stride[0] = stride;
+        }
+        return true;
+    }
+};
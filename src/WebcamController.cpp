@@ -1,166 +1,137 @@
 #include "WebcamController.h"
-#include <iostream>
+#include "AllocationTracker.h"
+#include "PixelConversion.h"
+#include "Trace.h"
+#include "Log.h"
+#include "ThreadCpu.h"
+
+// Progress steps reported while a camera opens
+static const int kOpenSteps = 5;
+
+// Longest a camera may take to start streaming before the open is reported
+// as failed; driver warm-up can take a few seconds
+static const std::chrono::milliseconds kOpenTimeout(10000);
 
 WebcamController::WebcamController(ID3D11Device* device, ID3D11DeviceContext* context)
-    : is_initialized(false), new_frame_ready(false), callback(this), m_device(device), m_context(context), Width(640), Height(480) {
+    : m_device(device), m_context(context) {
     CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    opener = std::make_unique<CameraOpener>(this, kOpenSteps, kOpenTimeout);
 }
 
 WebcamController::~WebcamController() {
-    Cleanup();
+    StopRecording();
+    StopHistory();
+    opener->Shutdown();
+    frameBroadcast.Close();
     CoUninitialize();
 }
 
-HRESULT WebcamController::Initialize(int cameraIndex) {
-    if (is_initialized.load()) {
-        return S_OK;
-    }
-
-    HRESULT hr;
-
-    // Create Filter Graph Manager
-    hr = pGraph.CoCreateInstance(CLSID_FilterGraph);
-    if (FAILED(hr)) {
-        return hr;
-    }
-
-    // Create Capture Graph Builder
-    hr = pCaptureGraph.CoCreateInstance(CLSID_CaptureGraphBuilder2);
-    if (FAILED(hr)) {
-        return hr;
-    }
-
-    hr = pCaptureGraph->SetFiltergraph(pGraph);
-    if (FAILED(hr)) {
-        return hr;
-    }
-
-    // Enumerate Video Input Devices
-    CComPtr<ICreateDevEnum> pDevEnum;
-    hr = pDevEnum.CoCreateInstance(CLSID_SystemDeviceEnum);
-    if (FAILED(hr)) {
-        return hr;
-    }
-
-    CComPtr<IEnumMoniker> pEnum;
-    hr = pDevEnum->CreateClassEnumerator(CLSID_VideoInputDeviceCategory, &pEnum, 0);
-    if (hr != S_OK) {
-        return E_FAIL;
-    }
-
-    IMoniker* pMoniker = nullptr;
-    ULONG fetched;
-    int index = 0;
-    while (pEnum->Next(1, &pMoniker, &fetched) == S_OK) {
-        if (index == cameraIndex) {
-            hr = pMoniker->BindToObject(0, 0, IID_IBaseFilter, (void**)&pSourceFilter);
-            pMoniker->Release();
-            if (FAILED(hr)) {
-                return hr;
-            }
-            break;
-        }
-        index++;
-        pMoniker->Release();
-    }
-
-    if (!pSourceFilter) {
-        return E_FAIL;
-    }
-
-    hr = pGraph->AddFilter(pSourceFilter, L"Video Capture");
-    if (FAILED(hr)) {
-        return hr;
-    }
+void WebcamController::AttachWorkerThread() {
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+}
 
-    // Add Sample Grabber Filter
-    hr = AddFilterByCLSID(pGraph, CLSID_SampleGrabber, &pGrabberFilter, L"Sample Grabber");
-    if (FAILED(hr)) {
-        return hr;
-    }
+void WebcamController::DetachWorkerThread() {
+    CoUninitialize();
+}
 
-    hr = pGrabberFilter->QueryInterface(IID_ISampleGrabber, (void**)&pGrabber);
-    if (FAILED(hr)) {
-        return hr;
+long WebcamController::OpenDevice(const std::wstring& path, CameraOpenContext& context) {
+    source = CreateCaptureSource(path);
+    if (!source) {
+        return E_INVALIDARG;
     }
 
-    hr = ConfigureSampleGrabber();
-    if (FAILED(hr)) {
+    HRESULT hr = source->Open(GetCapturePolicy(), context);
+    if (FAILED(hr) || context.Cancelled()) {
         return hr;
     }
 
-    // Add Null Renderer Filter
-    hr = AddFilterByCLSID(pGraph, CLSID_NullRenderer, &pNullRenderer, L"Null Renderer");
-    if (FAILED(hr)) {
-        return hr;
+    {
+        std::lock_guard<std::mutex> lock(modeMutex);
+        capabilities = source->Capabilities();
+        selectedMode = source->SelectedMode();
     }
 
-    // Connect Filters: Source Filter -> Sample Grabber -> Null Renderer
-    hr = pCaptureGraph->RenderStream(&PIN_CATEGORY_CAPTURE, &MEDIATYPE_Video, pSourceFilter, pGrabberFilter, pNullRenderer);
-    if (FAILED(hr)) {
-        return hr;
-    }
+    // Frames from here on belong to this device. The previous source has been
+    // stopped, so no streaming thread is touching frameSequence.
+    firstSessionFrame.store(frameSequence + 1, std::memory_order_release);
 
-    // Get Media Control Interface
-    hr = pGraph->QueryInterface(IID_IMediaControl, (void**)&pControl);
-    if (FAILED(hr)) {
-        return hr;
-    }
+    context.Step("Starting capture");
+    return source->Start(this);
+}
 
-    // Create the Direct3D texture
-    hr = CreateTexture(Width, Height);
-    if (FAILED(hr)) {
-        return hr;
+void WebcamController::CloseDevice() {
+    if (source) {
+        source->Stop();
+        source.reset();
     }
 
-    is_initialized.store(true);
-    return S_OK;
+    // Hide the last frame of this device from the UI thread.
+    firstSessionFrame.store(UINT64_MAX, std::memory_order_release);
 }
 
-HRESULT WebcamController::AddFilterByCLSID(IGraphBuilder* pGraph, const GUID& clsid, IBaseFilter** ppF, const wchar_t* name) {
-    CComPtr<IBaseFilter> pFilter;
-    HRESULT hr = pFilter.CoCreateInstance(clsid);
-    if (FAILED(hr)) {
-        return hr;
-    }
+void WebcamController::SetCapturePolicy(const CapturePolicy& policy) {
+    std::lock_guard<std::mutex> lock(modeMutex);
+    capturePolicy = policy;
+}
 
-    hr = pGraph->AddFilter(pFilter, name);
-    if (FAILED(hr)) {
-        return hr;
-    }
+CapturePolicy WebcamController::GetCapturePolicy() const {
+    std::lock_guard<std::mutex> lock(modeMutex);
+    return capturePolicy;
+}
 
-    *ppF = pFilter.Detach();
-    return S_OK;
+CaptureCapabilities WebcamController::GetCapabilities() const {
+    std::lock_guard<std::mutex> lock(modeMutex);
+    return capabilities;
 }
 
-HRESULT WebcamController::ConfigureSampleGrabber() {
-    AM_MEDIA_TYPE mt;
-    ZeroMemory(&mt, sizeof(AM_MEDIA_TYPE));
-    mt.majortype = MEDIATYPE_Video;
-    mt.subtype = MEDIASUBTYPE_RGB24;
-    mt.formattype = FORMAT_VideoInfo;
+int WebcamController::GetSelectedMode() const {
+    std::lock_guard<std::mutex> lock(modeMutex);
+    return selectedMode;
+}
 
-    HRESULT hr = pGrabber->SetMediaType(&mt);
-    if (FAILED(hr)) {
-        return hr;
+void WebcamController::OnFrame(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) {
+    const int64_t grabTime = MonotonicNanos();
+    TRACE_THREAD_NAME("Capture");
+    RegisterThreadCpu("Capture");
+    TRACE_SCOPE("WebcamController::OnFrame");
+    ALLOC_SCOPE("Capture");
+
+    // Copy the sample into a pooled frame once; the mailbox, and anyone else
+    // the frame is shared with, only pass the reference around.
+    size_t bytes = size;
+    if (format.format != PixelFormat::MJPEG) {
+        // Compressed samples vary in size; uncompressed ones must hold a
+        // whole frame of the negotiated format.
+        bytes = FrameSize(format.format, format.height, format.stride);
+        if (bytes == 0 || size < bytes) {
+            return;
+        }
     }
 
-    hr = pGrabber->SetOneShot(FALSE);
-    if (FAILED(hr)) {
-        return hr;
+    FrameRef frame = framePool.Acquire(format, bytes);
+    if (!frame) {
+        return;  // Every buffer is still held by a consumer; drop this frame
     }
+    memcpy(frame->pixels, data, bytes);
+    frame->sampleTime = sampleTime;
+    frame->sequence = ++frameSequence;
+    frame->grabTime = grabTime;
+    frame->publishTime = MonotonicNanos();
+    const uint64_t sequence = frame->sequence;
 
-    hr = pGrabber->SetBufferSamples(TRUE);
-    if (FAILED(hr)) {
-        return hr;
-    }
+    frameBroadcast.Publish(frame);
 
-    hr = pGrabber->SetCallback(&callback, 1);
-    if (FAILED(hr)) {
-        return hr;
-    }
+    // Replacing the write slot's reference returns the frame it held, unless
+    // something else still uses it.
+    frameMailbox.WriteSlot() = std::move(frame);
+    frameMailbox.Publish();
 
-    return S_OK;
+    // The capture stage ends once both have the frame, so it includes the
+    // fan-out; the frame itself is shared by now and keeps the earlier stamp.
+    latency.RecordCapture(sampleTime, grabTime, MonotonicNanos());
+    if (sequence == firstSessionFrame.load(std::memory_order_relaxed)) {
+        opener->NotifyFirstFrame();
+    }
 }
 
 HRESULT WebcamController::CreateTexture(int width, int height) {
@@ -175,17 +146,10 @@ HRESULT WebcamController::CreateTexture(int width, int height) {
     desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
     desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
-    // Create the front buffer texture
+    // Create the display texture. It is only ever written from the UI thread.
     HRESULT hr = m_device->CreateTexture2D(&desc, nullptr, &m_texture);
     if (FAILED(hr)) {
-        std::cerr << "Failed to create front buffer texture. HRESULT: " << std::hex << hr << std::endl;
-        return hr;
-    }
-
-    // Create the back buffer texture
-    hr = m_device->CreateTexture2D(&desc, nullptr, &m_backBufferTexture);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create back buffer texture. HRESULT: " << std::hex << hr << std::endl;
+        LOG_ERROR("WebcamController", "Failed to create display texture. HRESULT: 0x%08lX", static_cast<unsigned long>(hr));
         return hr;
     }
 
@@ -198,133 +162,245 @@ HRESULT WebcamController::CreateTexture(int width, int height) {
 
     hr = m_device->CreateShaderResourceView(m_texture.Get(), &srvDesc, &m_srv);
     if (FAILED(hr)) {
-        std::cerr << "Failed to create shader resource view. HRESULT: " << std::hex << hr << std::endl;
+        LOG_ERROR("WebcamController", "Failed to create shader resource view. HRESULT: 0x%08lX", static_cast<unsigned long>(hr));
         return hr;
     }
 
-    Width = width;
-    Height = height;
+    textureWidth = width;
+    textureHeight = height;
 
     return S_OK;
 }
 
-
-HRESULT WebcamController::StartCapture() {
-    if (!is_initialized.load()) {
-        return E_FAIL;
+ID3D11ShaderResourceView* WebcamController::GetFrameTexture() {
+    TRACE_SCOPE("WebcamController::GetFrameTexture");
+    ALLOC_SCOPE("Convert");
+    // Pick up the newest frame if one arrived since the last UI frame. When
+    // nothing new is pending the texture still holds the previous frame,
+    // unless that came from a device that has been closed or replaced since.
+    const uint64_t firstFrame = firstSessionFrame.load(std::memory_order_acquire);
+    if (frameMailbox.Acquire()) {
+        if (frameMailbox.ReadSlot()->sequence < firstFrame) {
+            frameMailbox.ResetReader();
+        }
+        else {
+            const VideoFrame& frame = *frameMailbox.ReadSlot();
+            uploadedTimes.sampleTime = frame.sampleTime;
+            uploadedTimes.grab = frame.grabTime;
+            uploadedTimes.publish = frame.publishTime;
+            uploadedTimes.pickup = MonotonicNanos();
+            if (FAILED(UploadFrame(frame))) {
+                uploadedPending = false;
+                return nullptr;
+            }
+            uploadedTimes.convert = MonotonicNanos();
+            uploadedPending = true;
+        }
     }
-
-    if (!pControl) {
-        return E_POINTER;
+    else if (frameMailbox.HasFrame() && frameMailbox.ReadSlot()->sequence < firstFrame) {
+        frameMailbox.ResetReader();
     }
+    return frameMailbox.HasFrame() ? m_srv.Get() : nullptr;
+}
 
-    HRESULT hr = pControl->Run();
-    if (FAILED(hr)) {
-        return hr;
-    }
+bool WebcamController::StartRecording(const RecorderOptions& options) {
+    StopRecording();
+    auto started = std::make_unique<SegmentedRecorder>(options);
+    if (!started->Start()) {
+        return false;
+    }
+
+    // Room for bursts while the recorder copies a frame; a backlog beyond
+    // that is the recorder's to drop, not the capture thread's.
+    SubscriberOptions subscriberOptions;
+    subscriberOptions.name = "Recorder";
+    subscriberOptions.policy = BackpressurePolicy::DropOldest;
+    subscriberOptions.capacity = 8;
+    recordSubscriber = frameBroadcast.Subscribe(subscriberOptions);
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        recorder = std::move(started);
+    }
+    recordStop.store(false, std::memory_order_relaxed);
+    recordThread = std::thread(&WebcamController::RecordFrames, this);
+    return true;
+}
 
-    return S_OK;
+void WebcamController::StopRecording() {
+    if (!recorder) {
+        return;
+    }
+    recordStop.store(true, std::memory_order_relaxed);
+    recordThread.join();
+    recordSubscriber.reset();
+    recorder->Stop();
+
+    std::lock_guard<std::mutex> lock(recordMutex);
+    const RecorderStats stats = recorder->GetStats();
+    LOG_INFO("Recorder", "Recorded %llu frames in %llu segments, %llu dropped",
+        static_cast<unsigned long long>(stats.framesRecorded), static_cast<unsigned long long>(stats.segments),
+        static_cast<unsigned long long>(stats.framesDropped));
+    recordedBytes += stats.bytesWritten;
+    recorder.reset();
+}
+
+RecorderStats WebcamController::GetRecorderStats() const {
+    std::lock_guard<std::mutex> lock(recordMutex);
+    RecorderStats stats = recorder ? recorder->GetStats() : RecorderStats();
+    stats.bytesWritten += recordedBytes;
+    return stats;
 }
 
-HRESULT WebcamController::StopCapture() {
-    if (!is_initialized.load()) {
-        return E_FAIL;
+void WebcamController::RecordFrames() {
+    TRACE_THREAD_NAME("Recorder");
+    RegisterThreadCpu("Recorder");
+    FrameRef frame;
+    while (!recordStop.load(std::memory_order_relaxed)) {
+        if (!recordSubscriber->Pop(&frame, std::chrono::milliseconds(50))) {
+            continue;
+        }
+        recorder->Enqueue(frame->Layout(), frame->pixels, frame->size, frame->sampleTime);
+        frame = FrameRef();  // Back to the pool before waiting for the next
     }
+}
+
+void WebcamController::StartHistory(const FrameHistoryOptions& options) {
+    StopHistory();
+    auto started = std::make_unique<FrameHistory>(options);
+
+    // Compressing a raw frame takes a while; the subscriber queue absorbs
+    // the jitter, and frames beyond it are the history's to drop.
+    SubscriberOptions subscriberOptions;
+    subscriberOptions.name = "History";
+    subscriberOptions.policy = BackpressurePolicy::DropOldest;
+    subscriberOptions.capacity = 8;
+    historySubscriber = frameBroadcast.Subscribe(subscriberOptions);
+    {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        history = std::move(started);
+    }
+    historyStop.store(false, std::memory_order_relaxed);
+    historyThread = std::thread(&WebcamController::HistoryFrames, this);
+}
 
-    if (!pControl) {
-        return E_POINTER;
+void WebcamController::StopHistory() {
+    if (!history) {
+        return;
     }
+    historyStop.store(true, std::memory_order_relaxed);
+    historyThread.join();
+    historySubscriber.reset();
 
-    HRESULT hr = pControl->Stop();
-    if (FAILED(hr)) {
-        return hr;
+    std::unique_ptr<FrameHistory> stopped;
+    {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        stopped = std::move(history);
     }
+    // Finishes a clip being saved; outside the lock so stats readers never
+    // wait on the disk
+    stopped.reset();
+}
 
-    return S_OK;
+FrameHistoryStats WebcamController::GetHistoryStats() const {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return history ? history->GetStats() : FrameHistoryStats();
 }
 
-ID3D11ShaderResourceView* WebcamController::GetFrameTexture() {
-    if (new_frame_ready.load()) {
-        new_frame_ready.store(false);
-        return m_srv.Get();
-    }
-    return nullptr;
+bool WebcamController::SaveClip(const std::filesystem::path& path, double seconds) {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return history && history->StartExport(path, seconds);
 }
 
-std::vector<std::wstring> WebcamController::ListAvailableCameras() {
-    std::vector<std::wstring> cameraNames;
+ClipExportStatus WebcamController::GetClipStatus() const {
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return history ? history->GetExportStatus() : ClipExportStatus();
+}
 
-    CComPtr<ICreateDevEnum> pDevEnum;
-    HRESULT hr = pDevEnum.CoCreateInstance(CLSID_SystemDeviceEnum);
-    if (FAILED(hr)) {
-        return cameraNames;
+void WebcamController::HistoryFrames() {
+    TRACE_THREAD_NAME("History");
+    RegisterThreadCpu("History");
+    FrameRef frame;
+    while (!historyStop.load(std::memory_order_relaxed)) {
+        if (!historySubscriber->Pop(&frame, std::chrono::milliseconds(50))) {
+            continue;
+        }
+        history->Add(frame->Layout(), frame->pixels, frame->size, frame->sampleTime);
+        frame = FrameRef();  // Back to the pool before waiting for the next
     }
+}
 
-    CComPtr<IEnumMoniker> pEnum;
-    hr = pDevEnum->CreateClassEnumerator(CLSID_VideoInputDeviceCategory, &pEnum, 0);
-    if (hr != S_OK) {
-        return cameraNames;
-    }
+CaptureMetrics WebcamController::GetMetrics() const {
+    CaptureMetrics metrics;
+    metrics.state = opener->Status().state;
+    metrics.camera = opener->GetStats();
+    metrics.display = frameMailbox.GetStats();
+    metrics.pool = framePool.GetStats();
+    metrics.latency = &latency;
+    metrics.recordingBytes = GetRecorderStats().bytesWritten;
+    metrics.history = GetHistoryStats();
+    return metrics;
+}
 
-    IMoniker* pMoniker = nullptr;
-    ULONG fetched;
-    while (pEnum->Next(1, &pMoniker, &fetched) == S_OK) {
-        CComPtr<IPropertyBag> pPropBag;
-        hr = pMoniker->BindToStorage(0, 0, IID_IPropertyBag, (void**)&pPropBag);
-        if (SUCCEEDED(hr)) {
-            VARIANT varName;
-            VariantInit(&varName);
-            hr = pPropBag->Read(L"FriendlyName", &varName, 0);
-            if (SUCCEEDED(hr)) {
-                cameraNames.push_back(varName.bstrVal);
-            }
-            VariantClear(&varName);
-        }
-        pMoniker->Release();
+void WebcamController::OnPresented() {
+    TRACE_COUNTER("Frames dropped", frameMailbox.GetStats().dropped);
+    if (uploadedPending) {
+        uploadedTimes.display = MonotonicNanos();
+        latency.RecordDisplay(uploadedTimes);
+        uploadedPending = false;
     }
-
-    return cameraNames;
 }
 
-void WebcamController::Cleanup() {
-    if (is_initialized.load()) {
-        if (pControl) {
-            pControl->Stop();
+HRESULT WebcamController::UploadFrame(const VideoFrame& frame) {
+    // MJPEG is decoded first so the texture can follow the decoded size.
+    // Only frames that reach the display are decoded; the ones the mailbox
+    // dropped never cost more than a memcpy.
+    ImagePlanes planes;
+    int frameWidth = frame.width;
+    int frameHeight = frame.height;
+    if (frame.format == PixelFormat::MJPEG) {
+        if (!mjpegDecoder) {
+            decodePool = std::make_unique<WorkerPool>();
+            mjpegDecoder = std::make_unique<MjpegDecoder>(decodePool.get());
         }
-
-        if (pGraph && pGrabberFilter && pNullRenderer) {
-            pGraph->RemoveFilter(pNullRenderer);
-            pGraph->RemoveFilter(pGrabberFilter);
+        TRACE_SCOPE("MJPEG decode");
+        if (!mjpegDecoder->Decode(frame.pixels, frame.size)) {
+            return S_OK;  // Keep showing the previous frame
         }
+        frameWidth = mjpegDecoder->Width();
+        frameHeight = mjpegDecoder->Height();
+    }
+    else if (!frame.GetPlanes(&planes)) {
+        return S_OK;
+    }
 
-        if (pGrabberFilter) {
-            pGrabberFilter.Release();
-            pGrabber.Detach();
-            pGrabber.Release();
+    // Rotating by 90 or 270 degrees swaps the texture dimensions. The first
+    // frame of a device creates the texture.
+    int displayWidth, displayHeight;
+    OrientedSize(orientation, frameWidth, frameHeight, &displayWidth, &displayHeight);
+    if (!m_texture || displayWidth != textureWidth || displayHeight != textureHeight) {
+        HRESULT hr = CreateTexture(displayWidth, displayHeight);
+        if (FAILED(hr)) {
+            return hr;
         }
+    }
 
-        if (pSourceFilter) {
-            pGraph->RemoveFilter(pSourceFilter);
-            pSourceFilter.Release();
-        }
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    HRESULT hr = m_context->Map(m_texture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+    if (FAILED(hr)) {
+        return hr;
+    }
 
-        pNullRenderer.Release();
-        pControl.Release();
-        pGraph.Release();
-        pCaptureGraph.Release();
-        pCamCtrl.Release();
-        pProcAmp.Release();
-
-        pGrabberFilter = nullptr;
-        pGrabber = nullptr;
-        pSourceFilter = nullptr;
-        pNullRenderer = nullptr;
-        pControl = nullptr;
-        pGraph = nullptr;
-        pCaptureGraph = nullptr;
-        pCamCtrl = nullptr;
-        pProcAmp = nullptr;
-
-        is_initialized.store(false);
+    // Convert and reorient from the capture format straight into the mapped
+    // texture. Bottom-up RGB DIBs are turned upright by the plane description.
+    uint8_t* pixels = reinterpret_cast<uint8_t*>(mappedResource.pData);
+    TRACE_SCOPE("Convert to RGBA");
+    if (frame.format == PixelFormat::MJPEG) {
+        mjpegDecoder->ConvertToRGBA(pixels, mappedResource.RowPitch, orientation);
     }
+    else {
+        ConvertToRGBA(planes, pixels, mappedResource.RowPitch, DefaultYuvColorSpace(frame.width, frame.height), orientation);
+    }
+
+    m_context->Unmap(m_texture.Get(), 0);
+    return S_OK;
 }
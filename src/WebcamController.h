@@ -1,126 +1,196 @@
 #pragma once
 
 #include <windows.h>
-#include <dshow.h>
 #include <d3d11.h>
 #include <wrl/client.h>
-#include <atlbase.h>
 #include <string>
 #include <vector>
 #include <atomic>
 #include <memory>
 #include <mutex>
-#include "graph.h"
+#include "CaptureSource.h"
+#include "FrameMailbox.h"
+#include "VideoFrame.h"
+#include "FramePool.h"
+#include "FrameBroadcast.h"
+#include "MjpegDecoder.h"
+#include "WorkerPool.h"
+#include "CameraOpener.h"
+#include "FrameLatency.h"
+#include "CaptureMetrics.h"
+#include "SegmentedRecorder.h"
+#include "FrameHistory.h"
 
-#pragma comment(lib, "strmiids.lib")
 #pragma comment(lib, "d3d11.lib")
 
-class WebcamController {
+class WebcamController : private CameraDevice, private CaptureSink {
 public:
     WebcamController(ID3D11Device* device, ID3D11DeviceContext* context);
     ~WebcamController();
 
-    HRESULT Initialize(int cameraIndex = 0);
-    HRESULT StartCapture();
-    HRESULT StopCapture();
+    // Open the device with the given path (DeviceInfo::path, or any path
+    // CreateCaptureSource() understands) and start capturing. Returns at
+    // once; the source is opened on a worker thread and GetStatus() reports
+    // progress. Opening while another open is in flight cancels that one.
+    void OpenCamera(const std::wstring& devicePath) { opener->Open(devicePath); }
+    void CloseCamera() { opener->Close(); }
+    void CancelOpen() { opener->Cancel(); }
+    CameraStatus GetStatus() const { return opener->Status(); }
+
     ID3D11ShaderResourceView* GetFrameTexture();
-    std::vector<std::wstring> ListAvailableCameras();
+    FrameMailboxStats GetFrameStats() const { return frameMailbox.GetStats(); }
+    FramePoolStats GetFramePoolStats() const { return framePool.GetStats(); }
+
+    // Counters and histograms for monitoring. Safe to call from any thread;
+    // never waits on the capture thread.
+    CaptureMetrics GetMetrics() const;
+
+    // Subscribe to every captured frame, besides the one shown on screen.
+    // Frames are delivered in capture format; see FrameBroadcast for the
+    // policies. Subscribers must be destroyed before the controller.
+    std::unique_ptr<FrameSubscriber> SubscribeFrames(const SubscriberOptions& options) { return frameBroadcast.Subscribe(options); }
+
+    // Record every captured frame, in capture format, to segment files as
+    // described by 'options'. The recorder takes frames from the broadcast
+    // on a thread of its own, so a slow disk costs recorded frames, never
+    // captured ones. MJPEG is recorded as the camera sent it; only the frames
+    // the display picks up are ever decoded. Returns false if the recorder
+    // could not start.
+    bool StartRecording(const RecorderOptions& options);
+    void StopRecording();
+    bool IsRecording() const { return recorder != nullptr; }
+    RecorderStats GetRecorderStats() const;
+
+    // Keep the last stretch of capture in memory, within the budget in
+    // 'options', so SaveClip() can write out what led up to an event. Fed
+    // from the broadcast on a thread of its own, like the recorder. Stopping
+    // waits for a clip being saved.
+    void StartHistory(const FrameHistoryOptions& options);
+    void StopHistory();
+    bool IsHistoryRunning() const { return history != nullptr; }
+    FrameHistoryStats GetHistoryStats() const;
+
+    // Save the last 'seconds' of history to an AVI file in the background;
+    // capture and the history carry on meanwhile. Returns false if no
+    // history is kept, it is empty, or a clip is being saved already.
+    bool SaveClip(const std::filesystem::path& path, double seconds);
+    ClipExportStatus GetClipStatus() const;
+
+    // Call on the UI thread right after the swap chain presents, so the frame
+    // uploaded by the last GetFrameTexture() counts as displayed.
+    void OnPresented();
+
+    // Per-stage latency and jitter of the frames captured and displayed
+    const FrameLatencyCollector& GetLatency() const { return latency; }
+    // Takes effect on each side's next frame
+    void ResetLatency() { latency.RequestReset(); }
+
+    // Orientation applied while converting frames for display. Call from the
+    // UI thread; takes effect with the next frame.
+    void SetOrientation(FrameOrientation value) { orientation = value; }
+    FrameOrientation GetOrientation() const { return orientation; }
+
+    // Policy for choosing among the camera's modes; applies from the next
+    // OpenCamera(). The capability index is rebuilt each time a device opens,
+    // on the worker thread, so these return copies.
+    void SetCapturePolicy(const CapturePolicy& policy);
+    CapturePolicy GetCapturePolicy() const;
+    CaptureCapabilities GetCapabilities() const;
+    int GetSelectedMode() const;
+
+    // Size of the display texture, i.e. the oriented frame size.
+    int GetDisplayWidth() const { return textureWidth; }
+    int GetDisplayHeight() const { return textureHeight; }
 
 private:
-    // COM interfaces
-    CComPtr<IGraphBuilder> pGraph;
-    CComPtr<ICaptureGraphBuilder2> pCaptureGraph;
-    CComPtr<IMediaControl> pControl;
-    CComPtr<IBaseFilter> pSourceFilter;
-    CComPtr<IBaseFilter> pGrabberFilter;
-    CComPtr<ISampleGrabber> pGrabber;
-    CComPtr<IBaseFilter> pNullRenderer;
-    CComPtr<IAMCameraControl> pCamCtrl;
-    CComPtr<IAMVideoProcAmp> pProcAmp;
-
-    std::atomic<bool> is_initialized;
-    std::atomic<bool> new_frame_ready;
-
     // Direct3D resources
     Microsoft::WRL::ComPtr<ID3D11Device> m_device;
     Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
     Microsoft::WRL::ComPtr<ID3D11Texture2D> m_texture;
-    Microsoft::WRL::ComPtr<ID3D11Texture2D> m_backBufferTexture;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_srv;
-
-    // Frame buffer
-    std::mutex frame_mutex;
+    int textureWidth = 0;
+    int textureHeight = 0;
+
+    // The open source, created and destroyed on the opener's worker thread
+    std::unique_ptr<CaptureSource> source;
+
+    // Buffers for captured frames. Declared before every holder of a FrameRef
+    // so it is destroyed after them. Sized for the display mailbox, the
+    // broadcast ring and a few frames queued for each subscriber.
+    FramePool framePool{ 32 };
+
+    // Captured frames for consumers other than the display
+    FrameBroadcast frameBroadcast;
+
+    // Latest-frame handoff from the source's streaming thread to the UI thread
+    FrameMailbox<FrameRef> frameMailbox;
+    uint64_t frameSequence = 0;
+
+    // Sequence number of the first frame of the current open; frames below it
+    // belong to a device that has been closed since and are not displayed.
+    std::atomic<uint64_t> firstSessionFrame{ UINT64_MAX };
+
+    FrameOrientation orientation;
+
+    FrameLatencyCollector latency;
+
+    // Timestamps of the frame uploaded by GetFrameTexture() that has not been
+    // presented yet. UI thread only.
+    FrameTimestamps uploadedTimes;
+    bool uploadedPending = false;
+
+    // Modes of the open device and the one chosen by capturePolicy. Written
+    // by the open worker, read by the UI.
+    mutable std::mutex modeMutex;
+    CaptureCapabilities capabilities;
+    CapturePolicy capturePolicy = DefaultCapturePolicy();
+    int selectedMode = -1;
+
+    // MJPEG frames are decoded on the UI thread at display rate, with restart
+    // intervals and color conversion spread over the worker pool. Created on
+    // the first MJPEG frame.
+    std::unique_ptr<WorkerPool> decodePool;
+    std::unique_ptr<MjpegDecoder> mjpegDecoder;
+
+    // Recording, started and stopped from the UI thread. recordMutex guards
+    // the recorder pointer against GetRecorderStats() on other threads, and
+    // recordedBytes keeps the bytes of recordings already finished.
+    mutable std::mutex recordMutex;
+    std::unique_ptr<SegmentedRecorder> recorder;
+    std::unique_ptr<FrameSubscriber> recordSubscriber;
+    std::thread recordThread;
+    std::atomic<bool> recordStop{ false };
+    uint64_t recordedBytes = 0;
+
+    // Feeds the recorder from recordSubscriber until recordStop
+    void RecordFrames();
+
+    // Pre-trigger history, started and stopped from the UI thread;
+    // historyMutex guards the history pointer as recordMutex does the
+    // recorder's.
+    mutable std::mutex historyMutex;
+    std::unique_ptr<FrameHistory> history;
+    std::unique_ptr<FrameSubscriber> historySubscriber;
+    std::thread historyThread;
+    std::atomic<bool> historyStop{ false };
+
+    // Feeds the history from historySubscriber until historyStop
+    void HistoryFrames();
+
+    // Opens and closes the source off the UI thread. The destructor shuts
+    // it down first so the device is closed before anything it uses.
+    std::unique_ptr<CameraOpener> opener;
+
+    // CameraDevice, called on the opener's worker thread
+    void AttachWorkerThread() override;
+    void DetachWorkerThread() override;
+    long OpenDevice(const std::wstring& path, CameraOpenContext& context) override;
+    void CloseDevice() override;
+
+    // CaptureSink, called on the source's streaming thread
+    void OnFrame(const VideoFormat& format, const uint8_t* data, size_t size, double sampleTime) override;
 
     // Helper methods
-    HRESULT AddFilterByCLSID(IGraphBuilder* pGraph, const GUID& clsid, IBaseFilter** ppF, const wchar_t* name);
-    HRESULT ConfigureSampleGrabber();
-    void Cleanup();
     HRESULT CreateTexture(int width, int height);
-
-    // SampleGrabber Callback
-    class SampleGrabberCallback : public ISampleGrabberCB {
-    public:
-        SampleGrabberCallback(WebcamController* controller) : controller(controller) {}
-
-        STDMETHODIMP SampleCB(double Time, IMediaSample* pSample) override {
-            return E_NOTIMPL;
-        }
-
-        STDMETHODIMP BufferCB(double Time, BYTE* pBuffer, long BufferLen) override {
-            std::lock_guard<std::mutex> lock(controller->frame_mutex);
-
-            if (controller->new_frame_ready.load()) {
-                return S_OK; // Avoid overwriting if the frame hasn't been processed yet
-            }
-
-            // Ensure back buffer texture is valid
-            if (!controller->m_backBufferTexture) {
-                return E_FAIL;  // No back buffer texture available
-            }
-
-            D3D11_MAPPED_SUBRESOURCE mappedResource;
-            HRESULT hr = controller->m_context->Map(controller->m_backBufferTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-            if (FAILED(hr)) {
-                return hr;
-            }
-
-            // Copy the buffer data to the back buffer texture
-            BYTE* mappedData = reinterpret_cast<BYTE*>(mappedResource.pData);
-            for (int y = 0; y < controller->Height; ++y) {
-                memcpy(mappedData + y * mappedResource.RowPitch, pBuffer + y * controller->Width * 3, controller->Width * 3);
-            }
-
-            controller->m_context->Unmap(controller->m_backBufferTexture.Get(), 0);
-
-            // Swap front and back buffers
-            std::swap(controller->m_texture, controller->m_backBufferTexture);
-
-            controller->new_frame_ready.store(true);
-
-            return S_OK;
-        }
-
-        STDMETHODIMP_(ULONG) AddRef() override {
-            return 1;
-        }
-
-        STDMETHODIMP_(ULONG) Release() override {
-            return 2;
-        }
-
-        STDMETHODIMP QueryInterface(REFIID riid, void** ppv) override {
-            if (riid == IID_ISampleGrabberCB || riid == IID_IUnknown) {
-                *ppv = static_cast<void*>(this);
-                return S_OK;
-            }
-            return E_NOINTERFACE;
-        }
-
-    private:
-        WebcamController* controller;
-    };
-
-    SampleGrabberCallback callback;
-    int Width, Height;
+    HRESULT UploadFrame(const VideoFrame& frame);
 };
-
@@ -0,0 +1,97 @@
+#include "WorkerPool.h"
+#include "Trace.h"
+#include "ThreadCpu.h"
+
+WorkerPool::WorkerPool(int workerCount) {
+    if (workerCount < 0) {
+        const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? static_cast<int>(hardwareThreads) - 1 : 0;
+    }
+
+    workers.reserve(workerCount);
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&WorkerPool::WorkerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::Run(int count, TaskFn fn, void* context) {
+    if (count <= 0) {
+        return;
+    }
+
+    // Nothing to share: run inline and skip the wake-up round trip.
+    if (count == 1 || workers.empty()) {
+        for (int i = 0; i < count; ++i) {
+            fn(context, i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    {
+        // A worker that woke up late for the previous job may still be
+        // looking at it; wait for it to leave before replacing the job.
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [this] { return activeWorkers == 0; });
+        jobFn = fn;
+        jobContext = context;
+        jobCount = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        pending.store(count, std::memory_order_relaxed);
+        ++generation;
+    }
+    wakeWorkers.notify_all();
+
+    RunTasks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+void WorkerPool::RunTasks() {
+    int index;
+    while ((index = nextIndex.fetch_add(1, std::memory_order_relaxed)) < jobCount) {
+        jobFn(jobContext, index);
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobDone.notify_all();
+        }
+    }
+}
+
+void WorkerPool::WorkerLoop() {
+    TRACE_THREAD_NAME("Worker");
+    RegisterThreadCpu("Worker");
+    uint64_t seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+            ++activeWorkers;
+        }
+        {
+            TRACE_SCOPE("WorkerPool tasks");
+            RunTasks();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --activeWorkers;
+        }
+        jobDone.notify_all();
+    }
+}
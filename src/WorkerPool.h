@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A small fixed set of worker threads for data-parallel loops such as decoding
+// independent JPEG restart intervals or converting bands of a frame. The
+// calling thread takes part in the work, so a pool of N threads runs N + 1
+// tasks at once. Submitting work does not allocate.
+class WorkerPool {
+public:
+    // workerCount < 0 picks one less than the number of hardware threads.
+    explicit WorkerPool(int workerCount = -1);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Threads that run tasks in ParallelFor, including the caller.
+    int Concurrency() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Call task(i) for every i in [0, count) and wait for all of them. Only one
+    // loop runs at a time; concurrent callers are serialized.
+    template <typename Task>
+    void ParallelFor(int count, Task&& task) {
+        using TaskType = typename std::remove_reference<Task>::type;
+        Run(count, [](void* context, int index) { (*static_cast<TaskType*>(context))(index); }, &task);
+    }
+
+private:
+    using TaskFn = void (*)(void* context, int index);
+
+    void Run(int count, TaskFn fn, void* context);
+    void WorkerLoop();
+    void RunTasks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex submitMutex;   // Serializes ParallelFor callers
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable jobDone;
+    bool stopping = false;
+    uint64_t generation = 0;
+    int activeWorkers = 0;    // Workers inside RunTasks()
+
+    // The job currently being run. Only changed under 'mutex' while no worker
+    // is active, so RunTasks() can read it without locking.
+    TaskFn jobFn = nullptr;
+    void* jobContext = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextIndex{ 0 };
+    std::atomic<int> pending{ 0 };
+};
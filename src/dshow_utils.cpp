@@ -88,13 +88,36 @@ HRESULT
 GetDeviceName(CLSID Category, int DeviceIndex, BSTR *pstrName)
 {
     CComPtr<IMoniker> pmk;
+    HRESULT hr = GetDeviceMoniker(Category, DeviceIndex, &pmk);
+    if (SUCCEEDED(hr))
+        hr = GetMonikerName(pmk, pstrName);
+    return hr;
+}
+
+HRESULT
+GetDeviceID(CLSID Category, int DeviceIndex, BSTR *pstrName)
+{
+    CComPtr<IMoniker> pmk;
+    HRESULT hr = GetDeviceMoniker(Category, DeviceIndex, &pmk);
+    if (SUCCEEDED(hr))
+        hr = GetMonikerID(pmk, pstrName);
+    return hr;
+}
+
+/**
+ *  Read the friendly name of a device from its moniker. Use this when
+ *  walking an enumerator, rather than GetDeviceName which enumerates all
+ *  devices again for every call.
+ */
+
+HRESULT
+GetMonikerName(IMoniker *pmk, BSTR *pstrName)
+{
     CComPtr<IBindCtx> pctx;
     CComPtr<IPropertyBag> pbag;
     CComVariant v;
 
-    HRESULT hr = GetDeviceMoniker(Category, DeviceIndex, &pmk);
-    if (SUCCEEDED(hr))
-        hr = CreateBindCtx(0, &pctx);
+    HRESULT hr = CreateBindCtx(0, &pctx);
     if (SUCCEEDED(hr))
         hr = pmk->BindToStorage(pctx, NULL, IID_IPropertyBag, reinterpret_cast<void**>(&pbag));
     if (SUCCEEDED(hr))
@@ -104,15 +127,40 @@ GetDeviceName(CLSID Category, int DeviceIndex, BSTR *pstrName)
     return hr;
 }
 
+/**
+ *  Get the moniker display name, which identifies the device across
+ *  enumerations and can be turned back into a moniker with MkParseDisplayName.
+ */
+
+HRESULT
+GetMonikerPath(IMoniker *pmk, BSTR *pstrPath)
+{
+    CComPtr<IBindCtx> pctx;
+    HRESULT hr = CreateBindCtx(0, &pctx);
+    if (SUCCEEDED(hr))
+    {
+        LPOLESTR ocsz = NULL;
+        hr = pmk->GetDisplayName(pctx, NULL, &ocsz);
+        if (SUCCEEDED(hr))
+        {
+            *pstrPath = ::SysAllocString(ocsz);
+            ::CoTaskMemFree(ocsz);
+        }
+    }
+    return hr;
+}
+
+/**
+ *  Get the short device ID (the serial number part of the device path) from
+ *  a moniker.
+ */
+
 HRESULT
-GetDeviceID(CLSID Category, int DeviceIndex, BSTR *pstrName)
+GetMonikerID(IMoniker *pmk, BSTR *pstrName)
 {
-    CComPtr<IMoniker> pmk;
     CComPtr<IBindCtx> pctx;
 
-    HRESULT hr = GetDeviceMoniker(Category, DeviceIndex, &pmk);
-    if (SUCCEEDED(hr))
-        hr = CreateBindCtx(0, &pctx);
+    HRESULT hr = CreateBindCtx(0, &pctx);
     if (SUCCEEDED(hr))
     {
         LPOLESTR ocsz = NULL, pstr = NULL;
@@ -30,6 +30,9 @@ HRESULT ShowPropertyPages(LPUNKNOWN Object, LPCOLESTR Caption = NULL, HWND hwnd
 HRESULT GetDeviceMoniker(CLSID Category, int DeviceIndex, IMoniker** ppMoniker);
 HRESULT GetDeviceName(CLSID Category, int DeviceIndex, BSTR* pstrName);
 HRESULT GetDeviceID(CLSID Category, int DeviceIndex, BSTR* pstrName);
+HRESULT GetMonikerName(IMoniker* pmk, BSTR* pstrName);
+HRESULT GetMonikerPath(IMoniker* pmk, BSTR* pstrPath);
+HRESULT GetMonikerID(IMoniker* pmk, BSTR* pstrName);
 
 HRESULT FindPinByName(IBaseFilter* pFilter, LPCWSTR sID, LPCWSTR sName, IPin** ppPin);
 HRESULT FindPinByCategory(IBaseFilter* pFilter, REFGUID Category, IPin** ppPin);
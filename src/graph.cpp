@@ -1,4 +1,5 @@
 #include "graph.h"
+#include <dvdmedia.h>
 
 #if _MSC_VER >= 100
 #pragma comment(lib, "amstrmid")
@@ -392,20 +393,98 @@ CreateCompatibleSampleGrabber(IBaseFilter **ppFilter)
     return hr;
 }
 
+// FOURCC 'I420'; uuids.h only defines the identical IYUV layout.
+static const GUID MEDIASUBTYPE_I420_FOURCC =
+    { 0x30323449, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+
+PixelFormat
+PixelFormatFromSubtype(REFGUID subtype)
+{
+    if (subtype == MEDIASUBTYPE_RGB24) return PixelFormat::BGR24;
+    if (subtype == MEDIASUBTYPE_RGB32) return PixelFormat::BGRA32;
+    if (subtype == MEDIASUBTYPE_YUY2) return PixelFormat::YUY2;
+    if (subtype == MEDIASUBTYPE_NV12) return PixelFormat::NV12;
+    if (subtype == MEDIASUBTYPE_IYUV || subtype == MEDIASUBTYPE_I420_FOURCC) return PixelFormat::I420;
+    if (subtype == MEDIASUBTYPE_MJPG) return PixelFormat::MJPEG;
+    return PixelFormat::Unknown;
+}
+
+// Frame size of a VIDEOINFOHEADER or VIDEOINFOHEADER2 media type.
+static BITMAPINFOHEADER *
+GetBitmapHeader(AM_MEDIA_TYPE *pmt)
+{
+    if (pmt->formattype == FORMAT_VideoInfo && pmt->cbFormat >= sizeof(VIDEOINFOHEADER) && pmt->pbFormat)
+        return &((VIDEOINFOHEADER *)pmt->pbFormat)->bmiHeader;
+    if (pmt->formattype == FORMAT_VideoInfo2 && pmt->cbFormat >= sizeof(VIDEOINFOHEADER2) && pmt->pbFormat)
+        return &((VIDEOINFOHEADER2 *)pmt->pbFormat)->bmiHeader;
+    return NULL;
+}
+
+// Record every mode of the pin once. Frame intervals are in 100ns units; the
+// shortest interval is the highest frame rate.
+HRESULT
+BuildCaptureCapabilities(IAMStreamConfig *pConfig, CaptureCapabilities *pCaps)
+{
+    int nCount = 0, nSize = 0;
+    HRESULT hr = pConfig->GetNumberOfCapabilities(&nCount, &nSize);
+    if (FAILED(hr))
+        return hr;
+    if (nSize != sizeof(VIDEO_STREAM_CONFIG_CAPS))
+        return E_UNEXPECTED;
+
+    pCaps->Clear();
+    for (int n = 0; n < nCount; n++)
+    {
+        VIDEO_STREAM_CONFIG_CAPS caps;
+        AM_MEDIA_TYPE *pmt = 0;
+        if (FAILED(pConfig->GetStreamCaps(n, &pmt, (LPBYTE)&caps)))
+            continue;
+
+        BITMAPINFOHEADER *pbmi = GetBitmapHeader(pmt);
+        if (pbmi)
+        {
+            CaptureMode mode;
+            mode.index = n;
+            mode.format = PixelFormatFromSubtype(pmt->subtype);
+            mode.width = pbmi->biWidth;
+            mode.height = pbmi->biHeight < 0 ? -pbmi->biHeight : pbmi->biHeight;
+            mode.maxFps = caps.MinFrameInterval > 0 ? 1e7 / caps.MinFrameInterval : 0.0;
+            mode.minFps = caps.MaxFrameInterval > 0 ? 1e7 / caps.MaxFrameInterval : mode.maxFps;
+            ATLTRACE(_T("caps: %d format: %d %dx%d %.1f-%.1f fps\n"), n, (int)mode.format,
+                mode.width, mode.height, mode.minFps, mode.maxFps);
+            pCaps->Add(mode);
+        }
+        FreeMediaType(pmt);
+    }
+    return S_OK;
+}
+
+HRESULT
+GetCaptureModeMediaType(IAMStreamConfig *pConfig, const CaptureMode &mode, double fps, AM_MEDIA_TYPE **ppmt)
+{
+    VIDEO_STREAM_CONFIG_CAPS caps;
+    HRESULT hr = pConfig->GetStreamCaps(mode.index, ppmt, (LPBYTE)&caps);
+    if (SUCCEEDED(hr) && fps > 0.0)
+    {
+        REFERENCE_TIME interval = (REFERENCE_TIME)(1e7 / fps + 0.5);
+        if ((*ppmt)->formattype == FORMAT_VideoInfo && (*ppmt)->cbFormat >= sizeof(VIDEOINFOHEADER))
+            ((VIDEOINFOHEADER *)(*ppmt)->pbFormat)->AvgTimePerFrame = interval;
+        else if ((*ppmt)->formattype == FORMAT_VideoInfo2 && (*ppmt)->cbFormat >= sizeof(VIDEOINFOHEADER2))
+            ((VIDEOINFOHEADER2 *)(*ppmt)->pbFormat)->AvgTimePerFrame = interval;
+    }
+    return hr;
+}
+
 HRESULT
 GetCaptureMediaFormat(IGraphBuilder *pGraph, int index, AM_MEDIA_TYPE **ppmt)
 {
-    CComPtr<IBaseFilter> pGrabberFilter;
     CComPtr<IAMStreamConfig> pConfig;
 
     HRESULT hr = FindGraphInterface(pGraph, CAPTURE_FILTER_NAME, IID_IAMStreamConfig, (void**)&pConfig);
     if (SUCCEEDED(hr))
     {
-        int nCount = 0, nSize = 0;
-        hr = pConfig->GetNumberOfCapabilities(&nCount, &nSize);
-
-        // If we were passed an index then return that media type. Otherwise we search for
-        // the best (ie: biggest) one.
+        // If we were passed an index then return that media type. Otherwise
+        // pick the largest mode, at its highest frame rate.
         if (index != -1)
         {
             VIDEO_STREAM_CONFIG_CAPS caps;
@@ -413,41 +492,17 @@ GetCaptureMediaFormat(IGraphBuilder *pGraph, int index, AM_MEDIA_TYPE **ppmt)
         }
         else
         {
-            AM_MEDIA_TYPE *pMediaType = 0;
-            ULONG nVideoSize = 0;
-
-            for (int n = 0; SUCCEEDED(hr) && n < nCount; n++)
+            CaptureCapabilities capabilities;
+            hr = BuildCaptureCapabilities(pConfig, &capabilities);
+            if (SUCCEEDED(hr))
             {
-                VIDEO_STREAM_CONFIG_CAPS caps;
-                AM_MEDIA_TYPE *pmt = 0;
-                ULONG nSize = 0;
-                hr = pConfig->GetStreamCaps(n, &pmt, (LPBYTE)&caps);
-                if (SUCCEEDED(hr))
-                {
-                    //ATLTRACE(_T("caps: %d cx: %d cy: %d\n"), n, caps.MaxOutputSize.cx, caps.MaxOutputSize.cy);
-                    if (pmt->formattype == FORMAT_VideoInfo && pmt->cbFormat > 0)
-                    {
-                        VIDEOINFOHEADER *pvih = (VIDEOINFOHEADER *)pmt->pbFormat;
-                        ATLTRACE(_T("pmt : %d cx: %d cy:%d bitcnt: %d\n"),
-                            n, pvih->bmiHeader.biWidth, pvih->bmiHeader.biHeight, pvih->bmiHeader.biBitCount);
-                        nSize = pvih->bmiHeader.biWidth * pvih->bmiHeader.biHeight;
-                    }
-                    if (nSize > nVideoSize)
-                    {
-                        ATLTRACE(_T("use index %d for return\n"), n);
-                        FreeMediaType(pMediaType);
-                        pMediaType = pmt;
-                        nVideoSize = nSize;
-                    }
-                    else 
-                    {
-                        FreeMediaType(pmt);
-                        if (nSize == nVideoSize && nSize != 0)
-                            break;
-                    }
-                }
+                double fps = 0.0;
+                int best = capabilities.Select(CapturePolicy(), &fps);
+                if (best < 0)
+                    hr = VFW_E_NO_ACCEPTABLE_TYPES;
+                else
+                    hr = GetCaptureModeMediaType(pConfig, capabilities.ModeFor(best, fps), fps, ppmt);
             }
-            *ppmt = pMediaType;
         }
     }
 
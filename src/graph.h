@@ -23,6 +23,7 @@
 #endif // HAVE_WMF_SDK
 
 #include "dshow_utils.h"
+#include "CaptureCapabilities.h"
 
 typedef enum EFilterIndices {
     CaptureFilterIndex,
@@ -55,6 +56,12 @@ HRESULT DisconnectPins(IBaseFilter* pFilter);
 HRESULT GetCaptureMediaFormat(IGraphBuilder* pGraph, int index, AM_MEDIA_TYPE** ppmt);
 void FreeMediaType(AM_MEDIA_TYPE* pmt);
 
+// Capability index of a capture pin, and the media type that selects one of
+// its modes at a given frame rate.
+PixelFormat PixelFormatFromSubtype(REFGUID subtype);
+HRESULT BuildCaptureCapabilities(IAMStreamConfig* pConfig, CaptureCapabilities* pCaps);
+HRESULT GetCaptureModeMediaType(IAMStreamConfig* pConfig, const CaptureMode& mode, double fps, AM_MEDIA_TYPE** ppmt);
+
 // Additional functions that were missing
 HRESULT CreateCompatibleSampleGrabber(IBaseFilter** ppFilter);
 HRESULT MediaType(LPCWSTR sPath, LPCGUID* ppMediaType, LPCGUID* ppMediaSubType);
@@ -4,18 +4,56 @@
 #include "libaries/imgui/backends/imgui_impl_dx11.h"
 #include "libaries/imgui/backends/imgui_impl_win32.h"
 #include <windows.h>
+#include <dbt.h>
+#include <ks.h>
+#include "AllocationTracker.h"
+#include "Log.h"
 #include "Renderer.h"
 #include "UIManager.h"
+#include "Trace.h"
+#include "ThreadCpu.h"
+#include "UiBenchmark.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 // Global variables
 HWND g_mainWindow = nullptr;
 Renderer renderer;
+UIManager* g_uiManager = nullptr;
 
 // Forward declarations
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-int main(int, char**) {
+int main(int argc, char** argv) {
+    // --ui-benchmark: time UIManager::Render() headless and print JSON
+    // --metrics [ADDRESS:]PORT: serve Prometheus metrics, on 127.0.0.1 by default
+    bool uiBenchmark = false;
+    std::string metricsAddress = "127.0.0.1";
+    int metricsPort = -1;
+    for (int i = 1; i < argc; ++i) {
+        uiBenchmark |= strcmp(argv[i], "--ui-benchmark") == 0;
+        if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            const std::string value = argv[++i];
+            const size_t colon = value.rfind(':');
+            if (colon != std::string::npos) {
+                metricsAddress = value.substr(0, colon);
+            }
+            const char* port = value.c_str() + (colon == std::string::npos ? 0 : colon + 1);
+            char* end = nullptr;
+            const long parsed = strtol(port, &end, 10);
+            if (end == port || *end != '\0' || parsed < 1 || parsed > 65535) {
+                LOG_ERROR("Main", "Ignoring --metrics %s: the port must be 1-65535", value.c_str());
+                metricsPort = -1;
+            }
+            else {
+                metricsPort = static_cast<int>(parsed);
+            }
+        }
+    }
+
     // Window class setup
     WNDCLASSEXW wc = {
         sizeof(wc),
@@ -43,6 +81,20 @@ int main(int, char**) {
         return 1;
     }
 
+    if (uiBenchmark) {
+        // The window stays hidden; the device is only needed by the camera code.
+        UiBenchmarkResult result;
+        {
+            UIManager uiManager(renderer.g_pd3dDevice, renderer.g_pd3dDeviceContext);
+            result = RunUiBenchmark(UiBenchmarkOptions(), [&uiManager](int) { uiManager.Render(); });
+        }
+        printf("%s\n", result.ToJson().c_str());
+        renderer.Cleanup();
+        DestroyWindow(g_mainWindow);
+        ::UnregisterClassW(wc.lpszClassName, wc.hInstance);
+        return 0;
+    }
+
     ::ShowWindow(g_mainWindow, SW_SHOWDEFAULT);
     ::UpdateWindow(g_mainWindow);
 
@@ -60,8 +112,22 @@ int main(int, char**) {
 
     // Initialize UIManager with Direct3D device and context
     UIManager uiManager(renderer.g_pd3dDevice, renderer.g_pd3dDeviceContext);
+    g_uiManager = &uiManager;
+    if (metricsPort >= 0 && !uiManager.StartMetrics(metricsAddress, metricsPort)) {
+        LOG_ERROR("Main", "Metrics are not served; nothing listens on %s:%d", metricsAddress.c_str(), metricsPort);
+    }
+
+    // Ask for arrival/removal notifications for capture devices so the
+    // camera list is only rescanned when it can have changed.
+    DEV_BROADCAST_DEVICEINTERFACE_W filter = {};
+    filter.dbcc_size = sizeof(filter);
+    filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+    filter.dbcc_classguid = KSCATEGORY_CAPTURE;
+    HDEVNOTIFY deviceNotify = ::RegisterDeviceNotificationW(g_mainWindow, &filter, DEVICE_NOTIFY_WINDOW_HANDLE);
 
     // Main loop
+    TRACE_THREAD_NAME("UI");
+    RegisterThreadCpu("UI");
     bool done = false;
     while (!done) {
         MSG msg;
@@ -75,6 +141,9 @@ int main(int, char**) {
         if (done)
             break;
 
+        // Everything the UI thread does for one frame
+        ALLOC_SCOPE("UI frame");
+
         // Start the ImGui frame
         ImGui_ImplDX11_NewFrame();
         ImGui_ImplWin32_NewFrame();
@@ -86,9 +155,15 @@ int main(int, char**) {
         // Rendering
         ImGui::Render();
         renderer.Render();
+        uiManager.OnPresented();
     }
 
     // Cleanup
+    if (deviceNotify) {
+        ::UnregisterDeviceNotification(deviceNotify);
+    }
+    g_uiManager = nullptr;
+
     ImGui_ImplDX11_Shutdown();
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
@@ -114,6 +189,12 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         if ((wParam & 0xfff0) == SC_KEYMENU)
             return 0;
         break;
+    case WM_DEVICECHANGE:
+        if (g_uiManager != nullptr &&
+            (wParam == DBT_DEVICEARRIVAL || wParam == DBT_DEVICEREMOVECOMPLETE || wParam == DBT_DEVNODES_CHANGED)) {
+            g_uiManager->OnDeviceChange();
+        }
+        return TRUE;
     case WM_DESTROY:
         ::PostQuitMessage(0);
         return 0;